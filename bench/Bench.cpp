@@ -0,0 +1,302 @@
+/**
+ * @file Bench.cpp
+ *
+ * @brief Minimal microbenchmark harness implementation
+ */
+
+#include "Bench.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <stdexcept>
+
+
+namespace emodlib
+{
+
+    namespace bench
+    {
+
+        State::State(size_t _iterations)
+            : iterations(_iterations)
+            , items_per_iteration(0)
+            , counters()
+            , started()
+            , elapsed(0)
+            , running(false)
+        {
+
+        }
+
+        size_t State::Iterations() const
+        {
+            return iterations;
+        }
+
+        void State::start()
+        {
+            started = Clock::now();
+            running = true;
+        }
+
+        void State::stop()
+        {
+            if (running)
+            {
+                elapsed += std::chrono::duration<double>(Clock::now() - started).count();
+                running = false;
+            }
+        }
+
+        void State::PauseTiming()
+        {
+            stop();
+        }
+
+        void State::ResumeTiming()
+        {
+            start();
+        }
+
+        void State::SetItemsPerIteration(double items)
+        {
+            items_per_iteration = items;
+        }
+
+        void State::SetCounter(const std::string& name, double value)
+        {
+            counters[name] = value;
+        }
+
+
+        double Result::Median() const
+        {
+            std::vector<double> sorted(ns_per_iteration);
+            std::sort(sorted.begin(), sorted.end());
+            size_t n = sorted.size();
+            return (n % 2) ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+        }
+
+        double Result::Min() const
+        {
+            return *std::min_element(ns_per_iteration.begin(), ns_per_iteration.end());
+        }
+
+        double Result::Mean() const
+        {
+            double sum = 0;
+            for (double ns : ns_per_iteration) sum += ns;
+            return sum / ns_per_iteration.size();
+        }
+
+        double Result::Stddev() const
+        {
+            if (ns_per_iteration.size() < 2) return 0;
+
+            double mean = Mean(), sum = 0;
+            for (double ns : ns_per_iteration) sum += (ns - mean) * (ns - mean);
+            return std::sqrt(sum / (ns_per_iteration.size() - 1));
+        }
+
+
+        Options::Options()
+            : filter()
+            , min_time(0.2)
+            , repetitions(5)
+            , json_path()
+            , list(false)
+        {
+
+        }
+
+
+        void Runner::Add(const std::string& name, Function function, size_t fixed_iterations)
+        {
+            entries.push_back(Entry{ name, function, fixed_iterations });
+        }
+
+        void Runner::SetContext(const std::string& key, const std::string& value)
+        {
+            context.push_back(std::make_pair(key, value));
+        }
+
+        Options Runner::ParseOptions(std::vector<std::string>& args)
+        {
+            Options options;
+            std::vector<std::string> rest;
+
+            for (const std::string& arg : args)
+            {
+                auto value = [&arg](const char* prefix) { return arg.substr(std::string(prefix).size()); };
+
+                if (arg.rfind("--filter=", 0) == 0) options.filter = value("--filter=");
+                else if (arg.rfind("--min_time=", 0) == 0) options.min_time = std::stod(value("--min_time="));
+                else if (arg.rfind("--repetitions=", 0) == 0) options.repetitions = std::max(1, std::stoi(value("--repetitions=")));
+                else if (arg.rfind("--json=", 0) == 0) options.json_path = value("--json=");
+                else if (arg == "--list") options.list = true;
+                else rest.push_back(arg);
+            }
+
+            args.swap(rest);
+            return options;
+        }
+
+        Result Runner::measure(const Entry& entry, const Options& options) const
+        {
+            // double the iterations until one run takes min_time, as the first (warm-up) run
+            size_t iterations = entry.fixed_iterations ? entry.fixed_iterations : 1;
+            while (true)
+            {
+                State state(iterations);
+                state.start();
+                entry.function(state);
+                state.stop();
+
+                if (entry.fixed_iterations || state.elapsed >= options.min_time || iterations >= (size_t(1) << 40)) break;
+
+                // aim straight for min_time once the timing is meaningful
+                double factor = (state.elapsed > 1e-3) ? 1.4 * options.min_time / state.elapsed : 10.0;
+                iterations = size_t(std::ceil(iterations * std::min(10.0, std::max(2.0, factor))));
+            }
+
+            Result result{ entry.name, iterations, {}, 0, {} };
+            for (int r = 0; r < options.repetitions; r++)
+            {
+                State state(iterations);
+                state.start();
+                entry.function(state);
+                state.stop();
+
+                result.ns_per_iteration.push_back(1e9 * state.elapsed / iterations);
+                result.items_per_iteration = state.items_per_iteration;
+                result.counters = state.counters;
+            }
+
+            return result;
+        }
+
+        static std::string escaped(const std::string& text)
+        {
+            std::string out;
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\') out += '\\';
+                out += c;
+            }
+            return out;
+        }
+
+        // JSON has no nan or inf, e.g. for a counter divided by zero
+        static std::string number(double value)
+        {
+            char text[32];
+            snprintf(text, sizeof(text), "%.6g", value);
+            return std::isfinite(value) ? text : "null";
+        }
+
+        void Runner::writeJson(const std::vector<Result>& results, std::ostream& out) const
+        {
+            char date[32];
+            time_t now = time(nullptr);
+            strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+            out << "{\n  \"context\": {\n    \"date\": \"" << date << "\"";
+            for (const auto& kv : context)
+            {
+                out << ",\n    \"" << escaped(kv.first) << "\": \"" << escaped(kv.second) << "\"";
+            }
+            out << "\n  },\n  \"benchmarks\": [";
+
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                const Result& r = results[i];
+                out << (i ? "," : "") << "\n    {\"name\": \"" << escaped(r.name) << "\", \"iterations\": " << r.iterations
+                    << ", \"repetitions\": " << r.ns_per_iteration.size() << ", \"median_ns\": " << number(r.Median())
+                    << ", \"min_ns\": " << number(r.Min()) << ", \"mean_ns\": " << number(r.Mean())
+                    << ", \"stddev_ns\": " << number(r.Stddev());
+                if (r.items_per_iteration > 0)
+                {
+                    out << ", \"items_per_second\": " << number(1e9 * r.items_per_iteration / r.Median());
+                }
+                for (const auto& kv : r.counters)
+                {
+                    out << ", \"" << escaped(kv.first) << "\": " << number(kv.second);
+                }
+                out << "}";
+            }
+            out << "\n  ]\n}\n";
+        }
+
+        static std::string readable(double ns)
+        {
+            char text[32];
+            if (ns < 1e3) snprintf(text, sizeof(text), "%.1f ns", ns);
+            else if (ns < 1e6) snprintf(text, sizeof(text), "%.2f us", ns / 1e3);
+            else if (ns < 1e9) snprintf(text, sizeof(text), "%.2f ms", ns / 1e6);
+            else snprintf(text, sizeof(text), "%.2f s", ns / 1e9);
+            return text;
+        }
+
+        int Runner::Run(const Options& options)
+        {
+            std::regex pattern(options.filter.empty() ? std::string(".*") : options.filter);
+
+            std::vector<const Entry*> selected;
+            for (const Entry& entry : entries)
+            {
+                if (std::regex_search(entry.name, pattern)) selected.push_back(&entry);
+            }
+
+            if (options.list)
+            {
+                for (const Entry* entry : selected) printf("%s\n", entry->name.c_str());
+                return 0;
+            }
+
+            if (selected.empty())
+            {
+                fprintf(stderr, "No benchmark matches '%s'\n", options.filter.c_str());
+                return 1;
+            }
+
+            // the table goes to stderr when the JSON takes stdout
+            FILE* table = (options.json_path == "-") ? stderr : stdout;
+            fprintf(table, "%-48s %12s %12s %12s %14s\n", "benchmark", "median", "min", "stddev", "items/s");
+
+            std::vector<Result> results;
+            for (const Entry* entry : selected)
+            {
+                Result r = measure(*entry, options);
+
+                char rate[32] = "";
+                if (r.items_per_iteration > 0) snprintf(rate, sizeof(rate), "%.4g", 1e9 * r.items_per_iteration / r.Median());
+
+                fprintf(table, "%-48s %12s %12s %12s %14s\n", r.name.c_str(),
+                        readable(r.Median()).c_str(), readable(r.Min()).c_str(), readable(r.Stddev()).c_str(), rate);
+                fflush(table);
+
+                results.push_back(r);
+            }
+
+            if (options.json_path == "-")
+            {
+                writeJson(results, std::cout);
+            }
+            else if (!options.json_path.empty())
+            {
+                std::ofstream file(options.json_path);
+                if (!file) throw std::runtime_error("Cannot write benchmark results to " + options.json_path);
+                writeJson(results, file);
+            }
+
+            return 0;
+        }
+
+    }
+
+}
@@ -0,0 +1,128 @@
+/**
+ * @file Bench.h
+ *
+ * @brief Minimal microbenchmark harness: calibrated timing loops, repetitions and JSON results
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+namespace emodlib
+{
+
+    namespace bench
+    {
+
+        // Handed to each benchmark, which runs its body Iterations() times.
+        // Setup inside the loop is excluded between PauseTiming and ResumeTiming.
+        class State
+        {
+
+        public:
+
+            explicit State(size_t _iterations);
+
+            size_t Iterations() const;
+
+            void PauseTiming();
+            void ResumeTiming();
+
+            // Work per iteration (draws, hosts, updates), reported as a rate
+            void SetItemsPerIteration(double items);
+
+            // Free-form counters reported with the result, e.g. parasite density reached
+            void SetCounter(const std::string& name, double value);
+
+        private:
+
+            friend class Runner;
+
+            typedef std::chrono::steady_clock Clock;
+
+            size_t iterations;
+            double items_per_iteration;
+            std::map<std::string, double> counters;
+
+            Clock::time_point started;
+            double elapsed;  // seconds, excluding paused intervals
+            bool running;
+
+            void start();
+            void stop();
+
+        };
+
+
+        typedef std::function<void(State&)> Function;
+
+        struct Result
+        {
+            std::string name;
+            size_t iterations;
+            std::vector<double> ns_per_iteration;  // one per repetition
+            double items_per_iteration;
+            std::map<std::string, double> counters;
+
+            double Median() const;
+            double Min() const;
+            double Mean() const;
+            double Stddev() const;
+        };
+
+
+        struct Options
+        {
+            std::string filter;     // regular expression on benchmark names, empty for all
+            double min_time;        // seconds per repetition, reached by doubling the iteration count
+            int repetitions;
+            std::string json_path;  // "-" for stdout, empty for none
+            bool list;
+
+            Options();
+        };
+
+
+        class Runner
+        {
+
+        public:
+
+            // Registers a benchmark; a fixed iteration count skips calibration for end-to-end scenarios
+            void Add(const std::string& name, Function function, size_t fixed_iterations=0);
+
+            // Extra key-value pairs for the JSON context (build configuration, problem sizes)
+            void SetContext(const std::string& key, const std::string& value);
+
+            // Parses --filter=, --min_time=, --repetitions=, --json= and --list, leaving other arguments in args
+            static Options ParseOptions(std::vector<std::string>& args);
+
+            // Runs the matching benchmarks, printing a table as it goes; returns 0, or 1 if nothing matched
+            int Run(const Options& options);
+
+        private:
+
+            struct Entry
+            {
+                std::string name;
+                Function function;
+                size_t fixed_iterations;
+            };
+
+            std::vector<Entry> entries;
+            std::vector<std::pair<std::string, std::string>> context;
+
+            Result measure(const Entry& entry, const Options& options) const;
+            void writeJson(const std::vector<Result>& results, std::ostream& out) const;
+
+        };
+
+    }
+
+}
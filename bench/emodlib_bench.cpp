@@ -0,0 +1,346 @@
+/**
+ * @file emodlib_bench.cpp
+ *
+ * @brief Microbenchmarks of the model's hot paths and end-to-end scenarios
+ *
+ * Usage: emodlib_bench [--filter=regex] [--min_time=s] [--repetitions=n] [--json=path|-] [--list]
+ *                      [--config=config.yml] [--hosts=n] [--threads=n]
+ */
+
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "emodlib/malaria/InfectionMalaria.h"
+#include "emodlib/malaria/IntrahostComponent.h"
+#include "emodlib/malaria/Malaria.h"
+#include "emodlib/malaria/Population.h"
+#include "emodlib/malaria/SusceptibilityMalaria.h"
+#include "emodlib/utils/Instrumentation.h"
+#include "emodlib/utils/Precision.h"
+#include "emodlib/utils/RANDOM.h"
+
+#include "Bench.h"
+
+using namespace emodlib;
+using namespace emodlib::malaria;
+using emodlib::bench::State;
+
+#define STRINGIFY(x) #x
+#define MACRO_STRINGIFY(x) STRINGIFY(x)
+
+
+namespace
+{
+
+    const size_t RNG_CACHE = 1024;
+
+    // The cache refill steps are protected; the benchmarks call them directly
+    class BenchStream : public PSEUDO_DES
+    {
+    public:
+        BenchStream() : PSEUDO_DES(12345, RNG_CACHE) {}
+        void FillBits() { fill_bits(); }
+        void BitsToFloat() { bits_to_float(); }
+    };
+
+
+    IntrahostParamsPtr params;
+    int n_hosts = 1000000;
+    int n_threads = 1;
+
+
+    // ==== Random numbers ==== //
+
+    void rng_fill_bits(State& state)
+    {
+        BenchStream rng;
+        rng.e();  // allocate the cache
+        for (size_t i = 0; i < state.Iterations(); i++) rng.FillBits();
+        state.SetItemsPerIteration(RNG_CACHE);
+    }
+
+    void rng_bits_to_float(State& state)
+    {
+        BenchStream rng;
+        rng.e();
+        for (size_t i = 0; i < state.Iterations(); i++) rng.BitsToFloat();
+        state.SetItemsPerIteration(RNG_CACHE);
+    }
+
+    void rng_e(State& state)
+    {
+        PSEUDO_DES rng(12345, RNG_CACHE);
+        float sum = 0;
+        for (size_t i = 0; i < state.Iterations(); i++) sum += rng.e();
+        state.SetCounter("mean", sum / state.Iterations());
+        state.SetItemsPerIteration(1);
+    }
+
+    void rng_eGauss(State& state)
+    {
+        PSEUDO_DES rng(12345, RNG_CACHE);
+        double sum = 0;
+        for (size_t i = 0; i < state.Iterations(); i++) sum += rng.eGauss();
+        state.SetCounter("mean", sum / state.Iterations());
+        state.SetItemsPerIteration(1);
+    }
+
+    bench::Function rng_Poisson(double rate)
+    {
+        return [rate](State& state)
+        {
+            PSEUDO_DES rng(12345, RNG_CACHE);
+            uint64_t sum = 0;
+            for (size_t i = 0; i < state.Iterations(); i++) sum += rng.Poisson(rate);
+            state.SetCounter("mean", double(sum) / state.Iterations());
+            state.SetItemsPerIteration(1);
+        };
+    }
+
+
+    // ==== Infection::Update, one phase at a time ==== //
+
+    // A single-infection host advanced to the start of the phase; each iteration updates the infection of a fresh copy
+    bench::Function infection_update(float day)
+    {
+        return [day](State& state)
+        {
+            state.PauseTiming();
+
+            std::unique_ptr<IntrahostComponent> host(IntrahostComponent::Create(params, IntrahostComponent::CreateHostStream(params->randomSeed, 0)));
+            host->Challenge();
+            for (float t = 0; t < day; t += 1.0f) host->Update(1.0f);
+            if (host->GetNumInfections() != 1) throw std::logic_error("Infection cleared before the benchmarked phase");
+
+            const size_t batch = 256;
+            std::vector<std::unique_ptr<IntrahostComponent>> copies;
+            std::vector<Infection*> infections;
+
+            for (size_t done = 0; done < state.Iterations(); done += batch)
+            {
+                size_t n = std::min(batch, state.Iterations() - done);
+
+                copies.clear();
+                infections.clear();
+                for (size_t i = 0; i < n; i++)
+                {
+                    copies.emplace_back(host->Clone());
+                    infections.push_back(copies.back()->GetInfections().front());
+                }
+
+                state.ResumeTiming();
+                for (Infection* infection : infections) infection->Update(1.0f);
+                state.PauseTiming();
+            }
+
+            state.SetCounter("parasite_density", host->GetParasiteDensity());
+            state.SetCounter("gametocyte_density", host->GetGametocyteDensity());
+            state.SetItemsPerIteration(1);
+            state.ResumeTiming();
+        };
+    }
+
+
+    // ==== Susceptibility::Update with n registered antibodies ==== //
+
+    bench::Function susceptibility_update(int n_antibodies, bool stimulated)
+    {
+        return [n_antibodies, stimulated](State& state)
+        {
+            state.PauseTiming();
+
+            std::unique_ptr<Susceptibility> susceptibility(Susceptibility::Create(params));
+
+            // an MSP antibody for every ten PfEMP1 antibodies, which are split between minor and major epitopes
+            std::vector<IMalariaAntibody*> antibodies;
+            for (int i = 0; i < n_antibodies; i++)
+            {
+                MalariaAntibodyType::Enum type = (i % 11 == 0) ? MalariaAntibodyType::MSP1
+                                               : (i % 2) ? MalariaAntibodyType::PfEMP1_minor : MalariaAntibodyType::PfEMP1_major;
+                antibodies.push_back(susceptibility->RegisterAntibody(type, i, real_t(0.1) + real_t(0.8) * (i % 7) / 7));
+            }
+
+            state.ResumeTiming();
+            for (size_t i = 0; i < state.Iterations(); i++)
+            {
+                // antigen from IRBCs of half the variants, as Infection::malariaImmuneStimulation would report it
+                if (stimulated)
+                {
+                    susceptibility->SetAntigenPresent();
+                    for (int j = 0; j < n_antibodies; j += 2)
+                    {
+                        antibodies[j]->IncreaseAntigenCount(100000);
+                        antibodies[j]->SetAntigenicPresence(true);
+                    }
+                }
+                susceptibility->Update(1.0f);
+            }
+
+            state.SetItemsPerIteration(1);
+        };
+    }
+
+
+    // ==== End-to-end scenarios ==== //
+
+    // One naive host through a 300-day challenge
+    void scenario_naive_challenge(State& state)
+    {
+        float density = 0;
+        for (size_t i = 0; i < state.Iterations(); i++)
+        {
+            std::unique_ptr<IntrahostComponent> host(IntrahostComponent::Create(params, IntrahostComponent::CreateHostStream(params->randomSeed, int(i))));
+            host->Challenge();
+            for (int t = 0; t < 300; t++) host->Update(1.0f);
+            density += host->GetParasiteDensity();
+        }
+        state.SetCounter("mean_final_density", density / state.Iterations());
+        state.SetItemsPerIteration(300);  // host-days
+    }
+
+    // One host challenged every 30 days for two years, accumulating antibodies and concurrent infections
+    void scenario_repeated_challenge(State& state)
+    {
+        int infections = 0;
+        for (size_t i = 0; i < state.Iterations(); i++)
+        {
+            std::unique_ptr<IntrahostComponent> host(IntrahostComponent::Create(params, IntrahostComponent::CreateHostStream(params->randomSeed, int(i))));
+            for (int t = 0; t < 730; t++)
+            {
+                if (t % 30 == 0) host->Challenge();
+                host->Update(1.0f);
+            }
+            infections += host->GetNumInfections();
+        }
+        state.SetCounter("mean_final_infections", double(infections) / state.Iterations());
+        state.SetItemsPerIteration(730);
+    }
+
+    // One day of a large population in which a tenth of the hosts were challenged a month ago
+    void scenario_population_day(State& state)
+    {
+        static std::unique_ptr<Population> population;  // built once across calibration and repetitions
+
+        state.PauseTiming();
+        if (!population)
+        {
+            // through the population, so that the challenged hosts leave the uninfected partition and its cheap kernel
+            population.reset(Population::Create(n_hosts, n_threads, params));
+            for (int i = 0; i < n_hosts; i += 10) population->Challenge(i);
+            for (int t = 0; t < 30; t++) population->Update(1.0f);
+        }
+        state.ResumeTiming();
+
+        for (size_t i = 0; i < state.Iterations(); i++) population->Update(1.0f);
+
+        state.SetCounter("infected_hosts", n_hosts - int(population->GetPartition(HostPartition::Uninfected).size()));
+        state.SetCounter("hosts", n_hosts);
+        state.SetCounter("threads", n_threads);
+        state.SetItemsPerIteration(n_hosts);  // host-days
+    }
+
+
+    // Totals over every benchmark run, when built with EMODLIB_INSTRUMENTATION
+    void print_instrumentation(FILE* out)
+    {
+        bool hardware = Instrumentation::HardwareAvailable();
+
+        fprintf(out, "\n%-32s %14s %16s %12s", "phase", "calls", Instrumentation::ClockName(), "per call");
+        if (hardware) fprintf(out, " %8s %14s %14s", "IPC", "LLC miss/call", "br miss/call");
+        fprintf(out, "\n");
+
+        for (const auto& p : Instrumentation::GetPhaseStats())
+        {
+            double calls = p.calls ? double(p.calls) : 1.0;
+            fprintf(out, "%-32s %14llu %16llu %12.1f", p.name.c_str(), (unsigned long long)p.calls,
+                    (unsigned long long)p.cycles, p.cycles / calls);
+            if (hardware)
+            {
+                double cycles = p.hardware[HardwareCounter::Cycles] ? double(p.hardware[HardwareCounter::Cycles]) : 1.0;
+                fprintf(out, " %8.2f %14.2f %14.2f", p.hardware[HardwareCounter::Instructions] / cycles,
+                        p.hardware[HardwareCounter::LLCMisses] / calls, p.hardware[HardwareCounter::BranchMisses] / calls);
+            }
+            fprintf(out, "\n");
+        }
+
+        fprintf(out, "\n%-32s %14s\n", "random draw", "count");
+        for (const auto& d : Instrumentation::GetDrawStats())
+        {
+            fprintf(out, "%-32s %14llu\n", d.name.c_str(), (unsigned long long)d.count);
+        }
+    }
+
+}
+
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+    bench::Options options = bench::Runner::ParseOptions(args);
+
+    std::string config = EMODLIB_BENCH_CONFIG;
+    n_threads = std::max(1, int(std::thread::hardware_concurrency()));
+
+    for (const std::string& arg : args)
+    {
+        if (arg.rfind("--config=", 0) == 0) config = arg.substr(9);
+        else if (arg.rfind("--hosts=", 0) == 0) n_hosts = std::stoi(arg.substr(8));
+        else if (arg.rfind("--threads=", 0) == 0) n_threads = std::stoi(arg.substr(10));
+        else
+        {
+            fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    params = IntrahostParams::CreateFromFile(config);
+    IntrahostParams::SetDefaults(params);
+    IntrahostComponent::p_rng = std::shared_ptr<RANDOMBASE>(new PSEUDO_DES(params->randomSeed, 256));
+
+    bench::Runner runner;
+    runner.SetContext("precision", EMODLIB_PRECISION_NAME);
+    runner.SetContext("pfemp1_variants", MACRO_STRINGIFY(CLONAL_PfEMP1_VARIANTS));
+    runner.SetContext("config", config);
+    runner.SetContext("hosts", std::to_string(n_hosts));
+    runner.SetContext("threads", std::to_string(n_threads));
+    runner.SetContext("instrumentation", Instrumentation::Enabled() ? "on" : "off");
+    runner.SetContext("perf_counters", Instrumentation::HardwareAvailable() ? "on" : "off");
+#ifdef NDEBUG
+    runner.SetContext("build", "release");
+#else
+    runner.SetContext("build", "debug");
+#endif
+
+    runner.Add("rng/fill_bits", rng_fill_bits);
+    runner.Add("rng/bits_to_float", rng_bits_to_float);
+    runner.Add("rng/e", rng_e);
+    runner.Add("rng/eGauss", rng_eGauss);
+    runner.Add("rng/Poisson/3", rng_Poisson(3.0));
+    runner.Add("rng/Poisson/300", rng_Poisson(300.0));
+
+    // fixed counts, since every timed update needs an untimed copy of the host
+    const size_t infection_updates = 20000;
+    runner.Add("infection/update/liver", infection_update(2), infection_updates);
+    runner.Add("infection/update/emerging", infection_update(10), infection_updates);
+    runner.Add("infection/update/peak", infection_update(18), infection_updates);
+    runner.Add("infection/update/chronic", infection_update(60), infection_updates);
+
+    for (int n : { 10, 100, 1000 })
+    {
+        runner.Add("susceptibility/update/decay/" + std::to_string(n), susceptibility_update(n, false));
+        runner.Add("susceptibility/update/stimulated/" + std::to_string(n), susceptibility_update(n, true));
+    }
+
+    runner.Add("scenario/naive_challenge", scenario_naive_challenge);
+    runner.Add("scenario/repeated_challenge", scenario_repeated_challenge);
+    runner.Add("scenario/population_day", scenario_population_day);
+
+    int status = runner.Run(options);
+    if (Instrumentation::Enabled() && !options.list) print_instrumentation(stderr);
+
+    return status;
+}
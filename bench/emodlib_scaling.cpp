@@ -0,0 +1,364 @@
+/**
+ * @file emodlib_scaling.cpp
+ *
+ * @brief Population scaling sweeps over hosts, infections per host and threads, for capacity planning
+ *
+ * Usage: emodlib_scaling [--sweep=hosts,infections,strong,weak] [--hosts=1000,10000,...] [--infections=0,1,3,5]
+ *                        [--threads=1,2,4] [--sweep_hosts=n] [--weak_hosts=n] [--days=n] [--config=config.yml]
+ *                        [--csv=path|-] [--json=path|-] [--trace=path]
+ *
+ * Every run is seeded by Run_Number, so repeated sweeps simulate identical populations.
+ * --trace writes a Chrome trace of the measured steps of the last run, for chrome://tracing or Perfetto.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "emodlib/ConfigFile.h"
+#include "emodlib/malaria/IntrahostComponent.h"
+#include "emodlib/malaria/Malaria.h"
+#include "emodlib/malaria/Population.h"
+#include "emodlib/utils/Precision.h"
+#include "emodlib/utils/Tracer.h"
+
+using namespace emodlib;
+using namespace emodlib::malaria;
+
+#define STRINGIFY(x) #x
+#define MACRO_STRINGIFY(x) STRINGIFY(x)
+
+
+namespace
+{
+
+    typedef std::chrono::steady_clock Clock;
+
+    const int CHALLENGE_INTERVAL = 7;  // days between the challenges of one host, so its infections overlap
+    const int SETTLING_DAYS = 14;      // after the last challenge, so every infection has left the liver
+
+    bool tracing = false;
+
+
+    struct Run
+    {
+        std::string sweep;
+        int hosts;
+        int challenges;       // per host, requested
+        double infections;    // per host, mean over the measured days
+        int threads;
+        int days;
+
+        double setup_seconds;
+        double host_days_per_second;
+        double bytes_per_host;
+        double step_p50_ms;
+        double step_p90_ms;
+        double step_p99_ms;
+        double step_max_ms;
+        double efficiency;    // scaling efficiency against the one-thread run of the sweep, else 0
+    };
+
+
+    // Resident set of the process, after handing freed pages back where the allocator allows it
+    double resident_bytes()
+    {
+#ifdef __GLIBC__
+        malloc_trim(0);
+#endif
+#ifdef __linux__
+        std::ifstream statm("/proc/self/statm");
+        long pages = 0, resident = 0;
+        if (statm >> pages >> resident) return double(resident) * sysconf(_SC_PAGESIZE);
+#endif
+        return 0;
+    }
+
+    double percentile(std::vector<double> values, double p)
+    {
+        std::sort(values.begin(), values.end());
+        size_t i = size_t(p * (values.size() - 1) + 0.5);
+        return values[std::min(i, values.size() - 1)];
+    }
+
+
+    // Every host challenged `challenges` times a week apart, then measured over `days` once the infections are in the blood
+    Run simulate(const std::string& sweep, IntrahostParamsPtr params, int hosts, int challenges, int threads, int days)
+    {
+        // trace buffers are left out, as they come and go with --trace
+        double baseline = resident_bytes() - double(Tracer::GetNumBytes());
+
+        Clock::time_point started = Clock::now();
+        std::unique_ptr<Population> population(Population::Create(hosts, threads, params));
+
+        int warmup = challenges ? CHALLENGE_INTERVAL * (challenges - 1) + SETTLING_DAYS : 1;
+        for (int t = 0; t < warmup; t++)
+        {
+            if (challenges && t % CHALLENGE_INTERVAL == 0 && t / CHALLENGE_INTERVAL < challenges)
+            {
+                for (int i = 0; i < hosts; i++) population->Challenge(i);
+            }
+            population->Update(1.0f);
+        }
+        double setup = std::chrono::duration<double>(Clock::now() - started).count();
+
+        std::vector<double> steps;
+        double infections = 0;
+        if (tracing) Tracer::Start();  // each run replaces the last, so the file holds the final one
+        for (int t = 0; t < days; t++)
+        {
+            Clock::time_point step = Clock::now();
+            population->Update(1.0f);
+            steps.push_back(std::chrono::duration<double>(Clock::now() - step).count());
+
+            // untimed, once per day
+            for (int i = 0; i < hosts; i++) infections += population->GetHost(i)->GetNumInfections();
+        }
+        Tracer::Stop();
+
+        double total = 0;
+        for (double s : steps) total += s;
+
+        Run run;
+        run.sweep = sweep;
+        run.hosts = hosts;
+        run.challenges = challenges;
+        run.infections = infections / (double(hosts) * days);
+        run.threads = threads;
+        run.days = days;
+        run.setup_seconds = setup;
+        run.host_days_per_second = double(hosts) * days / total;
+        run.bytes_per_host = std::max(0.0, resident_bytes() - double(Tracer::GetNumBytes()) - baseline) / hosts;
+        run.step_p50_ms = 1e3 * percentile(steps, 0.50);
+        run.step_p90_ms = 1e3 * percentile(steps, 0.90);
+        run.step_p99_ms = 1e3 * percentile(steps, 0.99);
+        run.step_max_ms = 1e3 * percentile(steps, 1.00);
+        run.efficiency = 0;
+
+        fprintf(stderr, "%-10s hosts=%-9d infections=%-5.2f threads=%-3d %12.4g host-days/s  %8.0f B/host  p99 %.2f ms\n",
+                sweep.c_str(), hosts, run.infections, threads, run.host_days_per_second, run.bytes_per_host, run.step_p99_ms);
+
+        return run;
+    }
+
+    // Throughput per thread relative to one thread: strong scaling at fixed hosts, weak scaling at fixed hosts per thread
+    void set_efficiency(std::vector<Run>& runs, const std::string& sweep)
+    {
+        double single = 0;
+        for (const Run& run : runs)
+        {
+            if (run.sweep == sweep && run.threads == 1) single = run.host_days_per_second;
+        }
+        if (single <= 0) return;
+
+        for (Run& run : runs)
+        {
+            if (run.sweep == sweep) run.efficiency = run.host_days_per_second / (run.threads * single);
+        }
+    }
+
+
+    std::vector<int> parse_list(const std::string& text)
+    {
+        std::vector<int> values;
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ','))
+        {
+            values.push_back(int(std::stod(item)));  // so 1e6 reads as a host count
+        }
+        return values;
+    }
+
+    bool contains(const std::vector<std::string>& list, const std::string& item)
+    {
+        return std::find(list.begin(), list.end(), item) != list.end();
+    }
+
+    std::vector<std::string> split(const std::string& text)
+    {
+        std::vector<std::string> items;
+        std::stringstream stream(text);
+        std::string item;
+        while (std::getline(stream, item, ',')) items.push_back(item);
+        return items;
+    }
+
+
+    const char* COLUMNS = "sweep,hosts,challenges,infections_per_host,threads,days,setup_seconds,host_days_per_second,"
+                          "bytes_per_host,step_p50_ms,step_p90_ms,step_p99_ms,step_max_ms,efficiency";
+
+    std::string row(const Run& r)
+    {
+        char line[512];
+        snprintf(line, sizeof(line), "%s,%d,%d,%.4g,%d,%d,%.4g,%.6g,%.6g,%.4g,%.4g,%.4g,%.4g,%.4g",
+                 r.sweep.c_str(), r.hosts, r.challenges, r.infections, r.threads, r.days, r.setup_seconds,
+                 r.host_days_per_second, r.bytes_per_host, r.step_p50_ms, r.step_p90_ms, r.step_p99_ms, r.step_max_ms, r.efficiency);
+        return line;
+    }
+
+    void write_csv(const std::vector<Run>& runs, std::ostream& out)
+    {
+        out << COLUMNS << "\n";
+        for (const Run& r : runs) out << row(r) << "\n";
+    }
+
+    // JSON has no nan or inf, e.g. for the per-host figures of a run of zero hosts
+    std::string json_number(const std::string& text)
+    {
+        return std::isfinite(strtod(text.c_str(), nullptr)) ? text : "null";
+    }
+
+    void write_json(const std::vector<Run>& runs, const std::vector<std::pair<std::string, std::string>>& context, std::ostream& out)
+    {
+        std::vector<std::string> columns = split(COLUMNS);
+
+        out << "{\n  \"context\": {";
+        for (size_t i = 0; i < context.size(); i++)
+        {
+            out << (i ? "," : "") << "\n    \"" << context[i].first << "\": \"" << context[i].second << "\"";
+        }
+        out << "\n  },\n  \"runs\": [";
+
+        for (size_t i = 0; i < runs.size(); i++)
+        {
+            std::vector<std::string> values = split(row(runs[i]));
+            out << (i ? "," : "") << "\n    {";
+            for (size_t c = 0; c < columns.size(); c++)
+            {
+                std::string value = (c == 0) ? "\"" + values[c] + "\"" : json_number(values[c]);
+                out << (c ? ", " : "") << "\"" << columns[c] << "\": " << value;
+            }
+            out << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    void write(const std::string& path, std::function<void(std::ostream&)> writer)
+    {
+        if (path.empty()) return;
+        if (path == "-")
+        {
+            writer(std::cout);
+            return;
+        }
+
+        std::ofstream file(path);
+        if (!file) throw std::runtime_error("Cannot write scaling results to " + path);
+        writer(file);
+    }
+
+}
+
+
+int main(int argc, char** argv)
+{
+    std::string config = EMODLIB_BENCH_CONFIG;
+    std::vector<std::string> sweeps = { "hosts", "infections", "strong", "weak" };
+    std::vector<int> host_counts = { 1000, 10000, 100000, 1000000 };
+    std::vector<int> challenge_counts = { 0, 1, 3, 5 };
+    std::vector<int> thread_counts;
+    int sweep_hosts = 100000;  // in the infection and strong-scaling sweeps
+    int weak_hosts = 50000;    // per thread
+    int days = 20;
+    std::string csv_path, json_path, trace_path;
+
+    int hardware = std::max(1, int(std::thread::hardware_concurrency()));
+    for (int t = 1; t < hardware; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(hardware);
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg(argv[i]);
+        size_t eq = arg.find('=');
+        std::string key = arg.substr(0, eq), value = (eq == std::string::npos) ? std::string() : arg.substr(eq + 1);
+
+        if (key == "--config") config = value;
+        else if (key == "--sweep") sweeps = split(value);
+        else if (key == "--hosts") host_counts = parse_list(value);
+        else if (key == "--infections") challenge_counts = parse_list(value);
+        else if (key == "--threads") thread_counts = parse_list(value);
+        else if (key == "--sweep_hosts") sweep_hosts = int(std::stod(value));
+        else if (key == "--weak_hosts") weak_hosts = int(std::stod(value));
+        else if (key == "--days") days = std::max(1, std::stoi(value));
+        else if (key == "--csv") csv_path = value;
+        else if (key == "--json") json_path = value;
+        else if (key == "--trace") trace_path = value;
+        else
+        {
+            fprintf(stderr, "Unknown argument %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    if (csv_path.empty() && json_path.empty()) csv_path = "-";
+    tracing = !trace_path.empty();
+
+    // room for the deepest sweep of concurrent infections
+    ParamSet pset = LoadConfigFile(config);
+    int max_challenges = *std::max_element(challenge_counts.begin(), challenge_counts.end());
+    if (max_challenges > pset["Max_Individual_Infections"].cast<int>()) pset.Set("Max_Individual_Infections", max_challenges);
+
+    IntrahostParamsPtr params = IntrahostParams::Create(pset);
+    IntrahostParams::SetDefaults(params);
+    IntrahostComponent::p_rng = std::shared_ptr<RANDOMBASE>(new PSEUDO_DES(params->randomSeed, 256));
+
+    // one infection per host, except in the sweep over infections
+    int base_challenges = 1;
+
+    std::vector<Run> runs;
+
+    if (contains(sweeps, "hosts"))
+        for (int hosts : host_counts) runs.push_back(simulate("hosts", params, hosts, base_challenges, 1, days));
+
+    if (contains(sweeps, "infections"))
+        for (int challenges : challenge_counts) runs.push_back(simulate("infections", params, sweep_hosts, challenges, 1, days));
+
+    if (contains(sweeps, "strong"))
+    {
+        for (int threads : thread_counts) runs.push_back(simulate("strong", params, sweep_hosts, base_challenges, threads, days));
+        set_efficiency(runs, "strong");
+    }
+
+    if (contains(sweeps, "weak"))
+    {
+        for (int threads : thread_counts) runs.push_back(simulate("weak", params, weak_hosts * threads, base_challenges, threads, days));
+        set_efficiency(runs, "weak");
+    }
+
+    std::vector<std::pair<std::string, std::string>> context = {
+        { "precision", EMODLIB_PRECISION_NAME },
+        { "pfemp1_variants", MACRO_STRINGIFY(CLONAL_PfEMP1_VARIANTS) },
+        { "config", config },
+        { "hardware_threads", std::to_string(hardware) },
+        { "run_number", std::to_string(params->randomSeed) },
+    };
+
+    write(csv_path, [&runs](std::ostream& out) { write_csv(runs, out); });
+    write(json_path, [&runs, &context](std::ostream& out) { write_json(runs, context, out); });
+    if (tracing)
+    {
+        Tracer::WriteChromeTrace(trace_path);
+        fprintf(stderr, "Trace of %zu events (%zu dropped) written to %s\n", Tracer::GetNumEvents(), Tracer::GetNumDropped(), trace_path.c_str());
+    }
+
+    return 0;
+}
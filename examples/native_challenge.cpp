@@ -0,0 +1,85 @@
+/**
+ * @file native_challenge.cpp
+ *
+ * @brief A single challenge run against the native emodlib library, without Python
+ */
+
+#include <cstdio>
+#include <memory>
+
+#include "emodlib/ParamSet.h"
+#include "emodlib/malaria/IntrahostComponent.h"
+
+using emodlib::ParamSet;
+namespace emm = emodlib::malaria;
+
+
+// The parameters of src/emodlib/malaria/config.yml, as a native simulator would build them from its own configuration
+static ParamSet default_params()
+{
+    ParamSet infection;
+    infection.Set("Antibody_IRBC_Kill_Rate", 1.596)
+             .Set("Antigen_Switch_Rate", 7.645570124964182e-10)
+             .Set("Base_Gametocyte_Fraction_Male", 0.2)
+             .Set("Base_Gametocyte_Production_Rate", 0.06150582)
+             .Set("Base_Incubation_Period", 7)
+             .Set("Gametocyte_Stage_Survival_Rate", 0.588569307)
+             .Set("MSP1_Merozoite_Kill_Fraction", 0.511735322)
+             .Set("Malaria_Strain_Model", "FALCIPARUM_RANDOM_STRAIN")
+             .Set("Merozoites_Per_Hepatocyte", 15000)
+             .Set("Merozoites_Per_Schizont", 16)
+             .Set("Nonspecific_Antigenicity_Factor", 0.415111634)
+             .Set("Number_Of_Asexual_Cycles_Without_Gametocytes", 1)
+             .Set("Parasite_Switch_Type", "RATE_PER_PARASITE_7VARS")
+             .Set("RBC_Destruction_Multiplier", 3.29);
+
+    ParamSet susceptibility;
+    susceptibility.Set("Antibody_CSP_Decay_Days", 90)
+                  .Set("Antibody_Capacity_Growth_Rate", 0.09)
+                  .Set("Antibody_Memory_Level", 0.34)
+                  .Set("Antibody_Stimulation_C50", 30)
+                  .Set("Erythropoiesis_Anemia_Effect", 3.5)
+                  .Set("Fever_IRBC_Kill_Rate", 1.4)
+                  .Set("Maternal_Antibody_Decay_Rate", 0.01)
+                  .Set("Max_MSP1_Antibody_Growthrate", 0.045)
+                  .Set("Min_Adapted_Response", 0.05)
+                  .Set("Nonspecific_Antibody_Growth_Rate_Factor", 0.5)
+                  .Set("Pyrogenic_Threshold", 15000.0);
+
+    ParamSet pset;
+    pset.Set("Base_Gametocyte_Mosquito_Survival_Rate", 0.002011099)
+        .Set("Cytokine_Gametocyte_Inactivation", 0.01667)
+        .Set("Falciparum_MSP_Variants", 32)
+        .Set("Falciparum_Nonspecific_Types", 76)
+        .Set("Falciparum_PfEMP1_Variants", 1070)
+        .Set("Run_Number", 12345)
+        .Set("Common_Random_Numbers", false)
+        .Set("Max_Individual_Infections", 5)
+        .Set("infection_params", infection)
+        .Set("susceptibility_params", susceptibility);
+
+    return pset;
+}
+
+int main()
+{
+    emm::IntrahostComponent::Configure(default_params());
+
+    std::unique_ptr<emm::IntrahostComponent> ic(emm::IntrahostComponent::Create());
+    ic->Challenge();
+
+    float peak = 0;
+    for (int t = 0; t < 60; t++)
+    {
+        ic->Update(1.0f);
+        if (ic->GetParasiteDensity() > peak) peak = ic->GetParasiteDensity();
+        if (t % 10 == 9)
+        {
+            printf("day %2d  parasites %10.2f/uL  gametocytes %8.4f/uL  fever %5.2f C\n",
+                   t + 1, ic->GetParasiteDensity(), ic->GetGametocyteDensity(), ic->GetFeverTemperature());
+        }
+    }
+
+    // a challenge with the default incubation period is patent well within 60 days
+    return peak > 0 ? 0 : 1;
+}
@@ -0,0 +1,603 @@
+/**
+ * @file ConfigFile.cpp
+ *
+ * @brief Native parsing of configuration files into a ParamSet
+ */
+
+#include "ConfigFile.h"
+
+#include <errno.h>
+#include <fstream>
+#include <limits>
+#include <regex>
+#include <sstream>
+#include <stdlib.h>
+#include <vector>
+
+
+namespace emodlib
+{
+
+    static std::string located(const std::string& source, int line, const std::string& message)
+    {
+        return source + (line > 0 ? ":" + std::to_string(line) : std::string()) + ": " + message;
+    }
+
+    ConfigError::ConfigError(const std::string& source, int line, const std::string& message)
+        : std::runtime_error(located(source, line, message))
+    {
+
+    }
+
+
+    // Integers and numbers in full, the way JSON writes them; false if any text is left over
+    static bool parseNumber(const std::string& text, ParamValue& value)
+    {
+        if (text.empty()) return false;
+
+        size_t start = (text[0] == '-' || text[0] == '+') ? 1 : 0;
+        if (start == text.size() || !(isdigit((unsigned char)text[start]) || text[start] == '.')) return false;  // not inf or nan
+
+        bool integral = text.find_first_not_of("0123456789", start) == std::string::npos;
+        const char* begin = text.c_str();
+        char* end = nullptr;
+
+        if (integral)
+        {
+            errno = 0;
+            long long i = strtoll(begin, &end, 10);
+            if (errno == 0 && *end == '\0')
+            {
+                value = ParamValue(int64_t(i));
+                return true;
+            }
+            // out of int64 range reads as a number
+        }
+
+        errno = 0;
+        double d = strtod(begin, &end);
+        if (*end != '\0' || errno == ERANGE) return false;
+
+        value = ParamValue(d);
+        return true;
+    }
+
+
+    namespace
+    {
+
+        struct YamlLine
+        {
+            int number;
+            int indent;
+            std::string key;
+            std::string value;  // empty when a nested block follows
+            bool quoted;        // value was quoted, so always a string
+        };
+
+
+        class YamlParser
+        {
+
+        public:
+
+            YamlParser(const std::string& _text, const std::string& _source)
+                : source(_source)
+                , lines()
+            {
+                split(_text);
+            }
+
+            ParamSet Parse()
+            {
+                if (lines.empty()) return ParamSet();
+
+                if (lines[0].indent != 0) fail(lines[0].number, "unexpected indentation");
+
+                size_t i = 0;
+                ParamSet pset = block(i, 0);
+                if (i < lines.size()) fail(lines[i].number, "unexpected indentation");
+
+                return pset;
+            }
+
+        private:
+
+            std::string source;
+            std::vector<YamlLine> lines;
+
+            void fail(int line, const std::string& message) const
+            {
+                throw ConfigError(source, line, message);
+            }
+
+            // Lines of one mapping at this indentation, with nested mappings indented further under an empty value
+            ParamSet block(size_t& i, int indent)
+            {
+                ParamSet pset;
+
+                while (i < lines.size() && lines[i].indent == indent)
+                {
+                    const YamlLine& line = lines[i++];
+
+                    if (pset.Contains(line.key)) fail(line.number, "duplicate key '" + line.key + "'");
+
+                    if (!line.value.empty() || line.quoted)
+                    {
+                        pset.Set(line.key, scalar(line));
+                    }
+                    else if (i < lines.size() && lines[i].indent > indent)
+                    {
+                        pset.Set(line.key, block(i, lines[i].indent));
+                    }
+                    else
+                    {
+                        fail(line.number, "null value for '" + line.key + "' is not supported");
+                    }
+                }
+
+                if (i < lines.size() && lines[i].indent > indent) fail(lines[i].number, "unexpected indentation");
+
+                return pset;
+            }
+
+            // Plain scalars resolve by PyYAML's YAML 1.1 implicit rules, so both loaders agree on every value
+            ParamValue scalar(const YamlLine& line) const
+            {
+                if (line.quoted) return ParamValue(line.value);
+
+                static const std::regex boolean("yes|Yes|YES|no|No|NO|true|True|TRUE|false|False|FALSE|on|On|ON|off|Off|OFF");
+                static const std::regex null("~|null|Null|NULL");
+                static const std::regex integer("[-+]?0b[0-1_]+"
+                                                "|[-+]?0[0-7_]+"
+                                                "|[-+]?(?:0|[1-9][0-9_]*)"
+                                                "|[-+]?0x[0-9a-fA-F_]+"
+                                                "|[-+]?[1-9][0-9_]*(?::[0-5]?[0-9])+");
+                static const std::regex number("[-+]?(?:[0-9][0-9_]*)\\.[0-9_]*(?:[eE][-+][0-9]+)?"
+                                               "|\\.[0-9][0-9_]*(?:[eE][-+][0-9]+)?"
+                                               "|[-+]?[0-9][0-9_]*(?::[0-5]?[0-9])+\\.[0-9_]*"
+                                               "|[-+]?\\.(?:inf|Inf|INF)"
+                                               "|\\.(?:nan|NaN|NAN)");
+                static const std::regex timestamp("[0-9]{4}-[0-9]{1,2}-[0-9]{1,2}(?:(?:[Tt]|[ \t]+).*)?");
+
+                const std::string& v = line.value;
+                if (std::regex_match(v, boolean)) return ParamValue(v[0] == 'y' || v[0] == 'Y' || v[0] == 't' || v[0] == 'T' || v == "on" || v == "On" || v == "ON");
+                if (std::regex_match(v, null)) fail(line.number, "null value for '" + line.key + "' is not supported");
+                if (std::regex_match(v, integer)) return resolveInteger(v);
+                if (std::regex_match(v, number)) return resolveNumber(v);
+                if (std::regex_match(v, timestamp)) fail(line.number, "timestamp value for '" + line.key + "' is not supported");
+
+                return ParamValue(v);
+            }
+
+            // Sign, digits without '_', and the rest of a matched int or float
+            static std::string digits(const std::string& v, bool& negative)
+            {
+                std::string out;
+                for (char c : v) if (c != '_') out += c;
+
+                negative = !out.empty() && out[0] == '-';
+                if (!out.empty() && (out[0] == '-' || out[0] == '+')) out.erase(0, 1);
+                return out;
+            }
+
+            // Base-60 "h:m:s" parts, as PyYAML reads 1:30 == 90
+            static double sexagesimal(const std::string& v)
+            {
+                double value = 0;
+                size_t start = 0;
+                while (true)
+                {
+                    size_t colon = v.find(':', start);
+                    value = value * 60 + strtod(v.substr(start, colon - start).c_str(), nullptr);
+                    if (colon == std::string::npos) return value;
+                    start = colon + 1;
+                }
+            }
+
+            static ParamValue resolveInteger(const std::string& v)
+            {
+                bool negative = false;
+                std::string d = digits(v, negative);
+
+                if (d.find(':') != std::string::npos)
+                {
+                    double s = sexagesimal(d);
+                    return ParamValue(int64_t(negative ? -s : s));
+                }
+
+                int base = 10;
+                size_t start = 0;
+                if (d.compare(0, 2, "0b") == 0) { base = 2; start = 2; }
+                else if (d.compare(0, 2, "0x") == 0) { base = 16; start = 2; }
+                else if (d.size() > 1 && d[0] == '0') { base = 8; start = 1; }
+
+                errno = 0;
+                unsigned long long u = strtoull(d.c_str() + start, nullptr, base);
+                if (errno == 0 && u <= uint64_t(std::numeric_limits<int64_t>::max()))
+                {
+                    return ParamValue(negative ? -int64_t(u) : int64_t(u));
+                }
+
+                // out of int64 range reads as a number
+                double f = strtod(d.c_str(), nullptr);
+                return ParamValue(negative ? -f : f);
+            }
+
+            static ParamValue resolveNumber(const std::string& v)
+            {
+                bool negative = false;
+                std::string d = digits(v, negative);
+                double f = 0;
+
+                if (d == ".inf" || d == ".Inf" || d == ".INF") f = std::numeric_limits<double>::infinity();
+                else if (d == ".nan" || d == ".NaN" || d == ".NAN") f = std::numeric_limits<double>::quiet_NaN();
+                else if (d.find(':') != std::string::npos) f = sexagesimal(d);
+                else f = strtod(d.c_str(), nullptr);
+
+                return ParamValue(negative ? -f : f);
+            }
+
+            // A quoted scalar starting at pos; pos is left after the closing quote
+            std::string quoted(const std::string& text, size_t& pos, int number) const
+            {
+                char quote = text[pos++];
+                std::string out;
+
+                while (pos < text.size())
+                {
+                    char c = text[pos++];
+                    if (c == quote)
+                    {
+                        if (quote == '\'' && pos < text.size() && text[pos] == '\'')
+                        {
+                            out += '\'';  // '' inside single quotes
+                            pos++;
+                            continue;
+                        }
+                        return out;
+                    }
+                    if (quote == '"' && c == '\\' && pos < text.size())
+                    {
+                        char e = text[pos++];
+                        switch (e)
+                        {
+                        case 'n':  out += '\n'; break;
+                        case 't':  out += '\t'; break;
+                        case '\\': out += '\\'; break;
+                        case '"':  out += '"';  break;
+                        case '/':  out += '/';  break;
+                        default:   fail(number, std::string("unsupported escape '\\") + e + "'");
+                        }
+                        continue;
+                    }
+                    out += c;
+                }
+
+                fail(number, "unterminated quoted string");
+                return out;
+            }
+
+            // Text up to a comment, which starts at a '#' after whitespace and outside quotes
+            static std::string uncommented(const std::string& text, size_t pos)
+            {
+                char quote = '\0';
+                for (size_t j = pos; j < text.size(); j++)
+                {
+                    char c = text[j];
+                    bool spaced = (j == pos || text[j - 1] == ' ' || text[j - 1] == '\t');
+
+                    if (quote)
+                    {
+                        if (c == '\\' && quote == '"') j++;
+                        else if (c == quote) quote = '\0';
+                    }
+                    else if ((c == '"' || c == '\'') && (spaced || text[j - 1] == ':'))
+                    {
+                        quote = c;
+                    }
+                    else if (c == '#' && spaced)
+                    {
+                        return text.substr(pos, j - pos);
+                    }
+                }
+                return text.substr(pos);
+            }
+
+            static std::string trimmed(const std::string& text)
+            {
+                size_t first = text.find_first_not_of(" \t\r");
+                if (first == std::string::npos) return std::string();
+                size_t last = text.find_last_not_of(" \t\r");
+                return text.substr(first, last - first + 1);
+            }
+
+            void split(const std::string& text)
+            {
+                std::istringstream stream(text);
+                std::string raw;
+                int number = 0;
+                bool content = false;
+
+                while (std::getline(stream, raw))
+                {
+                    number++;
+
+                    size_t indent = raw.find_first_not_of(' ');
+                    if (indent == std::string::npos) continue;
+
+                    std::string rest = trimmed(uncommented(raw, indent));
+                    if (rest.empty()) continue;
+                    if (raw[indent] == '\t') fail(number, "tabs are not allowed in indentation");
+
+                    if (indent == 0 && (rest == "---" || rest == "..."))
+                    {
+                        if (content && rest == "---") fail(number, "multiple documents are not supported");
+                        continue;
+                    }
+                    content = true;
+
+                    if (rest[0] == '-' && (rest.size() == 1 || rest[1] == ' ')) fail(number, "sequences are not supported");
+                    if (rest[0] == '[' || rest[0] == '{') fail(number, "flow collections are not supported");
+
+                    YamlLine line = { number, int(indent), std::string(), std::string(), false };
+
+                    size_t pos = 0;
+                    if (rest[0] == '"' || rest[0] == '\'')
+                    {
+                        line.key = quoted(rest, pos, number);
+                        if (pos >= rest.size() || rest[pos] != ':') fail(number, "expected ':' after key");
+                    }
+                    else
+                    {
+                        // a plain key ends at the first ': ' (or ':' at the end of the line)
+                        pos = rest.find(':');
+                        while (pos != std::string::npos && pos + 1 < rest.size() && rest[pos + 1] != ' ')
+                        {
+                            pos = rest.find(':', pos + 1);
+                        }
+                        if (pos == std::string::npos) fail(number, "expected 'key: value'");
+                        line.key = trimmed(rest.substr(0, pos));
+                    }
+                    pos++;  // ':'
+
+                    std::string value = trimmed(rest.substr(pos));
+                    if (!value.empty())
+                    {
+                        if (value[0] == '"' || value[0] == '\'')
+                        {
+                            size_t vpos = 0;
+                            line.value = quoted(value, vpos, number);
+                            line.quoted = true;
+                            if (!trimmed(value.substr(vpos)).empty()) fail(number, "unexpected text after quoted value");
+                        }
+                        else if (std::string("[{&*!|>%@`").find(value[0]) != std::string::npos)
+                        {
+                            fail(number, std::string("unsupported value starting with '") + value[0] + "'");
+                        }
+                        else
+                        {
+                            line.value = value;
+                        }
+                    }
+
+                    lines.push_back(line);
+                }
+            }
+
+        };
+
+
+        class JsonParser
+        {
+
+        public:
+
+            JsonParser(const std::string& _text, const std::string& _source)
+                : text(_text)
+                , source(_source)
+                , pos(0)
+                , line(1)
+            {
+
+            }
+
+            ParamSet Parse()
+            {
+                skip();
+                if (peek() != '{') fail("expected a JSON object");
+                ParamSet pset = object();
+
+                skip();
+                if (pos < text.size()) fail("unexpected text after the top-level object");
+
+                return pset;
+            }
+
+        private:
+
+            const std::string& text;
+            std::string source;
+            size_t pos;
+            int line;
+
+            void fail(const std::string& message) const
+            {
+                throw ConfigError(source, line, message);
+            }
+
+            char peek() const
+            {
+                return pos < text.size() ? text[pos] : '\0';
+            }
+
+            void skip()
+            {
+                while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n'))
+                {
+                    if (text[pos] == '\n') line++;
+                    pos++;
+                }
+            }
+
+            void expect(char c)
+            {
+                skip();
+                if (peek() != c) fail(std::string("expected '") + c + "'");
+                pos++;
+            }
+
+            ParamSet object()
+            {
+                ParamSet pset;
+                expect('{');
+
+                skip();
+                if (peek() == '}')
+                {
+                    pos++;
+                    return pset;
+                }
+
+                while (true)
+                {
+                    skip();
+                    if (peek() != '"') fail("expected a string key");
+                    std::string key = string();
+                    if (pset.Contains(key)) fail("duplicate key '" + key + "'");
+
+                    expect(':');
+                    pset.Set(key, value(key));
+
+                    skip();
+                    if (peek() == ',') { pos++; continue; }
+                    if (peek() == '}') { pos++; return pset; }
+                    fail("expected ',' or '}'");
+                }
+            }
+
+            ParamValue value(const std::string& key)
+            {
+                skip();
+                char c = peek();
+
+                if (c == '{') return object();
+                if (c == '"') return string();
+                if (literal("true")) return ParamValue(true);
+                if (literal("false")) return ParamValue(false);
+                if (c == '[') fail("arrays are not supported, for '" + key + "'");
+                if (literal("null")) fail("null value for '" + key + "' is not supported");
+
+                size_t start = pos;
+                while (pos < text.size() && std::string("+-0123456789.eE").find(text[pos]) != std::string::npos) pos++;
+
+                ParamValue number(0);
+                if (pos == start || !parseNumber(text.substr(start, pos - start), number)) fail("invalid value for '" + key + "'");
+                return number;
+            }
+
+            bool literal(const char* word)
+            {
+                std::string w(word);
+                if (text.compare(pos, w.size(), w) != 0) return false;
+                pos += w.size();
+                return true;
+            }
+
+            std::string string()
+            {
+                pos++;  // opening quote
+                std::string out;
+
+                while (pos < text.size())
+                {
+                    char c = text[pos++];
+                    if (c == '"') return out;
+                    if (c == '\n') fail("unterminated string");
+                    if (c != '\\')
+                    {
+                        out += c;
+                        continue;
+                    }
+
+                    char e = peek();
+                    pos++;
+                    switch (e)
+                    {
+                    case '"':  out += '"';  break;
+                    case '\\': out += '\\'; break;
+                    case '/':  out += '/';  break;
+                    case 'b':  out += '\b'; break;
+                    case 'f':  out += '\f'; break;
+                    case 'n':  out += '\n'; break;
+                    case 'r':  out += '\r'; break;
+                    case 't':  out += '\t'; break;
+                    case 'u':  unicode(out); break;
+                    default:   fail(std::string("invalid escape '\\") + e + "'");
+                    }
+                }
+
+                fail("unterminated string");
+                return out;
+            }
+
+            // \uXXXX in the basic multilingual plane, as UTF-8
+            void unicode(std::string& out)
+            {
+                if (pos + 4 > text.size()) fail("truncated unicode escape");
+
+                char* end = nullptr;
+                std::string hex = text.substr(pos, 4);
+                unsigned long code = strtoul(hex.c_str(), &end, 16);
+                if (*end != '\0') fail("invalid unicode escape");
+                if (code >= 0xD800 && code <= 0xDFFF) fail("surrogate pairs are not supported");
+                pos += 4;
+
+                if (code < 0x80)
+                {
+                    out += char(code);
+                }
+                else if (code < 0x800)
+                {
+                    out += char(0xC0 | (code >> 6));
+                    out += char(0x80 | (code & 0x3F));
+                }
+                else
+                {
+                    out += char(0xE0 | (code >> 12));
+                    out += char(0x80 | ((code >> 6) & 0x3F));
+                    out += char(0x80 | (code & 0x3F));
+                }
+            }
+
+        };
+
+    }
+
+
+    ParamSet ParseYaml(const std::string& text, const std::string& source)
+    {
+        return YamlParser(text, source).Parse();
+    }
+
+    ParamSet ParseJson(const std::string& text, const std::string& source)
+    {
+        return JsonParser(text, source).Parse();
+    }
+
+    ParamSet LoadConfigFile(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            throw ConfigError(path, 0, "cannot open configuration file");
+        }
+
+        std::stringstream contents;
+        contents << file.rdbuf();
+
+        bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        return json ? ParseJson(contents.str(), path) : ParseYaml(contents.str(), path);
+    }
+
+}
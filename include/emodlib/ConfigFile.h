@@ -0,0 +1,36 @@
+/**
+ * @file ConfigFile.h
+ *
+ * @brief Native parsing of configuration files into a ParamSet
+ */
+
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+#include "ParamSet.h"
+
+
+namespace emodlib
+{
+
+    // Malformed or unsupported configuration input, with the source and line in the message
+    class ConfigError : public std::runtime_error
+    {
+    public:
+        ConfigError(const std::string& source, int line, const std::string& message);
+    };
+
+    // The subset of YAML used by config.yml: nested block mappings of scalars, with comments.
+    // Plain scalars resolve as PyYAML's YAML 1.1 implicit resolver does (yes/on are booleans, 1e-3 is a string).
+    // Sequences, flow collections, anchors, multi-line scalars, nulls and timestamps are rejected.
+    ParamSet ParseYaml(const std::string& text, const std::string& source="<string>");
+
+    // JSON objects of booleans, numbers and strings, nested to any depth; arrays and nulls are rejected
+    ParamSet ParseJson(const std::string& text, const std::string& source="<string>");
+
+    // JSON for a .json extension, YAML otherwise
+    ParamSet LoadConfigFile(const std::string& path);
+
+}
@@ -0,0 +1,172 @@
+/**
+ * @file ParamSet.cpp
+ *
+ * @brief Native nested parameter dictionary implementation
+ */
+
+#include "ParamSet.h"
+
+#include <limits>
+
+
+namespace emodlib
+{
+
+    MissingParameter::MissingParameter(const std::string& name)
+        : std::out_of_range("Missing parameter '" + name + "'")
+    {
+
+    }
+
+
+    ParamValue::ParamValue(bool value)
+        : name(), type(Type::Bool), int_value(value ? 1 : 0), double_value(0), string_value(), block_value()
+    {
+
+    }
+
+    ParamValue::ParamValue(int value)
+        : ParamValue(int64_t(value))
+    {
+
+    }
+
+    ParamValue::ParamValue(int64_t value)
+        : name(), type(Type::Int), int_value(value), double_value(0), string_value(), block_value()
+    {
+
+    }
+
+    ParamValue::ParamValue(double value)
+        : name(), type(Type::Double), int_value(0), double_value(value), string_value(), block_value()
+    {
+
+    }
+
+    ParamValue::ParamValue(const char* value)
+        : ParamValue(std::string(value))
+    {
+
+    }
+
+    ParamValue::ParamValue(const std::string& value)
+        : name(), type(Type::String), int_value(0), double_value(0), string_value(value), block_value()
+    {
+
+    }
+
+    ParamValue::ParamValue(const ParamSet& value)
+        : name(), type(Type::Block), int_value(0), double_value(0), string_value(), block_value(std::make_shared<const ParamSet>(value))
+    {
+
+    }
+
+    ParamValue::Type ParamValue::GetType() const
+    {
+        return type;
+    }
+
+    void ParamValue::mismatch(const char* expected) const
+    {
+        static const char* names[] = { "a bool", "an integer", "a number", "a string", "a parameter block" };
+        throw std::invalid_argument("Parameter '" + name + "' should be " + expected + ", not " + names[int(type)]);
+    }
+
+    template<>
+    bool ParamValue::cast<bool>() const
+    {
+        if (type != Type::Bool) mismatch("a bool");
+        return int_value != 0;
+    }
+
+    template<>
+    int64_t ParamValue::cast<int64_t>() const
+    {
+        if (type != Type::Int) mismatch("an integer");
+        return int_value;
+    }
+
+    template<>
+    int ParamValue::cast<int>() const
+    {
+        int64_t value = cast<int64_t>();
+        if (value < std::numeric_limits<int>::min() || value > std::numeric_limits<int>::max())
+        {
+            throw std::invalid_argument("Parameter '" + name + "' is out of range: " + std::to_string(value));
+        }
+        return int(value);
+    }
+
+    template<>
+    double ParamValue::cast<double>() const
+    {
+        if (type == Type::Int) return double(int_value);
+        if (type != Type::Double) mismatch("a number");
+        return double_value;
+    }
+
+    template<>
+    float ParamValue::cast<float>() const
+    {
+        return float(cast<double>());
+    }
+
+    template<>
+    std::string ParamValue::cast<std::string>() const
+    {
+        if (type != Type::String) mismatch("a string");
+        return string_value;
+    }
+
+    template<>
+    ParamSet ParamValue::cast<ParamSet>() const
+    {
+        return *this;
+    }
+
+    ParamValue::operator const ParamSet&() const
+    {
+        if (type != Type::Block) mismatch("a parameter block");
+        return *block_value;
+    }
+
+
+    const ParamValue& ParamSet::operator[](const std::string& key) const
+    {
+        auto it = values.find(key);
+        if (it == values.end())
+        {
+            throw MissingParameter(key);
+        }
+        return it->second;
+    }
+
+    ParamSet& ParamSet::Set(const std::string& key, const ParamValue& value)
+    {
+        auto it = values.insert(std::make_pair(key, value)).first;
+        it->second = value;
+        it->second.name = key;
+        return *this;
+    }
+
+    bool ParamSet::Contains(const std::string& key) const
+    {
+        return values.count(key) > 0;
+    }
+
+    size_t ParamSet::Size() const
+    {
+        return values.size();
+    }
+
+    ParamSet::Map::const_iterator ParamSet::begin() const
+    {
+        return values.begin();
+    }
+
+    ParamSet::Map::const_iterator ParamSet::end() const
+    {
+        return values.end();
+    }
+
+}
@@ -1,7 +1,104 @@
+/**
+ * @file ParamSet.h
+ *
+ * @brief Native nested parameter dictionary
+ */
+
 #pragma once
 
-#include <pybind11/embed.h>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <stdint.h>
+#include <string>
+
+
+namespace emodlib
+{
+
+    class ParamSet;
+
+    // A requested parameter is not in the set
+    class MissingParameter : public std::out_of_range
+    {
+    public:
+        explicit MissingParameter(const std::string& name);
+    };
+
+
+    // One parameter: a bool, an integer, a number, a string or a nested block of parameters
+    class ParamValue
+    {
+
+    public:
+
+        enum class Type { Bool, Int, Double, String, Block };
+
+        ParamValue(bool value);
+        ParamValue(int value);
+        ParamValue(int64_t value);
+        ParamValue(double value);
+        ParamValue(const char* value);
+        ParamValue(const std::string& value);
+        ParamValue(const ParamSet& value);
+
+        Type GetType() const;
+
+        // Conversion to the type a component reads, as with the py::dict this replaces:
+        // integers widen to numbers, but nothing narrows, and strings and blocks only read as themselves.
+        // Throws std::invalid_argument naming the parameter.
+        template<typename T> T cast() const;
+
+        // so that a nested block can be handed straight to a component's Configure
+        operator const ParamSet&() const;
+
+    private:
+
+        friend class ParamSet;
+
+        std::string name;  // key in the enclosing set, for error messages
+        Type type;
+        int64_t int_value;  // also holds a bool
+        double double_value;
+        std::string string_value;
+        std::shared_ptr<const ParamSet> block_value;
+
+        void mismatch(const char* expected) const;
+
+    };
+
+    template<> bool ParamValue::cast<bool>() const;
+    template<> int ParamValue::cast<int>() const;
+    template<> int64_t ParamValue::cast<int64_t>() const;
+    template<> float ParamValue::cast<float>() const;
+    template<> double ParamValue::cast<double>() const;
+    template<> std::string ParamValue::cast<std::string>() const;
+    template<> ParamSet ParamValue::cast<ParamSet>() const;
+
+
+    // Nested string-keyed parameters read by the Configure methods of each component,
+    // built natively or converted from a Python dictionary by the bindings
+    class ParamSet
+    {
+
+    public:
+
+        typedef std::map<std::string, ParamValue> Map;
+
+        // Throws MissingParameter for an absent key
+        const ParamValue& operator[](const std::string& key) const;
+
+        ParamSet& Set(const std::string& key, const ParamValue& value);
+        bool Contains(const std::string& key) const;
+        size_t Size() const;
+
+        Map::const_iterator begin() const;
+        Map::const_iterator end() const;
+
+    private:
+
+        Map values;
 
-namespace py = pybind11;
+    };
 
-typedef py::dict ParamSet;
+}
@@ -0,0 +1,402 @@
+/**
+ * @file AggregateReporter.cpp
+ *
+ * @brief Per-step population summaries and distributions implementation
+ */
+
+#include "AggregateReporter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "emodlib/utils/Common.h"
+#include "emodlib/utils/Tracer.h"
+
+#include "IntrahostComponent.h"
+#include "SusceptibilityMalaria.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        AggregateReporter::Tally::Stratum::Stratum(int sketch_k)
+            : hosts(0)
+            , infected(0)
+            , patent(0)
+            , febrile(0)
+            , sum_density(0)
+            , sum_log10_density(0)
+            , sum_infectiousness(0)
+        {
+            for (QuantileSketch& sketch : distributions)
+            {
+                sketch = QuantileSketch(sketch_k);
+            }
+        }
+
+        void AggregateReporter::Tally::Stratum::Clear()
+        {
+            hosts = infected = patent = febrile = 0;
+            sum_density = sum_log10_density = sum_infectiousness = 0;
+            for (QuantileSketch& sketch : distributions)
+            {
+                sketch.Clear();  // keeping its capacity for the next step
+            }
+        }
+
+        AggregateReporter::Tally::Tally(const AggregateReporter* _reporter)
+            : reporter(_reporter)
+            , strata()
+        {
+            if (reporter)
+            {
+                strata.resize(reporter->GetNumStrata(), Stratum(reporter->sketch_k));
+            }
+        }
+
+        void AggregateReporter::Tally::Observe(const IntrahostComponent& host)
+        {
+            if (!reporter) return;
+
+            int s = reporter->stratum(host.GetSusceptibility()->get_age());
+            if (s < 0) return;
+
+            Stratum& stratum = strata[s];
+            stratum.hosts++;
+            if (host.GetFeverTemperature() > reporter->fever_threshold) stratum.febrile++;
+            stratum.distributions[ReportDistribution::PfEMP1MajorBreadth].Add(float(host.GetSusceptibility()->get_PfEMP1_major_breadth()));
+
+            // hosts without infections have no parasites or gametocytes to count
+            if (host.GetNumInfections() == 0) return;
+
+            stratum.infected++;
+            stratum.sum_infectiousness += host.GetInfectiousness();
+
+            float density = host.GetParasiteDensity();
+            if (density > reporter->detection_threshold) stratum.patent++;
+            if (density > 0)
+            {
+                stratum.sum_density += density;
+                stratum.sum_log10_density += std::log10(density);
+                stratum.distributions[ReportDistribution::ParasiteDensity].Add(density);
+            }
+
+            float gametocytes = host.GetGametocyteDensity();
+            if (gametocytes > 0) stratum.distributions[ReportDistribution::GametocyteDensity].Add(gametocytes);
+        }
+
+
+        AggregateReporter* AggregateReporter::Create(const std::vector<float>& age_bins, float detection_threshold, float fever_threshold, int sketch_k,
+                                                     int pipeline_depth, Backpressure::Enum backpressure)
+        {
+            if (pipeline_depth < 0)
+            {
+                throw std::invalid_argument("Pipeline depth must be zero (synchronous) or more steps");
+            }
+            if (sketch_k < 8)
+            {
+                throw std::invalid_argument("Quantile sketches need k of at least 8");
+            }
+
+            for (size_t i = 0; i < age_bins.size(); i++)
+            {
+                if (age_bins[i] <= 0 || (i > 0 && age_bins[i] <= age_bins[i - 1]))
+                {
+                    throw std::invalid_argument("Age bins must be increasing upper edges in years, greater than zero");
+                }
+            }
+
+            AggregateReporter* reporter = new AggregateReporter(age_bins, detection_threshold, fever_threshold, sketch_k);
+            if (pipeline_depth > 0)
+            {
+                reporter->backpressure = backpressure;
+                reporter->pipeline.reset(new SpscRing<PendingStep>(pipeline_depth));
+                for (PendingStep& slot : reporter->pipeline->Slots())
+                {
+                    slot.strata.assign(reporter->GetNumStrata(), Tally::Stratum(sketch_k));
+                }
+                reporter->thread = std::thread(&AggregateReporter::run, reporter);
+            }
+            return reporter;
+        }
+
+        AggregateReporter::AggregateReporter(const std::vector<float>& _age_bins, float _detection_threshold, float _fever_threshold, int _sketch_k)
+            : age_bins(_age_bins)
+            , age_bin_days()
+            , detection_threshold(_detection_threshold)
+            , fever_threshold(_fever_threshold)
+            , sketch_k(_sketch_k)
+            , mutex()
+            , step(nullptr)
+            , pipeline()
+            , backpressure(Backpressure::Block)
+            , n_ended(0)
+            , n_dropped(0)
+            , n_closed(0)
+            , stopping(false)
+            , thread()
+            , time(0)
+            , n_steps(0)
+            , times()
+            , data()
+            , sketches()
+        {
+            for (float edge : age_bins)
+            {
+                age_bin_days.push_back(edge * DAYSPERYEAR);
+            }
+
+            step = Tally(this);
+        }
+
+        AggregateReporter::~AggregateReporter()
+        {
+            if (thread.joinable())
+            {
+                stopping.store(true, std::memory_order_release);
+                thread.join();
+            }
+        }
+
+        const std::vector<std::string>& AggregateReporter::Channels()
+        {
+            static const std::vector<std::string> channels = {
+                "hosts",
+                "infected_prevalence",
+                "patent_prevalence",
+                "fever_prevalence",
+                "mean_density",
+                "median_density",
+                "mean_log10_density",
+                "mean_infectiousness",
+            };
+            return channels;
+        }
+
+        const std::vector<std::string>& AggregateReporter::Distributions()
+        {
+            static const std::vector<std::string> distributions = {
+                "parasite_density",
+                "gametocyte_density",
+                "pfemp1_major_breadth",
+            };
+            return distributions;
+        }
+
+        int AggregateReporter::stratum(float age_days) const
+        {
+            if (age_bin_days.empty()) return 0;
+
+            auto it = std::upper_bound(age_bin_days.begin(), age_bin_days.end(), age_days);
+            return (it == age_bin_days.end()) ? -1 : int(it - age_bin_days.begin());
+        }
+
+        void AggregateReporter::Merge(Tally& tally)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (size_t s = 0; s < tally.strata.size(); s++)
+            {
+                Tally::Stratum& from = tally.strata[s];
+                Tally::Stratum& to = step.strata[s];
+
+                to.hosts += from.hosts;
+                to.infected += from.infected;
+                to.patent += from.patent;
+                to.febrile += from.febrile;
+                to.sum_density += from.sum_density;
+                to.sum_log10_density += from.sum_log10_density;
+                to.sum_infectiousness += from.sum_infectiousness;
+                for (int d = 0; d < ReportDistribution::Count; d++)
+                {
+                    to.distributions[d].Merge(from.distributions[d]);
+                }
+            }
+        }
+
+        void AggregateReporter::EndStep(float dt)
+        {
+            EMODLIB_TRACE_SCOPE("output", "AggregateReporter::EndStep");  // including any wait for a free slot
+
+            time += dt;
+
+            if (!pipeline)
+            {
+                closeStep(step.strata, time);
+                return;
+            }
+
+            PendingStep* slot = pipeline->Claim();
+            if (!slot && backpressure == Backpressure::Drop)
+            {
+                n_dropped++;
+                for (Tally::Stratum& s : step.strata) s.Clear();
+                return;
+            }
+
+            RingBackoff backoff;
+            while (!slot)
+            {
+                backoff.Wait();
+                slot = pipeline->Claim();
+            }
+
+            // hands over the merged strata for the slot's cleared ones, without copying
+            slot->time = time;
+            std::swap(slot->strata, step.strata);
+            pipeline->Publish();
+            n_ended++;
+        }
+
+        void AggregateReporter::closeStep(std::vector<Tally::Stratum>& strata, float end_time)
+        {
+            times.push_back(end_time);
+            n_steps++;
+
+            for (Tally::Stratum& s : strata)
+            {
+                float row[ReportChannel::Count] = {};
+                row[ReportChannel::Hosts] = float(s.hosts);
+
+                if (s.hosts > 0)
+                {
+                    row[ReportChannel::InfectedPrevalence] = float(s.infected / s.hosts);
+                    row[ReportChannel::PatentPrevalence] = float(s.patent / s.hosts);
+                    row[ReportChannel::FeverPrevalence] = float(s.febrile / s.hosts);
+                    row[ReportChannel::MeanInfectiousness] = float(s.sum_infectiousness / s.hosts);
+                }
+
+                const QuantileSketch& densities = s.distributions[ReportDistribution::ParasiteDensity];
+                uint64_t n = densities.GetCount();
+                if (n > 0)
+                {
+                    row[ReportChannel::MeanDensity] = float(s.sum_density / n);
+                    row[ReportChannel::MedianDensity] = densities.Quantile(0.5f);
+                    row[ReportChannel::MeanLog10Density] = float(s.sum_log10_density / n);
+                }
+
+                data.insert(data.end(), row, row + ReportChannel::Count);
+                sketches.insert(sketches.end(), s.distributions, s.distributions + ReportDistribution::Count);
+
+                s.Clear();
+            }
+        }
+
+        void AggregateReporter::run()
+        {
+            Tracer::SetThreadName("reporter");
+
+            RingBackoff backoff;
+            while (true)
+            {
+                PendingStep* slot = pipeline->Front();
+                if (!slot)
+                {
+                    // nothing is published once stopping, so an empty ring stays empty
+                    if (stopping.load(std::memory_order_acquire) && pipeline->Empty()) break;
+                    backoff.Wait();
+                    continue;
+                }
+                backoff.Reset();
+
+                {
+                    EMODLIB_TRACE_SCOPE("output", "AggregateReporter::closeStep");
+                    closeStep(slot->strata, slot->time);
+                }
+                pipeline->Pop();
+                n_closed.fetch_add(1, std::memory_order_release);
+            }
+        }
+
+        void AggregateReporter::Flush()
+        {
+            if (!pipeline) return;
+
+            RingBackoff backoff;
+            while (n_closed.load(std::memory_order_acquire) != n_ended)
+            {
+                backoff.Wait();
+            }
+        }
+
+        void AggregateReporter::Clear()
+        {
+            Flush();
+            time = 0;
+            n_steps = 0;
+            times.clear();
+            data.clear();
+            sketches.clear();
+        }
+
+        int AggregateReporter::GetNumSteps() const
+        {
+            return n_steps;
+        }
+
+        int AggregateReporter::GetNumStrata() const
+        {
+            return age_bins.empty() ? 1 : int(age_bins.size());
+        }
+
+        const std::vector<float>& AggregateReporter::GetData() const
+        {
+            return data;
+        }
+
+        const std::vector<float>& AggregateReporter::GetTimes() const
+        {
+            return times;
+        }
+
+        const std::vector<float>& AggregateReporter::GetAgeBins() const
+        {
+            return age_bins;
+        }
+
+        float AggregateReporter::GetDetectionThreshold() const
+        {
+            return detection_threshold;
+        }
+
+        float AggregateReporter::GetFeverThreshold() const
+        {
+            return fever_threshold;
+        }
+
+        int AggregateReporter::GetSketchK() const
+        {
+            return sketch_k;
+        }
+
+        int AggregateReporter::GetPipelineDepth() const
+        {
+            return pipeline ? int(pipeline->Capacity()) : 0;
+        }
+
+        int AggregateReporter::GetNumDropped() const
+        {
+            return n_dropped;
+        }
+
+        const QuantileSketch& AggregateReporter::GetSketch(int step, int stratum, ReportDistribution::Enum distribution) const
+        {
+            if (step < 0 || step >= n_steps || stratum < 0 || stratum >= GetNumStrata())
+            {
+                throw std::out_of_range("No such step or stratum reported");
+            }
+            return sketches[(size_t(step) * GetNumStrata() + stratum) * ReportDistribution::Count + distribution];
+        }
+
+        float AggregateReporter::GetQuantile(int step, int stratum, ReportDistribution::Enum distribution, float q) const
+        {
+            return GetSketch(step, stratum, distribution).Quantile(q);
+        }
+
+    }
+
+}
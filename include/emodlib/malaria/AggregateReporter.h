@@ -0,0 +1,169 @@
+/**
+ * @file AggregateReporter.h
+ *
+ * @brief Per-step population summaries and distributions, optionally by age bin, accumulated during the update
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "emodlib/utils/QuantileSketch.h"
+#include "emodlib/utils/SpscRing.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        class IntrahostComponent;
+
+        namespace ReportChannel
+        {
+            enum Enum
+            {
+                Hosts,
+                InfectedPrevalence,
+                PatentPrevalence,
+                FeverPrevalence,
+                MeanDensity,        // densities over hosts with any parasites in the blood
+                MedianDensity,      // from the parasite density sketch
+                MeanLog10Density,
+                MeanInfectiousness,
+                Count
+            };
+        }
+
+        namespace ReportDistribution
+        {
+            enum Enum
+            {
+                ParasiteDensity,    // of hosts with any parasites in the blood
+                GametocyteDensity,  // of hosts with any gametocytes
+                PfEMP1MajorBreadth, // of every host
+                Count
+            };
+        }
+
+
+        class AggregateReporter
+        {
+
+        public:
+
+            // Sums over the hosts of one scheduler task, merged into the step when the task ends
+            class Tally
+            {
+
+            public:
+                explicit Tally(const AggregateReporter* _reporter);
+                void Observe(const IntrahostComponent& host);
+
+            private:
+                friend class AggregateReporter;
+
+                struct Stratum
+                {
+                    explicit Stratum(int sketch_k);
+                    void Clear();
+
+                    double hosts;
+                    double infected;
+                    double patent;
+                    double febrile;
+                    double sum_density;
+                    double sum_log10_density;
+                    double sum_infectiousness;
+                    QuantileSketch distributions[ReportDistribution::Count];
+                };
+
+                const AggregateReporter* reporter;
+                std::vector<Stratum> strata;
+            };
+
+            // age_bins are upper edges in years, as EMOD's summary reports bin them: hosts at or beyond
+            // the last edge go unreported, and no bins report every host as one stratum.
+            // With a pipeline_depth, each ended step is handed to a reporter thread through a ring of that
+            // many steps, which closes it into rows and sketches while the next step is computed.
+            static AggregateReporter* Create(const std::vector<float>& age_bins=std::vector<float>(),
+                                             float detection_threshold=40.0f,  // parasites/uL, thick-smear microscopy
+                                             float fever_threshold=38.5f,      // degrees Celsius
+                                             int sketch_k=200,                 // quantiles within about 1.7/k of their rank
+                                             int pipeline_depth=0,             // steps in flight, or 0 to close each step in EndStep
+                                             Backpressure::Enum backpressure=Backpressure::Block);
+            ~AggregateReporter();
+
+            static const std::vector<std::string>& Channels();
+            static const std::vector<std::string>& Distributions();
+
+            void Merge(Tally& tally);  // from any thread
+            void EndStep(float dt);    // once every host has been observed
+            void Flush();              // waits until every ended step is closed; pipelined, the getters below need it
+            void Clear();
+
+            int GetNumSteps() const;
+            int GetNumStrata() const;
+            const std::vector<float>& GetData() const;  // (step, stratum, channel), row-major
+            const std::vector<float>& GetTimes() const; // at the end of each step
+            const std::vector<float>& GetAgeBins() const;
+            float GetDetectionThreshold() const;
+            float GetFeverThreshold() const;
+            int GetSketchK() const;
+            int GetPipelineDepth() const;  // 0 if synchronous
+            int GetNumDropped() const;     // steps discarded while the pipeline was full
+
+            const QuantileSketch& GetSketch(int step, int stratum, ReportDistribution::Enum distribution) const;
+            float GetQuantile(int step, int stratum, ReportDistribution::Enum distribution, float q) const;
+
+        private:
+
+            std::vector<float> age_bins;
+            std::vector<float> age_bin_days;  // the same edges in days, as hosts age
+            float detection_threshold;
+            float fever_threshold;
+            int sketch_k;
+
+            std::mutex mutex;
+            Tally step;  // merged tallies of the step in progress
+
+            // ended steps, for the reporter thread to close in order
+            struct PendingStep
+            {
+                float time;
+                std::vector<Tally::Stratum> strata;
+            };
+
+            std::unique_ptr<SpscRing<PendingStep>> pipeline;  // else nullptr
+            Backpressure::Enum backpressure;
+            int n_ended;                  // by the stepping thread
+            int n_dropped;
+            std::atomic<int> n_closed;    // by the reporter thread
+            std::atomic<bool> stopping;
+            std::thread thread;
+
+            float time;
+            int n_steps;
+            std::vector<float> times;
+            std::vector<float> data;
+            std::vector<QuantileSketch> sketches;  // (step, stratum, distribution), a few kB each however many hosts
+
+
+            AggregateReporter(const std::vector<float>& _age_bins, float _detection_threshold, float _fever_threshold, int _sketch_k);
+
+            int stratum(float age_days) const;  // -1 if beyond the last bin
+
+            void closeStep(std::vector<Tally::Stratum>& strata, float end_time);  // appends its rows and clears the strata
+            void run();
+
+        };
+
+    }
+
+}
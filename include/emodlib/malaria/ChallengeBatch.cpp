@@ -0,0 +1,167 @@
+/**
+ * @file ChallengeBatch.cpp
+ *
+ * @brief Batched challenge protocol implementation
+ */
+
+#include "ChallengeBatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+#include "emodlib/utils/RANDOM.h"
+#include "emodlib/utils/Scheduler.h"
+
+#include "IntrahostComponent.h"
+#include "Malaria.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        BatchTrajectories::BatchTrajectories(int _n_param_sets, int _n_hosts, int _n_steps)
+            : n_param_sets(_n_param_sets)
+            , n_hosts(_n_hosts)
+            , n_steps(_n_steps)
+            , n_channels(TrajectoryChannel::Count)
+            , data(size_t(_n_param_sets) * _n_hosts * _n_steps * TrajectoryChannel::Count, 0.0f)
+        {
+
+        }
+
+        float* BatchTrajectories::at(int param_set, int host, int step)
+        {
+            return &data[((size_t(param_set) * n_hosts + host) * n_steps + step) * n_channels];
+        }
+
+
+        BatchTrajectories* ChallengeBatch::Run(const std::vector<IntrahostParamsPtr>& blocks,
+                                               int n_hosts,
+                                               int duration,
+                                               const std::vector<int>& challenge_days,
+                                               float dt,
+                                               int n_threads,
+                                               int variance_reduction)
+        {
+            if (n_hosts < 0) throw std::invalid_argument("ChallengeBatch needs a non-negative number of hosts");
+
+            std::vector<bool> challenged = ChallengeSchedule(duration, challenge_days, dt);
+            int n_steps = int(challenged.size());
+            int n_challenges = int(std::count(challenged.begin(), challenged.end(), true));
+
+            int n_param_sets = int(blocks.size());
+            BatchTrajectories* result = new BatchTrajectories(n_param_sets, n_hosts, n_steps);
+
+            bool antithetic = (variance_reduction & VarianceReduction::Antithetic) != 0;
+
+            // Parameter sets sharing a seed share their strata too, preserving common random numbers
+            int n_draws = n_challenges * REPERTOIRE_DRAWS;
+            std::map<int, std::vector<uint32_t>> strata;
+            if (variance_reduction & VarianceReduction::StratifiedRepertoire)
+            {
+                for (const auto& block: blocks)
+                {
+                    if (!strata.count(block->randomSeed))
+                    {
+                        strata[block->randomSeed] = StratifiedRepertoireDraws(block->randomSeed, n_hosts, n_draws);
+                    }
+                }
+            }
+
+            // Each run is one host under one parameter set, writing only to its own slice of the output
+            WorkStealingScheduler scheduler(n_threads);
+            scheduler.ParallelFor(size_t(n_param_sets) * n_hosts, [&](size_t begin, size_t end) {
+                for (size_t run = begin; run < end; run++)
+                {
+                    int k = int(run / n_hosts);
+                    int h = int(run % n_hosts);
+
+                    auto rng = IntrahostComponent::CreateHostStream(blocks[k]->randomSeed, h, blocks[k]->common_random_numbers);
+                    if (antithetic)
+                    {
+                        // Partners share only their normal deviates, from a pair stream indexed past the host streams:
+                        // sharing uniforms too would pair identical repertoires, correlating the partners positively
+                        auto pair = IntrahostComponent::CreateHostStream(blocks[k]->randomSeed, n_hosts + h / 2, blocks[k]->common_random_numbers);
+                        rng->SetGaussianStream(pair->Clone(), (h & 1) != 0);
+                    }
+                    std::unique_ptr<IntrahostComponent> host(IntrahostComponent::Create(blocks[k], rng));
+
+                    if (!strata.empty())
+                    {
+                        const uint32_t* row = strata[blocks[k]->randomSeed].data() + size_t(h) * n_draws;
+                        host->SetRepertoireStream(std::make_shared<PRESET_SEQUENCE>(std::vector<uint32_t>(row, row + n_draws)));
+                    }
+
+                    for (int t = 0; t < n_steps; t++)
+                    {
+                        if (challenged[t]) host->Challenge();
+                        host->Update(dt);
+
+                        float* record = result->at(k, h, t);
+                        record[TrajectoryChannel::ParasiteDensity] = host->GetParasiteDensity();
+                        record[TrajectoryChannel::GametocyteDensity] = host->GetGametocyteDensity();
+                        record[TrajectoryChannel::FeverTemperature] = host->GetFeverTemperature();
+                        record[TrajectoryChannel::Infectiousness] = host->GetInfectiousness();
+                    }
+                }
+            });
+
+            return result;
+        }
+
+        std::vector<bool> ChallengeBatch::ChallengeSchedule(int duration, const std::vector<int>& challenge_days, float dt)
+        {
+            if (duration < 0) throw std::invalid_argument("Challenge protocol needs a non-negative duration");
+            if (!(dt > 0)) throw std::invalid_argument("Challenge protocol needs a positive time step");
+
+            const double eps = 1e-4;  // of a step, so whole multiples of an inexact float dt (e.g. 0.1) land on their own step
+            int n_steps = int(std::ceil(duration / double(dt) - eps));
+
+            std::vector<bool> challenged(n_steps, false);
+            for (int day: challenge_days)
+            {
+                if (day < 0 || day >= duration) continue;
+                challenged[std::min(int(std::floor(day / double(dt) + eps)), n_steps - 1)] = true;
+            }
+            return challenged;
+        }
+
+        std::vector<uint32_t> ChallengeBatch::StratifiedRepertoireDraws(int randomSeed, int n_hosts, int n_draws)
+        {
+            std::vector<uint32_t> draws(size_t(n_hosts) * n_draws);
+            std::vector<uint32_t> strata(n_hosts);
+
+            // Column d gives host h the draw (pi_d(h) + v) / n_hosts for a random permutation pi_d and jitter v.
+            // Each draw is marginally uniform and the columns are independent, so every host's repertoire
+            // keeps its distribution, while each slot of the repertoire covers its range evenly across hosts.
+            PSEUDO_DES rng(uint64_t(uint32_t(randomSeed)) << 32 | 0x5EEDu, 256);
+            for (int d = 0; d < n_draws; d++)
+            {
+                for (int h = 0; h < n_hosts; h++)
+                {
+                    strata[h] = uint32_t(h);
+                }
+                for (int h = n_hosts - 1; h > 0; h--)
+                {
+                    std::swap(strata[h], strata[rng.uniformZeroToN32(uint32_t(h + 1))]);
+                }
+
+                for (int h = 0; h < n_hosts; h++)
+                {
+                    uint64_t u = ((uint64_t(strata[h]) << 32) + rng.ul()) / uint64_t(n_hosts);
+                    draws[size_t(h) * n_draws + d] = uint32_t(u);
+                }
+            }
+
+            return draws;
+        }
+
+    }
+
+}
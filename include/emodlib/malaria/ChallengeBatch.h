@@ -0,0 +1,72 @@
+/**
+ * @file ChallengeBatch.h
+ *
+ * @brief Batched challenge protocol over many parameter sets
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "MalariaEnums.h"
+#include "MalariaParams.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        // Stacked trajectories with shape (param_set, host, time, channel), stored row-major
+        struct BatchTrajectories
+        {
+            int n_param_sets;
+            int n_hosts;
+            int n_steps;
+            int n_channels;
+
+            std::vector<float> data;
+
+            BatchTrajectories(int _n_param_sets, int _n_hosts, int _n_steps);
+
+            float* at(int param_set, int host, int step);
+        };
+
+
+        class ChallengeBatch
+        {
+
+        public:
+
+            // Runs the same challenge protocol for every parameter block, spreading the
+            // (param_set, host) runs across n_threads. Hosts with the same index share a
+            // stream seed in every parameter set, so differences between sets are not
+            // drowned out by sampling noise.
+            //
+            // variance_reduction combines VarianceReduction flags. Each host's trajectory keeps its
+            // distribution under either mode, so ensemble means stay unbiased; with Antithetic,
+            // average hosts 2m and 2m+1 as one replicate when estimating the standard error.
+            //
+            // duration and challenge_days are in days, recorded as ceil(duration / dt) steps.
+            // Throws std::invalid_argument for negative n_hosts or duration, or a non-positive dt.
+            static BatchTrajectories* Run(const std::vector<IntrahostParamsPtr>& blocks,
+                                          int n_hosts,
+                                          int duration,
+                                          const std::vector<int>& challenge_days,
+                                          float dt=1.0f,
+                                          int n_threads=1,
+                                          int variance_reduction=VarianceReduction::None);
+
+            // Whether each step of length dt starts with a challenge, over duration days:
+            // a challenge on day d lands on the step containing it, and days outside the run are ignored
+            static std::vector<bool> ChallengeSchedule(int duration, const std::vector<int>& challenge_days, float dt);
+
+            // (host, draw) matrix of repertoire draws, each column a random Latin-hypercube sample over hosts
+            static std::vector<uint32_t> StratifiedRepertoireDraws(int randomSeed, int n_hosts, int n_draws);
+
+        };
+
+    }
+
+}
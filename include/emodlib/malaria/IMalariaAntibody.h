@@ -2,6 +2,8 @@
 
 #include <stdint.h>
 
+#include "emodlib/utils/Precision.h"
+
 #include "MalariaEnums.h"
 
 
@@ -14,9 +16,9 @@ namespace emodlib
         struct IMalariaAntibody
         {
             virtual void  Decay( float dt ) = 0;
-            virtual float StimulateCytokines( float dt, float inv_uL_blood ) = 0;
-            virtual void  UpdateAntibodyCapacity( float dt, float inv_uL_blood ) = 0;
-            virtual void  UpdateAntibodyCapacityByRate( float dt, float growth_rate ) = 0;
+            virtual real_t StimulateCytokines( float dt, real_t inv_uL_blood ) = 0;
+            virtual void  UpdateAntibodyCapacity( float dt, real_t inv_uL_blood ) = 0;
+            virtual void  UpdateAntibodyCapacityByRate( float dt, real_t growth_rate ) = 0;
             virtual void  UpdateAntibodyConcentration( float dt ) = 0;
             virtual void  ResetCounters() = 0;
 
@@ -25,11 +27,11 @@ namespace emodlib
 
             virtual int64_t GetAntigenCount()          const = 0;
             virtual bool    GetAntigenicPresence()     const = 0;
-            virtual float   GetAntibodyCapacity()      const = 0;
-            virtual float   GetAntibodyConcentration() const = 0;
+            virtual real_t   GetAntibodyCapacity()      const = 0;
+            virtual real_t   GetAntibodyConcentration() const = 0;
 
-            virtual void    SetAntibodyCapacity( float antibody_capacity ) = 0;
-            virtual void    SetAntibodyConcentration( float antibody_concentration ) = 0;
+            virtual void    SetAntibodyCapacity( real_t antibody_capacity ) = 0;
+            virtual void    SetAntibodyConcentration( real_t antibody_concentration ) = 0;
 
             virtual MalariaAntibodyType::Enum GetAntibodyType() const = 0;
             virtual int GetAntibodyVariant() const = 0;
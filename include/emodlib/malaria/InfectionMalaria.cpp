@@ -6,14 +6,21 @@
 
 #include "InfectionMalaria.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <mutex>
 #include <numeric>
+#include <stdexcept>
 
+#include "emodlib/utils/BinaryArchive.h"
 #include "emodlib/utils/Common.h"
+#include "emodlib/utils/Instrumentation.h"
 #include "emodlib/utils/Sigmoid.h"
 
 #include "IntrahostComponent.h"
 #include "SusceptibilityMalaria.h"
+#include "SwitchingPolicy.h"
 
 
 namespace emodlib
@@ -22,44 +29,8 @@ namespace emodlib
     namespace malaria
     {
 
-        // TODO: emodlib#8 (boost + enums)
-        // ParasiteSwitchType::Enum Infection::params::parasite_switch_type = ParasiteSwitchType::RATE_PER_PARASITE_7VARS;
-        // MalariaStrains::Enum     Infection::params::malaria_strains = MalariaStrains::FALCIPARUM_RANDOM_STRAIN;
-
-        float Infection::params::incubation_period = 7.0f; // liver stage duration
-
-        float Infection::params::antibody_IRBC_killrate = DEFAULT_ANTIBODY_IRBC_KILLRATE;
-        float Infection::params::non_specific_antigenicity = DEFAULT_NON_SPECIFIC_ANTIGENICITY;
-        float Infection::params::MSP1_merozoite_kill = DEFAULT_MSP1_MEROZOITE_KILL;
-        float Infection::params::gametocyte_stage_survival = DEFAULT_GAMETOCYTE_STAGE_SURVIVAL;
-        float Infection::params::base_gametocyte_sexratio = DEFAULT_BASE_GAMETOCYTE_SEX_RATIO;
-        float Infection::params::base_gametocyte_production = DEFAULT_BASE_GAMETOCYTE_PRODUCTION;
-        float Infection::params::antigen_switch_rate = DEFAULT_ANTIGEN_SWITCH_RATE;
-        float Infection::params::merozoites_per_hepatocyte = DEFAULT_MEROZOITES_PER_HEPATOCYTE;
-        float Infection::params::merozoites_per_schizont = DEFAULT_MEROZOITES_PER_SCHIZONT;
-        float Infection::params::RBC_destruction_multiplier = DEFAULT_RBC_DESTRUCTION_MULTIPLIER;
-        int   Infection::params::n_asexual_cycles_wo_gametocytes = DEFAULT_ASEXUAL_CYCLES_WITHOUT_GAMETOCYTES;
-
-
         suids::distributed_generator Infection::infectionSuidGenerator(0, 0);
-
-
-        void Infection::params::Configure(const ParamSet& pset)
-        {
-            incubation_period = pset["Base_Incubation_Period"].cast<float>();  // TODO: emodlib#6 (gaussian distribution)
-
-            antibody_IRBC_killrate = pset["Antibody_IRBC_Kill_Rate"].cast<float>();
-            non_specific_antigenicity = pset["Nonspecific_Antigenicity_Factor"].cast<float>();
-            MSP1_merozoite_kill = pset["MSP1_Merozoite_Kill_Fraction"].cast<float>();
-            gametocyte_stage_survival = pset["Gametocyte_Stage_Survival_Rate"].cast<float>();
-            base_gametocyte_sexratio = pset["Base_Gametocyte_Fraction_Male"].cast<float>();
-            base_gametocyte_production = pset["Base_Gametocyte_Production_Rate"].cast<float>();
-            antigen_switch_rate = pset["Antigen_Switch_Rate"].cast<float>();
-            merozoites_per_hepatocyte = pset["Merozoites_Per_Hepatocyte"].cast<float>();
-            merozoites_per_schizont = pset["Merozoites_Per_Schizont"].cast<float>();
-            RBC_destruction_multiplier = pset["RBC_Destruction_Multiplier"].cast<float>();
-            n_asexual_cycles_wo_gametocytes = pset["Number_Of_Asexual_Cycles_Without_Gametocytes"].cast<int>();
-        }
+        static std::mutex infectionSuidMutex;  // infections may be created from hosts updated on different threads
 
 
         Infection::Infection()
@@ -71,15 +42,12 @@ namespace emodlib
             , m_asexual_phase(AsexualCycleStatus::NoAsexualCycle)
             , m_asexual_cycle_count(0)
 
-            , m_MSPtype(0)
-            , m_nonspectype(0)
-            , m_minor_epitope_type()
-            , m_IRBCtype()
+            , m_repertoire(nullptr)
 
             , m_MSP_antibody(nullptr)
-            , m_PfEMP1_antibodies(CLONAL_PfEMP1_VARIANTS)
+            , m_PfEMP1_antibodies()
 
-            , m_IRBC_count(CLONAL_PfEMP1_VARIANTS)
+            , m_IRBC_count()
             , m_malegametocytes()
             , m_femalegametocytes()
 
@@ -87,22 +55,39 @@ namespace emodlib
             , m_gametosexratio(0.0)
 
             , immunity(nullptr)
+            , m_params(nullptr)
+            , rng(nullptr)
+            , m_ordinal(0)
         {
 
         }
 
-        Infection* Infection::Create(Susceptibility* _susceptibility, int initial_hepatocytes)
+        Infection* Infection::Create(Susceptibility* _susceptibility, int initial_hepatocytes, RANDOMBASE* _rng, int _ordinal, RANDOMBASE* _repertoire_rng, int _strain_id)
         {
             Infection *newinfection = new Infection();
-            newinfection->Initialize(_susceptibility, initial_hepatocytes);
+
+            try
+            {
+                newinfection->Initialize(_susceptibility, initial_hepatocytes, _rng, _ordinal, _repertoire_rng, _strain_id);
+            }
+            catch (...)
+            {
+                delete newinfection;
+                throw;
+            }
 
             return newinfection;
         }
 
-        void Infection::Initialize(Susceptibility* _susceptibility, int initial_hepatocytes)
+        void Infection::Initialize(Susceptibility* _susceptibility, int initial_hepatocytes, RANDOMBASE* _rng, int _ordinal, RANDOMBASE* _repertoire_rng, int _strain_id)
         {
-            suid = infectionSuidGenerator();  // next suid from generator
+            nextSuid();
             m_hepatocytes = initial_hepatocytes;
+            rng = _rng;
+            m_ordinal = _ordinal;
+
+            immunity = _susceptibility;
+            m_params = immunity->get_params();
 
             // Here we set the antigenic repertoire of the infection
             // Can be completely distinct strains, or partially overlapping repertoires of antigens
@@ -110,32 +95,138 @@ namespace emodlib
             // Recker, M., S. Nee, et al. (2004). "Transient cross-reactive immune responses can orchestrate antigenic variation in malaria." Nature 429(6991): 555-558.
             // In our model, not all antigens are expressed at the same time, but switching occurs.  This just sets the total repertoire
 
-            auto rng = IntrahostComponent::p_rng;
+            // An ensemble may supply repertoire draws stratified across its hosts
+            RANDOMBASE* prng = _repertoire_rng ? _repertoire_rng : random(RandomPurpose::Repertoire);
+            m_repertoire = StrainLibrary::Get(m_params, _strain_id, prng);
 
-            m_MSPtype = rng->uniformZeroToN16(IntrahostComponent::params::falciparumMSPVars);
-            m_nonspectype = rng->uniformZeroToN16(IntrahostComponent::params::falciparumNonSpecTypes);
+            m_MSP_antibody = immunity->RegisterAntibody(MalariaAntibodyType::MSP1, m_repertoire->MSPtype);
 
-            for (int i = 0; i < CLONAL_PfEMP1_VARIANTS; i++)
+            for( int ivariant = 0; ivariant < CLONAL_PfEMP1_VARIANTS; ivariant++ )
             {
-                m_IRBCtype[i] = rng->uniformZeroToN16(IntrahostComponent::params::falciparumPfEMP1Vars);
-                m_minor_epitope_type[i] = rng->uniformZeroToN16(MINOR_EPITOPE_VARS_PER_SET) + MINOR_EPITOPE_VARS_PER_SET * m_nonspectype;
+                m_PfEMP1_antibodies[ivariant].major = nullptr;
+                m_PfEMP1_antibodies[ivariant].minor = nullptr;
+
+                if ( m_IRBC_count[ivariant] > 0 )
+                {
+                    m_PfEMP1_antibodies[ivariant].minor  = immunity->RegisterAntibody(MalariaAntibodyType::PfEMP1_minor, m_repertoire->minor_epitope_type[ivariant]);
+                    m_PfEMP1_antibodies[ivariant].major  = immunity->RegisterAntibody(MalariaAntibodyType::PfEMP1_major, m_repertoire->IRBCtype[ivariant]);
+                }
             }
+        }
 
-            immunity = _susceptibility;
+        void Infection::nextSuid()
+        {
+            std::lock_guard<std::mutex> lock(infectionSuidMutex);
+            suid = infectionSuidGenerator();  // next suid from generator
+        }
+
+        void Infection::Serialize(BinaryWriter& writer) const
+        {
+            writer.Write<int32_t>(m_ordinal);
+
+            writer.Write<float>(m_liver_stage_timer);
+            writer.Write<real_t>(m_IRBCtimer);
+            writer.Write<int32_t>(m_hepatocytes);
+            writer.Write<int32_t>(m_asexual_phase);
+            writer.Write<int32_t>(m_asexual_cycle_count);
 
-            m_MSP_antibody = immunity->RegisterAntibody(MalariaAntibodyType::MSP1, m_MSPtype);
+            StrainLibrary::Serialize(*m_repertoire, writer);
 
-            for( int ivariant = 0; ivariant < m_PfEMP1_antibodies.size(); ivariant++ )
+            // Each link is to the antibody of the variant's own epitope type, so presence is all that needs saving
+            for (const auto& antibodies : m_PfEMP1_antibodies)
             {
-                m_PfEMP1_antibodies[ivariant].major = nullptr;
-                m_PfEMP1_antibodies[ivariant].minor = nullptr;
+                writer.Write<uint8_t>((antibodies.minor ? 1 : 0) | (antibodies.major ? 2 : 0));
+            }
 
-                if ( m_IRBC_count[ivariant] > 0 )
+            writer.WriteArray(m_IRBC_count.data(), CLONAL_PfEMP1_VARIANTS);
+            writer.WriteArray(m_malegametocytes, GametocyteStages::Count);
+            writer.WriteArray(m_femalegametocytes, GametocyteStages::Count);
+
+            writer.Write<real_t>(m_gametorate);
+            writer.Write<real_t>(m_gametosexratio);
+        }
+
+        Infection* Infection::Deserialize(BinaryReader& reader, Susceptibility* _susceptibility, RANDOMBASE* _rng)
+        {
+            Infection* inf = new Infection();
+
+            try
+            {
+                inf->nextSuid();  // suids identify infections within a process, so are not carried over
+                inf->rng = _rng;
+                inf->immunity = _susceptibility;
+                inf->m_params = _susceptibility->get_params();
+
+                inf->m_ordinal = reader.Read<int32_t>();
+
+                inf->m_liver_stage_timer = reader.Read<float>();
+                inf->m_IRBCtimer = reader.Read<real_t>();
+                inf->m_hepatocytes = reader.Read<int32_t>();
+                inf->m_asexual_phase = AsexualCycleStatus::Enum(reader.Read<int32_t>());
+                inf->m_asexual_cycle_count = reader.Read<int32_t>();
+
+                inf->m_repertoire = StrainLibrary::Deserialize(reader, inf->m_params);
+                const Repertoire& repertoire = *inf->m_repertoire;
+
+                inf->m_MSP_antibody = _susceptibility->RegisterAntibody(MalariaAntibodyType::MSP1, repertoire.MSPtype);
+
+                for (int i = 0; i < CLONAL_PfEMP1_VARIANTS; i++)
                 {
-                    m_PfEMP1_antibodies[ivariant].minor  = immunity->RegisterAntibody(MalariaAntibodyType::PfEMP1_minor, m_minor_epitope_type[ivariant]);
-                    m_PfEMP1_antibodies[ivariant].major  = immunity->RegisterAntibody(MalariaAntibodyType::PfEMP1_major, m_IRBCtype[ivariant]);
+                    uint8_t links = reader.Read<uint8_t>();
+                    if (links & 1)
+                        inf->m_PfEMP1_antibodies[i].minor = _susceptibility->RegisterAntibody(MalariaAntibodyType::PfEMP1_minor, repertoire.minor_epitope_type[i]);
+                    if (links & 2)
+                        inf->m_PfEMP1_antibodies[i].major = _susceptibility->RegisterAntibody(MalariaAntibodyType::PfEMP1_major, repertoire.IRBCtype[i]);
                 }
+
+                reader.ReadArray(inf->m_IRBC_count.data(), CLONAL_PfEMP1_VARIANTS);
+                reader.ReadArray(inf->m_malegametocytes, GametocyteStages::Count);
+                reader.ReadArray(inf->m_femalegametocytes, GametocyteStages::Count);
+
+                inf->m_gametorate = reader.Read<real_t>();
+                inf->m_gametosexratio = reader.Read<real_t>();
+            }
+            catch (...)
+            {
+                delete inf;
+                throw;
+            }
+
+            return inf;
+        }
+
+        Infection* Infection::Clone(Susceptibility* _susceptibility, const std::unordered_map<const IMalariaAntibody*, IMalariaAntibody*>& antibody_map, RANDOMBASE* _rng) const
+        {
+            Infection* inf = new Infection(*this);  // parasite state, sharing the repertoire
+            inf->nextSuid();
+            inf->immunity = _susceptibility;
+            inf->rng = _rng;
+
+            auto relink = [&](IMalariaAntibody* antibody) { return antibody ? antibody_map.at(antibody) : nullptr; };
+
+            inf->m_MSP_antibody = relink(m_MSP_antibody);
+            for (size_t i = 0; i < m_PfEMP1_antibodies.size(); i++)
+            {
+                inf->m_PfEMP1_antibodies[i].minor = relink(m_PfEMP1_antibodies[i].minor);
+                inf->m_PfEMP1_antibodies[i].major = relink(m_PfEMP1_antibodies[i].major);
             }
+
+            return inf;
+        }
+
+        RANDOMBASE* Infection::random(RandomPurpose::Enum purpose, int item) const
+        {
+            if (!rng)
+                return IntrahostComponent::p_rng.get();
+
+            // Keyed streams reposition on (infection, purpose, day, item), so that parameter sets whose
+            // control flow agrees see the same draws.  Host age stands in for the day, at any dt.
+            float age = immunity->get_age();
+            uint32_t step;
+            memcpy(&step, &age, sizeof(step));
+
+            rng->SetKey(uint32_t(m_ordinal), uint32_t(purpose), step, uint32_t(item));
+            return rng;
         }
 
         void Infection::Update(float dt)
@@ -194,6 +285,8 @@ namespace emodlib
 
         void Infection::malariaProcessHepatocytes(float dt)
         {
+            EMODLIB_PHASE(ProcessHepatocytes);
+
             // check for valid inputs
             if (dt > 0 && immunity && m_hepatocytes > 0)
             {
@@ -206,9 +299,9 @@ namespace emodlib
                 // --- process start of asexual phase if the incubation period is over and there are still hepatocytes
                 // ----------------------------------------------------------------------------------------------------------------------
                 if (m_asexual_phase == AsexualCycleStatus::NoAsexualCycle &&
-                     m_liver_stage_timer >= Infection::params::incubation_period)
+                     m_liver_stage_timer >= m_params->infection.incubation_period)
                 {
-                    m_IRBC_count.assign(CLONAL_PfEMP1_VARIANTS, 0);
+                    m_IRBC_count.fill(0);
 
                     // testing starting with multiple antigens, which reduces the probability of a single first variant being cleared by a pre-existing antibody response
                     // picked starting with 5 variants after exploring different options in work developing Intrahost model
@@ -216,8 +309,8 @@ namespace emodlib
                     #pragma loop(hint_parallel(8))
                     for ( int i=0; i<INITIAL_PFEMP1_VARIANTS; i++ )
                     {
-                        m_IRBC_count[i] = int64_t(m_hepatocytes * Infection::params::merozoites_per_hepatocyte / INITIAL_PFEMP1_VARIANTS);
-                        immunity->UpdateActiveAntibody( m_PfEMP1_antibodies[i], m_minor_epitope_type[i], m_IRBCtype[i] ); // insert into set of antigens the immune system has ever "seen"
+                        m_IRBC_count[i] = int64_t(m_hepatocytes * m_params->infection.merozoites_per_hepatocyte / INITIAL_PFEMP1_VARIANTS);
+                        immunity->UpdateActiveAntibody( m_PfEMP1_antibodies[i], m_repertoire->minor_epitope_type[i], m_repertoire->IRBCtype[i] ); // insert into set of antigens the immune system has ever "seen"
                     }
 
                     // now back to normal
@@ -230,13 +323,15 @@ namespace emodlib
 
         void Infection::processEndOfAsexualCycle()
         {
+            EMODLIB_PHASE(EndOfAsexualCycle);
+
             // Merozoite-specific antibodies can limit merozoite success--Blackman, M. J., H. G. Heidrich, et al. (1990).
             // "A single fragment of a malaria merozoite surface protein remains on the parasite during red cell invasion
             // and is the target of invasion-inhibiting antibodies." J Exp Med 172(1): 379-382.
-            double RBCavailability = immunity->get_RBC_availability();
+            real_t RBCavailability = immunity->get_RBC_availability();
 
             // Merozoite survival limited at very low density according to density-dependent probability-of-success formula
-            double merozoitesurvival = std::max(0.0, (1.0 - Infection::params::MSP1_merozoite_kill * m_MSP_antibody->GetAntibodyConcentration() ) * EXPCDF(-RBCavailability / MEROZOITE_LIMITING_RBC_THRESHOLD));
+            real_t merozoitesurvival = std::max(real_t(0), (real_t(1) - m_params->infection.MSP1_merozoite_kill * m_MSP_antibody->GetAntibodyConcentration() ) * EXPCDF(-RBCavailability / real_t(MEROZOITE_LIMITING_RBC_THRESHOLD)));
 
             // How many rupture for this infection handed to suscept object for total stimulation calculations
             int64_t totalIRBC = 0;
@@ -259,12 +354,12 @@ namespace emodlib
                 if ( m_IRBC_count[j] > 0 )
                 {
                     totalIRBC += m_IRBC_count[j];
-                    immunity->UpdateActiveAntibody( m_PfEMP1_antibodies[j], m_minor_epitope_type[j], m_IRBCtype[j] ); // insert into set of antigens the immune system has ever "seen"
+                    immunity->UpdateActiveAntibody( m_PfEMP1_antibodies[j], m_repertoire->minor_epitope_type[j], m_repertoire->IRBCtype[j] ); // insert into set of antigens the immune system has ever "seen"
                 }
             }
 
             // Uninfected RBC killing diminishing in proportion to RBC availability
-            double destruction_factor_ = std::max(1.0, Infection::params::RBC_destruction_multiplier * EXPCDF(-RBCavailability / MEROZOITE_LIMITING_RBC_THRESHOLD) );
+            real_t destruction_factor_ = std::max(real_t(1), m_params->infection.RBC_destruction_multiplier * EXPCDF(-RBCavailability / real_t(MEROZOITE_LIMITING_RBC_THRESHOLD)) );
             immunity->remove_RBCs( totalIRBC, m_malegametocytes[0] + m_femalegametocytes[0], destruction_factor_ );
 
             // reset timer for next asexual cycle
@@ -275,10 +370,9 @@ namespace emodlib
         }
 
         // Calculates the antigenic switching when an asexual cycle completes and creates next generation of IRBC's
-        void Infection::malariaIRBCAntigenSwitch(double merozoitesurvival)
+        void Infection::malariaIRBCAntigenSwitch(real_t merozoitesurvival)
         {
-            int64_t switchingIRBC[SWITCHING_IRBC_VARIANT_COUNT];
-            std::vector<int64_t> tmpIRBCcount(CLONAL_PfEMP1_VARIANTS);
+            EMODLIB_PHASE(IRBCAntigenSwitch);
 
             // check for valid range of input, and only create next cycle if valid
             if (merozoitesurvival < 0)
@@ -287,7 +381,34 @@ namespace emodlib
                 throw;
             }
 
-            // Several antigen switching mechanisms are supported
+            // Several antigen switching mechanisms are supported, each an instantiation of the kernel below
+            switch (m_params->infection.parasite_switch_type)
+            {
+            case ParasiteSwitchType::CONSTANT_SWITCH_RATE_2VARS:
+                antigenSwitch< SwitchingPolicy<ParasiteSwitchType::CONSTANT_SWITCH_RATE_2VARS> >(merozoitesurvival);
+                break;
+
+            case ParasiteSwitchType::RATE_PER_PARASITE_7VARS:
+                antigenSwitch< SwitchingPolicy<ParasiteSwitchType::RATE_PER_PARASITE_7VARS> >(merozoitesurvival);
+                break;
+
+            case ParasiteSwitchType::RATE_PER_PARASITE_5VARS_DECAYING:
+                antigenSwitch< SwitchingPolicy<ParasiteSwitchType::RATE_PER_PARASITE_5VARS_DECAYING> >(merozoitesurvival);
+                break;
+
+            default:
+                throw std::logic_error("Unknown parasite switch type " + std::to_string(int(m_params->infection.parasite_switch_type)));
+            }
+        }
+
+        template<class SwitchingPolicy>
+        void Infection::antigenSwitch(real_t merozoitesurvival)
+        {
+            int64_t switchingIRBC[SwitchingPolicy::n_targets]{};
+            std::array<int64_t, CLONAL_PfEMP1_VARIANTS> tmpIRBCcount = {};
+
+            real_t antigen_switch_rate = m_params->infection.antigen_switch_rate;
+
             #pragma loop(hint_parallel(8))
             for (int j = 0; j < CLONAL_PfEMP1_VARIANTS; j++)
             {
@@ -298,51 +419,63 @@ namespace emodlib
                 if ( m_IRBC_count[j] <= 0 ) continue; // no IRBC means no contribution to next time step
 
                 int64_t temp_sum_IRBC = 0;
-                if (Infection::params::antigen_switch_rate > 0)
+                if (antigen_switch_rate > 0)
                 {
-                    #pragma loop(hint_parallel(8))
-                    for ( int iswitch = 0; iswitch < SWITCHING_IRBC_VARIANT_COUNT; iswitch++ )
+                    if (SwitchingPolicy::stochastic)
+                    {
+                        RANDOMBASE* prng = random(RandomPurpose::AntigenSwitch, j);
+
+                        #pragma loop(hint_parallel(8))
+                        for ( int iswitch = 0; iswitch < SwitchingPolicy::n_targets; iswitch++ )
+                        {
+                            switchingIRBC[iswitch] = prng->Poisson(antigen_switch_rate * m_IRBC_count[j] * real_t(SwitchingPolicy::weight(iswitch)));
+                        }
+                    }
+                    else
                     {
-                        switchingIRBC[iswitch] = (iswitch < 7) ? IntrahostComponent::p_rng->Poisson(Infection::params::antigen_switch_rate * m_IRBC_count[j]) : 0;
+                        for ( int iswitch = 0; iswitch < SwitchingPolicy::n_targets; iswitch++ )
+                        {
+                            switchingIRBC[iswitch] = int64_t(antigen_switch_rate * m_IRBC_count[j] * real_t(SwitchingPolicy::weight(iswitch)));
+                        }
                     }
 
                     // now test to see if these add up to more than 100 percent
-                    temp_sum_IRBC = std::accumulate(switchingIRBC, switchingIRBC + SWITCHING_IRBC_VARIANT_COUNT, temp_sum_IRBC);
+                    temp_sum_IRBC = std::accumulate(switchingIRBC, switchingIRBC + SwitchingPolicy::n_targets, temp_sum_IRBC);
 
                     // if more than 100 percent minus those switching to gametocyte production, scale down in multiplicative way
-                    if (temp_sum_IRBC > ((1.0 - m_gametorate)*m_IRBC_count[j]))
+                    if (temp_sum_IRBC > ((real_t(1) - m_gametorate)*m_IRBC_count[j]))
                     {
                         #pragma loop(hint_parallel(8))
-                        for (int iswitch = 0; iswitch < SWITCHING_IRBC_VARIANT_COUNT; iswitch++)
-                            switchingIRBC[iswitch] = int64_t(switchingIRBC[iswitch] * ((1.0f - m_gametorate) * m_IRBC_count[j] / temp_sum_IRBC));
+                        for (int iswitch = 0; iswitch < SwitchingPolicy::n_targets; iswitch++)
+                            switchingIRBC[iswitch] = int64_t(switchingIRBC[iswitch] * ((real_t(1) - m_gametorate) * m_IRBC_count[j] / temp_sum_IRBC));
 
-                        temp_sum_IRBC = int64_t((1.0 - m_gametorate) * m_IRBC_count[j]);
+                        temp_sum_IRBC = int64_t((real_t(1) - m_gametorate) * m_IRBC_count[j]);
                     }
                 }
 
                 // Now switch to next stages based on predetermined number of switching IRBC's
-                tmpIRBCcount[j] = int64_t(tmpIRBCcount[j] + ((1.0 - m_gametorate) * m_IRBC_count[j] - temp_sum_IRBC) * Infection::params::merozoites_per_schizont * merozoitesurvival);
-                if (Infection::params::antigen_switch_rate > 0)
+                tmpIRBCcount[j] = int64_t(tmpIRBCcount[j] + ((real_t(1) - m_gametorate) * m_IRBC_count[j] - temp_sum_IRBC) * m_params->infection.merozoites_per_schizont * merozoitesurvival);
+                if (antigen_switch_rate > 0)
                 {
                     #pragma loop(hint_parallel(8))
-                    for ( int iswitch = 0; iswitch < SWITCHING_IRBC_VARIANT_COUNT; iswitch++)
+                    for ( int iswitch = 0; iswitch < SwitchingPolicy::n_targets; iswitch++)
                     {
-                        tmpIRBCcount[(j + iswitch + 1) % CLONAL_PfEMP1_VARIANTS]  = int64_t(tmpIRBCcount[(j + iswitch + 1) % CLONAL_PfEMP1_VARIANTS] + switchingIRBC[iswitch] * Infection::params::merozoites_per_schizont * merozoitesurvival);
+                        tmpIRBCcount[(j + iswitch + 1) % CLONAL_PfEMP1_VARIANTS]  = int64_t(tmpIRBCcount[(j + iswitch + 1) % CLONAL_PfEMP1_VARIANTS] + switchingIRBC[iswitch] * m_params->infection.merozoites_per_schizont * merozoitesurvival);
                     }
                 }
             }
 
-            m_IRBC_count.swap(tmpIRBCcount); // swap temporarily accumulated vector of next time step into data member
+            m_IRBC_count = tmpIRBCcount; // copy temporarily accumulated counts of next time step into data member
         }
 
         // Moves all falciparum gametocytes forward a development stage when an asexual cycle completes, and creates the stage 0 immature gametocytes
-        void Infection::malariaCycleGametocytes(double merozoitesurvival)
+        void Infection::malariaCycleGametocytes(real_t merozoitesurvival)
         {
             // set gametocyte production rate for next cycle
-            if ( m_asexual_cycle_count >= Infection::params::n_asexual_cycles_wo_gametocytes )
+            if ( m_asexual_cycle_count >= m_params->infection.n_asexual_cycles_wo_gametocytes )
             {
-                m_gametorate     = double(Infection::params::base_gametocyte_production); // gametocyte production used by all switching calculations, here is where factors modifying production would go
-                m_gametosexratio = double(Infection::params::base_gametocyte_sexratio);
+                m_gametorate     = real_t(m_params->infection.base_gametocyte_production); // gametocyte production used by all switching calculations, here is where factors modifying production would go
+                m_gametosexratio = real_t(m_params->infection.base_gametocyte_sexratio);
             }
 
             // check for valid range of input, and only create next cycle if valid
@@ -352,13 +485,13 @@ namespace emodlib
                 //process gametocytes--5 stages--Sinden, R. E., G. A. Butcher, et al. (1996). "Regulation of Infectivity of Plasmodium to the Mosquito Vector." Advances in Parasitology 38: 53-117.
                 for (int j = GametocyteStages::Mature; j > 0; j--) // move developing gametocytes forward a class, moving backwards through stages to not override next stage's values
                 {
-                    m_malegametocytes[j] = int64_t(m_malegametocytes[j] + m_malegametocytes[j - 1] * Infection::params::gametocyte_stage_survival);
+                    m_malegametocytes[j] = int64_t(m_malegametocytes[j] + m_malegametocytes[j - 1] * m_params->infection.gametocyte_stage_survival);
                     m_malegametocytes[j - 1] = 0;
 
                     if (m_malegametocytes[j] < 1)
                         m_malegametocytes[j] = 0;
 
-                    m_femalegametocytes[j] = int64_t(m_femalegametocytes[j] + (m_femalegametocytes[j - 1] * Infection::params::gametocyte_stage_survival));
+                    m_femalegametocytes[j] = int64_t(m_femalegametocytes[j] + (m_femalegametocytes[j - 1] * m_params->infection.gametocyte_stage_survival));
                     m_femalegametocytes[j - 1] = 0;
 
                     if (m_femalegametocytes[j] < 1)
@@ -371,8 +504,8 @@ namespace emodlib
                 {
                     // review of production rates and sex ratios in Sinden, R. E., G. A. Butcher, et al. (1996). "Regulation of Infectivity of Plasmodium to the Mosquito Vector." Advances in Parasitology 38: 53-117.
                     // each factor may be variable, but here we leave it constant at the moment, conservatively not including the possible senescence of transmission in late infection
-                    m_malegametocytes[GametocyteStages::Stage0]   = int64_t(m_malegametocytes[GametocyteStages::Stage0]   + m_IRBC_count[j] * m_gametorate * m_gametosexratio * merozoitesurvival * Infection::params::merozoites_per_schizont);
-                    m_femalegametocytes[GametocyteStages::Stage0] = int64_t(m_femalegametocytes[GametocyteStages::Stage0] + m_IRBC_count[j] * m_gametorate * (1.0 - m_gametosexratio) * merozoitesurvival * Infection::params::merozoites_per_schizont);
+                    m_malegametocytes[GametocyteStages::Stage0]   = int64_t(m_malegametocytes[GametocyteStages::Stage0]   + m_IRBC_count[j] * m_gametorate * m_gametosexratio * merozoitesurvival * m_params->infection.merozoites_per_schizont);
+                    m_femalegametocytes[GametocyteStages::Stage0] = int64_t(m_femalegametocytes[GametocyteStages::Stage0] + m_IRBC_count[j] * m_gametorate * (real_t(1) - m_gametosexratio) * merozoitesurvival * m_params->infection.merozoites_per_schizont);
                 }
             }
         }
@@ -380,6 +513,8 @@ namespace emodlib
         // Calculates stimulation of immune system by malaria infection
         void Infection::malariaImmuneStimulation(float dt)
         {
+            EMODLIB_PHASE(ImmuneStimulation);
+
             // check for valid inputs
             if ( dt <= 0 || immunity == nullptr )
             {
@@ -417,6 +552,8 @@ namespace emodlib
         // Calculates the IRBC killing from drugs and immune action
         void Infection::malariaImmunityIRBCKill(float dt)
         {
+            EMODLIB_PHASE(IRBCKill);
+
             // check for valid inputs
             if (dt > 0 && immunity)
             {
@@ -424,10 +561,10 @@ namespace emodlib
                 // "Innate immunity to malaria." Nat Rev Immunol 4(3): 169-180.
 
                 // Offset basic sigmoid: effect rises as basic sigmoid beginning from a fever of MIN_FEVER_DEGREES_KILLING
-                double fever_cytokine_killrate = (immunity->get_fever() > MIN_FEVER_DEGREES_KILLING) ? immunity->get_fever_killing_rate() * Sigmoid::basic_sigmoid(1.0, immunity->get_fever() - MIN_FEVER_DEGREES_KILLING) : 0.0;
+                real_t fever_cytokine_killrate = (immunity->get_fever() > MIN_FEVER_DEGREES_KILLING) ? immunity->get_fever_killing_rate() * Sigmoid::basic_sigmoid(real_t(1), immunity->get_fever() - real_t(MIN_FEVER_DEGREES_KILLING)) : 0;
 
                 // TODO: emodlib#4 (asexual-stage drug killing)
-                double drug_killrate = 0;
+                real_t drug_killrate = 0;
 
                 #pragma loop(hint_parallel(8))
                 for (int i = 0; i < CLONAL_PfEMP1_VARIANTS; i++)
@@ -435,22 +572,22 @@ namespace emodlib
                     if ( m_IRBC_count[i] == 0 ) continue; // don't need to estimate killing if there are no IRBC of this variant to kill!
 
                     // total = antibodies (major, minor, maternal) + fever + drug
-                    double pkill = EXPCDF(-dt * ( (m_PfEMP1_antibodies[i].major->GetAntibodyConcentration() + Infection::params::non_specific_antigenicity * m_PfEMP1_antibodies[i].minor->GetAntibodyConcentration() + immunity->get_maternal_antibodies() ) * Infection::params::antibody_IRBC_killrate + fever_cytokine_killrate + drug_killrate));
+                    real_t pkill = EXPCDF(-dt * ( (m_PfEMP1_antibodies[i].major->GetAntibodyConcentration() + m_params->infection.non_specific_antigenicity * m_PfEMP1_antibodies[i].minor->GetAntibodyConcentration() + immunity->get_maternal_antibodies() ) * m_params->infection.antibody_IRBC_killrate + fever_cytokine_killrate + drug_killrate));
 
                     // Now here there is an interesting issue: to save massive amounts of computational time, can use a Gaussian approximation for the true binomial, but this returns a float
                     // This is fine for large numbers of killed IRBC's, but an issue arises for small numbers
                     // big question, is 1.5 killed IRBC's 1 or 2 killed?
 
-                    double tempval1 = m_IRBC_count[i] * pkill;
+                    real_t tempval1 = m_IRBC_count[i] * pkill;
                     if ( tempval1 > 0 ) // don't need to smear the killing by a random number if it is going to be zero
-                        tempval1 = IntrahostComponent::p_rng->eGauss() * sqrt(tempval1 * (1.0 - pkill)) + tempval1;
+                        tempval1 = real_t(random(RandomPurpose::IRBCKill, i)->eGauss()) * sqrt(tempval1 * (real_t(1) - pkill)) + tempval1;
 
-                    if (tempval1 < 0.5)
+                    if (tempval1 < real_t(0.5))
                         tempval1 = 0;
 
 
                     // so add a continuity correction 0.5, and then convert to integer
-                    m_IRBC_count[i] -= int64_t(tempval1 + 0.5);
+                    m_IRBC_count[i] -= int64_t(tempval1 + real_t(0.5));
 
                     if (m_IRBC_count[i] < 1)
                         m_IRBC_count[i] = 0;   // check for too large a time step
@@ -463,6 +600,8 @@ namespace emodlib
         // Calculates immature gametocyte killing from drugs and immune action
         void Infection::malariaImmunityGametocyteKill(float dt)
         {
+            EMODLIB_PHASE(GametocyteKill);
+
             // check for valid inputs
             if (dt > 0 && immunity)
             {
@@ -472,44 +611,45 @@ namespace emodlib
                     // Currently have fever and inflammatory cytokines limiting infectivity,
                     // rather than killing gametocytes.  See IndividualHumanMalaria::DepositInfectiousnessFromGametocytes()
                     // We leave this variable here at zero incase we change DepositInfectiousnessFromGametocytes()
-                    double fever_cytokine_killrate = 0; // 0 = don't kill due to fever
+                    real_t fever_cytokine_killrate = 0; // 0 = don't kill due to fever
 
                     // TODO: emodlib#4 (early- and late-stage gametocyte drug killing)
-                    double drug_killrate = 0;
+                    real_t drug_killrate = 0;
 
                     // no randomness in gametocyte killing, but a continuity correction
-                    double gametocyte_kill_fraction = EXPCDF( -dt * (fever_cytokine_killrate + drug_killrate) );
+                    real_t gametocyte_kill_fraction = EXPCDF( -dt * (fever_cytokine_killrate + drug_killrate) );
 
-                    m_malegametocytes[i] -= int64_t( 0.5 + m_malegametocytes[i] * gametocyte_kill_fraction );
+                    m_malegametocytes[i] -= int64_t( real_t(0.5) + m_malegametocytes[i] * gametocyte_kill_fraction );
                     if (m_malegametocytes[i] < 1)
                         m_malegametocytes[i] = 0;
 
-                    m_femalegametocytes[i] -= int64_t( 0.5 + m_femalegametocytes[i] * gametocyte_kill_fraction );
+                    m_femalegametocytes[i] -= int64_t( real_t(0.5) + m_femalegametocytes[i] * gametocyte_kill_fraction );
                     if (m_femalegametocytes[i] < 1)
                         m_femalegametocytes[i] = 0;
                 }
 
                 // TODO: emodlib#5 (mature gametocyte decay)
 
-                float drugGametocyteKill = 0;  // TODO: emodlib#4 (mature gametocyte drug killing)
-                double pkill = EXPCDF( -dt * (0.277 + drugGametocyteKill) ); // half-life of 2.5 days corresponds to a decay time constant of 3.6 days, 0.277 = 1/3.6
+                real_t drugGametocyteKill = 0;  // TODO: emodlib#4 (mature gametocyte drug killing)
+                real_t pkill = EXPCDF( -dt * (real_t(0.277) + drugGametocyteKill) ); // half-life of 2.5 days corresponds to a decay time constant of 3.6 days, 0.277 = 1/3.6
                 apply_MatureGametocyteKillProbability( pkill );
             }
         }
 
-        int64_t ApplyKillProbability( float pkill, int64_t initial_gc, double eGauss )
+        int64_t ApplyKillProbability( real_t pkill, int64_t initial_gc, real_t eGauss )
         {
-            double numkilled = (eGauss * sqrt( pkill * initial_gc * (1.0 - pkill) ) + pkill * initial_gc);
-            numkilled = std::max( 0.0, numkilled ); //can't add by killing
+            real_t numkilled = (eGauss * sqrt( pkill * initial_gc * (real_t(1) - pkill) ) + pkill * initial_gc);
+            numkilled = std::max( real_t(0), numkilled ); //can't add by killing
             int64_t new_gc = int64_t( initial_gc - numkilled );
             return std::max( (int64_t)0, new_gc );
         }
 
-        void Infection::apply_MatureGametocyteKillProbability(float pkill)
+        void Infection::apply_MatureGametocyteKillProbability(real_t pkill)
         {
             // Gaussian approximation of binomial errors for male and female mature gametocytes
-            m_femalegametocytes[ GametocyteStages::Mature ] = ApplyKillProbability( pkill, m_femalegametocytes[ GametocyteStages::Mature ], IntrahostComponent::p_rng->eGauss() );
-            m_malegametocytes[ GametocyteStages::Mature ] = ApplyKillProbability(   pkill, m_malegametocytes[   GametocyteStages::Mature ], IntrahostComponent::p_rng->eGauss() );
+            RANDOMBASE* prng = random(RandomPurpose::GametocyteKill);
+            m_femalegametocytes[ GametocyteStages::Mature ] = ApplyKillProbability( pkill, m_femalegametocytes[ GametocyteStages::Mature ], real_t(prng->eGauss()) );
+            m_malegametocytes[ GametocyteStages::Mature ] = ApplyKillProbability(   pkill, m_malegametocytes[   GametocyteStages::Mature ], real_t(prng->eGauss()) );
         }
 
         void Infection::malariaCheckInfectionStatus(float dt)
@@ -533,14 +673,14 @@ namespace emodlib
             return m_femalegametocytes[stage];
         }
 
-        float Infection::get_asexual_density() const
+        real_t Infection::get_asexual_density() const
         {
             int64_t totalIRBC = 0;
             totalIRBC = std::accumulate(m_IRBC_count.begin(), m_IRBC_count.end(), totalIRBC);
             return totalIRBC * immunity->get_inv_microliters_blood();
         }
 
-        float Infection::get_mature_gametocyte_density() const
+        real_t Infection::get_mature_gametocyte_density() const
         {
             int64_t mature_female_gametocytes = get_FemaleGametocytes(GametocyteStages::Mature);
             return mature_female_gametocytes * immunity->get_inv_microliters_blood();
@@ -560,18 +700,33 @@ namespace emodlib
             return (totalIRBC + m_hepatocytes + totalgametocytes) < 1;
         }
 
+        bool Infection::IsLiverStage() const
+        {
+            return m_asexual_phase == AsexualCycleStatus::NoAsexualCycle;
+        }
+
+        int Infection::GetActiveVariantCount() const
+        {
+            return int(std::count_if(m_IRBC_count.begin(), m_IRBC_count.end(), [](int64_t n) { return n > 0; }));
+        }
+
         int32_t Infection::get_msp_type() const
         {
-            return m_MSPtype;
+            return m_repertoire->MSPtype;
         }
 
         std::vector<int32_t> Infection::get_pfemp1_major_types() const
         {
             std::vector<int32_t> vi;
-            vi.assign(m_IRBCtype, m_IRBCtype + CLONAL_PfEMP1_VARIANTS);
+            vi.assign(m_repertoire->IRBCtype, m_repertoire->IRBCtype + CLONAL_PfEMP1_VARIANTS);
             return vi;
         }
 
+        int32_t Infection::get_strain_id() const
+        {
+            return m_repertoire->strain_id;
+        }
+
         IMalariaAntibody* Infection::get_msp_antibody() const
         {
             return m_MSP_antibody;
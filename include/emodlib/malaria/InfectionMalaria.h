@@ -6,17 +6,26 @@
 
 #pragma once
 
-#include "emodlib/ParamSet.h"
+#include <array>
+#include <unordered_map>
+#include <vector>
+
 #include "emodlib/utils/suids.hpp"
 
 #include "Malaria.h"
 #include "MalariaEnums.h"
+#include "MalariaParams.h"
 #include "IMalariaAntibody.h"
+#include "StrainLibrary.h"
 
 
 namespace emodlib
 {
 
+    class RANDOMBASE;
+    class BinaryWriter;
+    class BinaryReader;
+
     namespace malaria
     {
 
@@ -27,45 +36,32 @@ namespace emodlib
 
         public:
 
-            struct params
-            {
-                // TODO: emodlib#8 (boost + enums)
-                // static ParasiteSwitchType::Enum parasite_switch_type;
-                // static MalariaStrains::Enum     malaria_strains;
-
-                static float incubation_period;
-                static float antibody_IRBC_killrate;
-                static float non_specific_antigenicity;
-                static float MSP1_merozoite_kill;
-                static float gametocyte_stage_survival;
-                static float base_gametocyte_sexratio;
-                static float base_gametocyte_production;
-                static float antigen_switch_rate;
-                static float merozoites_per_hepatocyte;
-                static float merozoites_per_schizont;
-                static float RBC_destruction_multiplier;
-                static int   n_asexual_cycles_wo_gametocytes;
-
-                static void Configure(const ParamSet& pset);
-            };
+            static suids::distributed_generator infectionSuidGenerator;
 
 
-            static suids::distributed_generator infectionSuidGenerator;
+            static Infection *Create(Susceptibility* _susceptibility, int initial_hepatocytes=1, RANDOMBASE* _rng=nullptr, int _ordinal=0, RANDOMBASE* _repertoire_rng=nullptr, int _strain_id=0);
 
+            // Antibody links are stored as flags and re-registered with the restored Susceptibility
+            void Serialize(BinaryWriter& writer) const;
+            static Infection *Deserialize(BinaryReader& reader, Susceptibility* _susceptibility, RANDOMBASE* _rng=nullptr);
 
-            static Infection *Create(Susceptibility* _susceptibility, int initial_hepatocytes=1);
+            // Copy attached to a cloned Susceptibility, relinked through the map it filled in
+            Infection *Clone(Susceptibility* _susceptibility, const std::unordered_map<const IMalariaAntibody*, IMalariaAntibody*>& antibody_map, RANDOMBASE* _rng=nullptr) const;
 
             void Update(float dt);
 
             suids::suid GetSuid() const;
             int64_t get_MaleGametocytes(int stage) const;
             int64_t get_FemaleGametocytes(int stage) const;
-            float get_asexual_density() const;
-            float get_mature_gametocyte_density() const;
+            real_t get_asexual_density() const;
+            real_t get_mature_gametocyte_density() const;
             bool IsCleared() const;
+            bool IsLiverStage() const;
+            int GetActiveVariantCount() const;
 
             int32_t get_msp_type() const;
             std::vector<int32_t> get_pfemp1_major_types() const;
+            int32_t get_strain_id() const;
 
             IMalariaAntibody* get_msp_antibody() const;
 
@@ -74,42 +70,46 @@ namespace emodlib
             suids::suid suid; // unique id of this infection within the system
 
             float m_liver_stage_timer;
-            double m_IRBCtimer;
+            real_t m_IRBCtimer;
             int32_t m_hepatocytes;
             AsexualCycleStatus::Enum m_asexual_phase;
             int32_t m_asexual_cycle_count;
 
-            int32_t m_MSPtype;        // allow variation in MSP from clone to clone
-            int32_t m_nonspectype;    // what is the set of minor_epitope_types
-            int32_t m_minor_epitope_type[CLONAL_PfEMP1_VARIANTS];
-            int32_t m_IRBCtype[CLONAL_PfEMP1_VARIANTS];
+            RepertoirePtr m_repertoire;  // MSP type and PfEMP1 epitopes, shared by infections of the same strain
 
+            // Fixed-size, so the per-variant kernels have compile-time trip counts
             IMalariaAntibody* m_MSP_antibody;
-            std::vector< pfemp1_antibody_t > m_PfEMP1_antibodies;
+            std::array<pfemp1_antibody_t, CLONAL_PfEMP1_VARIANTS> m_PfEMP1_antibodies;
 
-            std::vector<int64_t> m_IRBC_count;
+            std::array<int64_t, CLONAL_PfEMP1_VARIANTS> m_IRBC_count;
             int64_t m_malegametocytes[GametocyteStages::Count];
             int64_t m_femalegametocytes[GametocyteStages::Count];
 
             // placeholders for infection-level variation in merozoite-to-gametocyte dynamics
-            double m_gametorate;
-            double m_gametosexratio;
+            real_t m_gametorate;
+            real_t m_gametosexratio;
 
             Susceptibility* immunity;
+            const IntrahostParams* m_params;  // owned by the immunity object
+            RANDOMBASE* rng;  // host-owned stream, or nullptr to draw from IntrahostComponent::p_rng
+            int m_ordinal;    // order of this infection among those of its host, for keyed streams
 
 
             Infection();
-            void Initialize(Susceptibility* _susceptibility, int initial_hepatocytes);
+            void Initialize(Susceptibility* _susceptibility, int initial_hepatocytes, RANDOMBASE* _rng, int _ordinal, RANDOMBASE* _repertoire_rng, int _strain_id);
+            void nextSuid();
+            RANDOMBASE* random(RandomPurpose::Enum purpose, int item=0) const;
 
             void malariaProcessHepatocytes(float dt);
             void processEndOfAsexualCycle();
-            void malariaIRBCAntigenSwitch(double merozoitesurvival = 1.0);
-            void malariaCycleGametocytes(double merozoitesurvival = 1.0);
+            void malariaIRBCAntigenSwitch(real_t merozoitesurvival = 1);
+            template<class SwitchingPolicy> void antigenSwitch(real_t merozoitesurvival);
+            void malariaCycleGametocytes(real_t merozoitesurvival = 1);
             void malariaImmuneStimulation(float dt);
             void malariaImmunityIRBCKill(float dt);
             void malariaImmunityGametocyteKill(float dt);
             void malariaCheckInfectionStatus(float dt);  // TODO: emodlib#3 (InfectionStateChange::Cleared)
-            void apply_MatureGametocyteKillProbability(float pkill);
+            void apply_MatureGametocyteKillProbability(real_t pkill);
 
         };
 
@@ -6,9 +6,16 @@
 
 #include "IntrahostComponent.h"
 
+#include <stdexcept>
+
+#include "emodlib/utils/BinaryArchive.h"
 #include "emodlib/utils/Common.h"
+#include "emodlib/utils/Instrumentation.h"
 #include "emodlib/utils/Sigmoid.h"
 
+#define HOST_RNG_CACHE_SIZE (64)   // small per-host cache keeps the memory cost of independent streams down
+#define KEYED_RNG_CACHE_SIZE (16)  // keyed streams refill on every key, and most keys need only a few draws
+
 
 namespace emodlib
 {
@@ -16,60 +23,137 @@ namespace emodlib
     namespace malaria
     {
 
-        int IntrahostComponent::params::randomSeed = 0;
+        std::shared_ptr<RANDOMBASE> IntrahostComponent::p_rng = nullptr;
 
-        int IntrahostComponent::params::max_ind_inf = 1;
 
+        void IntrahostComponent::Configure(const ParamSet& pset)
+        {
+            IntrahostParamsPtr block = IntrahostParams::Create(pset);
+            IntrahostParams::SetDefaults(block);
 
-        int IntrahostComponent::params::falciparumMSPVars = DEFAULT_MSP_VARIANTS;
-        int IntrahostComponent::params::falciparumNonSpecTypes = DEFAULT_NONSPECIFIC_TYPES;
-        int IntrahostComponent::params::falciparumPfEMP1Vars = DEFAULT_PFEMP1_VARIANTS;
+            IntrahostComponent::p_rng = std::shared_ptr<RANDOMBASE>(new PSEUDO_DES(block->randomSeed, 256));
+        }
 
-        // TODO: emodlib#7 (infectiousness calculations)
-        float  IntrahostComponent::params::base_gametocyte_mosquito_survival = DEFAULT_BASE_GAMETOCYTE_MOSQUITO_SURVIVAL;
-        float  IntrahostComponent::params::cytokine_gametocyte_inactivation  = DEFAULT_CYTOKINE_GAMETOCYTE_INACTIVATION;
 
-        std::shared_ptr<RANDOMBASE> IntrahostComponent::p_rng = nullptr;
+        IntrahostComponent::IntrahostComponent()
+            : susceptibility(nullptr)
+            , infections()
+            , rng(nullptr)
+            , n_challenges(0)
+            , repertoire_rng(nullptr)
+        {
 
+        }
 
-        void IntrahostComponent::params::Configure(const ParamSet& pset)
+        IntrahostComponent* IntrahostComponent::Create(IntrahostParamsPtr _params, std::shared_ptr<RANDOMBASE> _rng)
         {
-            randomSeed = pset["Run_Number"].cast<int>();
-            IntrahostComponent::p_rng = std::shared_ptr<RANDOMBASE>(new PSEUDO_DES(randomSeed, 256));
+            IntrahostComponent* ic = new IntrahostComponent();
+            ic->susceptibility = Susceptibility::Create(_params);
+            ic->rng = _rng;
+            return ic;
+        }
+
+        std::shared_ptr<RANDOMBASE> IntrahostComponent::CreateHostStream(int randomSeed, int index, bool keyed)
+        {
+            if (keyed)
+            {
+                uint64_t base = (uint64_t(uint32_t(randomSeed)) << 32) | uint32_t(index);
+                return std::shared_ptr<RANDOMBASE>(new KEYED_DES(base, KEYED_RNG_CACHE_SIZE));
+            }
+
+            // distinct iSeq per host index, so streams never overlap the way offset counters would
+            uint32_t sequence = uint32_t(randomSeed) ^ (uint32_t(index) * 0x9E3779B9u);
+            return std::shared_ptr<RANDOMBASE>(new PSEUDO_DES(sequence, HOST_RNG_CACHE_SIZE));
+        }
 
-            max_ind_inf = pset["Max_Individual_Infections"].cast<int>();
+        void IntrahostComponent::Serialize(BinaryWriter& writer) const
+        {
+            writer.Write<int32_t>(n_challenges);
 
-            falciparumMSPVars = pset["Falciparum_MSP_Variants"].cast<int>();
-            falciparumNonSpecTypes = pset["Falciparum_Nonspecific_Types"].cast<int>();
-            falciparumPfEMP1Vars = pset["Falciparum_PfEMP1_Variants"].cast<int>();
+            writer.Write<uint8_t>(rng ? 1 : 0);  // hosts without their own stream draw from p_rng, which is not saved
+            if (rng) rng->Serialize(writer);
 
-            // TODO: emodlib#7 (infectiousness calculations)
-            base_gametocyte_mosquito_survival = pset["Base_Gametocyte_Mosquito_Survival_Rate"].cast<float>();
-            cytokine_gametocyte_inactivation = pset["Cytokine_Gametocyte_Inactivation"].cast<float>();
+            susceptibility->Serialize(writer);
 
-            Infection::params::Configure(pset["infection_params"]);
-            Susceptibility::params::Configure(pset["susceptibility_params"]);
+            writer.Write<uint32_t>(uint32_t(infections.size()));
+            for (auto* inf: infections) {
+                inf->Serialize(writer);
+            }
         }
 
-
-        IntrahostComponent::IntrahostComponent()
-            : susceptibility(nullptr)
-            , infections()
+        IntrahostComponent* IntrahostComponent::Deserialize(BinaryReader& reader, IntrahostParamsPtr _params)
         {
+            IntrahostComponent* ic = new IntrahostComponent();
+
+            try
+            {
+                ic->n_challenges = reader.Read<int32_t>();
 
+                if (reader.Read<uint8_t>()) {
+                    ic->rng = std::shared_ptr<RANDOMBASE>(RANDOMBASE::Deserialize(reader));
+                }
+
+                ic->susceptibility = Susceptibility::Deserialize(reader, _params);
+
+                uint32_t n_infections = reader.Read<uint32_t>();
+                for (uint32_t i = 0; i < n_infections; i++) {
+                    ic->infections.push_back(Infection::Deserialize(reader, ic->susceptibility, ic->rng.get()));
+                }
+            }
+            catch (...)
+            {
+                delete ic;
+                throw;
+            }
+
+            return ic;
         }
 
-        IntrahostComponent* IntrahostComponent::Create()
+        IntrahostComponent* IntrahostComponent::Clone(std::shared_ptr<RANDOMBASE> _rng) const
         {
             IntrahostComponent* ic = new IntrahostComponent();
-            ic->susceptibility = Susceptibility::Create();
+            ic->n_challenges = n_challenges;
+
+            // a host drawing from p_rng gets its own copy of p_rng at its current position
+            if (_rng) {
+                ic->rng = _rng;
+            }
+            else if (rng || p_rng) {
+                ic->rng = std::shared_ptr<RANDOMBASE>((rng ? rng : p_rng)->Clone());
+            }
+            else {
+                delete ic;
+                throw std::logic_error("Cannot clone a host without a random stream before IntrahostComponent::Configure");
+            }
+
+            if (repertoire_rng) {
+                ic->repertoire_rng = std::shared_ptr<RANDOMBASE>(repertoire_rng->Clone());
+            }
+
+            Susceptibility::AntibodyMap antibody_map;
+            ic->susceptibility = susceptibility->Clone(antibody_map);
+
+            for (auto* inf: infections) {
+                ic->infections.push_back(inf->Clone(ic->susceptibility, antibody_map, ic->rng.get()));
+            }
+
             return ic;
         }
 
+        IntrahostComponent::~IntrahostComponent()
+        {
+            for (auto* inf: infections) {
+                delete inf;
+            }
+            delete susceptibility;
+        }
+
         // TODO: emodlib#7 (infectiousness calculations)
 
         void IntrahostComponent::Update(float dt)
         {
+            EMODLIB_PHASE(IntrahostUpdate);
+
             // TODO: emodlib#5 (mature gametocyte decay) + emodlib#4 (mature gametocyte drug killing)
 
             susceptibility->Update(dt);
@@ -90,16 +174,26 @@ namespace emodlib
             }
         }
 
-        void IntrahostComponent::Challenge()
+        void IntrahostComponent::SetRepertoireStream(std::shared_ptr<RANDOMBASE> _repertoire_rng)
+        {
+            repertoire_rng = _repertoire_rng;
+        }
+
+        void IntrahostComponent::Challenge(int strain_id)
         {
-            if (infections.size() < params::max_ind_inf) {
-                Infection* inf = Infection::Create(susceptibility);
+            n_challenges++;  // counted even when the challenge is refused, so later infections keep their keys
+
+            if (infections.size() < GetParams()->max_ind_inf) {
+                Infection* inf = Infection::Create(susceptibility, 1, rng.get(), n_challenges, repertoire_rng.get(), strain_id);
                 infections.push_back(inf);  // TODO: emodlib#2 (Max_Individual_Infections)
             }
         }
 
         void IntrahostComponent::Treat()
         {
+            for (auto* inf: infections) {
+                delete inf;
+            }
             infections.clear();  // TODO: emodlib#4 (asexual drug killing) + emodlib#3 (InfectionStateChange::Cleared)
         }
 
@@ -108,9 +202,33 @@ namespace emodlib
             return infections.size();
         }
 
+        HostPartition::Enum IntrahostComponent::GetHostPartition() const
+        {
+            if (infections.empty())
+                return HostPartition::Uninfected;
+
+            for (auto* inf: infections) {
+                if (!inf->IsLiverStage())
+                    return HostPartition::BloodStage;
+            }
+
+            return HostPartition::LiverStage;
+        }
+
+        // Relative update cost: the susceptibility sweeps every antibody once,
+        // and each active variant of each infection touches its antibodies again
+        float IntrahostComponent::GetCostEstimate() const
+        {
+            int active_variants = 0;
+            for (auto* inf: infections) {
+                active_variants += 1 + inf->GetActiveVariantCount();
+            }
+            return float(1 + susceptibility->get_num_antibodies()) * float(1 + active_variants);
+        }
+
         float IntrahostComponent::GetParasiteDensity() const
         {
-            float total = 0.0f;
+            real_t total = 0;
             for (auto* inf: infections) {
                 total += inf->get_asexual_density();
             }
@@ -119,7 +237,7 @@ namespace emodlib
 
         float IntrahostComponent::GetGametocyteDensity() const
         {
-            float total = 0.0f;
+            real_t total = 0;
             for (auto* inf: infections) {
                 total += inf->get_mature_gametocyte_density();  // TODO: emodlib#5 (mature gametocyte decay)
             }
@@ -133,9 +251,14 @@ namespace emodlib
 
         float IntrahostComponent::GetInfectiousness() const
         {
-            float cytokines = susceptibility->get_cytokines();
-            double fever_effect = Sigmoid::basic_sigmoid(params::cytokine_gametocyte_inactivation, cytokines);
-            return EXPCDF(-GetGametocyteDensity() * MICROLITERS_PER_BLOODMEAL * params::base_gametocyte_mosquito_survival * (1.0 - fever_effect));
+            real_t cytokines = susceptibility->get_cytokines();
+            real_t fever_effect = Sigmoid::basic_sigmoid(real_t(GetParams()->cytokine_gametocyte_inactivation), cytokines);
+            return EXPCDF(-GetGametocyteDensity() * MICROLITERS_PER_BLOODMEAL * GetParams()->base_gametocyte_mosquito_survival * (1.0 - fever_effect));
+        }
+
+        const IntrahostParams* IntrahostComponent::GetParams() const
+        {
+            return susceptibility->get_params();
         }
 
         Susceptibility* IntrahostComponent::GetSusceptibility() const
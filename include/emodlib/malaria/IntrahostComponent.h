@@ -13,6 +13,7 @@
 #include "emodlib/utils/RANDOM.h"
 
 #include "InfectionMalaria.h"
+#include "MalariaParams.h"
 #include "SusceptibilityMalaria.h"
 
 
@@ -27,34 +28,37 @@ namespace emodlib
 
         public:
 
-            struct params
-            {
-                static int randomSeed;
+            // Installs a process-wide default parameter block for hosts created without one, and reseeds p_rng
+            static void Configure(const ParamSet& pset);
 
-                static int max_ind_inf;
-
-                static int falciparumMSPVars;
-                static int falciparumNonSpecTypes;
-                static int falciparumPfEMP1Vars;
+            static std::shared_ptr<RANDOMBASE> p_rng;
 
-                // ... infectiousness calculations
-                static float base_gametocyte_mosquito_survival;  // TODO: emodlib#7 (infectiousness calculations)
-                static float cytokine_gametocyte_inactivation;
+            static IntrahostComponent* Create(IntrahostParamsPtr _params=nullptr, std::shared_ptr<RANDOMBASE> _rng=nullptr);
 
-                static void Configure(const ParamSet& pset);
-            };
+            // Independent stream for the host at index, for hosts that may be updated concurrently;
+            // keyed streams give common random numbers across parameter sets
+            static std::shared_ptr<RANDOMBASE> CreateHostStream(int randomSeed, int index, bool keyed=false);
 
+            void Serialize(BinaryWriter& writer) const;
+            static IntrahostComponent* Deserialize(BinaryReader& reader, IntrahostParamsPtr _params=nullptr);
 
-            static std::shared_ptr<RANDOMBASE> p_rng;
+            // Deep copy for counterfactual branches, with its own copy of the host's stream (of p_rng for a host
+            // without one) at the same position, or drawing from _rng instead so that the copy diverges
+            IntrahostComponent* Clone(std::shared_ptr<RANDOMBASE> _rng=nullptr) const;
+            ~IntrahostComponent();
 
-            static IntrahostComponent* Create();
+            // Draws the antigenic repertoires of later infections from _repertoire_rng rather than the host stream.
+            // Transient: not saved by Serialize, though copied by Clone.
+            void SetRepertoireStream(std::shared_ptr<RANDOMBASE> _repertoire_rng);
 
             void Update(float dt);
 
-            void Challenge();
+            void Challenge(int strain_id=0);  // strain_id selects the strain under FALCIPARUM_STRAIN_GENERATOR
             void Treat();
 
             int GetNumInfections() const;
+            HostPartition::Enum GetHostPartition() const;
+            float GetCostEstimate() const;
 
             float GetParasiteDensity() const;
             float GetGametocyteDensity() const;
@@ -62,6 +66,8 @@ namespace emodlib
 
             float GetInfectiousness() const;
 
+            const IntrahostParams* GetParams() const;
+
             Susceptibility* GetSusceptibility() const;
             std::list<Infection*> GetInfections() const;
 
@@ -70,6 +76,11 @@ namespace emodlib
             Susceptibility* susceptibility;
             std::list<Infection*> infections;
 
+            std::shared_ptr<RANDOMBASE> rng;  // independent stream for hosts updated concurrently, else nullptr for p_rng
+            int n_challenges;                 // challenges received so far, the ordinal of each new infection for keyed streams
+
+            std::shared_ptr<RANDOMBASE> repertoire_rng;  // optional source of repertoire draws, else the host stream
+
 
             IntrahostComponent();
 
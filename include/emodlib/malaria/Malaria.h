@@ -1,8 +1,11 @@
 #pragma once
 
 
+#ifndef CLONAL_PfEMP1_VARIANTS  // fixed per build, see EMODLIB_PFEMP1_VARIANTS
 #define CLONAL_PfEMP1_VARIANTS (50)
+#endif
 #define MINOR_EPITOPE_VARS_PER_SET 5
+#define REPERTOIRE_DRAWS (2 + 2 * CLONAL_PfEMP1_VARIANTS)  // uniform draws per infection in Infection::Initialize
 
 #define INV_MICROLITERS_BLOOD_ADULT (1.0/5e6) // 5 liters of blood/adult (http://hypertextbook.com/facts/1998/LanNaLee.shtml)
 
@@ -29,7 +32,6 @@
 #define MIN_FEVER_DEGREES_KILLING (1.5)
 
 #define MEROZOITE_LIMITING_RBC_THRESHOLD (0.2)
-#define SWITCHING_IRBC_VARIANT_COUNT    (10)
 
 #define DEFAULT_MSP_VARIANTS 100
 #define DEFAULT_NONSPECIFIC_TYPES 20
@@ -1,14 +1,13 @@
 #include "MalariaAntibody.h"
 
 #include "emodlib/utils/Sigmoid.h"
-#include "SusceptibilityMalaria.h"
 
 
-#define NON_TRIVIAL_ANTIBODY_THRESHOLD  (0.0000001)
-#define TWENTY_DAY_DECAY_CONSTANT       (0.05f)
-#define B_CELL_PROLIFERATION_THRESHOLD  (0.4)
-#define B_CELL_PROLIFERATION_CONSTANT   (0.33f)
-#define ANTIBODY_RELEASE_THRESHOLD      (0.3)
+#define NON_TRIVIAL_ANTIBODY_THRESHOLD  (real_t(0.0000001))
+#define TWENTY_DAY_DECAY_CONSTANT       (real_t(0.05))
+#define B_CELL_PROLIFERATION_THRESHOLD  (real_t(0.4))
+#define B_CELL_PROLIFERATION_CONSTANT   (real_t(0.33))
+#define ANTIBODY_RELEASE_THRESHOLD      (real_t(0.3))
 #define ANTIBODY_RELEASE_FACTOR         (4)
 
 
@@ -21,11 +20,13 @@ namespace emodlib
         MalariaAntibody::MalariaAntibody()
             : m_antigen_count(0)
             , m_antigen_present(false)
+            , m_params(nullptr)
         {
         }
 
-        void MalariaAntibody::Initialize( MalariaAntibodyType::Enum type, int variant, float capacity, float concentration )
+        void MalariaAntibody::Initialize( const SusceptibilityParams* params, MalariaAntibodyType::Enum type, int variant, real_t capacity, real_t concentration )
         {
+            m_params                 = params;
             m_antibody_type          = type;
             m_antibody_variant       = variant;
             m_antibody_capacity      = capacity;
@@ -41,9 +42,9 @@ namespace emodlib
             }
 
             // antibody capacity decays to a medium value (.3) dropping below .4 in ~120 days from 1.0
-            if ( m_antibody_capacity > Susceptibility::params::memory_level )
+            if ( m_antibody_capacity > m_params->memory_level )
             {
-                m_antibody_capacity -= ( m_antibody_capacity - Susceptibility::params::memory_level) * Susceptibility::params::hyperimmune_decay_rate * dt;
+                m_antibody_capacity -= ( m_antibody_capacity - m_params->memory_level) * m_params->hyperimmune_decay_rate * dt;
             }
         }
 
@@ -52,7 +53,7 @@ namespace emodlib
             // allow the decay of anti-CSP concentrations greater than unity (e.g. after boosting by vaccine)
             if ( m_antibody_concentration > m_antibody_capacity )
             {
-                m_antibody_concentration -= m_antibody_concentration * dt / Susceptibility::params::antibody_csp_decay_days;
+                m_antibody_concentration -= m_antibody_concentration * dt / m_params->antibody_csp_decay_days;
             }
             else
             {
@@ -61,89 +62,89 @@ namespace emodlib
             }
         }
 
-        float MalariaAntibody::StimulateCytokines( float dt, float inv_uL_blood )
+        real_t MalariaAntibody::StimulateCytokines( float /*dt*/, real_t inv_uL_blood )
         {
             // Cytokines released at low antibody concentration (if capacity hasn't switched into high proliferation rate yet)
-            return ( 1 - m_antibody_concentration ) * float(m_antigen_count) * inv_uL_blood;
+            return ( 1 - m_antibody_concentration ) * real_t(m_antigen_count) * inv_uL_blood;
         }
 
         // Let's use the MSP version of antibody growth in the base class ...
-        void MalariaAntibody::UpdateAntibodyCapacity( float dt, float inv_uL_blood )
+        void MalariaAntibody::UpdateAntibodyCapacity( float dt, real_t inv_uL_blood )
         {
-            float growth_rate = Susceptibility::params::MSP1_antibody_growthrate;
-            float threshold   = Susceptibility::params::antibody_stimulation_c50;
+            real_t growth_rate = m_params->MSP1_antibody_growthrate;
+            real_t threshold   = m_params->antibody_stimulation_c50;
 
-            m_antibody_capacity += growth_rate  * (1.0f - m_antibody_capacity) * float(Sigmoid::basic_sigmoid( threshold, float(m_antigen_count) * inv_uL_blood));
+            m_antibody_capacity += growth_rate  * (real_t(1) - m_antibody_capacity) * Sigmoid::basic_sigmoid( threshold, real_t(m_antigen_count) * inv_uL_blood);
 
             // rapid B cell proliferation above a threshold given stimulation
             if (m_antibody_capacity > B_CELL_PROLIFERATION_THRESHOLD)
             {
-                m_antibody_capacity += ( 1.0f - m_antibody_capacity ) * B_CELL_PROLIFERATION_CONSTANT * dt;
+                m_antibody_capacity += ( real_t(1) - m_antibody_capacity ) * B_CELL_PROLIFERATION_CONSTANT * dt;
             }
 
-            if (m_antibody_capacity > 1.0)
+            if (m_antibody_capacity > 1)
             {
-                m_antibody_capacity = 1.0;
+                m_antibody_capacity = 1;
             }
         }
 
         // Different arguments used by CSP update called directly from IndividualHumanMalaria::ExposeToInfectivity
         // and also in SusceptibilityMalaria::updateImmunityCSP
-        void MalariaAntibody::UpdateAntibodyCapacityByRate( float dt, float growth_rate )
+        void MalariaAntibody::UpdateAntibodyCapacityByRate( float dt, real_t growth_rate )
         {
             m_antibody_capacity += growth_rate * dt * (1 - m_antibody_capacity);
 
-            if (m_antibody_capacity > 1.0)
+            if (m_antibody_capacity > 1)
             {
-                m_antibody_capacity = 1.0;
+                m_antibody_capacity = 1;
             }
         }
 
         // The minor PfEMP1 version is similar but not exactly the same...
-        void MalariaAntibodyPfEMP1Minor::UpdateAntibodyCapacity( float dt, float inv_uL_blood )
+        void MalariaAntibodyPfEMP1Minor::UpdateAntibodyCapacity( float dt, real_t inv_uL_blood )
         {
-            float min_stimulation = Susceptibility::params::antibody_stimulation_c50 * Susceptibility::params::minimum_adapted_response;
-            float growth_rate     = Susceptibility::params::antibody_capacity_growthrate * Susceptibility::params::non_specific_growth;
-            float threshold       = Susceptibility::params::antibody_stimulation_c50;
+            real_t min_stimulation = m_params->minimum_stimulation;
+            real_t growth_rate     = m_params->nonspecific_growthrate;
+            real_t threshold       = m_params->antibody_stimulation_c50;
 
             if (m_antibody_capacity <= B_CELL_PROLIFERATION_THRESHOLD)
             {
-                m_antibody_capacity += growth_rate * dt * (1.0f - m_antibody_capacity) * float(Sigmoid::basic_sigmoid(threshold, float(m_antigen_count) * inv_uL_blood + min_stimulation));
+                m_antibody_capacity += growth_rate * dt * (real_t(1) - m_antibody_capacity) * Sigmoid::basic_sigmoid(threshold, real_t(m_antigen_count) * inv_uL_blood + min_stimulation);
             }
             else
             {
                 //rapid B cell proliferation above a threshold given stimulation
-                m_antibody_capacity += (1.0f - m_antibody_capacity) * B_CELL_PROLIFERATION_CONSTANT * dt;
+                m_antibody_capacity += (real_t(1) - m_antibody_capacity) * B_CELL_PROLIFERATION_CONSTANT * dt;
             }
 
-            if (m_antibody_capacity > 1.0)
+            if (m_antibody_capacity > 1)
             {
-                m_antibody_capacity = 1.0;
+                m_antibody_capacity = 1;
             }
         }
 
         // The major PfEMP1 version is slightly different again...
-        void MalariaAntibodyPfEMP1Major::UpdateAntibodyCapacity( float dt, float inv_uL_blood )
+        void MalariaAntibodyPfEMP1Major::UpdateAntibodyCapacity( float dt, real_t inv_uL_blood )
         {
-            float min_stimulation = Susceptibility::params::antibody_stimulation_c50 * Susceptibility::params::minimum_adapted_response;
-            float growth_rate     = Susceptibility::params::antibody_capacity_growthrate;
-            float threshold       = Susceptibility::params::antibody_stimulation_c50;
+            real_t min_stimulation = m_params->minimum_stimulation;
+            real_t growth_rate     = m_params->antibody_capacity_growthrate;
+            real_t threshold       = m_params->antibody_stimulation_c50;
 
             if (m_antibody_capacity <= B_CELL_PROLIFERATION_THRESHOLD)
             {
                 //ability and number of B-cells to produce antibodies, with saturation
-                m_antibody_capacity += growth_rate * dt * (1.0f - m_antibody_capacity) * float(Sigmoid::basic_sigmoid(threshold, float(m_antigen_count) * inv_uL_blood + min_stimulation));
+                m_antibody_capacity += growth_rate * dt * (real_t(1) - m_antibody_capacity) * Sigmoid::basic_sigmoid(threshold, real_t(m_antigen_count) * inv_uL_blood + min_stimulation);
 
                 // check for antibody capacity out of range
-                if (m_antibody_capacity > 1.0)
+                if (m_antibody_capacity > 1)
                 {
-                    m_antibody_capacity = 1.0;
+                    m_antibody_capacity = 1;
                 }
             }
             else
             {
                 //rapid B cell proliferation above a threshold given stimulation
-                m_antibody_capacity += (1.0f - m_antibody_capacity) * B_CELL_PROLIFERATION_CONSTANT * dt;
+                m_antibody_capacity += (real_t(1) - m_antibody_capacity) * B_CELL_PROLIFERATION_CONSTANT * dt;
             }
         }
 
@@ -169,7 +170,7 @@ namespace emodlib
             // allow the decay of anti-CSP concentrations greater than unity (e.g. after boosting by vaccine)
             if ( m_antibody_concentration > m_antibody_capacity )
             {
-                m_antibody_concentration -= m_antibody_concentration * dt / Susceptibility::params::antibody_csp_decay_days;
+                m_antibody_concentration -= m_antibody_concentration * dt / m_params->antibody_csp_decay_days;
             }
             else
             {
@@ -208,22 +209,22 @@ namespace emodlib
             return m_antigen_present;
         }
 
-        float MalariaAntibody::GetAntibodyCapacity() const
+        real_t MalariaAntibody::GetAntibodyCapacity() const
         {
             return m_antibody_capacity;
         }
 
-        float MalariaAntibody::GetAntibodyConcentration() const
+        real_t MalariaAntibody::GetAntibodyConcentration() const
         {
             return m_antibody_concentration;
         }
 
-        void MalariaAntibody::SetAntibodyCapacity( float antibody_capacity )
+        void MalariaAntibody::SetAntibodyCapacity( real_t antibody_capacity )
         {
             m_antibody_capacity = antibody_capacity;
         }
 
-        void MalariaAntibody::SetAntibodyConcentration( float antibody_concentration )
+        void MalariaAntibody::SetAntibodyConcentration( real_t antibody_concentration )
         {
             m_antibody_concentration = antibody_concentration;
         }
@@ -240,34 +241,34 @@ namespace emodlib
 
         //------------------------------------------------------------------
 
-        IMalariaAntibody* MalariaAntibodyCSP::CreateAntibody( int variant, float capacity )
+        IMalariaAntibody* MalariaAntibodyCSP::CreateAntibody( const SusceptibilityParams* params, int variant, real_t capacity )
         {
             MalariaAntibodyCSP * antibody = new MalariaAntibodyCSP();
-            antibody->Initialize( MalariaAntibodyType::CSP, variant, capacity );
+            antibody->Initialize( params, MalariaAntibodyType::CSP, variant, capacity );
 
             return antibody;
         }
 
-        IMalariaAntibody* MalariaAntibodyMSP::CreateAntibody( int variant, float capacity )
+        IMalariaAntibody* MalariaAntibodyMSP::CreateAntibody( const SusceptibilityParams* params, int variant, real_t capacity )
         {
             MalariaAntibodyMSP * antibody = new MalariaAntibodyMSP();
-            antibody->Initialize( MalariaAntibodyType::MSP1, variant, capacity );
+            antibody->Initialize( params, MalariaAntibodyType::MSP1, variant, capacity );
 
             return antibody;
         }
 
-        IMalariaAntibody* MalariaAntibodyPfEMP1Minor::CreateAntibody( int variant, float capacity )
+        IMalariaAntibody* MalariaAntibodyPfEMP1Minor::CreateAntibody( const SusceptibilityParams* params, int variant, real_t capacity )
         {
             MalariaAntibodyPfEMP1Minor * antibody = new MalariaAntibodyPfEMP1Minor();
-            antibody->Initialize( MalariaAntibodyType::PfEMP1_minor, variant, capacity );
+            antibody->Initialize( params, MalariaAntibodyType::PfEMP1_minor, variant, capacity );
 
             return antibody;
         }
 
-        IMalariaAntibody* MalariaAntibodyPfEMP1Major::CreateAntibody( int variant, float capacity )
+        IMalariaAntibody* MalariaAntibodyPfEMP1Major::CreateAntibody( const SusceptibilityParams* params, int variant, real_t capacity )
         {
             MalariaAntibodyPfEMP1Major * antibody = new MalariaAntibodyPfEMP1Major();
-            antibody->Initialize( MalariaAntibodyType::PfEMP1_major, variant, capacity );
+            antibody->Initialize( params, MalariaAntibodyType::PfEMP1_major, variant, capacity );
 
             return antibody;
         }
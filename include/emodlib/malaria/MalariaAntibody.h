@@ -1,6 +1,7 @@
 #pragma once
 
 #include "IMalariaAntibody.h"
+#include "MalariaParams.h"
 
 namespace emodlib
 {
@@ -17,9 +18,9 @@ namespace emodlib
         public:
             // IMalariaAntibody methods
             virtual void  Decay( float dt ) override;
-            virtual float StimulateCytokines( float dt, float inv_uL_blood ) override;
-            virtual void  UpdateAntibodyCapacity( float dt, float inv_uL_blood ) override;
-            virtual void  UpdateAntibodyCapacityByRate( float dt, float growth_rate ) override;
+            virtual real_t StimulateCytokines( float dt, real_t inv_uL_blood ) override;
+            virtual void  UpdateAntibodyCapacity( float dt, real_t inv_uL_blood ) override;
+            virtual void  UpdateAntibodyCapacityByRate( float dt, real_t growth_rate ) override;
             virtual void  UpdateAntibodyConcentration( float dt ) override;
             virtual void  ResetCounters() override;
 
@@ -28,26 +29,28 @@ namespace emodlib
 
             virtual int64_t GetAntigenCount() const override;
             virtual bool    GetAntigenicPresence() const override;
-            virtual float   GetAntibodyCapacity() const override;
-            virtual float   GetAntibodyConcentration() const override;
+            virtual real_t   GetAntibodyCapacity() const override;
+            virtual real_t   GetAntibodyConcentration() const override;
 
-            virtual void    SetAntibodyCapacity( float antibody_capacity ) override;
-            virtual void    SetAntibodyConcentration(float antibody_concentration) override;
+            virtual void    SetAntibodyCapacity( real_t antibody_capacity ) override;
+            virtual void    SetAntibodyConcentration(real_t antibody_concentration) override;
 
             virtual MalariaAntibodyType::Enum GetAntibodyType() const override;
             virtual int GetAntibodyVariant() const override;
 
         protected:
-            float   m_antibody_capacity;
-            float   m_antibody_concentration;
+            real_t   m_antibody_capacity;
+            real_t   m_antibody_concentration;
             int64_t m_antigen_count;
             bool    m_antigen_present;
 
             MalariaAntibodyType::Enum m_antibody_type;
             int m_antibody_variant;
 
+            const SusceptibilityParams* m_params;  // owned by the Susceptibility holding this antibody
+
             MalariaAntibody();
-            void Initialize( MalariaAntibodyType::Enum type, int variant, float capacity = 0, float concentration = 0 );
+            void Initialize( const SusceptibilityParams* params, MalariaAntibodyType::Enum type, int variant, real_t capacity = 0, real_t concentration = 0 );
         };
 
         // -----------------------------------------------------------
@@ -55,7 +58,7 @@ namespace emodlib
         class MalariaAntibodyCSP : public MalariaAntibody
         {
         public:
-            static IMalariaAntibody* CreateAntibody( int variant, float capacity=0.0f );
+            static IMalariaAntibody* CreateAntibody( const SusceptibilityParams* params, int variant, real_t capacity=0 );
             virtual void UpdateAntibodyConcentration( float dt ) override;
             virtual void Decay( float dt ) override;
         };
@@ -63,21 +66,21 @@ namespace emodlib
         class MalariaAntibodyMSP : public MalariaAntibody
         {
         public:
-            static IMalariaAntibody* CreateAntibody( int variant, float capacity=0.0f );
+            static IMalariaAntibody* CreateAntibody( const SusceptibilityParams* params, int variant, real_t capacity=0 );
         };
 
         class MalariaAntibodyPfEMP1Minor : public MalariaAntibody
         {
         public:
-            static IMalariaAntibody* CreateAntibody( int variant, float capacity=0.0f );
-            virtual void UpdateAntibodyCapacity( float dt, float inv_uL_blood ) override;
+            static IMalariaAntibody* CreateAntibody( const SusceptibilityParams* params, int variant, real_t capacity=0 );
+            virtual void UpdateAntibodyCapacity( float dt, real_t inv_uL_blood ) override;
         };
 
         class MalariaAntibodyPfEMP1Major : public MalariaAntibody
         {
         public:
-            static IMalariaAntibody* CreateAntibody( int variant, float capacity=0.0f );
-            virtual void UpdateAntibodyCapacity( float dt, float inv_uL_blood ) override;
+            static IMalariaAntibody* CreateAntibody( const SusceptibilityParams* params, int variant, real_t capacity=0 );
+            virtual void UpdateAntibodyCapacity( float dt, real_t inv_uL_blood ) override;
         };
     }
 
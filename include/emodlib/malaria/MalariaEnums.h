@@ -91,6 +91,55 @@ namespace emodlib
             };
         }
 
+        // Population partitions by the most advanced stage of any infection in the host
+        // LiverStage hosts carry only infections that have not yet released merozoites
+        namespace HostPartition {
+            enum Enum {
+                Uninfected = 0,
+                LiverStage = 1,
+                BloodStage = 2,
+                Count = 3,
+            };
+        }
+
+        // What a block of random draws is used for, one component of the key in common-random-numbers mode
+        namespace RandomPurpose {
+            enum Enum {
+                Repertoire = 0,
+                AntigenSwitch = 1,
+                IRBCKill = 2,
+                GametocyteKill = 3,
+            };
+        }
+
+        // Severity scores that multilevel splitting drives towards rare thresholds
+        namespace SplittingObservable {
+            enum Enum {
+                ParasiteDensity = 0,
+                RBCDeficit = 1,  // 1 - RBC count / capacity
+            };
+        }
+
+        // Opt-in variance-reduction flags for challenge ensembles, combined with |
+        namespace VarianceReduction {
+            enum Enum {
+                None = 0,
+                Antithetic = 1,            // hosts 2m and 2m+1 share their normal deviates with opposite signs
+                StratifiedRepertoire = 2,  // repertoire draws Latin-hypercube stratified across the hosts of a set
+            };
+        }
+
+        // Per-step observables recorded for each host in trajectory outputs
+        namespace TrajectoryChannel {
+            enum Enum {
+                ParasiteDensity = 0,
+                GametocyteDensity = 1,
+                FeverTemperature = 2,
+                Infectiousness = 3,
+                Count = 4,
+            };
+        }
+
     }
 
 }
@@ -0,0 +1,216 @@
+/**
+ * @file MalariaParams.cpp
+ *
+ * @brief Malaria intrahost parameter blocks implementation
+ */
+
+#include "MalariaParams.h"
+
+#include <math.h>
+#include <stdexcept>
+#include <string>
+
+#include "emodlib/ConfigFile.h"
+
+#include "Malaria.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        SusceptibilityParams::SusceptibilityParams()
+            : memory_level(0.2f)
+            , hyperimmune_decay_rate(0.0f)
+            , MSP1_antibody_growthrate(0.02f)
+            , antibody_stimulation_c50(10.0f)
+            , antibody_capacity_growthrate(0.1f)
+            , minimum_adapted_response(0.02f)
+            , non_specific_growth(0.5f)
+            , antibody_csp_decay_days(DEFAULT_ANTIBODY_CSP_DECAY_DAYS)
+
+            // TODO: emodlib#9 (maternal antibody init) + emodlib#8 (boost + enums)
+            // , enable_maternal_antibodies_transmission(false)
+            // , maternal_antibodies_type(MaternalAntibodiesType::OFF)
+            // , maternal_antibody_protection(0.1f)
+            , maternal_antibody_decay_rate(0.01f)
+
+            // TODO: emodlib#9 (innate heterogeneity init) + emodlib#8 (boost + enums)
+            // , innate_immune_variation_type(InnateImmuneVariationType::NONE)
+            , pyrogenic_threshold(1000.0f)
+            , fever_IRBC_killrate(DEFAULT_FEVER_IRBC_KILL_RATE)
+
+            , erythropoiesis_anemia_effect(3.5f)
+        {
+            derive();
+        }
+
+        void SusceptibilityParams::derive()
+        {
+            minimum_stimulation = antibody_stimulation_c50 * minimum_adapted_response;
+            nonspecific_growthrate = antibody_capacity_growthrate * non_specific_growth;
+        }
+
+        void SusceptibilityParams::Configure(const ParamSet& pset)
+        {
+            memory_level = pset["Antibody_Memory_Level"].cast<float>();
+            if (!(memory_level >= 0.0f && memory_level < 0.4f))
+            {
+                throw std::invalid_argument("Antibody_Memory_Level must be in [0, 0.4), got " + std::to_string(memory_level));
+            }
+            hyperimmune_decay_rate = -log((0.4f - memory_level) / (1.0f - memory_level)) / 120.0f;  // This sets the decay rate towards memory level so that the decay from antibody levels of 1 to levels of 0.4 is consistent
+            MSP1_antibody_growthrate = pset["Max_MSP1_Antibody_Growthrate"].cast<float>();
+            antibody_stimulation_c50 = pset["Antibody_Stimulation_C50"].cast<float>();
+            antibody_capacity_growthrate = pset["Antibody_Capacity_Growth_Rate"].cast<float>();
+            minimum_adapted_response = pset["Min_Adapted_Response"].cast<float>();
+            non_specific_growth = pset["Nonspecific_Antibody_Growth_Rate_Factor"].cast<float>();
+            antibody_csp_decay_days = pset["Antibody_CSP_Decay_Days"].cast<float>();
+            if (!(antibody_csp_decay_days > 0.0f))
+            {
+                throw std::invalid_argument("Antibody_CSP_Decay_Days must be positive, got " + std::to_string(antibody_csp_decay_days));
+            }
+
+            maternal_antibody_decay_rate = pset["Maternal_Antibody_Decay_Rate"].cast<float>();
+
+            pyrogenic_threshold = pset["Pyrogenic_Threshold"].cast<float>();
+            fever_IRBC_killrate = pset["Fever_IRBC_Kill_Rate"].cast<float>();
+
+            erythropoiesis_anemia_effect = pset["Erythropoiesis_Anemia_Effect"].cast<float>();
+
+            derive();
+        }
+
+
+        InfectionParams::InfectionParams()
+            : parasite_switch_type(ParasiteSwitchType::RATE_PER_PARASITE_7VARS)
+            , malaria_strains(MalariaStrains::FALCIPARUM_RANDOM_STRAIN)
+
+            , incubation_period(7.0f) // liver stage duration
+
+            , antibody_IRBC_killrate(DEFAULT_ANTIBODY_IRBC_KILLRATE)
+            , non_specific_antigenicity(DEFAULT_NON_SPECIFIC_ANTIGENICITY)
+            , MSP1_merozoite_kill(DEFAULT_MSP1_MEROZOITE_KILL)
+            , gametocyte_stage_survival(DEFAULT_GAMETOCYTE_STAGE_SURVIVAL)
+            , base_gametocyte_sexratio(DEFAULT_BASE_GAMETOCYTE_SEX_RATIO)
+            , base_gametocyte_production(DEFAULT_BASE_GAMETOCYTE_PRODUCTION)
+            , antigen_switch_rate(DEFAULT_ANTIGEN_SWITCH_RATE)
+            , merozoites_per_hepatocyte(DEFAULT_MEROZOITES_PER_HEPATOCYTE)
+            , merozoites_per_schizont(DEFAULT_MEROZOITES_PER_SCHIZONT)
+            , RBC_destruction_multiplier(DEFAULT_RBC_DESTRUCTION_MULTIPLIER)
+            , n_asexual_cycles_wo_gametocytes(DEFAULT_ASEXUAL_CYCLES_WITHOUT_GAMETOCYTES)
+        {
+
+        }
+
+        static ParasiteSwitchType::Enum parasiteSwitchTypeFromString(const std::string& name)
+        {
+            if (name == "CONSTANT_SWITCH_RATE_2VARS") return ParasiteSwitchType::CONSTANT_SWITCH_RATE_2VARS;
+            if (name == "RATE_PER_PARASITE_7VARS") return ParasiteSwitchType::RATE_PER_PARASITE_7VARS;
+            if (name == "RATE_PER_PARASITE_5VARS_DECAYING") return ParasiteSwitchType::RATE_PER_PARASITE_5VARS_DECAYING;
+
+            throw std::invalid_argument("Unknown Parasite_Switch_Type '" + name + "'");
+        }
+
+        static MalariaStrains::Enum malariaStrainsFromString(const std::string& name)
+        {
+            if (name == "FALCIPARUM_NONRANDOM_STRAIN") return MalariaStrains::FALCIPARUM_NONRANDOM_STRAIN;
+            if (name == "FALCIPARUM_RANDOM50_STRAIN") return MalariaStrains::FALCIPARUM_RANDOM50_STRAIN;
+            if (name == "FALCIPARUM_RANDOM_STRAIN") return MalariaStrains::FALCIPARUM_RANDOM_STRAIN;
+            if (name == "FALCIPARUM_STRAIN_GENERATOR") return MalariaStrains::FALCIPARUM_STRAIN_GENERATOR;
+
+            throw std::invalid_argument("Unknown Malaria_Strain_Model '" + name + "'");
+        }
+
+        void InfectionParams::Configure(const ParamSet& pset)
+        {
+            parasite_switch_type = parasiteSwitchTypeFromString(pset["Parasite_Switch_Type"].cast<std::string>());
+            malaria_strains = malariaStrainsFromString(pset["Malaria_Strain_Model"].cast<std::string>());
+
+            incubation_period = pset["Base_Incubation_Period"].cast<float>();  // TODO: emodlib#6 (gaussian distribution)
+
+            antibody_IRBC_killrate = pset["Antibody_IRBC_Kill_Rate"].cast<float>();
+            non_specific_antigenicity = pset["Nonspecific_Antigenicity_Factor"].cast<float>();
+            MSP1_merozoite_kill = pset["MSP1_Merozoite_Kill_Fraction"].cast<float>();
+            gametocyte_stage_survival = pset["Gametocyte_Stage_Survival_Rate"].cast<float>();
+            base_gametocyte_sexratio = pset["Base_Gametocyte_Fraction_Male"].cast<float>();
+            base_gametocyte_production = pset["Base_Gametocyte_Production_Rate"].cast<float>();
+            antigen_switch_rate = pset["Antigen_Switch_Rate"].cast<float>();
+            merozoites_per_hepatocyte = pset["Merozoites_Per_Hepatocyte"].cast<float>();
+            merozoites_per_schizont = pset["Merozoites_Per_Schizont"].cast<float>();
+            RBC_destruction_multiplier = pset["RBC_Destruction_Multiplier"].cast<float>();
+            n_asexual_cycles_wo_gametocytes = pset["Number_Of_Asexual_Cycles_Without_Gametocytes"].cast<int>();
+        }
+
+
+        std::shared_ptr<const IntrahostParams> IntrahostParams::defaults = std::make_shared<const IntrahostParams>();
+
+        IntrahostParams::IntrahostParams()
+            : randomSeed(0)
+            , common_random_numbers(false)
+
+            , max_ind_inf(1)
+
+            , falciparumMSPVars(DEFAULT_MSP_VARIANTS)
+            , falciparumNonSpecTypes(DEFAULT_NONSPECIFIC_TYPES)
+            , falciparumPfEMP1Vars(DEFAULT_PFEMP1_VARIANTS)
+
+            // TODO: emodlib#7 (infectiousness calculations)
+            , base_gametocyte_mosquito_survival(DEFAULT_BASE_GAMETOCYTE_MOSQUITO_SURVIVAL)
+            , cytokine_gametocyte_inactivation(DEFAULT_CYTOKINE_GAMETOCYTE_INACTIVATION)
+
+            , infection()
+            , susceptibility()
+        {
+
+        }
+
+        void IntrahostParams::Configure(const ParamSet& pset)
+        {
+            randomSeed = pset["Run_Number"].cast<int>();
+            common_random_numbers = pset["Common_Random_Numbers"].cast<bool>();
+
+            max_ind_inf = pset["Max_Individual_Infections"].cast<int>();
+
+            falciparumMSPVars = pset["Falciparum_MSP_Variants"].cast<int>();
+            falciparumNonSpecTypes = pset["Falciparum_Nonspecific_Types"].cast<int>();
+            falciparumPfEMP1Vars = pset["Falciparum_PfEMP1_Variants"].cast<int>();
+            if (max_ind_inf < 0 || falciparumMSPVars < 1 || falciparumNonSpecTypes < 1 || falciparumPfEMP1Vars < 1)
+            {
+                throw std::invalid_argument("Max_Individual_Infections must be non-negative and the Falciparum_*_Variants/Types counts positive");
+            }
+
+            // TODO: emodlib#7 (infectiousness calculations)
+            base_gametocyte_mosquito_survival = pset["Base_Gametocyte_Mosquito_Survival_Rate"].cast<float>();
+            cytokine_gametocyte_inactivation = pset["Cytokine_Gametocyte_Inactivation"].cast<float>();
+
+            infection.Configure(pset["infection_params"]);
+            susceptibility.Configure(pset["susceptibility_params"]);
+        }
+
+        std::shared_ptr<const IntrahostParams> IntrahostParams::Create(const ParamSet& pset)
+        {
+            std::shared_ptr<IntrahostParams> block = std::make_shared<IntrahostParams>();
+            block->Configure(pset);
+            return block;
+        }
+
+        std::shared_ptr<const IntrahostParams> IntrahostParams::CreateFromFile(const std::string& path)
+        {
+            return Create(LoadConfigFile(path));
+        }
+
+        std::shared_ptr<const IntrahostParams> IntrahostParams::GetDefaults()
+        {
+            return std::atomic_load(&defaults);
+        }
+
+        void IntrahostParams::SetDefaults(std::shared_ptr<const IntrahostParams> block)
+        {
+            std::atomic_store(&defaults, block);
+        }
+
+    }
+
+}
@@ -0,0 +1,127 @@
+/**
+ * @file MalariaParams.h
+ *
+ * @brief Malaria intrahost parameter blocks
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "emodlib/ParamSet.h"
+
+#include "MalariaEnums.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        struct SusceptibilityParams
+        {
+            // Used in MalariaAntibody for boost-decay functions
+            float memory_level;
+            float hyperimmune_decay_rate;
+            float MSP1_antibody_growthrate;
+            float antibody_stimulation_c50;
+            float antibody_capacity_growthrate;
+            float minimum_adapted_response;
+            float non_specific_growth;
+            float antibody_csp_decay_days;
+
+            // ...derived once here rather than on every antibody update
+            float minimum_stimulation;     // antibody_stimulation_c50 * minimum_adapted_response
+            float nonspecific_growthrate;  // antibody_capacity_growthrate * non_specific_growth
+
+            // Used in Susceptibility for:
+            // ...maternal protection
+            // bool enable_maternal_antibodies_transmission;
+            // MaternalAntibodiesType::Enum maternal_antibodies_type; // TODO: emodlib#9 (innate init)
+            // float maternal_antibody_protection;
+            float maternal_antibody_decay_rate;
+
+            // ...innate immunity effects
+            // InnateImmuneVariationType::Enum innate_immune_variation_type; // TODO: emodlib#9 (innate init)
+            float pyrogenic_threshold;
+            float fever_IRBC_killrate;
+
+            // ... red blood cell effects
+            float erythropoiesis_anemia_effect;
+
+            SusceptibilityParams();
+            void Configure(const ParamSet& pset);
+
+        private:
+
+            void derive();
+        };
+
+
+        struct InfectionParams
+        {
+            ParasiteSwitchType::Enum parasite_switch_type;
+            MalariaStrains::Enum     malaria_strains;
+
+            float incubation_period;
+            float antibody_IRBC_killrate;
+            float non_specific_antigenicity;
+            float MSP1_merozoite_kill;
+            float gametocyte_stage_survival;
+            float base_gametocyte_sexratio;
+            float base_gametocyte_production;
+            float antigen_switch_rate;
+            float merozoites_per_hepatocyte;
+            float merozoites_per_schizont;
+            float RBC_destruction_multiplier;
+            int   n_asexual_cycles_wo_gametocytes;
+
+            InfectionParams();
+            void Configure(const ParamSet& pset);
+        };
+
+
+        // Immutable once built: hosts, infections and antibodies only ever see a const block,
+        // so many configurations can be simulated side by side in one process
+        struct IntrahostParams
+        {
+            int randomSeed;
+            bool common_random_numbers;  // host streams keyed by (host, infection, purpose, day) instead of sequential
+
+            int max_ind_inf;
+
+            int falciparumMSPVars;
+            int falciparumNonSpecTypes;
+            int falciparumPfEMP1Vars;
+
+            // ... infectiousness calculations
+            float base_gametocyte_mosquito_survival;  // TODO: emodlib#7 (infectiousness calculations)
+            float cytokine_gametocyte_inactivation;
+
+            InfectionParams infection;
+            SusceptibilityParams susceptibility;
+
+            IntrahostParams();
+            void Configure(const ParamSet& pset);
+
+            static std::shared_ptr<const IntrahostParams> Create(const ParamSet& pset);
+
+            // From a config.yml-shaped YAML (or .json) file, parsed natively
+            static std::shared_ptr<const IntrahostParams> CreateFromFile(const std::string& path);
+
+            // Process-wide block used by objects created without an explicit one
+            static std::shared_ptr<const IntrahostParams> GetDefaults();
+            static void SetDefaults(std::shared_ptr<const IntrahostParams> block);
+
+        private:
+
+            static std::shared_ptr<const IntrahostParams> defaults;
+        };
+
+        typedef std::shared_ptr<const IntrahostParams> IntrahostParamsPtr;
+
+    }
+
+}
@@ -0,0 +1,470 @@
+/**
+ * @file Population.cpp
+ *
+ * @brief Malaria population implementation
+ */
+
+#include "Population.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "emodlib/utils/BinaryArchive.h"
+#include "emodlib/utils/Tracer.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        Population::Population()
+            : parameters(nullptr)
+            , hosts()
+            , source()
+            , source_offsets()
+            , partitions()
+            , host_partition()
+            , host_slot()
+            , migrants()
+            , costs()
+            , scheduler()
+            , reporter()
+            , writer()
+        {
+
+        }
+
+        Population* Population::Create(int n_hosts, int n_threads, IntrahostParamsPtr _params)
+        {
+            Population* pop = new Population();
+            pop->parameters = _params ? _params : IntrahostParams::GetDefaults();
+            pop->SetNumThreads(n_threads);
+
+            pop->hosts.reserve(n_hosts);
+            pop->host_partition.assign(n_hosts, HostPartition::Uninfected);
+            pop->host_slot.assign(n_hosts, 0);
+            pop->partitions[HostPartition::Uninfected].reserve(n_hosts);
+
+            for (int i = 0; i < n_hosts; i++)
+            {
+                // hosts may be updated concurrently, so each draws from its own stream
+                auto rng = IntrahostComponent::CreateHostStream(pop->parameters->randomSeed, i, pop->parameters->common_random_numbers);
+                pop->hosts.push_back(IntrahostComponent::Create(pop->parameters, rng));
+                pop->host_slot[i] = int(pop->partitions[HostPartition::Uninfected].size());
+                pop->partitions[HostPartition::Uninfected].push_back(i);
+            }
+
+            return pop;
+        }
+
+        Population::~Population()
+        {
+            for (auto* host: hosts) {
+                delete host;
+            }
+        }
+
+        void Population::Serialize(BinaryWriter& writer) const
+        {
+            uint64_t n_hosts = hosts.size();
+            writer.Write<uint64_t>(n_hosts);
+
+            size_t table = writer.Size();
+            std::vector<uint64_t> offsets(n_hosts + 1, 0);
+            writer.WriteArray(offsets.data(), offsets.size());
+
+            for (auto partition: host_partition)
+            {
+                writer.Write<uint8_t>(uint8_t(partition));
+            }
+
+            for (size_t i = 0; i < n_hosts; i++)
+            {
+                offsets[i] = writer.Size();
+                if (hosts[i])
+                {
+                    hosts[i]->Serialize(writer);
+                }
+                else if (deferred.empty())
+                {
+                    // never materialized or updated, so the mapped record is still current
+                    writer.WriteBytes(source->Data() + source_offsets[i], size_t(source_offsets[i + 1] - source_offsets[i]));
+                }
+                else
+                {
+                    std::unique_ptr<IntrahostComponent> caught_up(materialize(int(i)));
+                    caught_up->Serialize(writer);
+                }
+            }
+            offsets[n_hosts] = writer.Size();
+
+            writer.Patch(table, offsets.data(), offsets.size() * sizeof(uint64_t));
+        }
+
+        void Population::readTables(BinaryReader& reader)
+        {
+            uint64_t n_hosts = reader.Read<uint64_t>();
+            if (n_hosts >= (reader.Size() - reader.Position()) / sizeof(uint64_t))
+            {
+                throw std::runtime_error("Corrupt snapshot: host count exceeds the data");
+            }
+
+            source_offsets.resize(n_hosts + 1);
+            reader.ReadArray(source_offsets.data(), source_offsets.size());
+
+            for (size_t i = 0; i < n_hosts; i++)
+            {
+                if (source_offsets[i] > source_offsets[i + 1] || source_offsets[i + 1] > reader.Size())
+                {
+                    throw std::runtime_error("Corrupt snapshot: invalid host offset table");
+                }
+            }
+
+            hosts.assign(n_hosts, nullptr);
+            host_partition.resize(n_hosts);
+            host_slot.resize(n_hosts);
+
+            for (size_t i = 0; i < n_hosts; i++)
+            {
+                uint8_t partition = reader.Read<uint8_t>();
+                if (partition >= HostPartition::Count)
+                {
+                    throw std::runtime_error("Corrupt snapshot: invalid host partition");
+                }
+
+                host_partition[i] = HostPartition::Enum(partition);
+                host_slot[i] = int(partitions[partition].size());
+                partitions[partition].push_back(int(i));
+            }
+        }
+
+        Population* Population::Deserialize(BinaryReader& reader, int n_threads, IntrahostParamsPtr _params)
+        {
+            Population* pop = new Population();
+
+            try
+            {
+                pop->parameters = _params ? _params : IntrahostParams::GetDefaults();
+                pop->SetNumThreads(n_threads);
+                pop->readTables(reader);
+
+                for (size_t i = 0; i < pop->hosts.size(); i++)
+                {
+                    reader.Seek(pop->source_offsets[i]);
+                    pop->hosts[i] = IntrahostComponent::Deserialize(reader, pop->parameters);
+                }
+                pop->source_offsets.clear();
+            }
+            catch (...)
+            {
+                delete pop;
+                throw;
+            }
+
+            return pop;
+        }
+
+        Population* Population::Map(std::shared_ptr<const MappedFile> _source, size_t record, int n_threads, IntrahostParamsPtr _params)
+        {
+            Population* pop = new Population();
+
+            try
+            {
+                pop->parameters = _params ? _params : IntrahostParams::GetDefaults();
+                pop->SetNumThreads(n_threads);
+
+                BinaryReader reader(_source->Data(), _source->Size());
+                reader.Seek(record);
+                pop->readTables(reader);
+                pop->source = _source;
+            }
+            catch (...)
+            {
+                delete pop;
+                throw;
+            }
+
+            return pop;
+        }
+
+        Population* Population::Fork() const
+        {
+            Population* pop = new Population();
+            pop->parameters = parameters;
+            pop->SetNumThreads(GetNumThreads());
+
+            pop->source = source;
+            pop->source_offsets = source_offsets;
+            pop->deferred = deferred;
+            for (int p = 0; p < HostPartition::Count; p++)
+            {
+                pop->partitions[p] = partitions[p];
+            }
+            pop->host_partition = host_partition;
+            pop->host_slot = host_slot;
+
+            pop->hosts.assign(hosts.size(), nullptr);
+            pop->scheduler->ParallelFor(hosts.size(), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                {
+                    if (hosts[i]) pop->hosts[i] = hosts[i]->Clone();
+                }
+            });
+
+            return pop;
+        }
+
+        IntrahostComponent* Population::host(int index) const
+        {
+            // Each host is only ever touched by one scheduler task per sweep, so no lock is needed
+            if (!hosts.at(index))
+            {
+                hosts[index] = materialize(index);
+            }
+            return hosts[index];
+        }
+
+        IntrahostComponent* Population::materialize(int index) const
+        {
+            BinaryReader reader(source->Data(), size_t(source_offsets[index + 1]));
+            reader.Seek(source_offsets[index]);
+            IntrahostComponent* h = IntrahostComponent::Deserialize(reader, parameters);
+
+            for (float dt : deferred)
+            {
+                h->GetSusceptibility()->Update(dt);
+            }
+            return h;
+        }
+
+        int Population::GetNumMaterialized() const
+        {
+            return int(std::count_if(hosts.begin(), hosts.end(), [](const IntrahostComponent* h) { return h != nullptr; }));
+        }
+
+        void Population::Update(float dt)
+        {
+            EMODLIB_TRACE_SCOPE("population", "Population::Update");
+
+            // The uninfected bulk of the population only needs its immune state advanced, liver-stage hosts
+            // cost about the same as each other, and only blood-stage hosts pay for the variant loops
+            updateUninfected(dt);
+            updateLiverStage(dt);
+            updateBloodStage(dt);
+
+            // after the infected sweeps, which materialize any hosts of theirs still mapped
+            if (source) deferred.push_back(dt);
+
+            // Hosts can only leave the infected partitions during an update (liver-stage release or clearance),
+            // so reclassify them after the sweeps to avoid mutating a partition while it is being iterated
+            {
+                EMODLIB_TRACE_SCOPE("population", "reclassify");
+                migrants.clear();
+                migrants.insert(migrants.end(), partitions[HostPartition::LiverStage].begin(), partitions[HostPartition::LiverStage].end());
+                migrants.insert(migrants.end(), partitions[HostPartition::BloodStage].begin(), partitions[HostPartition::BloodStage].end());
+
+                for (int index: migrants)
+                {
+                    reclassify(index);
+                }
+            }
+
+            if (reporter)
+            {
+                reporter->EndStep(dt);
+            }
+
+            if (writer)
+            {
+                writer->Record(*this, dt);
+            }
+        }
+
+        void Population::updateUninfected(float dt)
+        {
+            // Identical to IntrahostComponent::Update with an empty infection list
+            const std::vector<int>& partition = partitions[HostPartition::Uninfected];
+            EMODLIB_TRACE_SCOPE("population", "updateUninfected", 0, int64_t(partition.size()));
+
+            scheduler->ParallelFor(partition.size(), [&](size_t begin, size_t end) {
+                AggregateReporter::Tally tally(reporter.get());
+                for (size_t i = begin; i < end; i++)
+                {
+                    // mapped hosts are left as records, unless a reporter needs to see them
+                    if (!hosts[partition[i]] && !reporter) continue;
+
+                    IntrahostComponent* h = host(partition[i]);
+                    h->GetSusceptibility()->Update(dt);
+                    tally.Observe(*h);
+                }
+                if (reporter) reporter->Merge(tally);
+            });
+        }
+
+        void Population::updateLiverStage(float dt)
+        {
+            // Infections still in the liver only advance their hepatocytes, so tasks are even ranges with no cost pass
+            const std::vector<int>& partition = partitions[HostPartition::LiverStage];
+            EMODLIB_TRACE_SCOPE("population", "updateLiverStage", 0, int64_t(partition.size()));
+
+            scheduler->ParallelFor(partition.size(), [&](size_t begin, size_t end) {
+                AggregateReporter::Tally tally(reporter.get());
+                for (size_t i = begin; i < end; i++)
+                {
+                    IntrahostComponent* h = host(partition[i]);
+                    h->Update(dt);
+                    tally.Observe(*h);
+                }
+                if (reporter) reporter->Merge(tally);
+            });
+        }
+
+        void Population::updateBloodStage(float dt)
+        {
+            // Superinfected hosts can cost orders of magnitude more than the rest, so size tasks by estimated cost
+            const std::vector<int>& partition = partitions[HostPartition::BloodStage];
+            EMODLIB_TRACE_SCOPE("population", "updateBloodStage", 0, int64_t(partition.size()));
+
+            costs.resize(partition.size());
+            for (size_t i = 0; i < partition.size(); i++)
+            {
+                costs[i] = host(partition[i])->GetCostEstimate();
+            }
+
+            scheduler->ParallelFor(costs, [&](size_t begin, size_t end) {
+                AggregateReporter::Tally tally(reporter.get());
+                for (size_t i = begin; i < end; i++)
+                {
+                    IntrahostComponent* h = host(partition[i]);
+                    h->Update(dt);
+                    tally.Observe(*h);
+                }
+                if (reporter) reporter->Merge(tally);
+            });
+        }
+
+        void Population::Challenge(int index, int strain_id)
+        {
+            host(index)->Challenge(strain_id);
+            reclassify(index);
+        }
+
+        void Population::Treat(int index)
+        {
+            host(index)->Treat();
+            reclassify(index);
+        }
+
+        void Population::reclassify(int index)
+        {
+            HostPartition::Enum partition = host(index)->GetHostPartition();
+
+            if (partition != host_partition[index])
+            {
+                assignPartition(index, partition);
+            }
+        }
+
+        void Population::assignPartition(int index, HostPartition::Enum partition)
+        {
+            // swap-remove from the current partition, patching the slot of the host moved into the gap
+            std::vector<int>& source = partitions[host_partition[index]];
+            int slot = host_slot[index];
+            int moved = source.back();
+            source[slot] = moved;
+            host_slot[moved] = slot;
+            source.pop_back();
+
+            std::vector<int>& target = partitions[partition];
+            host_slot[index] = int(target.size());
+            host_partition[index] = partition;
+            target.push_back(index);
+        }
+
+        int Population::GetSize() const
+        {
+            return int(hosts.size());
+        }
+
+        const IntrahostComponent* Population::GetHost(int index) const
+        {
+            return host(index);
+        }
+
+        IntrahostComponent* Population::AcquireHost(int index)
+        {
+            return host(index);
+        }
+
+        void Population::ReleaseHost(int index)
+        {
+            reclassify(index);
+        }
+
+        const std::vector<int>& Population::GetPartition(HostPartition::Enum partition) const
+        {
+            return partitions[partition];
+        }
+
+        HostPartition::Enum Population::GetHostPartition(int index) const
+        {
+            return host_partition.at(index);
+        }
+
+        IntrahostParamsPtr Population::GetParams() const
+        {
+            return parameters;
+        }
+
+        void Population::SetReporter(std::shared_ptr<AggregateReporter> _reporter)
+        {
+            reporter = _reporter;
+        }
+
+        std::shared_ptr<AggregateReporter> Population::GetReporter() const
+        {
+            return reporter;
+        }
+
+        void Population::SetWriter(std::shared_ptr<TrajectoryWriter> _writer)
+        {
+            if (_writer)
+            {
+                for (int index : _writer->GetHosts())
+                {
+                    if (index >= GetSize()) throw std::out_of_range("Host index " + std::to_string(index) + " out of range");
+                }
+            }
+            writer = _writer;
+        }
+
+        std::shared_ptr<TrajectoryWriter> Population::GetWriter() const
+        {
+            return writer;
+        }
+
+        void Population::SetNumThreads(int n_threads)
+        {
+            scheduler.reset(new WorkStealingScheduler(n_threads));
+        }
+
+        int Population::GetNumThreads() const
+        {
+            return scheduler->GetNumThreads();
+        }
+
+        const std::vector<WorkStealingScheduler::WorkerStats>& Population::GetSchedulerStats() const
+        {
+            return scheduler->GetStats();
+        }
+
+        void Population::ResetSchedulerStats()
+        {
+            scheduler->ResetStats();
+        }
+
+    }
+
+}
@@ -0,0 +1,126 @@
+/**
+ * @file Population.h
+ *
+ * @brief Malaria population interface
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "emodlib/utils/MappedFile.h"
+#include "emodlib/utils/Scheduler.h"
+
+#include "AggregateReporter.h"
+#include "MalariaEnums.h"
+#include "MalariaParams.h"
+#include "IntrahostComponent.h"
+#include "TrajectoryWriter.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        class Population
+        {
+
+        public:
+
+            static Population* Create(int n_hosts, int n_threads=1, IntrahostParamsPtr _params=nullptr);
+            ~Population();
+
+            // Host records follow an offset table and a partition table, so any one host can be located
+            // and the partitions rebuilt without parsing the others
+            void Serialize(BinaryWriter& writer) const;
+            static Population* Deserialize(BinaryReader& reader, int n_threads=1, IntrahostParamsPtr _params=nullptr);
+
+            // Hosts stay as records in the mapped snapshot until first accessed, challenged or infected
+            // (or observed by a reporter), while updates of the uninfected ones are deferred until then
+            // Deep copy of every host, still sharing the mapped records of hosts not yet materialized
+            Population* Fork() const;
+
+            static Population* Map(std::shared_ptr<const MappedFile> _source, size_t record, int n_threads=1, IntrahostParamsPtr _params=nullptr);
+            int GetNumMaterialized() const;
+
+            void Update(float dt);
+
+            void Challenge(int index, int strain_id=0);
+            void Treat(int index);
+
+            int GetSize() const;
+            const IntrahostComponent* GetHost(int index) const;
+
+            // For changing a host other than through Challenge or Treat: the host moves to its new partition
+            // on release, and must not be changed once released
+            IntrahostComponent* AcquireHost(int index);
+            void ReleaseHost(int index);
+
+            const std::vector<int>& GetPartition(HostPartition::Enum partition) const;
+            HostPartition::Enum GetHostPartition(int index) const;
+            IntrahostParamsPtr GetParams() const;
+
+            // Observes every host as it is updated, and closes a report row after each step.
+            // Transient: neither saved by Serialize nor carried over by Fork.
+            void SetReporter(std::shared_ptr<AggregateReporter> _reporter);
+            std::shared_ptr<AggregateReporter> GetReporter() const;
+
+            // Records its hosts' channels after each step, as transient as the reporter
+            void SetWriter(std::shared_ptr<TrajectoryWriter> _writer);
+            std::shared_ptr<TrajectoryWriter> GetWriter() const;
+
+            void SetNumThreads(int n_threads);
+            int GetNumThreads() const;
+            const std::vector<WorkStealingScheduler::WorkerStats>& GetSchedulerStats() const;
+            void ResetSchedulerStats();
+
+        private:
+
+            IntrahostParamsPtr parameters;  // one immutable block shared by every host
+
+            // nullptr until materialized from the mapped snapshot, hence mutable behind const accessors
+            mutable std::vector<IntrahostComponent*> hosts;
+
+            std::shared_ptr<const MappedFile> source;  // mapped snapshot backing unmaterialized hosts, else nullptr
+            std::vector<uint64_t> source_offsets;      // record offsets into the snapshot, with the end as a sentinel
+
+            // Steps since mapping, owed to every host still only a record: those are uninfected, so
+            // each step only advances its susceptibility, replayed when the host is materialized
+            std::vector<float> deferred;
+
+            // Index lists of hosts in each partition, plus the reverse lookup of each host's partition and slot,
+            // so that hosts can migrate between partitions in constant time on challenge, treatment and clearance
+            std::vector<int> partitions[HostPartition::Count];
+            std::vector<HostPartition::Enum> host_partition;
+            std::vector<int> host_slot;
+
+            std::vector<int> migrants;  // scratch list of infected hosts to reclassify after each update
+            std::vector<float> costs;   // scratch list of per-host cost estimates for the scheduler
+
+            std::unique_ptr<WorkStealingScheduler> scheduler;
+
+            std::shared_ptr<AggregateReporter> reporter;  // else nullptr
+            std::shared_ptr<TrajectoryWriter> writer;     // else nullptr
+
+
+            Population();
+
+            IntrahostComponent* host(int index) const;
+            IntrahostComponent* materialize(int index) const;  // a new host from the mapped record, caught up
+            void readTables(BinaryReader& reader);
+
+            void assignPartition(int index, HostPartition::Enum partition);
+            void reclassify(int index);
+
+            void updateUninfected(float dt);
+            void updateLiverStage(float dt);
+            void updateBloodStage(float dt);
+
+        };
+
+    }
+
+}
@@ -0,0 +1,155 @@
+/**
+ * @file Snapshot.cpp
+ *
+ * @brief Versioned binary snapshots of hosts and populations
+ */
+
+#include "Snapshot.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#include "emodlib/utils/BinaryArchive.h"
+#include "emodlib/utils/MappedFile.h"
+#include "emodlib/utils/Tracer.h"
+
+#include "IntrahostComponent.h"
+#include "Population.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        const uint32_t Snapshot::VERSION;
+
+        static const char SNAPSHOT_MAGIC[8] = { 'E', 'M', 'O', 'D', 'L', 'I', 'B', '\0' };
+
+        static void writeHeader(BinaryWriter& writer, SnapshotKind::Enum kind)
+        {
+            writer.WriteArray(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+            writer.Write<uint32_t>(Snapshot::VERSION);
+            writer.Write<uint32_t>(kind);
+            writer.Write<uint32_t>(CLONAL_PfEMP1_VARIANTS);
+            writer.Write<uint32_t>(sizeof(real_t));
+        }
+
+        void Snapshot::readHeader(BinaryReader& reader, SnapshotKind::Enum kind)
+        {
+            char magic[sizeof(SNAPSHOT_MAGIC)];
+            reader.ReadArray(magic, sizeof(magic));
+            if (memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0)
+            {
+                throw std::runtime_error("Not an emodlib snapshot");
+            }
+
+            uint32_t version = reader.Read<uint32_t>();
+            if (version != VERSION)
+            {
+                throw std::runtime_error("Unsupported snapshot version " + std::to_string(version) + " (expected " + std::to_string(VERSION) + ")");
+            }
+
+            uint32_t found = reader.Read<uint32_t>();
+            if (found != uint32_t(kind))
+            {
+                throw std::runtime_error(kind == SnapshotKind::Host ? "Snapshot is not of a single host" : "Snapshot is not of a population");
+            }
+
+            // infection records are laid out per variant, so a build with another count cannot read them
+            uint32_t variants = reader.Read<uint32_t>();
+            if (variants != CLONAL_PfEMP1_VARIANTS)
+            {
+                throw std::runtime_error("Snapshot has " + std::to_string(variants) + " PfEMP1 variants per infection (this build has " + std::to_string(CLONAL_PfEMP1_VARIANTS) + ")");
+            }
+
+            uint32_t real_size = reader.Read<uint32_t>();
+            if (real_size != sizeof(real_t))
+            {
+                throw std::runtime_error("Snapshot state is float" + std::to_string(8 * real_size) + " (this build is " EMODLIB_PRECISION_NAME ")");
+            }
+        }
+
+        std::vector<char> Snapshot::SaveHost(const IntrahostComponent& host)
+        {
+            BinaryWriter writer;
+            writeHeader(writer, SnapshotKind::Host);
+            host.Serialize(writer);
+            return std::move(writer.Buffer());
+        }
+
+        IntrahostComponent* Snapshot::LoadHost(const char* data, size_t size, IntrahostParamsPtr _params)
+        {
+            BinaryReader reader(data, size);
+            readHeader(reader, SnapshotKind::Host);
+            return IntrahostComponent::Deserialize(reader, _params);
+        }
+
+        std::vector<char> Snapshot::SavePopulation(const Population& pop)
+        {
+            BinaryWriter writer;
+            writeHeader(writer, SnapshotKind::Population);
+            pop.Serialize(writer);
+            return std::move(writer.Buffer());
+        }
+
+        Population* Snapshot::LoadPopulation(const char* data, size_t size, int n_threads, IntrahostParamsPtr _params)
+        {
+            BinaryReader reader(data, size);
+            readHeader(reader, SnapshotKind::Population);
+            return Population::Deserialize(reader, n_threads, _params);
+        }
+
+        void Snapshot::SavePopulationFile(const Population& pop, const std::string& path)
+        {
+            EMODLIB_TRACE_SCOPE("output", "SavePopulationFile");
+            std::vector<char> buffer = SavePopulation(pop);
+
+            // Populations opened from the file, here or in other processes, keep reading hosts from its mapping,
+            // so write a new file beside it and rename it into place rather than truncating the mapped one
+            std::string temporary = path + ".tmp" + std::to_string(getpid());
+            {
+                std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+                stream.write(buffer.data(), buffer.size());
+                stream.close();
+                if (!stream)
+                {
+                    std::remove(temporary.c_str());
+                    throw std::runtime_error("Cannot write snapshot to " + path);
+                }
+            }
+
+#ifdef _WIN32
+            std::remove(path.c_str());  // rename does not replace on Windows, where snapshots are read rather than mapped
+#endif
+            if (std::rename(temporary.c_str(), path.c_str()) != 0)
+            {
+                std::remove(temporary.c_str());
+                throw std::runtime_error("Cannot write snapshot to " + path + ": " + strerror(errno));
+            }
+        }
+
+        Population* Snapshot::OpenPopulationFile(const std::string& path, int n_threads, IntrahostParamsPtr _params)
+        {
+            std::shared_ptr<const MappedFile> file = MappedFile::Open(path);
+
+            BinaryReader reader(file->Data(), file->Size());
+            readHeader(reader, SnapshotKind::Population);
+            return Population::Map(file, reader.Position(), n_threads, _params);
+        }
+
+    }
+
+}
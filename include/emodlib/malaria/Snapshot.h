@@ -0,0 +1,65 @@
+/**
+ * @file Snapshot.h
+ *
+ * @brief Versioned binary snapshots of hosts and populations
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "MalariaParams.h"
+
+
+namespace emodlib
+{
+
+    class BinaryReader;
+
+    namespace malaria
+    {
+
+        class IntrahostComponent;
+        class Population;
+
+        namespace SnapshotKind {
+            enum Enum {
+                Host = 1,
+                Population = 2,
+            };
+        }
+
+        // A snapshot is the 8-byte magic "EMODLIB\0", a uint32 format version, a uint32 kind, and the
+        // uint32 PfEMP1 variant count and state precision (bytes per real) the library was built with,
+        // followed by the object record. Parameters are not part of the snapshot: restore takes
+        // the block to attach, or the process-wide defaults.
+        class Snapshot
+        {
+
+        public:
+
+            static const uint32_t VERSION = 1;
+
+            static std::vector<char> SaveHost(const IntrahostComponent& host);
+            static IntrahostComponent* LoadHost(const char* data, size_t size, IntrahostParamsPtr _params=nullptr);
+
+            static std::vector<char> SavePopulation(const Population& pop);
+            static Population* LoadPopulation(const char* data, size_t size, int n_threads=1, IntrahostParamsPtr _params=nullptr);
+
+            // File-backed population snapshots, mapped read-only and materialized host by host on first use,
+            // so that startup cost does not depend on population size and processes share the untouched pages
+            static void SavePopulationFile(const Population& pop, const std::string& path);
+            static Population* OpenPopulationFile(const std::string& path, int n_threads=1, IntrahostParamsPtr _params=nullptr);
+
+        private:
+
+            static void readHeader(BinaryReader& reader, SnapshotKind::Enum kind);
+
+        };
+
+    }
+
+}
@@ -0,0 +1,168 @@
+/**
+ * @file Splitting.cpp
+ *
+ * @brief Multilevel splitting estimator implementation
+ */
+
+#include "Splitting.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "emodlib/utils/Scheduler.h"
+
+#include "ChallengeBatch.h"
+#include "IntrahostComponent.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        namespace
+        {
+            struct Particle
+            {
+                IntrahostComponent* host;
+                int step;
+            };
+
+            double observe(const IntrahostComponent* host, SplittingObservable::Enum observable)
+            {
+                switch (observable)
+                {
+                case SplittingObservable::ParasiteDensity:
+                    return host->GetParasiteDensity();
+
+                case SplittingObservable::RBCDeficit:
+                    return 1.0 - host->GetSusceptibility()->get_RBC_availability();
+
+                default:
+                    throw std::invalid_argument("Unknown SplittingObservable enum used");
+                }
+            }
+        }
+
+        SplittingResult MultilevelSplitting::Run(IntrahostParamsPtr block,
+                                                 SplittingObservable::Enum observable,
+                                                 const std::vector<float>& levels,
+                                                 int n_particles,
+                                                 int duration,
+                                                 const std::vector<int>& challenge_days,
+                                                 float dt,
+                                                 int n_threads)
+        {
+            if (levels.empty() || n_particles < 1)
+            {
+                throw std::invalid_argument("Splitting needs at least one level and one particle");
+            }
+            for (size_t k = 1; k < levels.size(); k++)
+            {
+                if (!(levels[k] > levels[k - 1]))
+                {
+                    throw std::invalid_argument("Splitting levels must be strictly increasing");
+                }
+            }
+
+            block = block ? block : IntrahostParams::GetDefaults();
+
+            std::vector<bool> challenged = ChallengeBatch::ChallengeSchedule(duration, challenge_days, dt);
+            int last_step = int(challenged.size());
+
+            SplittingResult result;
+            result.probability = 1.0;
+            result.relative_variance = 0.0;
+            result.levels = levels;
+            result.host_steps = 0;
+
+            WorkStealingScheduler scheduler(n_threads);
+
+            std::vector<Particle> particles(n_particles);
+            std::vector<Particle> survivors;
+            std::vector<char> reached(n_particles);
+            std::vector<uint64_t> steps(n_particles);
+
+            // after every particle stream, for picking the survivors that get an extra clone
+            auto resampling = IntrahostComponent::CreateHostStream(block->randomSeed, int(levels.size()) * n_particles, block->common_random_numbers);
+
+            for (size_t k = 0; k < levels.size(); k++)
+            {
+                // Survivors are only exchangeable in a random order, so the remainder of clones goes to a random subset
+                for (size_t i = survivors.size(); i > 1; i--)
+                {
+                    std::swap(survivors[i - 1], survivors[resampling->uniformZeroToN32(uint32_t(i))]);
+                }
+
+                // Every particle of every stage gets its own stream, so clones of one survivor diverge
+                for (int j = 0; j < n_particles; j++)
+                {
+                    auto rng = IntrahostComponent::CreateHostStream(block->randomSeed, int(k) * n_particles + j, block->common_random_numbers);
+                    if (k == 0)
+                    {
+                        particles[j] = { IntrahostComponent::Create(block, rng), 0 };
+                    }
+                    else
+                    {
+                        const Particle& parent = survivors[j % survivors.size()];
+                        particles[j] = { parent.host->Clone(rng), parent.step };
+                    }
+                }
+
+                for (auto& survivor: survivors) delete survivor.host;
+                survivors.clear();
+
+                double level = levels[k];
+                scheduler.ParallelFor(size_t(n_particles), [&](size_t begin, size_t end) {
+                    for (size_t j = begin; j < end; j++)
+                    {
+                        Particle& p = particles[j];
+                        uint64_t n_steps = 0;
+                        bool hit = observe(p.host, observable) >= level;
+
+                        while (!hit && p.step < last_step)
+                        {
+                            if (challenged[p.step]) p.host->Challenge();
+                            p.host->Update(dt);
+                            p.step++;
+                            n_steps++;
+                            hit = observe(p.host, observable) >= level;
+                        }
+
+                        reached[j] = hit;
+                        steps[j] = n_steps;
+                    }
+                });
+
+                for (int j = 0; j < n_particles; j++)
+                {
+                    result.host_steps += steps[j];
+                    if (reached[j])
+                        survivors.push_back(particles[j]);
+                    else
+                        delete particles[j].host;
+                }
+
+                int hits = int(survivors.size());
+                double p = double(hits) / n_particles;
+                result.level_hits.push_back(hits);
+                result.level_probabilities.push_back(p);
+                result.probability *= p;
+
+                if (hits == 0)
+                {
+                    result.relative_variance = 0.0;  // no information on the variance of a zero estimate
+                    break;
+                }
+                result.relative_variance += (1.0 - p) / (n_particles * p);
+            }
+
+            for (auto& survivor: survivors) delete survivor.host;
+
+            return result;
+        }
+
+    }
+
+}
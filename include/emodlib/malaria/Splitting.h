@@ -0,0 +1,56 @@
+/**
+ * @file Splitting.h
+ *
+ * @brief Multilevel splitting estimator for rare severe outcomes
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "MalariaEnums.h"
+#include "MalariaParams.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        struct SplittingResult
+        {
+            double probability;                       // product of the conditional level probabilities
+            double relative_variance;                 // approximate squared relative error of the estimate
+            std::vector<float> levels;
+            std::vector<double> level_probabilities;  // P(reach level k | reached level k-1)
+            std::vector<int> level_hits;
+            uint64_t host_steps;                      // total host updates, the cost of the estimate
+        };
+
+
+        // Fixed-effort multilevel splitting: each stage runs n_particles hosts until their observable reaches
+        // the next level or the protocol ends, and the hosts that reached it are cloned (with fresh streams)
+        // to start the next stage. The product of the stage success fractions is an unbiased estimate of
+        // the probability of reaching the last level within the protocol duration.
+        // duration and challenge_days are in days, as for ChallengeBatch::Run.
+        class MultilevelSplitting
+        {
+
+        public:
+
+            static SplittingResult Run(IntrahostParamsPtr block,
+                                       SplittingObservable::Enum observable,
+                                       const std::vector<float>& levels,
+                                       int n_particles,
+                                       int duration,
+                                       const std::vector<int>& challenge_days,
+                                       float dt=1.0f,
+                                       int n_threads=1);
+
+        };
+
+    }
+
+}
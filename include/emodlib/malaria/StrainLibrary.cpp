@@ -0,0 +1,174 @@
+/**
+ * @file StrainLibrary.cpp
+ *
+ * @brief Shared immutable antigenic repertoires implementation
+ */
+
+#include "StrainLibrary.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "emodlib/utils/BinaryArchive.h"
+#include "emodlib/utils/RANDOM.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        bool Repertoire::SameAntigens(const Repertoire& other) const
+        {
+            return MSPtype == other.MSPtype
+                && nonspectype == other.nonspectype
+                && std::equal(minor_epitope_type, minor_epitope_type + CLONAL_PfEMP1_VARIANTS, other.minor_epitope_type)
+                && std::equal(IRBCtype, IRBCtype + CLONAL_PfEMP1_VARIANTS, other.IRBCtype);
+        }
+
+
+        std::mutex StrainLibrary::mutex;
+        std::map<StrainLibrary::Key, RepertoirePtr> StrainLibrary::strains;
+
+        RepertoirePtr StrainLibrary::Get(const IntrahostParams* params, int strain_id, RANDOMBASE* rng)
+        {
+            MalariaStrains::Enum model = params->infection.malaria_strains;
+
+            switch (model)
+            {
+            case MalariaStrains::FALCIPARUM_NONRANDOM_STRAIN:
+                return intern(params, model, 0);
+
+            case MalariaStrains::FALCIPARUM_STRAIN_GENERATOR:
+                if (strain_id < 0)
+                {
+                    throw std::invalid_argument("Strain ids must be non-negative, got " + std::to_string(strain_id));
+                }
+                return intern(params, model, strain_id);
+
+            case MalariaStrains::FALCIPARUM_RANDOM50_STRAIN:
+            case MalariaStrains::FALCIPARUM_RANDOM_STRAIN:
+            {
+                std::shared_ptr<Repertoire> repertoire = std::make_shared<Repertoire>();
+                repertoire->model = model;
+                repertoire->strain_id = -1;
+
+                int PfEMP1_vars = (model == MalariaStrains::FALCIPARUM_RANDOM50_STRAIN) ? CLONAL_PfEMP1_VARIANTS : params->falciparumPfEMP1Vars;
+                draw(*repertoire, rng, params->falciparumMSPVars, params->falciparumNonSpecTypes, PfEMP1_vars);
+                return repertoire;
+            }
+
+            default:
+                throw std::invalid_argument("Unknown malaria strain model " + std::to_string(int(model)));
+            }
+        }
+
+        RepertoirePtr StrainLibrary::intern(const IntrahostParams* params, MalariaStrains::Enum model, int strain_id)
+        {
+            Key key(int(model), params->falciparumMSPVars, params->falciparumNonSpecTypes, params->falciparumPfEMP1Vars, strain_id);
+
+            // infections may be created from hosts updated on different threads
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto it = strains.find(key);
+            if (it == strains.end())
+            {
+                it = strains.emplace(key, std::make_shared<const Repertoire>(generate(params, model, strain_id))).first;
+            }
+            return it->second;
+        }
+
+        Repertoire StrainLibrary::generate(const IntrahostParams* params, MalariaStrains::Enum model, int strain_id)
+        {
+            Repertoire repertoire;
+            repertoire.model = model;
+            repertoire.strain_id = strain_id;
+
+            if (model == MalariaStrains::FALCIPARUM_NONRANDOM_STRAIN)
+            {
+                repertoire.MSPtype = 0;
+                repertoire.nonspectype = 0;
+                for (int i = 0; i < CLONAL_PfEMP1_VARIANTS; i++)
+                {
+                    repertoire.IRBCtype[i] = i % params->falciparumPfEMP1Vars;
+                    repertoire.minor_epitope_type[i] = i % MINOR_EPITOPE_VARS_PER_SET;
+                }
+            }
+            else
+            {
+                // A stream of its own, so a strain has the same antigens in every run and on every host
+                PSEUDO_DES rng(uint64_t(uint32_t(strain_id)) << 32 | 0x57A1u, 128);
+                draw(repertoire, &rng, params->falciparumMSPVars, params->falciparumNonSpecTypes, params->falciparumPfEMP1Vars);
+            }
+
+            return repertoire;
+        }
+
+        void StrainLibrary::draw(Repertoire& repertoire, RANDOMBASE* rng, int MSP_vars, int nonspec_types, int PfEMP1_vars)
+        {
+            repertoire.MSPtype = rng->uniformZeroToN16(MSP_vars);
+            repertoire.nonspectype = rng->uniformZeroToN16(nonspec_types);
+
+            for (int i = 0; i < CLONAL_PfEMP1_VARIANTS; i++)
+            {
+                repertoire.IRBCtype[i] = rng->uniformZeroToN16(PfEMP1_vars);
+                repertoire.minor_epitope_type[i] = rng->uniformZeroToN16(MINOR_EPITOPE_VARS_PER_SET) + MINOR_EPITOPE_VARS_PER_SET * repertoire.nonspectype;
+            }
+        }
+
+        void StrainLibrary::Serialize(const Repertoire& repertoire, BinaryWriter& writer)
+        {
+            writer.Write<int32_t>(repertoire.model);
+            writer.Write<int32_t>(repertoire.strain_id);
+
+            writer.Write<int32_t>(repertoire.MSPtype);
+            writer.Write<int32_t>(repertoire.nonspectype);
+            writer.WriteArray(repertoire.minor_epitope_type, CLONAL_PfEMP1_VARIANTS);
+            writer.WriteArray(repertoire.IRBCtype, CLONAL_PfEMP1_VARIANTS);
+        }
+
+        RepertoirePtr StrainLibrary::Deserialize(BinaryReader& reader, const IntrahostParams* params)
+        {
+            std::shared_ptr<Repertoire> repertoire = std::make_shared<Repertoire>();
+
+            repertoire->model = MalariaStrains::Enum(reader.Read<int32_t>());
+            repertoire->strain_id = reader.Read<int32_t>();
+
+            repertoire->MSPtype = reader.Read<int32_t>();
+            repertoire->nonspectype = reader.Read<int32_t>();
+            reader.ReadArray(repertoire->minor_epitope_type, CLONAL_PfEMP1_VARIANTS);
+            reader.ReadArray(repertoire->IRBCtype, CLONAL_PfEMP1_VARIANTS);
+
+            bool library_strain = (repertoire->model == MalariaStrains::FALCIPARUM_NONRANDOM_STRAIN && repertoire->strain_id == 0)
+                               || (repertoire->model == MalariaStrains::FALCIPARUM_STRAIN_GENERATOR && repertoire->strain_id >= 0);
+            if (library_strain)
+            {
+                // a block with other variant counts generates other antigens, so keep the saved ones private
+                RepertoirePtr shared = intern(params, repertoire->model, repertoire->strain_id);
+                if (shared->SameAntigens(*repertoire))
+                {
+                    return shared;
+                }
+            }
+
+            return repertoire;
+        }
+
+        size_t StrainLibrary::GetSize()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return strains.size();
+        }
+
+        void StrainLibrary::Clear()
+        {
+            // infections hold their own references, so clearing only stops further sharing
+            std::lock_guard<std::mutex> lock(mutex);
+            strains.clear();
+        }
+
+    }
+
+}
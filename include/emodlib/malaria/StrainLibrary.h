@@ -0,0 +1,83 @@
+/**
+ * @file StrainLibrary.h
+ *
+ * @brief Shared immutable antigenic repertoires of malaria strains
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+#include "Malaria.h"
+#include "MalariaEnums.h"
+#include "MalariaParams.h"
+
+
+namespace emodlib
+{
+
+    class RANDOMBASE;
+    class BinaryWriter;
+    class BinaryReader;
+
+    namespace malaria
+    {
+
+        // Antigenic repertoire of a strain: its MSP type and the minor and major epitopes of its PfEMP1 variants
+        struct Repertoire
+        {
+            MalariaStrains::Enum model;
+            int32_t strain_id;  // id within the strain model, or -1 for a repertoire drawn for one infection
+
+            int32_t MSPtype;
+            int32_t nonspectype;
+            int32_t minor_epitope_type[CLONAL_PfEMP1_VARIANTS];
+            int32_t IRBCtype[CLONAL_PfEMP1_VARIANTS];
+
+            bool SameAntigens(const Repertoire& other) const;
+        };
+
+        typedef std::shared_ptr<const Repertoire> RepertoirePtr;
+
+
+        // Process-wide store of interned repertoires, so that infections of the same strain share one copy:
+        //   FALCIPARUM_NONRANDOM_STRAIN  a single strain with MSP type 0 and PfEMP1 variants 0..49
+        //   FALCIPARUM_RANDOM50_STRAIN   a fresh draw per infection, PfEMP1 variants limited to the first 50
+        //   FALCIPARUM_RANDOM_STRAIN     a fresh draw per infection over all variants (default)
+        //   FALCIPARUM_STRAIN_GENERATOR  one repertoire per strain id, generated from the id alone
+        class StrainLibrary
+        {
+
+        public:
+
+            // Repertoire of a new infection with strain_id under the block's strain model,
+            // drawing from rng only for the random models
+            static RepertoirePtr Get(const IntrahostParams* params, int strain_id, RANDOMBASE* rng);
+
+            // Restored library strains are shared again if the library still generates the same antigens
+            static void Serialize(const Repertoire& repertoire, BinaryWriter& writer);
+            static RepertoirePtr Deserialize(BinaryReader& reader, const IntrahostParams* params);
+
+            static size_t GetSize();
+            static void Clear();
+
+        private:
+
+            // (model, MSP variants, nonspecific types, PfEMP1 variants, strain id)
+            typedef std::tuple<int, int, int, int, int> Key;
+
+            static std::mutex mutex;
+            static std::map<Key, RepertoirePtr> strains;
+
+            static RepertoirePtr intern(const IntrahostParams* params, MalariaStrains::Enum model, int strain_id);
+            static Repertoire generate(const IntrahostParams* params, MalariaStrains::Enum model, int strain_id);
+            static void draw(Repertoire& repertoire, RANDOMBASE* rng, int MSP_vars, int nonspec_types, int PfEMP1_vars);
+
+        };
+
+    }
+
+}
@@ -7,8 +7,11 @@
 #include "SusceptibilityMalaria.h"
 
 #include <iostream>
+#include <stdexcept>
 
+#include "emodlib/utils/BinaryArchive.h"
 #include "emodlib/utils/Common.h"
+#include "emodlib/utils/Instrumentation.h"
 #include "emodlib/utils/Sigmoid.h"
 #include "Malaria.h"
 
@@ -21,51 +24,10 @@ namespace emodlib
     namespace malaria
     {
 
-        float  Susceptibility::params::memory_level                      = 0.2f;
-        float  Susceptibility::params::hyperimmune_decay_rate            = 0.0f;
-        float  Susceptibility::params::MSP1_antibody_growthrate          = 0.02f;
-        float  Susceptibility::params::antibody_stimulation_c50          = 10.0f;
-        float  Susceptibility::params::antibody_capacity_growthrate      = 0.1f;
-        float  Susceptibility::params::minimum_adapted_response          = 0.02f;
-        float  Susceptibility::params::non_specific_growth               = 0.5f;
-        float  Susceptibility::params::antibody_csp_decay_days           = DEFAULT_ANTIBODY_CSP_DECAY_DAYS;
-
-        // TODO: emodlib#9 (maternal antibody init) + emodlib#8 (boost + enums)
-        // bool   Susceptibility::params::enable_maternal_antibodies_transmission  = false;
-        // MaternalAntibodiesType::Enum Susceptibility::params::maternal_antibodies_type = MaternalAntibodiesType::OFF;
-        // float  Susceptibility::params::maternal_antibody_protection      = 0.1f;
-        float  Susceptibility::params::maternal_antibody_decay_rate      = 0.01f;
-
-        // TODO: emodlib#9 (innate heterogeneity init) + emodlib#8 (boost + enums)
-        // InnateImmuneVariationType::Enum Susceptibility::params::innate_immune_variation_type = InnateImmuneVariationType::NONE;
-        float  Susceptibility::params::pyrogenic_threshold               = 1000.0f;
-        float  Susceptibility::params::fever_IRBC_killrate               = DEFAULT_FEVER_IRBC_KILL_RATE;
-
-        float  Susceptibility::params::erythropoiesis_anemia_effect      = 3.5f;
-
-
-        void Susceptibility::params::Configure(const ParamSet& pset)
-        {
-            memory_level = pset["Antibody_Memory_Level"].cast<float>();
-            hyperimmune_decay_rate = -log((0.4f - memory_level) / (1.0f - memory_level)) / 120.0f;  // This sets the decay rate towards memory level so that the decay from antibody levels of 1 to levels of 0.4 is consistent
-            MSP1_antibody_growthrate = pset["Max_MSP1_Antibody_Growthrate"].cast<float>();
-            antibody_stimulation_c50 = pset["Antibody_Stimulation_C50"].cast<float>();
-            antibody_capacity_growthrate = pset["Antibody_Capacity_Growth_Rate"].cast<float>();
-            minimum_adapted_response = pset["Min_Adapted_Response"].cast<float>();
-            non_specific_growth = pset["Nonspecific_Antibody_Growth_Rate_Factor"].cast<float>();
-            antibody_csp_decay_days = pset["Antibody_CSP_Decay_Days"].cast<float>();
-
-            maternal_antibody_decay_rate = pset["Maternal_Antibody_Decay_Rate"].cast<float>();
-
-            pyrogenic_threshold = pset["Pyrogenic_Threshold"].cast<float>();
-            fever_IRBC_killrate = pset["Fever_IRBC_Kill_Rate"].cast<float>();
-
-            erythropoiesis_anemia_effect = pset["Erythropoiesis_Anemia_Effect"].cast<float>();
-        }
-
-
         Susceptibility::Susceptibility()
-            : age(0)
+            : m_params(nullptr)
+
+            , age(0)
 
             , m_antigenic_flag(0)
             , m_maternal_antibody_strength(0)
@@ -77,27 +39,170 @@ namespace emodlib
             , m_RBC(0)
             , m_RBCcapacity(0)
             , m_RBCproduction(0)
-            , m_inv_microliters_blood(0.0f)  // assigned in Initialize() as function of age
+            , m_inv_microliters_blood(0)  // assigned in Initialize() as function of age
 
-            , m_cytokines(0.0f)
-            , m_ind_pyrogenic_threshold(0.0f)
-            , m_ind_fever_kill_rate(0.0f)
-            , m_cytokine_stimulation(0.0f)
-            , m_parasite_density(0.0f)
+            , m_cytokines(0)
+            , m_ind_pyrogenic_threshold(0)
+            , m_ind_fever_kill_rate(0)
+            , m_cytokine_stimulation(0)
+            , m_parasite_density(0)
         {
 
         }
 
-        Susceptibility* Susceptibility::Create()
+        Susceptibility* Susceptibility::Create(IntrahostParamsPtr _params)
         {
             Susceptibility *newsusceptibility = new Susceptibility();
-            newsusceptibility->Initialize();
+            newsusceptibility->Initialize(_params ? _params : IntrahostParams::GetDefaults());
 
             return newsusceptibility;
         }
 
-        void Susceptibility::Initialize()
+        Susceptibility::~Susceptibility()
+        {
+            delete m_CSP_antibody;
+
+            for (auto antibody : m_active_MSP_antibodies) delete antibody;
+            for (auto antibody : m_active_PfEMP1_minor_antibodies) delete antibody;
+            for (auto antibody : m_active_PfEMP1_major_antibodies) delete antibody;
+        }
+
+        static void SerializeAntibody(BinaryWriter& writer, const IMalariaAntibody* antibody)
+        {
+            writer.Write<int32_t>(antibody->GetAntibodyVariant());
+            writer.Write<real_t>(antibody->GetAntibodyCapacity());
+            writer.Write<real_t>(antibody->GetAntibodyConcentration());
+            writer.Write<int64_t>(antibody->GetAntigenCount());
+            writer.Write<uint8_t>(antibody->GetAntigenicPresence() ? 1 : 0);
+        }
+
+        static void DeserializeAntibody(BinaryReader& reader, IMalariaAntibody* antibody)
+        {
+            antibody->SetAntibodyCapacity(reader.Read<real_t>());
+            antibody->SetAntibodyConcentration(reader.Read<real_t>());
+            antibody->ResetCounters();
+            antibody->IncreaseAntigenCount(reader.Read<int64_t>());
+            antibody->SetAntigenicPresence(reader.Read<uint8_t>() != 0);
+        }
+
+        static void CopyAntibody(const IMalariaAntibody* from, IMalariaAntibody* to)
+        {
+            to->SetAntibodyCapacity(from->GetAntibodyCapacity());
+            to->SetAntibodyConcentration(from->GetAntibodyConcentration());
+            to->ResetCounters();
+            to->IncreaseAntigenCount(from->GetAntigenCount());
+            to->SetAntigenicPresence(from->GetAntigenicPresence());
+        }
+
+        Susceptibility* Susceptibility::Clone(AntibodyMap& antibody_map) const
         {
+            Susceptibility *s = new Susceptibility(*this);  // scalar state, sharing the immutable parameter block
+
+            s->m_CSP_antibody = MalariaAntibodyCSP::CreateAntibody(&m_params->susceptibility, m_CSP_antibody->GetAntibodyVariant());
+            CopyAntibody(m_CSP_antibody, s->m_CSP_antibody);
+            antibody_map[m_CSP_antibody] = s->m_CSP_antibody;
+
+            typedef IMalariaAntibody* (*create_antibody_t)(const SusceptibilityParams*, int, real_t);
+            struct { const std::vector<IMalariaAntibody*>* from; std::vector<IMalariaAntibody*>* to; create_antibody_t create; } lists[] = {
+                { &m_active_MSP_antibodies, &s->m_active_MSP_antibodies, MalariaAntibodyMSP::CreateAntibody },
+                { &m_active_PfEMP1_minor_antibodies, &s->m_active_PfEMP1_minor_antibodies, MalariaAntibodyPfEMP1Minor::CreateAntibody },
+                { &m_active_PfEMP1_major_antibodies, &s->m_active_PfEMP1_major_antibodies, MalariaAntibodyPfEMP1Major::CreateAntibody },
+            };
+
+            for (const auto& list : lists)
+            {
+                // same order as ours, since the immune updates iterate these lists in order
+                list.to->clear();
+                list.to->reserve(list.from->size());
+                for (auto* antibody : *list.from)
+                {
+                    IMalariaAntibody* copy = list.create(&m_params->susceptibility, antibody->GetAntibodyVariant(), 0);
+                    CopyAntibody(antibody, copy);
+                    list.to->push_back(copy);
+                    antibody_map[antibody] = copy;
+                }
+            }
+
+            return s;
+        }
+
+        void Susceptibility::Serialize(BinaryWriter& writer) const
+        {
+            writer.Write<float>(age);
+
+            writer.Write<int32_t>(m_antigenic_flag);
+            writer.Write<real_t>(m_maternal_antibody_strength);
+
+            writer.Write<int64_t>(m_RBC);
+            writer.Write<int64_t>(m_RBCcapacity);
+            writer.Write<int64_t>(m_RBCproduction);
+            writer.Write<real_t>(m_inv_microliters_blood);
+
+            writer.Write<real_t>(m_cytokines);
+            writer.Write<real_t>(m_ind_pyrogenic_threshold);
+            writer.Write<real_t>(m_ind_fever_kill_rate);
+            writer.Write<real_t>(m_cytokine_stimulation);
+            writer.Write<real_t>(m_parasite_density);
+
+            SerializeAntibody(writer, m_CSP_antibody);
+
+            // Registration order is kept, since the immune updates iterate these lists in order
+            for (auto* antibodies : { &m_active_MSP_antibodies, &m_active_PfEMP1_minor_antibodies, &m_active_PfEMP1_major_antibodies })
+            {
+                writer.Write<uint32_t>(uint32_t(antibodies->size()));
+                for (auto* antibody : *antibodies) SerializeAntibody(writer, antibody);
+            }
+        }
+
+        Susceptibility* Susceptibility::Deserialize(BinaryReader& reader, IntrahostParamsPtr _params)
+        {
+            Susceptibility *s = new Susceptibility();
+            s->m_params = _params ? _params : IntrahostParams::GetDefaults();
+
+            try
+            {
+                s->age = reader.Read<float>();
+
+                s->m_antigenic_flag = reader.Read<int32_t>();
+                s->m_maternal_antibody_strength = reader.Read<real_t>();
+
+                s->m_RBC = reader.Read<int64_t>();
+                s->m_RBCcapacity = reader.Read<int64_t>();
+                s->m_RBCproduction = reader.Read<int64_t>();
+                s->m_inv_microliters_blood = reader.Read<real_t>();
+
+                s->m_cytokines = reader.Read<real_t>();
+                s->m_ind_pyrogenic_threshold = reader.Read<real_t>();
+                s->m_ind_fever_kill_rate = reader.Read<real_t>();
+                s->m_cytokine_stimulation = reader.Read<real_t>();
+                s->m_parasite_density = reader.Read<real_t>();
+
+                s->m_CSP_antibody = MalariaAntibodyCSP::CreateAntibody(&s->m_params->susceptibility, reader.Read<int32_t>());
+                DeserializeAntibody(reader, s->m_CSP_antibody);
+
+                MalariaAntibodyType::Enum types[] = { MalariaAntibodyType::MSP1, MalariaAntibodyType::PfEMP1_minor, MalariaAntibodyType::PfEMP1_major };
+                for (auto type : types)
+                {
+                    uint32_t count = reader.Read<uint32_t>();
+                    for (uint32_t i = 0; i < count; i++)
+                    {
+                        DeserializeAntibody(reader, s->RegisterAntibody(type, reader.Read<int32_t>()));
+                    }
+                }
+            }
+            catch (...)
+            {
+                delete s;
+                throw;
+            }
+
+            return s;
+        }
+
+        void Susceptibility::Initialize(IntrahostParamsPtr _params)
+        {
+            m_params = _params;
+
             age = 20 * DAYSPERYEAR;  // TODO: emodlib#10 (demographic components)
 
             // TODO: emodlib#10 (transmission components)
@@ -108,20 +213,20 @@ namespace emodlib
 
             // Track individual pyrogenic thresholds + fever killing rates as instance variables
             // TODO: emodlib#9 (innate heterogeneity init)
-            m_ind_pyrogenic_threshold = params::pyrogenic_threshold;
-            m_ind_fever_kill_rate = params::fever_IRBC_killrate;
+            m_ind_pyrogenic_threshold = m_params->susceptibility.pyrogenic_threshold;
+            m_ind_fever_kill_rate = m_params->susceptibility.fever_IRBC_killrate;
 
             // TODO: emodlib#9 (maternal antibody init)
 
-            m_CSP_antibody = MalariaAntibodyCSP::CreateAntibody(0);
+            m_CSP_antibody = MalariaAntibodyCSP::CreateAntibody(&m_params->susceptibility, 0);
 
             // MSP + PfEMP1 antibodies are added upon infection
         }
 
-        IMalariaAntibody* Susceptibility::RegisterAntibody(MalariaAntibodyType::Enum type, int variant, float capacity)
+        IMalariaAntibody* Susceptibility::RegisterAntibody(MalariaAntibodyType::Enum type, int variant, real_t capacity)
         {
             std::vector<IMalariaAntibody*> *variant_vector;
-            IMalariaAntibody* (*typed_create_antibody)(int,float);
+            IMalariaAntibody* (*typed_create_antibody)(const SusceptibilityParams*,int,real_t);
 
             switch( type )
             {
@@ -160,7 +265,7 @@ namespace emodlib
 
             if (antibody == nullptr) // make a new antibody if it hasn't been created yet
             {
-                antibody = typed_create_antibody(variant, capacity);
+                antibody = typed_create_antibody(&m_params->susceptibility, variant, capacity);
                 variant_vector->push_back(antibody);
             }
 
@@ -180,27 +285,29 @@ namespace emodlib
             }
         }
 
-        void Susceptibility::remove_RBCs(int64_t infectedAsexual, int64_t infectedGametocytes, double RBC_destruction_multiplier)
+        void Susceptibility::remove_RBCs(int64_t infectedAsexual, int64_t infectedGametocytes, real_t RBC_destruction_multiplier)
         {
             m_RBC -= ( int64_t(infectedAsexual*RBC_destruction_multiplier) + infectedGametocytes );
         }
 
         void Susceptibility::Update(float dt)
         {
+            EMODLIB_PHASE(SusceptibilityUpdate);
+
             age += dt;
 
             recalculateBloodCapacity(age);
 
             // Red blood cell dynamics
-            if (Susceptibility::params::erythropoiesis_anemia_effect > 0)
+            if (m_params->susceptibility.erythropoiesis_anemia_effect > 0)
             {
                 // This is the amount of "erythropoietin", assume absolute amounts of erythropoietin correlate linearly with absolute increases in hemoglobin
-                float anemia_erythropoiesis_multiplier = exp( Susceptibility::params::erythropoiesis_anemia_effect * (1 - get_RBC_availability()) );
-                m_RBC = int64_t(m_RBC - (m_RBC * .00833 - m_RBCproduction * anemia_erythropoiesis_multiplier) * dt); // *.00833 ==/120 (AVERAGE_RBC_LIFESPAN)
+                real_t anemia_erythropoiesis_multiplier = exp( m_params->susceptibility.erythropoiesis_anemia_effect * (1 - get_RBC_availability()) );
+                m_RBC = int64_t(m_RBC - (m_RBC * real_t(.00833) - m_RBCproduction * anemia_erythropoiesis_multiplier) * dt); // *.00833 ==/120 (AVERAGE_RBC_LIFESPAN)
             }
             else
             {
-                m_RBC = int64_t(m_RBC - (m_RBC * .00833 - m_RBCproduction) * dt); // *.00833 ==/120 (AVERAGE_RBC_LIFESPAN)
+                m_RBC = int64_t(m_RBC - (m_RBC * real_t(.00833) - m_RBCproduction) * dt); // *.00833 ==/120 (AVERAGE_RBC_LIFESPAN)
             }
 
             // Cytokines decay with time constant of 12 hours
@@ -211,7 +318,7 @@ namespace emodlib
             m_parasite_density = 0; // this is accumulated in updateImmunityPfEMP1Minor
 
             // decay maternal antibodies
-            m_maternal_antibody_strength -= dt * m_maternal_antibody_strength * Susceptibility::params::maternal_antibody_decay_rate;
+            m_maternal_antibody_strength -= dt * m_maternal_antibody_strength * m_params->susceptibility.maternal_antibody_decay_rate;
             if ( m_maternal_antibody_strength < 0 ) { m_maternal_antibody_strength = 0; }
 
             // antibody capacities increase and antibodies released if antigen present, only process if antigens are present at all
@@ -228,7 +335,7 @@ namespace emodlib
             else
             {
                 // Update antigen-antibody reactions for MSP and PfEMP1 minor/major epitopes, including cytokine stimulation
-                float temp_cytokine_stimulation = 0; // used to track total stimulation of cytokines due to rupturing schizonts
+                real_t temp_cytokine_stimulation = 0; // used to track total stimulation of cytokines due to rupturing schizonts
                 updateImmunityMSP(dt, temp_cytokine_stimulation);
                 updateImmunityPfEMP1Minor(dt);
                 updateImmunityPfEMP1Major(dt);
@@ -236,8 +343,8 @@ namespace emodlib
                 // inflammatory immune response--Stevenson, M. M. and E. M. Riley (2004). "Innate immunity to malaria." Nat Rev Immunol 4(3): 169-180.
                 // now let cytokine be increased in response to IRBCs and ruptured schizonts, if any
                 // pyrogenic threshold similar to previous models--(Molineaux, Diebner et al. 2001; Paget-McNicol, Gatton et al. 2002; Maire, Smith et al. 2006)
-                m_cytokines = float(m_cytokines + CYTOKINE_STIMULATION_SCALE * Sigmoid::basic_sigmoid(m_ind_pyrogenic_threshold, m_cytokine_stimulation) * dt * 2);//12-hour time constant
-                m_cytokines = float(m_cytokines + CYTOKINE_STIMULATION_SCALE * Sigmoid::basic_sigmoid(m_ind_pyrogenic_threshold, temp_cytokine_stimulation));//one time spike for rupturing schizonts
+                m_cytokines = m_cytokines + real_t(CYTOKINE_STIMULATION_SCALE) * Sigmoid::basic_sigmoid(m_ind_pyrogenic_threshold, m_cytokine_stimulation) * dt * 2;//12-hour time constant
+                m_cytokines = m_cytokines + real_t(CYTOKINE_STIMULATION_SCALE) * Sigmoid::basic_sigmoid(m_ind_pyrogenic_threshold, temp_cytokine_stimulation);//one time spike for rupturing schizonts
                 m_cytokine_stimulation = 0; // and reset for next time step
 
                 // reset antigenic presence and IRBC counters
@@ -268,14 +375,14 @@ namespace emodlib
             {
                 // 2.0*10^11 (RBCs/day)*(120 days)=2.4x10^13 RBCs ~= 5 liters * 5x10^6 RBCs/microliter
                 m_RBCproduction         = ADULT_RBC_PRODUCTION;
-                m_inv_microliters_blood = float(1 / ( (0.225 * (7300/DAYSPERYEAR) + 0.5) * 1e6 ));
+                m_inv_microliters_blood = real_t(1 / ( (0.225 * (7300/DAYSPERYEAR) + 0.5) * 1e6 ));
             }
             else
             {
                 // Sets daily production of red blood cells for children to set their equilibrium RBC concentrations and blood volume given an RBC lifetime
                 // Only approximate due to linear increase in blood volume from 0.5 to 5 liters with age, a better growth model would be nonlinear
                 m_RBCproduction         = int64_t(INFANT_RBC_PRODUCTION + (_age * .000137) * (ADULT_RBC_PRODUCTION - INFANT_RBC_PRODUCTION)); //*.000137==/(20*DAYSPERYEAR)
-                m_inv_microliters_blood = float(1 / ( (0.225 * (_age/DAYSPERYEAR) + 0.5 ) * 1e6 ));
+                m_inv_microliters_blood = real_t(1 / ( (0.225 * (_age/DAYSPERYEAR) + 0.5 ) * 1e6 ));
             }
 
             m_RBCcapacity = m_RBCproduction * AVERAGE_RBC_LIFESPAN;  // Health equilibrium of RBC is production*lifetime.  This is the total number of RBC per human
@@ -283,6 +390,8 @@ namespace emodlib
 
         void Susceptibility::updateImmunityCSP( float dt )
         {
+            EMODLIB_PHASE(UpdateImmunityCSP);
+
             if ( !m_CSP_antibody->GetAntigenicPresence() )
             {
                 m_CSP_antibody->Decay( dt );
@@ -290,16 +399,18 @@ namespace emodlib
             }
 
             // Hyper-immune response (could potentially keep this as part of the update in ExposeToInfectivity)
-            if (m_CSP_antibody->GetAntibodyCapacity() > 0.4)
+            if (m_CSP_antibody->GetAntibodyCapacity() > real_t(0.4))
             {
-                m_CSP_antibody->UpdateAntibodyCapacityByRate( dt, 0.33f );
+                m_CSP_antibody->UpdateAntibodyCapacityByRate( dt, real_t(0.33) );
             }
 
             m_CSP_antibody->UpdateAntibodyConcentration( dt );
         }
 
-        void Susceptibility::updateImmunityMSP( float dt, float& temp_cytokine_stimulation )
+        void Susceptibility::updateImmunityMSP( float dt, real_t& temp_cytokine_stimulation )
         {
+            EMODLIB_PHASE(UpdateImmunityMSP);
+
             // Merozoite-specific immunity
             // Blackman, M. J., H. G. Heidrich, et al. (1990).
             // "A single fragment of a malaria merozoite surface protein remains on the parasite during
@@ -324,6 +435,8 @@ namespace emodlib
 
         void Susceptibility::updateImmunityPfEMP1Minor( float dt )
         {
+            EMODLIB_PHASE(UpdateImmunityPfEMP1Minor);
+
             // Minor epitope IRBC antigens
             // Recker, M., S. Nee, et al. (2004).
             // "Transient cross-reactive immune responses can orchestrate antigenic variation in malaria."
@@ -341,12 +454,14 @@ namespace emodlib
                 antibody->UpdateAntibodyConcentration( dt );
 
                 // Accumulate parasite density
-                m_parasite_density += float(antibody->GetAntigenCount()) * m_inv_microliters_blood;
+                m_parasite_density += real_t(antibody->GetAntigenCount()) * m_inv_microliters_blood;
             }
         }
 
         void Susceptibility::updateImmunityPfEMP1Major( float dt )
         {
+            EMODLIB_PHASE(UpdateImmunityPfEMP1Major);
+
             for (auto antibody : m_active_PfEMP1_major_antibodies)
             {
                 if ( !antibody->GetAntigenicPresence() )
@@ -356,7 +471,7 @@ namespace emodlib
                 }
 
                 // Cytokines released at low antibody concentration (if capacity hasn't switched into high proliferation rate yet)
-                if ( antibody->GetAntibodyCapacity() <= 0.4 )
+                if ( antibody->GetAntibodyCapacity() <= real_t(0.4) )
                 {
                     m_cytokine_stimulation += antibody->StimulateCytokines( dt, m_inv_microliters_blood );
                 }
@@ -368,6 +483,8 @@ namespace emodlib
 
         void Susceptibility::decayAllAntibodies( float dt )
         {
+            EMODLIB_PHASE(DecayAllAntibodies);
+
             // CSP handled outside check for any active infection
 
             for (auto antibody : m_active_MSP_antibodies)
@@ -396,48 +513,68 @@ namespace emodlib
             return m_RBC;
         }
 
-        float Susceptibility::get_inv_microliters_blood() const
+        real_t Susceptibility::get_inv_microliters_blood() const
         {
             return m_inv_microliters_blood;
         }
 
-        double Susceptibility::get_RBC_availability() const
+        real_t Susceptibility::get_RBC_availability() const
         {
-            return (m_RBCcapacity > 0) ? (double(m_RBC) / m_RBCcapacity) : 0.0;
+            return (m_RBCcapacity > 0) ? (real_t(m_RBC) / m_RBCcapacity) : 0;
         }
 
         // Fever tracks the level of cytokines
         // This changes a limited cytokine range to more closely match the range of fevers experienced by patients
-        float Susceptibility::get_fever() const
+        real_t Susceptibility::get_fever() const
         {
             return FEVER_DEGREES_CELSIUS_PER_UNIT_CYTOKINES * m_cytokines;
         }
 
-        float Susceptibility::get_fever_celsius() const
+        real_t Susceptibility::get_fever_celsius() const
         {
-            return 37.0f + get_fever();
+            return real_t(37) + get_fever();
         }
 
-        float Susceptibility::get_cytokines() const
+        real_t Susceptibility::get_cytokines() const
         {
             return m_cytokines;
         }
 
-        float Susceptibility::get_fever_killing_rate() const
+        real_t Susceptibility::get_fever_killing_rate() const
         {
             return m_ind_fever_kill_rate;
         }
 
-        float Susceptibility::get_parasite_density() const
+        real_t Susceptibility::get_parasite_density() const
         {
             return m_parasite_density;
         }
 
-        float Susceptibility::get_maternal_antibodies() const
+        real_t Susceptibility::get_maternal_antibodies() const
         {
             return m_maternal_antibody_strength;
         }
 
+        int Susceptibility::get_num_antibodies() const
+        {
+            return 1 + int(m_active_MSP_antibodies.size() + m_active_PfEMP1_minor_antibodies.size() + m_active_PfEMP1_major_antibodies.size());
+        }
+
+        real_t Susceptibility::get_PfEMP1_major_breadth() const
+        {
+            real_t capacity = 0;
+            for (auto antibody : m_active_PfEMP1_major_antibodies)
+            {
+                capacity += antibody->GetAntibodyCapacity();
+            }
+            return capacity / m_params->falciparumPfEMP1Vars;
+        }
+
+        const IntrahostParams* Susceptibility::get_params() const
+        {
+            return m_params.get();
+        }
+
         float Susceptibility::get_age() const
         {
             return age;
@@ -448,32 +585,32 @@ namespace emodlib
             age = _age;
         }
 
-        float Susceptibility::get_maternal_antibody_strength() const
+        real_t Susceptibility::get_maternal_antibody_strength() const
         {
             return m_maternal_antibody_strength;
         }
 
-        void Susceptibility::set_maternal_antibody_strength(float _matAb)
+        void Susceptibility::set_maternal_antibody_strength(real_t _matAb)
         {
             m_maternal_antibody_strength = _matAb;
         }
 
-        float Susceptibility::get_pyrogenic_threshold() const
+        real_t Susceptibility::get_pyrogenic_threshold() const
         {
             return m_ind_pyrogenic_threshold;
         }
 
-        void Susceptibility::set_pyrogenic_threshold(float _threshold)
+        void Susceptibility::set_pyrogenic_threshold(real_t _threshold)
         {
             m_ind_pyrogenic_threshold = _threshold;
         }
 
-        float Susceptibility::get_fever_kill_rate() const
+        real_t Susceptibility::get_fever_kill_rate() const
         {
             return m_ind_fever_kill_rate;
         }
 
-        void Susceptibility::set_fever_kill_rate(float _rate)
+        void Susceptibility::set_fever_kill_rate(real_t _rate)
         {
             m_ind_fever_kill_rate = _rate;
         }
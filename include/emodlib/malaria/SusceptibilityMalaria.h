@@ -6,15 +6,20 @@
 
 #pragma once
 
-#include "emodlib/ParamSet.h"
+#include <unordered_map>
+#include <vector>
 
 #include "MalariaEnums.h"
+#include "MalariaParams.h"
 #include "IMalariaAntibody.h"
 
 
 namespace emodlib
 {
 
+    class BinaryWriter;
+    class BinaryReader;
+
     namespace malaria
     {
 
@@ -23,74 +28,57 @@ namespace emodlib
 
         public:
 
-            struct params
-            {
-                // Used in MalariaAntibody for boost-decay functions
-                static float memory_level;
-                static float hyperimmune_decay_rate;
-                static float MSP1_antibody_growthrate;
-                static float antibody_stimulation_c50;
-                static float antibody_capacity_growthrate;
-                static float minimum_adapted_response;
-                static float non_specific_growth;
-                static float antibody_csp_decay_days;
-
-                // Used in Susceptibility for:
-                // ...maternal protection
-                // static bool enable_maternal_antibodies_transmission;
-                // static MaternalAntibodiesType::Enum maternal_antibodies_type; // TODO: emodlib#9 (innate init)
-                // static float maternal_antibody_protection;
-                static float maternal_antibody_decay_rate;
-
-                // ...innate immunity effects
-                // static InnateImmuneVariationType::Enum innate_immune_variation_type; // TODO: emodlib#9 (innate init)
-                static float pyrogenic_threshold;
-                static float fever_IRBC_killrate;
-
-                // ... red blood cell effects
-                static float erythropoiesis_anemia_effect;
-
-                static void Configure(const ParamSet& pset);
-            };
-
-
-            static Susceptibility *Create();
-            IMalariaAntibody* RegisterAntibody(MalariaAntibodyType::Enum type, int variant, float capacity=0.0f);
+            static Susceptibility *Create(IntrahostParamsPtr _params=nullptr);
+            ~Susceptibility();
+
+            void Serialize(BinaryWriter& writer) const;
+            static Susceptibility *Deserialize(BinaryReader& reader, IntrahostParamsPtr _params);
+
+            // Deep copy, recording which new antibody replaces each of ours so infections can be relinked
+            typedef std::unordered_map<const IMalariaAntibody*, IMalariaAntibody*> AntibodyMap;
+            Susceptibility *Clone(AntibodyMap& antibody_map) const;
+
+            IMalariaAntibody* RegisterAntibody(MalariaAntibodyType::Enum type, int variant, real_t capacity=0);
             void UpdateActiveAntibody( pfemp1_antibody_t &pfemp1_variant, int minor_variant, int major_variant );
-            void remove_RBCs(int64_t infectedAsexual, int64_t infectedGametocytes, double RBC_destruction_multiplier);
+            void remove_RBCs(int64_t infectedAsexual, int64_t infectedGametocytes, real_t RBC_destruction_multiplier);
 
             void Update(float dt);
             void SetAntigenPresent();
 
             long long get_RBC_count() const;
-            float get_inv_microliters_blood() const;
-            double get_RBC_availability() const;
-            float get_fever() const;
-            float get_fever_celsius() const;
-            float get_cytokines() const;
-            float get_fever_killing_rate() const;
-            float get_parasite_density() const;
-            float get_maternal_antibodies() const;
+            real_t get_inv_microliters_blood() const;
+            real_t get_RBC_availability() const;
+            real_t get_fever() const;
+            real_t get_fever_celsius() const;
+            real_t get_cytokines() const;
+            real_t get_fever_killing_rate() const;
+            real_t get_parasite_density() const;
+            real_t get_maternal_antibodies() const;
+            int get_num_antibodies() const;
+            real_t get_PfEMP1_major_breadth() const;  // mean capacity over every major variant there is, from 0 to 1
+            const IntrahostParams* get_params() const;
 
             float get_age() const;
             void set_age(float _age);
 
-            float get_maternal_antibody_strength() const;
-            void set_maternal_antibody_strength(float _matAb);
+            real_t get_maternal_antibody_strength() const;
+            void set_maternal_antibody_strength(real_t _matAb);
 
-            float get_pyrogenic_threshold() const;
-            void set_pyrogenic_threshold(float _threshold);
+            real_t get_pyrogenic_threshold() const;
+            void set_pyrogenic_threshold(real_t _threshold);
 
-            float get_fever_kill_rate() const;
-            void set_fever_kill_rate(float _rate);
+            real_t get_fever_kill_rate() const;
+            void set_fever_kill_rate(real_t _rate);
 
         private:
 
+            IntrahostParamsPtr m_params;  // shared with the host's infections and antibodies
+
             float age;  // TODO: emodlib#10 (demographic components)
 
             // containers for antibody objects
             int32_t m_antigenic_flag;
-            float m_maternal_antibody_strength;
+            real_t m_maternal_antibody_strength;
             IMalariaAntibody* m_CSP_antibody;
             std::vector<IMalariaAntibody*> m_active_MSP_antibodies;
             std::vector<IMalariaAntibody*> m_active_PfEMP1_minor_antibodies;
@@ -100,22 +88,22 @@ namespace emodlib
             int64_t m_RBC;
             int64_t m_RBCcapacity;
             int64_t m_RBCproduction;   // how many RBC's a person should have /120 (AVERAGE_RBC_LIFESPAN)
-            float   m_inv_microliters_blood; // ==/(age dependent estimate of blood volume)
+            real_t  m_inv_microliters_blood; // ==/(age dependent estimate of blood volume)
 
             // symptomatic variables
-            float m_cytokines;
-            float m_ind_pyrogenic_threshold;
-            float m_ind_fever_kill_rate;
-            float m_cytokine_stimulation;
-            float m_parasite_density;
+            real_t m_cytokines;
+            real_t m_ind_pyrogenic_threshold;
+            real_t m_ind_fever_kill_rate;
+            real_t m_cytokine_stimulation;
+            real_t m_parasite_density;
 
 
             Susceptibility();
-            void Initialize();  // TODO: emodlib#9 (innate init) + emodlib#10 (demographic/transmission components)
+            void Initialize(IntrahostParamsPtr _params);  // TODO: emodlib#9 (innate init) + emodlib#10 (demographic/transmission components)
 
             void recalculateBloodCapacity( float _age );
             void updateImmunityCSP( float dt );
-            void updateImmunityMSP( float dt, float& temp_cytokine_stimulation );
+            void updateImmunityMSP( float dt, real_t& temp_cytokine_stimulation );
             void updateImmunityPfEMP1Minor( float dt );
             void updateImmunityPfEMP1Major( float dt );
             void decayAllAntibodies( float dt );
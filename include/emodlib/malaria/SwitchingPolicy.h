@@ -0,0 +1,56 @@
+/**
+ * @file SwitchingPolicy.h
+ *
+ * @brief Compile-time antigen switching policies
+ */
+
+#pragma once
+
+#include "Malaria.h"
+#include "MalariaEnums.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        // Where the IRBCs of one PfEMP1 variant switch to at the end of an asexual cycle, fixed at compile time
+        // so that the switching kernel runs constant trip counts without branching on the switch type per variant.
+        // Switchers land on the n_targets variants following their own, the i-th receiving weight(i) of the switch rate.
+        template<ParasiteSwitchType::Enum Type>
+        struct SwitchingPolicy;
+
+        // A fixed fraction switches deterministically, split evenly between the next two variants
+        template<>
+        struct SwitchingPolicy<ParasiteSwitchType::CONSTANT_SWITCH_RATE_2VARS>
+        {
+            static const int n_targets = 2;
+            static const bool stochastic = false;
+            static constexpr double weight(int) { return 0.5; }
+        };
+
+        // Each of the next seven variants receives a Poisson number of switchers at the full rate
+        template<>
+        struct SwitchingPolicy<ParasiteSwitchType::RATE_PER_PARASITE_7VARS>
+        {
+            static const int n_targets = 7;
+            static const bool stochastic = true;
+            static constexpr double weight(int) { return 1.0; }
+        };
+
+        // As above over the next five variants, with the rate halving at each step away
+        template<>
+        struct SwitchingPolicy<ParasiteSwitchType::RATE_PER_PARASITE_5VARS_DECAYING>
+        {
+            static const int n_targets = 5;
+            static const bool stochastic = true;
+            static constexpr double weight(int iswitch) { return 1.0 / double(1 << iswitch); }
+        };
+
+        static_assert(CLONAL_PfEMP1_VARIANTS > 7, "Every switching policy needs more clonal PfEMP1 variants than switch targets");
+
+    }
+
+}
@@ -0,0 +1,454 @@
+/**
+ * @file TrajectoryWriter.cpp
+ *
+ * @brief Streaming per-host trajectory writer implementation
+ */
+
+#include "TrajectoryWriter.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "emodlib/utils/Tracer.h"
+
+#include "IntrahostComponent.h"
+#include "MalariaEnums.h"
+#include "Population.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        // Fixed-size headers, so that rewriting the shape never moves the data
+        static const size_t NPY_HEADER_SIZE = 128;
+
+        static std::string npy_header(const char* type, const std::string& shape)
+        {
+            uint16_t probe = 1;
+            char order = (*reinterpret_cast<const char*>(&probe) == 1) ? '<' : '>';
+
+            std::string header("\x93NUMPY\x01\x00", 8);
+            uint16_t length = uint16_t(NPY_HEADER_SIZE - 10);
+            header.push_back(char(length & 0xff));
+            header.push_back(char(length >> 8));
+            header += std::string("{'descr': '") + order + type + "', 'fortran_order': False, 'shape': " + shape + ", }";
+            header.append(NPY_HEADER_SIZE - 1 - header.size(), ' ');
+            header.push_back('\n');
+            return header;
+        }
+
+        static void write_all(std::FILE* file, const void* data, size_t size, const std::string& path)
+        {
+            if (size > 0 && std::fwrite(data, 1, size, file) != size)
+            {
+                throw std::runtime_error("Cannot write trajectories to " + path + ": " + strerror(errno));
+            }
+        }
+
+        static void write_header(std::FILE* file, const char* type, const std::string& shape, const std::string& path)
+        {
+            std::string header = npy_header(type, shape);
+            std::fseek(file, 0, SEEK_SET);
+            write_all(file, header.data(), header.size(), path);
+        }
+
+
+        TrajectoryWriter* TrajectoryWriter::Create(const std::string& path, const std::vector<int>& hosts, int steps_per_chunk,
+                                                   int chunks_in_flight, Backpressure::Enum backpressure)
+        {
+            if (hosts.empty())
+            {
+                throw std::invalid_argument("Trajectories need at least one host to record");
+            }
+            for (int index : hosts)
+            {
+                if (index < 0) throw std::out_of_range("Host index " + std::to_string(index) + " out of range");
+            }
+            if (steps_per_chunk < 1)
+            {
+                throw std::invalid_argument("Chunks need at least one step");
+            }
+            if (chunks_in_flight < 1)
+            {
+                throw std::invalid_argument("At least one chunk must be in flight");
+            }
+
+            std::unique_ptr<TrajectoryWriter> writer(new TrajectoryWriter(path, hosts, steps_per_chunk, chunks_in_flight, backpressure));
+            writer->open();
+            return writer.release();
+        }
+
+        TrajectoryWriter::TrajectoryWriter(const std::string& _path, const std::vector<int>& _hosts, int _steps_per_chunk,
+                                           int _chunks_in_flight, Backpressure::Enum _backpressure)
+            : path(_path)
+            , hosts(_hosts)
+            , steps_per_chunk(_steps_per_chunk)
+            , files()
+            , time(0)
+            , n_steps(0)
+            , ring(size_t(_chunks_in_flight))
+            , backpressure(_backpressure)
+            , scratch()
+            , current(nullptr)
+            , n_submitted(0)
+            , n_dropped(0)
+            , n_written(0)
+            , stopping(false)
+            , failed(false)
+            , error_mutex()
+            , error()
+            , thread()
+        {
+            for (Chunk& chunk : ring.Slots())
+            {
+                allocate(chunk);
+            }
+            allocate(scratch);
+            claim(false);
+        }
+
+        TrajectoryWriter::~TrajectoryWriter()
+        {
+            try
+            {
+                Close();
+            }
+            catch (...)
+            {
+                closeFiles();
+            }
+        }
+
+        const std::vector<std::string>& TrajectoryWriter::Channels()
+        {
+            static const std::vector<std::string> channels = {
+                "parasite_density",
+                "gametocyte_density",
+                "fever_temperature",
+                "infectiousness",
+            };
+            return channels;
+        }
+
+        void TrajectoryWriter::allocate(Chunk& chunk) const
+        {
+            chunk.n_steps = 0;
+            chunk.times.resize(steps_per_chunk);
+            chunk.columns.resize(size_t(TrajectoryChannel::Count) * steps_per_chunk * hosts.size());
+        }
+
+        void TrajectoryWriter::open()
+        {
+#ifdef _WIN32
+            int status = _mkdir(path.c_str());
+#else
+            int status = mkdir(path.c_str(), 0755);
+#endif
+            if (status != 0 && errno != EEXIST)
+            {
+                throw std::runtime_error("Cannot create " + path + ": " + strerror(errno));
+            }
+
+            std::vector<std::string> names = Channels();
+            names.push_back("times");
+
+            for (const std::string& name : names)
+            {
+                std::string file_path = path + "/" + name + ".npy";
+                std::FILE* file = std::fopen(file_path.c_str(), "wb+");
+                if (!file)
+                {
+                    closeFiles();
+                    throw std::runtime_error("Cannot open " + file_path + ": " + strerror(errno));
+                }
+                files.push_back(file);
+
+                // empty until the first chunk lands
+                std::string shape = (name == "times") ? "(0,)" : "(0, " + std::to_string(hosts.size()) + ")";
+                write_header(file, "f4", shape, file_path);
+                std::fflush(file);
+            }
+
+            std::string hosts_path = path + "/hosts.npy";
+            std::FILE* file = std::fopen(hosts_path.c_str(), "wb");
+            if (!file)
+            {
+                closeFiles();
+                throw std::runtime_error("Cannot open " + hosts_path + ": " + strerror(errno));
+            }
+            std::vector<int32_t> indices(hosts.begin(), hosts.end());
+            try
+            {
+                write_header(file, "i4", "(" + std::to_string(hosts.size()) + ",)", hosts_path);
+                write_all(file, indices.data(), sizeof(int32_t) * indices.size(), hosts_path);
+            }
+            catch (...)
+            {
+                std::fclose(file);
+                closeFiles();
+                throw;
+            }
+            std::fclose(file);
+
+            thread = std::thread(&TrajectoryWriter::run, this);
+        }
+
+        void TrajectoryWriter::Record(const Population& pop, float dt)
+        {
+            EMODLIB_TRACE_SCOPE("output", "TrajectoryWriter::Record");
+
+            checkError();
+            if (!thread.joinable())
+            {
+                throw std::logic_error("Trajectory writer for " + path + " is closed");
+            }
+
+            time += dt;
+
+            Chunk& chunk = *current;
+            size_t n_hosts = hosts.size();
+            size_t step = size_t(chunk.n_steps);
+            chunk.times[step] = time;
+
+            float* columns = chunk.columns.data();
+            size_t stride = size_t(steps_per_chunk) * n_hosts;  // between channels
+            for (size_t h = 0; h < n_hosts; h++)
+            {
+                const IntrahostComponent* host = pop.GetHost(hosts[h]);
+                float* record = columns + step * n_hosts + h;
+                record[TrajectoryChannel::ParasiteDensity * stride] = host->GetParasiteDensity();
+                record[TrajectoryChannel::GametocyteDensity * stride] = host->GetGametocyteDensity();
+                record[TrajectoryChannel::FeverTemperature * stride] = host->GetFeverTemperature();
+                record[TrajectoryChannel::Infectiousness * stride] = host->GetInfectiousness();
+            }
+
+            chunk.n_steps++;
+            n_steps++;
+
+            if (chunk.n_steps == steps_per_chunk)
+            {
+                submit(backpressure == Backpressure::Block);
+            }
+        }
+
+        void TrajectoryWriter::claim(bool wait)
+        {
+            Chunk* slot = ring.Claim();
+
+            RingBackoff backoff;
+            while (!slot && wait)
+            {
+                backoff.Wait();
+                slot = ring.Claim();
+            }
+
+            current = slot ? slot : &scratch;
+            current->n_steps = 0;
+        }
+
+        void TrajectoryWriter::submit(bool wait)
+        {
+            if (current == &scratch)
+            {
+                n_dropped += scratch.n_steps;
+            }
+            else
+            {
+                n_submitted += current->n_steps;
+                ring.Publish();
+            }
+            claim(wait);
+        }
+
+        void TrajectoryWriter::run()
+        {
+            Tracer::SetThreadName("trajectory writer");
+
+            RingBackoff backoff;
+            while (true)
+            {
+                Chunk* chunk = ring.Front();
+                if (!chunk)
+                {
+                    // nothing is published once stopping, so an empty ring stays empty
+                    if (stopping.load(std::memory_order_acquire) && ring.Empty()) break;
+                    backoff.Wait();
+                    continue;
+                }
+                backoff.Reset();
+
+                // after a failure, chunks are still drained so that the recording thread never waits forever
+                if (!failed.load(std::memory_order_relaxed))
+                {
+                    try
+                    {
+                        write(*chunk);
+                    }
+                    catch (const std::exception& e)
+                    {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        error = e.what();
+                        failed.store(true, std::memory_order_release);
+                    }
+                }
+
+                int n = chunk->n_steps;
+                ring.Pop();
+                n_written.fetch_add(n, std::memory_order_release);
+            }
+        }
+
+        void TrajectoryWriter::write(const Chunk& chunk)
+        {
+            int first_step = n_written.load(std::memory_order_relaxed);
+            EMODLIB_TRACE_SCOPE("output", "TrajectoryWriter::write", first_step, first_step + chunk.n_steps);
+
+            const std::vector<std::string>& names = Channels();
+            size_t n_hosts = hosts.size();
+            size_t stride = size_t(steps_per_chunk) * n_hosts;
+            std::string rows = std::to_string(first_step + chunk.n_steps);
+
+            for (int c = 0; c < TrajectoryChannel::Count; c++)
+            {
+                std::string file_path = path + "/" + names[c] + ".npy";
+                std::FILE* file = files[c];
+                std::fseek(file, 0, SEEK_END);
+                write_all(file, chunk.columns.data() + c * stride, sizeof(float) * chunk.n_steps * n_hosts, file_path);
+                write_header(file, "f4", "(" + rows + ", " + std::to_string(n_hosts) + ")", file_path);
+                std::fflush(file);
+            }
+
+            std::string times_path = path + "/times.npy";
+            std::FILE* file = files[TrajectoryChannel::Count];
+            std::fseek(file, 0, SEEK_END);
+            write_all(file, chunk.times.data(), sizeof(float) * chunk.n_steps, times_path);
+            write_header(file, "f4", "(" + rows + ",)", times_path);
+            std::fflush(file);
+        }
+
+        void TrajectoryWriter::Flush()
+        {
+            if (!thread.joinable())
+            {
+                throw std::logic_error("Trajectory writer for " + path + " is closed");
+            }
+
+            if (current->n_steps > 0)
+            {
+                if (current == &scratch)
+                {
+                    // keep a partial chunk gathered while dropping, trading buffers with a slot
+                    Chunk* partial = current;
+                    claim(true);
+                    std::swap(current->times, partial->times);
+                    std::swap(current->columns, partial->columns);
+                    current->n_steps = partial->n_steps;
+                    partial->n_steps = 0;
+                }
+                submit(true);
+            }
+
+            RingBackoff backoff;
+            while (n_written.load(std::memory_order_acquire) != n_submitted)
+            {
+                backoff.Wait();
+            }
+            checkError();
+        }
+
+        void TrajectoryWriter::Close()
+        {
+            if (!thread.joinable()) return;
+
+            std::string failure;
+            try
+            {
+                Flush();
+            }
+            catch (const std::exception& e)
+            {
+                failure = e.what();
+            }
+
+            stopping.store(true, std::memory_order_release);
+            thread.join();
+            closeFiles();
+
+            if (!failure.empty())
+            {
+                throw std::runtime_error(failure);
+            }
+        }
+
+        void TrajectoryWriter::closeFiles()
+        {
+            for (std::FILE* file : files)
+            {
+                std::fclose(file);
+            }
+            files.clear();
+        }
+
+        void TrajectoryWriter::checkError() const
+        {
+            if (failed.load(std::memory_order_acquire))
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                throw std::runtime_error(error);
+            }
+        }
+
+        int TrajectoryWriter::GetNumSteps() const
+        {
+            return n_steps;
+        }
+
+        int TrajectoryWriter::GetNumWritten() const
+        {
+            return n_written.load(std::memory_order_acquire);
+        }
+
+        int TrajectoryWriter::GetNumDropped() const
+        {
+            return n_dropped;
+        }
+
+        int TrajectoryWriter::GetStepsPerChunk() const
+        {
+            return steps_per_chunk;
+        }
+
+        int TrajectoryWriter::GetChunksInFlight() const
+        {
+            return int(ring.Capacity());
+        }
+
+        const std::vector<int>& TrajectoryWriter::GetHosts() const
+        {
+            return hosts;
+        }
+
+        const std::string& TrajectoryWriter::GetPath() const
+        {
+            return path;
+        }
+
+        bool TrajectoryWriter::IsOpen() const
+        {
+            return thread.joinable();
+        }
+
+    }
+
+}
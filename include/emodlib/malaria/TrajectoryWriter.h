@@ -0,0 +1,111 @@
+/**
+ * @file TrajectoryWriter.h
+ *
+ * @brief Streams per-step channels of selected hosts to .npy columns on disk, written by a background thread
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "emodlib/utils/SpscRing.h"
+
+
+namespace emodlib
+{
+
+    namespace malaria
+    {
+
+        class Population;
+
+        // The output is a directory of NumPy .npy files, readable by numpy.load(mmap_mode="r") or by mapping
+        // them directly: hosts.npy (int32, the population indices recorded), times.npy (float32, one per step)
+        // and one float32 (step, host) column per TrajectoryChannel.  Each header is rewritten as chunks land,
+        // so the files are valid up to the last chunk written even if the run never closes them.
+        class TrajectoryWriter
+        {
+
+        public:
+
+            // chunks_in_flight (rounded up to a power of two) is how far the writer thread may fall behind
+            static TrajectoryWriter* Create(const std::string& path, const std::vector<int>& hosts, int steps_per_chunk=64,
+                                            int chunks_in_flight=2, Backpressure::Enum backpressure=Backpressure::Block);
+            ~TrajectoryWriter();  // closes, without reporting errors
+
+            static const std::vector<std::string>& Channels();
+
+            // Gathers the hosts' channels after an update into the chunk in progress, publishing full chunks
+            // to the writer thread.  Once every chunk is in flight, Block waits for the writer, while Drop
+            // gathers into a scratch chunk that is discarded when full, leaving a gap in times.npy.
+            void Record(const Population& pop, float dt);
+
+            void Flush();  // blocks until every recorded step is on disk
+            void Close();  // flushes and stops the writer thread; recording afterwards throws
+
+            int GetNumSteps() const;    // recorded
+            int GetNumWritten() const;  // on disk
+            int GetNumDropped() const;
+            int GetStepsPerChunk() const;
+            int GetChunksInFlight() const;
+            const std::vector<int>& GetHosts() const;
+            const std::string& GetPath() const;
+            bool IsOpen() const;
+
+        private:
+
+            struct Chunk
+            {
+                int n_steps;
+                std::vector<float> times;
+                std::vector<float> columns;  // (channel, step, host), each channel steps_per_chunk rows apart
+            };
+
+            std::string path;
+            std::vector<int> hosts;
+            int steps_per_chunk;
+
+            std::vector<std::FILE*> files;  // one per channel, then times
+            float time;
+            int n_steps;
+
+            SpscRing<Chunk> ring;
+            Backpressure::Enum backpressure;
+            Chunk scratch;    // filled instead of a ring slot while dropping
+            Chunk* current;   // claimed slot or scratch
+            int n_submitted;  // by the recording thread
+            int n_dropped;
+
+            std::atomic<int> n_written;  // by the writer thread
+            std::atomic<bool> stopping;
+            std::atomic<bool> failed;
+            mutable std::mutex error_mutex;
+            std::string error;  // of the writer thread, rethrown to the recording thread
+            std::thread thread;
+
+
+            TrajectoryWriter(const std::string& _path, const std::vector<int>& _hosts, int _steps_per_chunk,
+                             int _chunks_in_flight, Backpressure::Enum _backpressure);
+            TrajectoryWriter(const TrajectoryWriter&) = delete;
+            TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+            void open();
+            void allocate(Chunk& chunk) const;
+            void claim(bool wait);  // the next slot as current, or scratch if none is free and not waiting
+            void submit(bool wait);
+            void run();
+            void write(const Chunk& chunk);
+            void closeFiles();
+            void checkError() const;
+
+        };
+
+    }
+
+}
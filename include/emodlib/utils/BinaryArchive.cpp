@@ -0,0 +1,94 @@
+/**
+ * @file BinaryArchive.cpp
+ *
+ * @brief Little-endian binary writer and reader for snapshots
+ */
+
+#include "BinaryArchive.h"
+
+#include <stdexcept>
+
+
+namespace emodlib
+{
+
+    // ----------------------------------------------------------------------------
+    // --- BinaryWriter
+    // ----------------------------------------------------------------------------
+
+    BinaryWriter::BinaryWriter()
+        : buffer()
+    {
+    }
+
+    void BinaryWriter::WriteBytes( const void* data, size_t size )
+    {
+        const char* bytes = reinterpret_cast<const char*>(data);
+        buffer.insert( buffer.end(), bytes, bytes + size );
+    }
+
+    size_t BinaryWriter::Size() const
+    {
+        return buffer.size();
+    }
+
+    void BinaryWriter::Patch( size_t offset, const void* data, size_t size )
+    {
+        if ( offset + size > buffer.size() )
+        {
+            throw std::out_of_range( "BinaryWriter::Patch beyond the end of the buffer" );
+        }
+        memcpy( buffer.data() + offset, data, size );
+    }
+
+    const std::vector<char>& BinaryWriter::Buffer() const
+    {
+        return buffer;
+    }
+
+    std::vector<char>& BinaryWriter::Buffer()
+    {
+        return buffer;
+    }
+
+    // ----------------------------------------------------------------------------
+    // --- BinaryReader
+    // ----------------------------------------------------------------------------
+
+    BinaryReader::BinaryReader( const char* data, size_t _size )
+        : begin( data )
+        , size( _size )
+        , position( 0 )
+    {
+    }
+
+    void BinaryReader::ReadBytes( void* data, size_t count )
+    {
+        if ( count > size - position )
+        {
+            throw std::runtime_error( "Truncated snapshot: read past the end of the data" );
+        }
+        memcpy( data, begin + position, count );
+        position += count;
+    }
+
+    size_t BinaryReader::Position() const
+    {
+        return position;
+    }
+
+    void BinaryReader::Seek( size_t _position )
+    {
+        if ( _position > size )
+        {
+            throw std::runtime_error( "Corrupt snapshot: offset past the end of the data" );
+        }
+        position = _position;
+    }
+
+    size_t BinaryReader::Size() const
+    {
+        return size;
+    }
+
+}
@@ -0,0 +1,98 @@
+/**
+ * @file BinaryArchive.h
+ *
+ * @brief Little-endian binary writer and reader for snapshots
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+namespace emodlib
+{
+
+    // ------------------------------------------------------------------------
+    // --- BinaryWriter
+    // ------------------------------------------------------------------------
+    // Appends plain values to a growing byte buffer in host byte order
+    // (little-endian on every platform emodlib builds for).
+
+    class BinaryWriter
+    {
+
+    public:
+
+        BinaryWriter();
+
+        template <typename T>
+        void Write( const T& value )
+        {
+            WriteBytes( &value, sizeof(T) );
+        }
+
+        template <typename T>
+        void WriteArray( const T* values, size_t count )
+        {
+            WriteBytes( values, count * sizeof(T) );
+        }
+
+        void WriteBytes( const void* data, size_t size );
+
+        size_t Size() const;
+        void   Patch( size_t offset, const void* data, size_t size );  // overwrite bytes already written, e.g. an offset table
+
+        const std::vector<char>& Buffer() const;
+        std::vector<char>&       Buffer();
+
+    private:
+
+        std::vector<char> buffer;
+    };
+
+
+    // ------------------------------------------------------------------------
+    // --- BinaryReader
+    // ------------------------------------------------------------------------
+    // Reads values back from a byte range it does not own, throwing
+    // std::runtime_error instead of reading past the end.
+
+    class BinaryReader
+    {
+
+    public:
+
+        BinaryReader( const char* data, size_t size );
+
+        template <typename T>
+        T Read()
+        {
+            T value;
+            ReadBytes( &value, sizeof(T) );
+            return value;
+        }
+
+        template <typename T>
+        void ReadArray( T* values, size_t count )
+        {
+            ReadBytes( values, count * sizeof(T) );
+        }
+
+        void ReadBytes( void* data, size_t size );
+
+        size_t Position() const;
+        void   Seek( size_t position );
+        size_t Size() const;
+
+    private:
+
+        const char* begin;
+        size_t      size;
+        size_t      position;
+    };
+
+}
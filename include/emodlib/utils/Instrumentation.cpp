@@ -0,0 +1,371 @@
+/**
+ * @file Instrumentation.cpp
+ *
+ * @brief Per-thread instrumentation counters and their totals
+ */
+
+#include "Instrumentation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define EMODLIB_HAS_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define EMODLIB_HAS_TSC
+#endif
+
+#if defined(EMODLIB_PERF_COUNTERS) && defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define EMODLIB_HAS_PERF
+#endif
+
+
+namespace emodlib
+{
+
+    static const char* PHASE_NAMES[Phase::Count] = {
+        "IntrahostComponent::Update",
+        "malariaProcessHepatocytes",
+        "processEndOfAsexualCycle",
+        "malariaIRBCAntigenSwitch",
+        "malariaImmuneStimulation",
+        "malariaImmunityIRBCKill",
+        "malariaImmunityGametocyteKill",
+        "Susceptibility::Update",
+        "updateImmunityCSP",
+        "updateImmunityMSP",
+        "updateImmunityPfEMP1Minor",
+        "updateImmunityPfEMP1Major",
+        "decayAllAntibodies",
+    };
+
+    static const char* DRAW_NAMES[RandomDraw::Count] = {
+        "ul",
+        "e",
+        "ee",
+        "uniformZeroToN",
+        "eGauss",
+        "Poisson",
+        "Poisson_true",
+        "cache_refill",
+    };
+
+    static const char* HARDWARE_NAMES[HardwareCounter::Count] = {
+        "cpu_cycles",
+        "instructions",
+        "llc_misses",
+        "branch_misses",
+    };
+
+    // Written only by the owning thread, so a relaxed load and store suffice; atomic so that totals may be read meanwhile
+    struct ThreadCounters
+    {
+        std::atomic<uint64_t> calls[Phase::Count];
+        std::atomic<uint64_t> cycles[Phase::Count];
+        std::atomic<uint64_t> draws[RandomDraw::Count];
+        std::atomic<uint64_t> hardware[Phase::Count][HardwareCounter::Count];
+
+        ThreadCounters() { clear(); }
+
+        void clear()
+        {
+            for (auto& c : calls) c.store(0, std::memory_order_relaxed);
+            for (auto& c : cycles) c.store(0, std::memory_order_relaxed);
+            for (auto& c : draws) c.store(0, std::memory_order_relaxed);
+            for (auto& phase : hardware)
+                for (auto& c : phase) c.store(0, std::memory_order_relaxed);
+        }
+    };
+
+    static inline void add( std::atomic<uint64_t>& counter, uint64_t n )
+    {
+        counter.store( counter.load( std::memory_order_relaxed ) + n, std::memory_order_relaxed );
+    }
+
+    static inline uint64_t read( const std::atomic<uint64_t>& counter )
+    {
+        return counter.load( std::memory_order_relaxed );
+    }
+
+    // Blocks of live threads; an exiting thread folds its counts into the retired totals and frees its block
+    static std::mutex registry_mutex;
+    static std::vector<std::unique_ptr<ThreadCounters>> registry;
+    static ThreadCounters retired;
+
+    struct LocalCounters
+    {
+        ThreadCounters* counters;
+
+        LocalCounters() : counters( nullptr ) {}
+        ~LocalCounters()
+        {
+            if (!counters) return;
+            std::lock_guard<std::mutex> lock( registry_mutex );
+
+            for (int p = 0; p < Phase::Count; p++)
+            {
+                add( retired.calls[p], read( counters->calls[p] ) );
+                add( retired.cycles[p], read( counters->cycles[p] ) );
+                for (int c = 0; c < HardwareCounter::Count; c++)
+                {
+                    add( retired.hardware[p][c], read( counters->hardware[p][c] ) );
+                }
+            }
+            for (int d = 0; d < RandomDraw::Count; d++)
+            {
+                add( retired.draws[d], read( counters->draws[d] ) );
+            }
+
+            registry.erase( std::find_if( registry.begin(), registry.end(),
+                                          [this]( const std::unique_ptr<ThreadCounters>& block ) { return block.get() == counters; } ) );
+        }
+    };
+
+    static ThreadCounters& local_counters()
+    {
+        thread_local LocalCounters local;
+        if (!local.counters)
+        {
+            std::lock_guard<std::mutex> lock( registry_mutex );
+            registry.emplace_back( new ThreadCounters() );
+            local.counters = registry.back().get();
+        }
+        return *local.counters;
+    }
+
+    // Retired totals and the blocks of live threads, under registry_mutex
+    template<typename Visit>
+    static void for_each_counters( Visit visit )
+    {
+        visit( retired );
+        for (const auto& counters : registry)
+        {
+            visit( *counters );
+        }
+    }
+
+#ifdef EMODLIB_HAS_PERF
+    // The events of one thread as a group, scheduled onto the PMU together and read by one system call.
+    // User space only, which perf_event_paranoid up to 2 allows without privileges.
+    class PerfGroup
+    {
+
+    public:
+
+        PerfGroup()
+        {
+            for (int& fd : fds) fd = -1;
+
+            // cache misses as the kernel maps them, the last-level cache on most cores
+            static const uint64_t EVENTS[HardwareCounter::Count] = {
+                PERF_COUNT_HW_CPU_CYCLES,
+                PERF_COUNT_HW_INSTRUCTIONS,
+                PERF_COUNT_HW_CACHE_MISSES,
+                PERF_COUNT_HW_BRANCH_MISSES,
+            };
+
+            for (int c = 0; c < HardwareCounter::Count; c++)
+            {
+                perf_event_attr attr;
+                memset( &attr, 0, sizeof(attr) );
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = EVENTS[c];
+                attr.read_format = PERF_FORMAT_GROUP;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+
+                fds[c] = int( syscall( __NR_perf_event_open, &attr, 0, -1, (c == 0) ? -1 : fds[0], 0 ) );
+                if (fds[c] < 0)
+                {
+                    close_all();  // e.g. no PMU in a virtual machine, or perf_event_paranoid > 2
+                    return;
+                }
+            }
+        }
+
+        ~PerfGroup()
+        {
+            close_all();
+        }
+
+        bool Available() const
+        {
+            return fds[0] >= 0;
+        }
+
+        void Read( uint64_t counts[HardwareCounter::Count] ) const
+        {
+            struct { uint64_t nr; uint64_t values[HardwareCounter::Count]; } group;
+
+            if (fds[0] < 0 || ::read( fds[0], &group, sizeof(group) ) != ssize_t(sizeof(group)))
+            {
+                memset( counts, 0, sizeof(uint64_t) * HardwareCounter::Count );
+                return;
+            }
+            memcpy( counts, group.values, sizeof(group.values) );
+        }
+
+    private:
+
+        void close_all()
+        {
+            for (int& fd : fds)
+            {
+                if (fd >= 0) ::close( fd );
+                fd = -1;
+            }
+        }
+
+        int fds[HardwareCounter::Count];
+    };
+
+    static PerfGroup& perf_group()
+    {
+        thread_local PerfGroup group;
+        return group;
+    }
+#endif
+
+    // ----------------------------------------------------------------------------
+    // --- Instrumentation
+    // ----------------------------------------------------------------------------
+
+    bool Instrumentation::Enabled()
+    {
+#ifdef EMODLIB_INSTRUMENTATION
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    const char* Instrumentation::ClockName()
+    {
+#ifdef EMODLIB_HAS_TSC
+        return "tsc";
+#else
+        return "ns";
+#endif
+    }
+
+    bool Instrumentation::HardwareAvailable()
+    {
+#ifdef EMODLIB_HAS_PERF
+        return perf_group().Available();
+#else
+        return false;
+#endif
+    }
+
+    const char* Instrumentation::HardwareCounterName( HardwareCounter::Enum counter )
+    {
+        return HARDWARE_NAMES[counter];
+    }
+
+    uint64_t Instrumentation::Now()
+    {
+#ifdef EMODLIB_HAS_TSC
+        return __rdtsc();
+#else
+        return uint64_t( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count() );
+#endif
+    }
+
+    void Instrumentation::AddPhase( Phase::Enum phase, uint64_t cycles )
+    {
+        ThreadCounters& counters = local_counters();
+        add( counters.calls[phase], 1 );
+        add( counters.cycles[phase], cycles );
+    }
+
+    void Instrumentation::ReadHardware( uint64_t counts[HardwareCounter::Count] )
+    {
+#ifdef EMODLIB_HAS_PERF
+        perf_group().Read( counts );
+#else
+        for (int c = 0; c < HardwareCounter::Count; c++) counts[c] = 0;
+#endif
+    }
+
+    void Instrumentation::AddHardware( Phase::Enum phase, const uint64_t started[HardwareCounter::Count] )
+    {
+#ifdef EMODLIB_HAS_PERF
+        if (!perf_group().Available()) return;
+
+        uint64_t now[HardwareCounter::Count];
+        perf_group().Read( now );
+
+        ThreadCounters& counters = local_counters();
+        for (int c = 0; c < HardwareCounter::Count; c++)
+        {
+            add( counters.hardware[phase][c], now[c] - started[c] );
+        }
+#else
+        (void)phase;
+        (void)started;
+#endif
+    }
+
+    void Instrumentation::CountDraw( RandomDraw::Enum kind )
+    {
+        add( local_counters().draws[kind], 1 );
+    }
+
+    std::vector<Instrumentation::PhaseStats> Instrumentation::GetPhaseStats()
+    {
+        std::vector<PhaseStats> stats;
+        for (int p = 0; p < Phase::Count; p++)
+        {
+            stats.push_back( PhaseStats{ PHASE_NAMES[p], 0, 0, {} } );
+        }
+
+        std::lock_guard<std::mutex> lock( registry_mutex );
+        for_each_counters( [&stats]( const ThreadCounters& counters ) {
+            for (int p = 0; p < Phase::Count; p++)
+            {
+                stats[p].calls += read( counters.calls[p] );
+                stats[p].cycles += read( counters.cycles[p] );
+                for (int c = 0; c < HardwareCounter::Count; c++)
+                {
+                    stats[p].hardware[c] += read( counters.hardware[p][c] );
+                }
+            }
+        } );
+        return stats;
+    }
+
+    std::vector<Instrumentation::DrawStats> Instrumentation::GetDrawStats()
+    {
+        std::vector<DrawStats> stats;
+        for (int d = 0; d < RandomDraw::Count; d++)
+        {
+            stats.push_back( DrawStats{ DRAW_NAMES[d], 0 } );
+        }
+
+        std::lock_guard<std::mutex> lock( registry_mutex );
+        for_each_counters( [&stats]( const ThreadCounters& counters ) {
+            for (int d = 0; d < RandomDraw::Count; d++)
+            {
+                stats[d].count += read( counters.draws[d] );
+            }
+        } );
+        return stats;
+    }
+
+    void Instrumentation::Reset()
+    {
+        std::lock_guard<std::mutex> lock( registry_mutex );
+        for_each_counters( []( ThreadCounters& counters ) { counters.clear(); } );
+    }
+
+}
@@ -0,0 +1,150 @@
+/**
+ * @file Instrumentation.h
+ *
+ * @brief Per-phase call counts and cycles of the intra-host update, and random draws by kind
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+namespace emodlib
+{
+
+    // Phases of IntrahostComponent::Update, timed inclusive of the phases nested in them
+    namespace Phase
+    {
+        enum Enum
+        {
+            IntrahostUpdate,
+            ProcessHepatocytes,
+            EndOfAsexualCycle,
+            IRBCAntigenSwitch,
+            ImmuneStimulation,
+            IRBCKill,
+            GametocyteKill,
+            SusceptibilityUpdate,
+            UpdateImmunityCSP,
+            UpdateImmunityMSP,
+            UpdateImmunityPfEMP1Minor,
+            UpdateImmunityPfEMP1Major,
+            DecayAllAntibodies,
+            Count
+        };
+    }
+
+    // Public RANDOMBASE draws; Gaussian and Poisson deviates consume uniform and bit draws of their own
+    namespace RandomDraw
+    {
+        enum Enum
+        {
+            Bits,
+            Uniform,
+            UniformDouble,
+            UniformInt,
+            Gaussian,
+            Poisson,
+            PoissonTrue,
+            CacheRefill,
+            Count
+        };
+    }
+
+
+    // Hardware events counted per phase by perf_event_open, in builds with EMODLIB_PERF_COUNTERS on Linux
+    namespace HardwareCounter
+    {
+        enum Enum
+        {
+            Cycles,
+            Instructions,
+            LLCMisses,
+            BranchMisses,
+            Count
+        };
+    }
+
+
+    // ------------------------------------------------------------------------
+    // --- Instrumentation
+    // ------------------------------------------------------------------------
+    // Counters live in a block per thread, summed when read, so the hot path takes no lock;
+    // an exiting thread adds its counts to retired totals and frees its block.
+    // Only builds with EMODLIB_INSTRUMENTATION record anything; otherwise the macros below
+    // compile to nothing and the counters stay zero.  EMODLIB_PERF_COUNTERS adds a perf event
+    // group per thread, read at either end of every phase: a system call each, so the phase
+    // cycles then include that overhead, but the hardware counts exclude the kernel.
+
+    class Instrumentation
+    {
+
+    public:
+
+        struct PhaseStats
+        {
+            std::string name;
+            uint64_t    calls;
+            uint64_t    cycles;
+            uint64_t    hardware[HardwareCounter::Count];
+        };
+
+        struct DrawStats
+        {
+            std::string name;
+            uint64_t    count;
+        };
+
+        static bool Enabled();
+        static const char* ClockName();  // "tsc" on x86, else "ns" from the steady clock
+        static bool HardwareAvailable();  // whether this thread could open the perf events
+        static const char* HardwareCounterName( HardwareCounter::Enum counter );
+
+        static std::vector<PhaseStats> GetPhaseStats();
+        static std::vector<DrawStats> GetDrawStats();
+        static void Reset();  // while no thread is updating hosts
+
+        static uint64_t Now();
+        static void AddPhase( Phase::Enum phase, uint64_t cycles );
+        static void ReadHardware( uint64_t counts[HardwareCounter::Count] );  // zeros if unavailable
+        static void AddHardware( Phase::Enum phase, const uint64_t started[HardwareCounter::Count] );
+        static void CountDraw( RandomDraw::Enum kind );
+
+    };
+
+
+    class ScopedPhase
+    {
+
+    public:
+#ifdef EMODLIB_PERF_COUNTERS
+        explicit ScopedPhase( Phase::Enum _phase ) : phase( _phase ) { Instrumentation::ReadHardware( hardware ); started = Instrumentation::Now(); }
+        ~ScopedPhase() { Instrumentation::AddPhase( phase, Instrumentation::Now() - started ); Instrumentation::AddHardware( phase, hardware ); }
+#else
+        explicit ScopedPhase( Phase::Enum _phase ) : phase( _phase ), started( Instrumentation::Now() ) {}
+        ~ScopedPhase() { Instrumentation::AddPhase( phase, Instrumentation::Now() - started ); }
+#endif
+
+        ScopedPhase( const ScopedPhase& ) = delete;
+        ScopedPhase& operator=( const ScopedPhase& ) = delete;
+
+    private:
+        Phase::Enum phase;
+        uint64_t    started;
+#ifdef EMODLIB_PERF_COUNTERS
+        uint64_t    hardware[HardwareCounter::Count];
+#endif
+    };
+
+}
+
+
+#ifdef EMODLIB_INSTRUMENTATION
+    #define EMODLIB_PHASE(phase) ::emodlib::ScopedPhase emodlib_scoped_phase_( ::emodlib::Phase::phase )
+    #define EMODLIB_COUNT_DRAW(kind) ::emodlib::Instrumentation::CountDraw( ::emodlib::RandomDraw::kind )
+#else
+    #define EMODLIB_PHASE(phase) ((void)0)
+    #define EMODLIB_COUNT_DRAW(kind) ((void)0)
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @file MappedFile.cpp
+ *
+ * @brief Read-only memory-mapped file
+ */
+
+#include "MappedFile.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace emodlib
+{
+
+    MappedFile::MappedFile()
+        : data( nullptr )
+        , size( 0 )
+        , buffer()
+    {
+    }
+
+    MappedFile::~MappedFile()
+    {
+#ifndef _WIN32
+        if ( data && buffer.empty() )
+        {
+            munmap( const_cast<char*>(data), size );
+        }
+#endif
+    }
+
+#ifndef _WIN32
+
+    std::shared_ptr<const MappedFile> MappedFile::Open( const std::string& path )
+    {
+        int fd = open( path.c_str(), O_RDONLY );
+        if ( fd < 0 )
+        {
+            throw std::runtime_error( "Cannot open " + path + ": " + strerror( errno ) );
+        }
+
+        struct stat info;
+        if ( fstat( fd, &info ) != 0 || info.st_size == 0 )
+        {
+            close( fd );
+            throw std::runtime_error( "Cannot map " + path + ": empty or unreadable file" );
+        }
+
+        void* address = mmap( nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0 );
+        close( fd );  // the mapping holds its own reference to the file
+
+        if ( address == MAP_FAILED )
+        {
+            throw std::runtime_error( "Cannot map " + path + ": " + strerror( errno ) );
+        }
+
+        std::shared_ptr<MappedFile> file( new MappedFile() );
+        file->data = reinterpret_cast<const char*>(address);
+        file->size = size_t(info.st_size);
+        return file;
+    }
+
+#else
+
+    std::shared_ptr<const MappedFile> MappedFile::Open( const std::string& path )
+    {
+        std::ifstream stream( path, std::ios::binary | std::ios::ate );
+        if ( !stream )
+        {
+            throw std::runtime_error( "Cannot open " + path );
+        }
+
+        std::shared_ptr<MappedFile> file( new MappedFile() );
+        file->buffer.resize( size_t(stream.tellg()) );
+        stream.seekg( 0 );
+        stream.read( file->buffer.data(), file->buffer.size() );
+
+        if ( file->buffer.empty() || !stream )
+        {
+            throw std::runtime_error( "Cannot read " + path + ": empty or unreadable file" );
+        }
+
+        file->data = file->buffer.data();
+        file->size = file->buffer.size();
+        return file;
+    }
+
+#endif
+
+    const char* MappedFile::Data() const
+    {
+        return data;
+    }
+
+    size_t MappedFile::Size() const
+    {
+        return size;
+    }
+
+}
@@ -0,0 +1,47 @@
+/**
+ * @file MappedFile.h
+ *
+ * @brief Read-only memory-mapped file
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace emodlib
+{
+
+    // ------------------------------------------------------------------------
+    // --- MappedFile
+    // ------------------------------------------------------------------------
+    // Maps a whole file read-only, so that pages are loaded on first touch and
+    // shared between processes mapping the same file. Where mmap is not
+    // available the file is read into memory instead.
+
+    class MappedFile
+    {
+
+    public:
+
+        static std::shared_ptr<const MappedFile> Open( const std::string& path );
+        ~MappedFile();
+
+        const char* Data() const;
+        size_t      Size() const;
+
+    private:
+
+        const char* data;
+        size_t      size;
+        std::vector<char> buffer;  // fallback storage when the file is not mapped
+
+        MappedFile();
+        MappedFile( const MappedFile& ) = delete;
+        MappedFile& operator=( const MappedFile& ) = delete;
+    };
+
+}
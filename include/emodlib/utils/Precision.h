@@ -0,0 +1,26 @@
+/**
+ * @file Precision.h
+ *
+ * @brief Floating-point precision of the simulation state
+ */
+
+#pragma once
+
+
+namespace emodlib
+{
+
+    // Antibody, immune-response and parasite-kinetics state, and the arithmetic updating it, use real_t.
+    // It is fixed per build (EMODLIB_PRECISION): float64 by default for validation, or float32 with
+    // EMODLIB_SINGLE_PRECISION for bulk population runs, halving antibody state.  Parameters, time steps,
+    // host age (which also keys the random streams) and reported observables are float in either build,
+    // so the random draws and outputs of the two builds line up for comparison.
+#ifdef EMODLIB_SINGLE_PRECISION
+    typedef float real_t;
+    #define EMODLIB_PRECISION_NAME "float32"
+#else
+    typedef double real_t;
+    #define EMODLIB_PRECISION_NAME "float64"
+#endif
+
+}
@@ -0,0 +1,191 @@
+/**
+ * @file QuantileSketch.cpp
+ *
+ * @brief Mergeable streaming quantile sketch implementation
+ */
+
+#include "QuantileSketch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+
+namespace emodlib
+{
+
+    QuantileSketch::QuantileSketch( int _k )
+        : k( _k )
+        , count( 0 )
+        , min( std::numeric_limits<float>::infinity() )
+        , max( -std::numeric_limits<float>::infinity() )
+        , retained( 0 )
+        , max_retained( 0 )
+        , levels()
+        , parity()
+    {
+        if (k < 8)
+        {
+            throw std::invalid_argument( "Quantile sketches need k of at least 8" );
+        }
+
+        grow();
+    }
+
+    size_t QuantileSketch::capacity( size_t level ) const
+    {
+        size_t depth = levels.size() - level - 1;
+        return std::max( size_t(2), size_t( std::ceil( k * std::pow( 2.0 / 3.0, double(depth) ) ) ) );
+    }
+
+    void QuantileSketch::grow()
+    {
+        levels.emplace_back();
+        parity.push_back( 0 );
+
+        max_retained = 0;
+        for (size_t h = 0; h < levels.size(); h++)
+        {
+            max_retained += capacity( h );
+        }
+    }
+
+    void QuantileSketch::compress()
+    {
+        for (size_t h = 0; h < levels.size(); h++)
+        {
+            if (levels[h].size() < capacity( h )) continue;
+
+            if (h + 1 == levels.size()) grow();  // which may move the levels
+            std::vector<float>& level = levels[h];
+            std::vector<float>& above = levels[h + 1];
+
+            std::sort( level.begin(), level.end() );
+
+            // an odd item out stays behind, the smallest
+            size_t keep = level.size() % 2;
+            for (size_t i = keep + parity[h]; i < level.size(); i += 2)
+            {
+                above.push_back( level[i] );
+            }
+            parity[h] ^= 1;
+
+            retained -= level.size() - keep;
+            retained += (level.size() - keep) / 2;
+            levels[h].resize( keep );
+
+            if (retained < max_retained) break;
+        }
+    }
+
+    void QuantileSketch::Add( float value )
+    {
+        if (std::isnan( value )) return;
+
+        count++;
+        min = std::min( min, value );
+        max = std::max( max, value );
+
+        levels[0].push_back( value );
+        if (++retained >= max_retained) compress();
+    }
+
+    void QuantileSketch::Merge( const QuantileSketch& other )
+    {
+        if (other.k != k)
+        {
+            throw std::invalid_argument( "Only quantile sketches of the same k can be merged" );
+        }
+        if (other.count == 0) return;
+
+        while (levels.size() < other.levels.size()) grow();
+
+        for (size_t h = 0; h < other.levels.size(); h++)
+        {
+            levels[h].insert( levels[h].end(), other.levels[h].begin(), other.levels[h].end() );
+        }
+        retained += other.retained;
+        count += other.count;
+        min = std::min( min, other.min );
+        max = std::max( max, other.max );
+
+        while (retained >= max_retained) compress();
+    }
+
+    void QuantileSketch::Clear()
+    {
+        // keeps the levels' capacity for refilling
+        for (auto& level : levels) level.clear();
+        for (auto& p : parity) p = 0;
+        count = 0;
+        retained = 0;
+        min = std::numeric_limits<float>::infinity();
+        max = -std::numeric_limits<float>::infinity();
+    }
+
+    void QuantileSketch::weighted( std::vector<std::pair<float, uint64_t>>& items ) const
+    {
+        items.clear();
+        items.reserve( retained );
+        for (size_t h = 0; h < levels.size(); h++)
+        {
+            for (float value : levels[h])
+            {
+                items.emplace_back( value, uint64_t(1) << h );
+            }
+        }
+        std::sort( items.begin(), items.end() );
+    }
+
+    float QuantileSketch::Quantile( float q ) const
+    {
+        if (count == 0) return std::numeric_limits<float>::quiet_NaN();
+        if (q <= 0) return min;
+        if (q >= 1) return max;
+
+        std::vector<std::pair<float, uint64_t>> items;
+        weighted( items );
+
+        // compaction halves the items and doubles their weight, so the weights still total the count
+        double target = double(q) * double(count);
+        uint64_t cumulative = 0;
+        for (const auto& item : items)
+        {
+            cumulative += item.second;
+            if (double(cumulative) >= target) return item.first;
+        }
+        return max;
+    }
+
+    float QuantileSketch::Rank( float value ) const
+    {
+        if (count == 0) return std::numeric_limits<float>::quiet_NaN();
+
+        uint64_t below = 0;
+        for (size_t h = 0; h < levels.size(); h++)
+        {
+            for (float v : levels[h])
+            {
+                if (v <= value) below += uint64_t(1) << h;
+            }
+        }
+        return float( double(below) / double(count) );
+    }
+
+    uint64_t QuantileSketch::GetCount() const
+    {
+        return count;
+    }
+
+    size_t QuantileSketch::GetNumRetained() const
+    {
+        return retained;
+    }
+
+    int QuantileSketch::GetK() const
+    {
+        return k;
+    }
+
+}
@@ -0,0 +1,62 @@
+/**
+ * @file QuantileSketch.h
+ *
+ * @brief Mergeable streaming quantile sketch (KLL) of bounded size
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+
+namespace emodlib
+{
+
+    // ------------------------------------------------------------------------
+    // --- QuantileSketch
+    // ------------------------------------------------------------------------
+    // The compactor hierarchy of Karnin, Lang & Liberty (2016): level h holds items of weight 2^h,
+    // and a full level sorts itself and promotes every other item to the level above.  Capacities
+    // shrink by 2/3 per level below the top, so the sketch keeps O(k) items however many it has seen,
+    // and any quantile is within about 1.7/k of its true rank.  Compaction alternates between odd
+    // and even items rather than tossing a coin, leaving the model's random streams untouched.
+
+    class QuantileSketch
+    {
+
+    public:
+
+        explicit QuantileSketch( int _k = 200 );
+
+        void Add( float value );
+        void Merge( const QuantileSketch& other );  // of the same k
+        void Clear();
+
+        float Quantile( float q ) const;  // NaN while empty; the exact extremes at 0 and 1
+        float Rank( float value ) const;  // fraction of values at or below
+
+        uint64_t GetCount() const;
+        size_t GetNumRetained() const;
+        int GetK() const;
+
+    private:
+
+        int k;
+        uint64_t count;
+        float min;
+        float max;
+        size_t retained;
+        size_t max_retained;
+        std::vector<std::vector<float>> levels;
+        std::vector<uint8_t> parity;  // of the next compaction of each level
+
+        size_t capacity( size_t level ) const;
+        void grow();
+        void compress();
+        void weighted( std::vector<std::pair<float, uint64_t>>& items ) const;  // sorted by value
+    };
+
+}
@@ -5,6 +5,12 @@
 
 #include <memory.h>    // memset
 #include <climits>     // UINT_MAX
+#include <memory>      // unique_ptr
+#include <stdexcept>
+
+#include "BinaryArchive.h"
+#include "Instrumentation.h"
+#include "Tracer.h"
 
 #if defined(__APPLE__) && defined(__arm64__)  // intended for Apple M1 hardware
 #include "sse2neon.h"
@@ -32,6 +38,8 @@ namespace emodlib
         , random_floats( nullptr )
         , bGauss( false )
         , eGauss_( 0.0f )
+        , gaussian( nullptr )
+        , antithetic( false )
         {
             if( cache_count == 0 )
             {
@@ -43,16 +51,19 @@ namespace emodlib
 
     RANDOMBASE::~RANDOMBASE()
     {
-    #ifdef _DEBUG
+        delete gaussian;
         free(random_bits);
         free(random_floats);
-    #endif
     }
 
     uint32_t RANDOMBASE::ul()
     {
+        EMODLIB_COUNT_DRAW(Bits);
+
         if (index >= cache_count)
         {
+            EMODLIB_COUNT_DRAW(CacheRefill);
+            EMODLIB_TRACE_SCOPE("rng", "refill");
             fill_bits();
             bits_to_float();
             index = 0;
@@ -63,8 +74,12 @@ namespace emodlib
 
     float RANDOMBASE::e()
     {
+        EMODLIB_COUNT_DRAW(Uniform);
+
         if (index >= cache_count)
         {
+            EMODLIB_COUNT_DRAW(CacheRefill);
+            EMODLIB_TRACE_SCOPE("rng", "refill");
             fill_bits();
             bits_to_float();
             index = 0;
@@ -76,6 +91,8 @@ namespace emodlib
     // Finds an uniformally distributed number between 0 (inclusive) and N (exclusive)
     uint16_t RANDOMBASE::uniformZeroToN16( uint16_t N )
     {
+        EMODLIB_COUNT_DRAW(UniformInt);
+
         uint32_t ulA = ul();
         uint32_t ll = (ulA & 0xFFFFL) * N;
         ll >>= 16;
@@ -86,6 +103,8 @@ namespace emodlib
     // Finds an uniformally distributed number between 0 (inclusive) and N (exclusive)
     uint32_t RANDOMBASE::uniformZeroToN32( uint32_t N )
     {
+        EMODLIB_COUNT_DRAW(UniformInt);
+
         uint64_t ulA = uint64_t( ul() );
         uint64_t ulB = uint64_t( ul() );
         ulB <<= 32;
@@ -100,6 +119,130 @@ namespace emodlib
         assert(false);
     }
 
+    void RANDOMBASE::SetKey( uint32_t stream, uint32_t purpose, uint32_t step, uint32_t item )
+    {
+        set_key( stream, purpose, step, item );
+        if ( gaussian )
+        {
+            gaussian->SetKey( stream, purpose, step, item );
+        }
+    }
+
+    void RANDOMBASE::set_key( uint32_t /*stream*/, uint32_t /*purpose*/, uint32_t /*step*/, uint32_t /*item*/ )
+    {
+    }
+
+    RandomGenerator::Enum RANDOMBASE::generator_type() const
+    {
+        throw std::logic_error( "RANDOMBASE has no serializable generator" );
+    }
+
+    void RANDOMBASE::serialize_state( BinaryWriter& /*writer*/ ) const
+    {
+    }
+
+    void RANDOMBASE::deserialize_state( BinaryReader& /*reader*/ )
+    {
+    }
+
+    void RANDOMBASE::rewind( size_t /*count*/ )
+    {
+        throw std::logic_error( "RANDOMBASE cannot rewind its generator" );
+    }
+
+    RANDOMBASE* RANDOMBASE::Clone() const
+    {
+        throw std::logic_error( "RANDOMBASE cannot be cloned" );
+    }
+
+    void RANDOMBASE::copy_cache( const RANDOMBASE& other )
+    {
+        assert( cache_count == other.cache_count );
+        if ( other.index < cache_count )  // otherwise the cache is exhausted or was never filled
+        {
+            memcpy( random_bits, other.random_bits, cache_count * sizeof( uint32_t ) );
+            memcpy( random_floats, other.random_floats, cache_count * sizeof( float ) );
+        }
+        index = other.index;
+        bGauss = other.bGauss;
+        eGauss_ = other.eGauss_;
+
+        delete gaussian;
+        gaussian = other.gaussian ? other.gaussian->Clone() : nullptr;
+        antithetic = other.antithetic;
+    }
+
+    void RANDOMBASE::Serialize( BinaryWriter& writer ) const
+    {
+        writer.Write<uint32_t>( generator_type() );
+        writer.Write<uint64_t>( cache_count );
+        serialize_state( writer );                  // generator position after the last fill_bits()
+        writer.Write<uint64_t>( index < cache_count ? index : cache_count );  // cache_count when exhausted or never filled
+        writer.Write<uint8_t>( bGauss ? 1 : 0 );
+        writer.Write<double>( eGauss_ );
+        writer.Write<uint8_t>( antithetic ? 1 : 0 );
+        writer.Write<uint8_t>( gaussian ? 1 : 0 );
+        if ( gaussian ) gaussian->Serialize( writer );
+    }
+
+    RANDOMBASE* RANDOMBASE::Deserialize( BinaryReader& reader )
+    {
+        uint32_t type = reader.Read<uint32_t>();
+        uint64_t nCache = reader.Read<uint64_t>();
+
+        if ( nCache == 0 || nCache % 4 != 0 )
+        {
+            throw std::runtime_error( "Corrupt snapshot: invalid random number cache size" );
+        }
+
+        std::unique_ptr<RANDOMBASE> rng;
+        switch ( type )
+        {
+        case RandomGenerator::PseudoDES:
+            rng.reset( new PSEUDO_DES( 0, size_t(nCache) ) );
+            break;
+
+        case RandomGenerator::KeyedDES:
+            rng.reset( new KEYED_DES( 0, size_t(nCache) ) );
+            break;
+
+        default:
+            throw std::runtime_error( "Corrupt snapshot: unknown random number generator" );
+        }
+
+        rng->deserialize_state( reader );
+        uint64_t position = reader.Read<uint64_t>();
+        rng->bGauss = reader.Read<uint8_t>() != 0;
+        rng->eGauss_ = reader.Read<double>();
+        rng->antithetic = reader.Read<uint8_t>() != 0;
+
+        if ( position > rng->cache_count )
+        {
+            throw std::runtime_error( "Corrupt snapshot: random number cache position out of range" );
+        }
+
+        if ( reader.Read<uint8_t>() != 0 )
+        {
+            std::unique_ptr<RANDOMBASE> nested( Deserialize( reader ) );
+            if ( nested->gaussian )
+            {
+                throw std::runtime_error( "Corrupt snapshot: nested gaussian random number streams" );
+            }
+            rng->gaussian = nested.release();
+        }
+
+        if ( position < rng->cache_count )
+        {
+            // regenerate the cache the saved stream was drawing from
+            rng->rewind( rng->cache_count );
+            rng->fill_bits();
+            rng->bits_to_float();
+        }
+        rng->index = size_t(position);
+
+        return rng.release();
+    }
+
     #define FLOAT_EXP   8
     #define DOUBLE_EXP 11
 
@@ -134,10 +277,19 @@ namespace emodlib
 
     double RANDOMBASE::eGauss()
     {
+        double sign = antithetic ? -1.0 : 1.0;
+
+        if (gaussian)
+        {
+            return sign * gaussian->eGauss();
+        }
+
+        EMODLIB_COUNT_DRAW(Gaussian);  // by the stream that draws it
+
         if (bGauss)
         {
             bGauss = false;
-            return eGauss_;
+            return sign * eGauss_;
         }
 
         double rad, norm;
@@ -154,11 +306,20 @@ namespace emodlib
         norm = sqrt(rad / s);
         eGauss_ = r1 * norm;
         bGauss = true;
-        return r2 * norm;
+        return sign * r2 * norm;
+    }
+
+    void RANDOMBASE::SetGaussianStream( RANDOMBASE* _gaussian, bool _antithetic )
+    {
+        delete gaussian;
+        gaussian = _gaussian;
+        antithetic = _antithetic;
     }
 
     double RANDOMBASE::ee()
     {
+        EMODLIB_COUNT_DRAW(UniformDouble);
+
         union
         {
             double ee;
@@ -181,6 +342,8 @@ namespace emodlib
     // Poisson() added by Philip Eckhoff, uses Gaussian approximation for ratetime>10
     uint64_t RANDOMBASE::Poisson(double ratetime)
     {
+        EMODLIB_COUNT_DRAW(Poisson);
+
         if (ratetime <= 0)
         {
             return 0;
@@ -217,6 +380,8 @@ namespace emodlib
     // Poisson_true added by Philip Eckhoff, actual Poisson, without approximation
     uint32_t RANDOMBASE::Poisson_true(double ratetime)
     {
+        EMODLIB_COUNT_DRAW(PoissonTrue);
+
         if (ratetime <= 0)
         {
             return 0;
@@ -249,6 +414,41 @@ namespace emodlib
     {
     }
 
+    RANDOMBASE* PSEUDO_DES::Clone() const
+    {
+        PSEUDO_DES* rng = new PSEUDO_DES( 0, cache_count );
+        rng->iSeq = iSeq;
+        rng->iNum = iNum;
+        rng->copy_cache( *this );
+        return rng;
+    }
+
+    RandomGenerator::Enum PSEUDO_DES::generator_type() const
+    {
+        return RandomGenerator::PseudoDES;
+    }
+
+    void PSEUDO_DES::serialize_state( BinaryWriter& writer ) const
+    {
+        writer.Write<uint32_t>( iSeq );
+        writer.Write<uint32_t>( iNum );
+    }
+
+    void PSEUDO_DES::deserialize_state( BinaryReader& reader )
+    {
+        iSeq = reader.Read<uint32_t>();
+        iNum = reader.Read<uint32_t>();
+    }
+
+    void PSEUDO_DES::rewind( size_t count )
+    {
+        // fill_bits() advances (iSeq, iNum) as one 64-bit counter
+        uint64_t counter = ( uint64_t(iSeq) << 32 ) | iNum;
+        counter -= count;
+        iSeq = uint32_t( counter >> 32 );
+        iNum = uint32_t( counter & 0xFFFFFFFF );
+    }
+
     const uint32_t c1[4] = {0xBAA96887L, 0x1E17D32CL, 0x03BCDC3CL, 0x0F33D1B2L};
     const uint32_t c2[4] = {0x4B0F3B58L, 0xE874F0C3L, 0x6955C5A6L, 0x55A7CA46L};
 
@@ -294,4 +494,106 @@ namespace emodlib
         }
     }
 
+
+    // ----------------------------------------------------------------------------
+    // --- KEYED_DES
+    // ----------------------------------------------------------------------------
+
+    #define KEY_COUNTER_BITS 20
+
+    // splitmix64 finalizer (Steele, Lea & Flood 2014)
+    static inline uint64_t mix64( uint64_t z )
+    {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    KEYED_DES::KEYED_DES( uint64_t iBase, size_t nCache )
+        : PSEUDO_DES( iBase, nCache )
+        , base( iBase )
+    {
+    }
+
+    KEYED_DES::~KEYED_DES()
+    {
+    }
+
+    RANDOMBASE* KEYED_DES::Clone() const
+    {
+        KEYED_DES* rng = new KEYED_DES( base, cache_count );
+        rng->iSeq = iSeq;
+        rng->iNum = iNum;
+        rng->copy_cache( *this );
+        return rng;
+    }
+
+    RandomGenerator::Enum KEYED_DES::generator_type() const
+    {
+        return RandomGenerator::KeyedDES;
+    }
+
+    void KEYED_DES::serialize_state( BinaryWriter& writer ) const
+    {
+        PSEUDO_DES::serialize_state( writer );
+        writer.Write<uint64_t>( base );
+    }
+
+    void KEYED_DES::deserialize_state( BinaryReader& reader )
+    {
+        PSEUDO_DES::deserialize_state( reader );
+        base = reader.Read<uint64_t>();
+    }
+
+    void KEYED_DES::set_key( uint32_t stream, uint32_t purpose, uint32_t step, uint32_t item )
+    {
+        uint64_t key = mix64( base + 0x9E3779B97F4A7C15ULL );
+        key = mix64( key ^ ( (uint64_t(stream) << 32) | purpose ) );
+        key = mix64( key ^ ( (uint64_t(step) << 32) | item ) );
+
+        iSeq = uint32_t( key & 0xFFFFFFFF );
+        iNum = uint32_t( key >> 32 ) & ~((1u << KEY_COUNTER_BITS) - 1);
+
+        index = cache_count;  // next draw refills the cache from the new position
+        bGauss = false;
+    }
+
+
+
+    // ----------------------------------------------------------------------------
+    // --- PRESET_SEQUENCE
+    // ----------------------------------------------------------------------------
+
+    PRESET_SEQUENCE::PRESET_SEQUENCE( const std::vector<uint32_t>& _sequence )
+        : RANDOMBASE( 4 )
+        , sequence( _sequence )
+        , position( 0 )
+    {
+        // the cache is refilled four draws at a time, so pad to a whole number of fills
+        sequence.resize( ( sequence.size() + 3 ) & ~size_t(3), 0 );
+    }
+
+    PRESET_SEQUENCE::~PRESET_SEQUENCE()
+    {
+    }
+
+    RANDOMBASE* PRESET_SEQUENCE::Clone() const
+    {
+        PRESET_SEQUENCE* rng = new PRESET_SEQUENCE( sequence );
+        rng->position = position;
+        rng->copy_cache( *this );
+        return rng;
+    }
+
+    void PRESET_SEQUENCE::fill_bits()
+    {
+        if ( position + cache_count > sequence.size() )
+        {
+            throw std::logic_error( "PRESET_SEQUENCE exhausted" );
+        }
+
+        memcpy( random_bits, sequence.data() + position, cache_count * sizeof( uint32_t ) );
+        position += cache_count;
+    }
+
 }
@@ -21,6 +21,17 @@
 namespace emodlib
 {
 
+    class BinaryWriter;
+    class BinaryReader;
+
+    // Generator tags stored in snapshots
+    namespace RandomGenerator {
+        enum Enum {
+            PseudoDES = 1,
+            KeyedDES = 2,
+        };
+    }
+
     // ------------------------------------------------------------------------
     // --- RANDOMBASE
     // ------------------------------------------------------------------------
@@ -44,6 +55,11 @@ namespace emodlib
         double ee();
         double eGauss();    // Returns a normal deviate.
 
+        // Takes ownership of a separate stream for normal deviates, returning -z for each of its deviates z
+        // if antithetic, so that a pair of hosts can share Gaussian noise with opposite signs while their
+        // uniform draws stay independent.  Keys are forwarded to it.
+        void SetGaussianStream( RANDOMBASE* _gaussian, bool _antithetic=false );
+
         // Added by Philip Eckhoff, Poisson takes in a rate, and returns the number of events in unit time
         // Or equivalently, takes in rate*time and returns number of events in that time
         // Poisson uses a Gaussian approximation for large lambda, while Poisson_true is the fully accurate Poisson
@@ -51,11 +67,31 @@ namespace emodlib
         uint64_t Poisson(double=1.0);
         uint32_t Poisson_true(double=1.0);
 
+        // Repositions a keyed stream so the draws that follow depend only on the key,
+        // not on how many numbers were consumed before.  Sequential streams ignore it.
+        void SetKey( uint32_t stream, uint32_t purpose, uint32_t step, uint32_t item );
+
+        // Position in the stream, compact enough to store per host: the cache is
+        // regenerated on restore rather than saved
+        void Serialize( BinaryWriter& writer ) const;
+        static RANDOMBASE* Deserialize( BinaryReader& reader );
+
+        // Independent copy at the same position, including the unconsumed cache
+        virtual RANDOMBASE* Clone() const;
+
     protected:
 
         virtual void fill_bits();
         void bits_to_float();
 
+        virtual void set_key( uint32_t stream, uint32_t purpose, uint32_t step, uint32_t item );
+
+        virtual RandomGenerator::Enum generator_type() const;
+        virtual void serialize_state( BinaryWriter& writer ) const;
+        virtual void deserialize_state( BinaryReader& reader );
+        virtual void rewind( size_t count );  // step the counter back by count draws
+        void copy_cache( const RANDOMBASE& other );
+
         size_t    cache_count;
         size_t    index;
         uint32_t* random_bits;
@@ -64,6 +100,9 @@ namespace emodlib
         bool   bGauss;
         double eGauss_;
 
+        RANDOMBASE* gaussian;  // owned source of normal deviates, else nullptr to draw them from this stream
+        bool   antithetic;
+
     };
 
 
@@ -79,11 +118,69 @@ namespace emodlib
         PSEUDO_DES( uint64_t iSequence = 0, size_t nCache = 0 );
         ~PSEUDO_DES();
 
+        virtual RANDOMBASE* Clone() const override;
+
     protected:
         virtual void fill_bits() override;
 
+        virtual RandomGenerator::Enum generator_type() const override;
+        virtual void serialize_state( BinaryWriter& writer ) const override;
+        virtual void deserialize_state( BinaryReader& reader ) override;
+        virtual void rewind( size_t count ) override;
+
         uint32_t iSeq;
         uint32_t iNum;
     };
 
+
+
+    // ------------------------------------------------------------------------
+    // --- KEYED_DES
+    // ------------------------------------------------------------------------
+    // PSEUDO_DES whose position is a hash of (base, stream, purpose, step, item)
+    // whenever SetKey() is called: 44 bits of key select iSeq and the top of iNum,
+    // leaving the low 20 bits of iNum as a counter for draws within one key.
+
+    class KEYED_DES : public PSEUDO_DES
+    {
+
+    public:
+        KEYED_DES( uint64_t iBase = 0, size_t nCache = 16 );
+        ~KEYED_DES();
+
+        virtual RANDOMBASE* Clone() const override;
+
+    protected:
+        virtual void set_key( uint32_t stream, uint32_t purpose, uint32_t step, uint32_t item ) override;
+        virtual RandomGenerator::Enum generator_type() const override;
+        virtual void serialize_state( BinaryWriter& writer ) const override;
+        virtual void deserialize_state( BinaryReader& reader ) override;
+
+        uint64_t base;
+    };
+
+
+
+    // ------------------------------------------------------------------------
+    // --- PRESET_SEQUENCE
+    // ------------------------------------------------------------------------
+    // Replays a precomputed sequence of 32-bit draws, e.g. stratified across an
+    // ensemble, then fails rather than repeat it.  Not serializable.
+
+    class PRESET_SEQUENCE : public RANDOMBASE
+    {
+
+    public:
+        PRESET_SEQUENCE( const std::vector<uint32_t>& _sequence );
+        ~PRESET_SEQUENCE();
+
+        virtual RANDOMBASE* Clone() const override;
+
+    protected:
+        virtual void fill_bits() override;
+
+        std::vector<uint32_t> sequence;
+        size_t position;
+    };
+
 }
@@ -0,0 +1,260 @@
+#include "Scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <string>
+
+#include "Tracer.h"
+
+#define TASKS_PER_THREAD (8) // oversubscription of tasks so that there is something left to steal
+
+
+namespace emodlib
+{
+
+    typedef std::chrono::steady_clock clock_type;
+
+    static double seconds_since( clock_type::time_point start )
+    {
+        return std::chrono::duration<double>( clock_type::now() - start ).count();
+    }
+
+    // ----------------------------------------------------------------------------
+    // --- WorkStealingScheduler
+    // ----------------------------------------------------------------------------
+
+    WorkStealingScheduler::WorkStealingScheduler( int nThreads )
+        : n_threads( nThreads > 1 ? nThreads : 1 )
+        , workers()
+        , threads()
+        , stats()
+        , pending()
+        , job_generation( 0 )
+        , workers_active( 0 )
+        , shutdown( false )
+        , job( nullptr )
+        , tasks_remaining( 0 )
+        , job_error( nullptr )
+    {
+        for (int i = 0; i < n_threads; i++)
+        {
+            workers.emplace_back( new Worker() );
+        }
+        ResetStats();
+
+        for (int i = 1; i < n_threads; i++)
+        {
+            threads.emplace_back( &WorkStealingScheduler::workerLoop, this, i );
+        }
+    }
+
+    WorkStealingScheduler::~WorkStealingScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock( job_mutex );
+            shutdown = true;
+        }
+        job_start.notify_all();
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    void WorkStealingScheduler::ParallelFor( size_t nItems, const RangeFunction& fn )
+    {
+        pending.clear();
+
+        size_t n_tasks = std::min( nItems, size_t(n_threads * TASKS_PER_THREAD) );
+        for (size_t i = 0; i < n_tasks; i++)
+        {
+            pending.push_back( Task{ i * nItems / n_tasks, (i + 1) * nItems / n_tasks } );
+        }
+
+        run( fn );
+    }
+
+    void WorkStealingScheduler::ParallelFor( const std::vector<float>& costs, const RangeFunction& fn )
+    {
+        pending.clear();
+
+        // Greedily close a task once it accumulates its share of the total cost,
+        // so a single very expensive item ends up alone in its own task
+        double total  = std::accumulate( costs.begin(), costs.end(), 0.0 );
+        double target = total / (n_threads * TASKS_PER_THREAD);
+
+        size_t begin = 0;
+        double accumulated = 0;
+        for (size_t i = 0; i < costs.size(); i++)
+        {
+            accumulated += costs[i];
+            if (accumulated >= target)
+            {
+                pending.push_back( Task{ begin, i + 1 } );
+                begin = i + 1;
+                accumulated = 0;
+            }
+        }
+
+        if (begin < costs.size())
+        {
+            pending.push_back( Task{ begin, costs.size() } );
+        }
+
+        run( fn );
+    }
+
+    void WorkStealingScheduler::run( const RangeFunction& fn )
+    {
+        if (pending.empty()) return;
+
+        // deal contiguous runs of tasks to each worker to preserve locality until stealing kicks in
+        for (int w = 0; w < n_threads; w++)
+        {
+            size_t first = w * pending.size() / n_threads;
+            size_t last  = (w + 1) * pending.size() / n_threads;
+
+            std::lock_guard<std::mutex> lock( workers[w]->mutex );
+            workers[w]->tasks.assign( pending.begin() + first, pending.begin() + last );
+        }
+
+        job = &fn;
+        job_error = nullptr;
+        tasks_remaining = pending.size();
+
+        {
+            std::lock_guard<std::mutex> lock( job_mutex );
+            workers_active = n_threads - 1;
+            job_generation++;
+        }
+        job_start.notify_all();
+
+        runTasks( 0 );
+
+        {
+            std::unique_lock<std::mutex> lock( job_mutex );
+            job_done.wait( lock, [this]{ return workers_active == 0; } );
+        }
+
+        job = nullptr;
+
+        if (job_error)
+        {
+            std::rethrow_exception( job_error );
+        }
+    }
+
+    void WorkStealingScheduler::workerLoop( int id )
+    {
+        uint64_t generation = 0;
+        Tracer::SetThreadName( "worker " + std::to_string( id ) );
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock( job_mutex );
+                job_start.wait( lock, [&]{ return shutdown || job_generation != generation; } );
+                if (shutdown) return;
+                generation = job_generation;
+            }
+
+            runTasks( id );
+
+            {
+                std::lock_guard<std::mutex> lock( job_mutex );
+                if (--workers_active == 0)
+                {
+                    job_done.notify_one();
+                }
+            }
+        }
+    }
+
+    void WorkStealingScheduler::runTasks( int id )
+    {
+        auto start = clock_type::now();
+        double busy = 0;
+
+        Task task;
+        while (tasks_remaining.load() > 0)
+        {
+            bool stolen = false;
+            if (!popTask( id, task ))
+            {
+                if (!stealTask( id, task ))
+                {
+                    std::this_thread::yield();  // remaining tasks are already running elsewhere
+                    continue;
+                }
+                stolen = true;
+            }
+
+            auto task_start = clock_type::now();
+            try
+            {
+                EMODLIB_TRACE_SCOPE( "scheduler", stolen ? "stolen task" : "task", int64_t(task.begin), int64_t(task.end) );
+                (*job)( task.begin, task.end );
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock( job_mutex );
+                if (!job_error) job_error = std::current_exception();
+            }
+            busy += seconds_since( task_start );
+
+            stats[id].tasks++;
+            if (stolen) stats[id].steals++;
+
+            tasks_remaining--;
+        }
+
+        stats[id].busy_seconds += busy;
+        stats[id].idle_seconds += seconds_since( start ) - busy;
+    }
+
+    bool WorkStealingScheduler::popTask( int id, Task& task )
+    {
+        Worker& worker = *workers[id];
+        std::lock_guard<std::mutex> lock( worker.mutex );
+
+        if (worker.tasks.empty()) return false;
+
+        task = worker.tasks.front();
+        worker.tasks.pop_front();
+        return true;
+    }
+
+    bool WorkStealingScheduler::stealTask( int id, Task& task )
+    {
+        for (int i = 1; i < n_threads; i++)
+        {
+            Worker& victim = *workers[(id + i) % n_threads];
+            std::lock_guard<std::mutex> lock( victim.mutex );
+
+            if (victim.tasks.empty()) continue;
+
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    int WorkStealingScheduler::GetNumThreads() const
+    {
+        return n_threads;
+    }
+
+    const std::vector<WorkStealingScheduler::WorkerStats>& WorkStealingScheduler::GetStats() const
+    {
+        return stats;
+    }
+
+    void WorkStealingScheduler::ResetStats()
+    {
+        stats.assign( n_threads, WorkerStats{ 0, 0, 0.0, 0.0 } );
+    }
+
+}
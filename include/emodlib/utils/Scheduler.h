@@ -0,0 +1,99 @@
+/**
+ * @file Scheduler.h
+ *
+ * @brief Work-stealing scheduler for ranges of heterogeneous-cost items
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+
+namespace emodlib
+{
+
+    // ------------------------------------------------------------------------
+    // --- WorkStealingScheduler
+    // ------------------------------------------------------------------------
+    // Splits [0, n) into tasks of roughly equal estimated cost, deals contiguous
+    // runs of tasks to per-worker deques, and lets idle workers steal from the
+    // back of other workers' deques. The calling thread participates as worker 0.
+
+    class WorkStealingScheduler
+    {
+
+    public:
+
+        struct WorkerStats
+        {
+            uint64_t tasks;
+            uint64_t steals;
+            double   busy_seconds;
+            double   idle_seconds;
+        };
+
+        typedef std::function<void(size_t, size_t)> RangeFunction;
+
+        explicit WorkStealingScheduler( int nThreads = 1 );
+        ~WorkStealingScheduler();
+
+        // Items of uniform cost
+        void ParallelFor( size_t nItems, const RangeFunction& fn );
+
+        // Items with a relative cost estimate each
+        void ParallelFor( const std::vector<float>& costs, const RangeFunction& fn );
+
+        int GetNumThreads() const;
+        const std::vector<WorkerStats>& GetStats() const;
+        void ResetStats();
+
+    private:
+
+        struct Task
+        {
+            size_t begin;
+            size_t end;
+        };
+
+        struct Worker
+        {
+            std::mutex       mutex;
+            std::deque<Task> tasks;
+        };
+
+        int n_threads;
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::vector<std::thread> threads;
+        std::vector<WorkerStats> stats;
+        std::vector<Task> pending;
+
+        std::mutex              job_mutex;
+        std::condition_variable job_start;
+        std::condition_variable job_done;
+        uint64_t                job_generation;
+        int                     workers_active;
+        bool                    shutdown;
+
+        const RangeFunction* job;
+        std::atomic<size_t>  tasks_remaining;
+        std::exception_ptr   job_error;
+
+        void run( const RangeFunction& fn );
+        void workerLoop( int id );
+        void runTasks( int id );
+        bool popTask( int id, Task& task );
+        bool stealTask( int id, Task& task );
+
+    };
+
+}
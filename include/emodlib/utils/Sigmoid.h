@@ -7,9 +7,11 @@ namespace emodlib
 
     struct Sigmoid
     {
-        inline static double basic_sigmoid ( double threshold = 100.0, double variable = 0.0 )
+        // evaluated in the precision of its arguments
+        template<typename T>
+        inline static T basic_sigmoid ( T threshold = T(100), T variable = T(0) )
         {
-            return (variable > 0) ? (variable / (threshold + variable)) : 0.0;
+            return (variable > 0) ? (variable / (threshold + variable)) : T(0);
         }
 
 
@@ -0,0 +1,154 @@
+/**
+ * @file SpscRing.h
+ *
+ * @brief Lock-free single-producer, single-consumer ring of reusable slots
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+
+namespace emodlib
+{
+
+    // What a producer does when the ring is full
+    namespace Backpressure
+    {
+        enum Enum
+        {
+            Block,  // wait for the consumer, so nothing is lost
+            Drop,   // discard the block and count it, so the producer never waits
+        };
+    }
+
+
+    // ------------------------------------------------------------------------
+    // --- SpscRing
+    // ------------------------------------------------------------------------
+    // Slots are filled and drained in place, so blocks as large as a chunk of trajectories
+    // pass between threads without copies or allocation.  The producer claims the slot
+    // after the last published one and publishes it once filled; the consumer reads the
+    // oldest published slot and pops it once done.  Each side caches the other's index,
+    // touching the shared cache line only when the ring looks full or empty.
+
+    template <typename T>
+    class SpscRing
+    {
+
+    public:
+
+        explicit SpscRing( size_t capacity )
+            : slots( round_up( capacity ) )
+            , mask( slots.size() - 1 )
+            , head( 0 )
+            , cached_tail( 0 )
+            , tail( 0 )
+            , cached_head( 0 )
+        {
+        }
+
+        SpscRing( const SpscRing& ) = delete;
+        SpscRing& operator=( const SpscRing& ) = delete;
+
+        size_t Capacity() const { return slots.size(); }
+
+        std::vector<T>& Slots() { return slots; }  // to size them before either thread starts
+
+        // Producer: the slot to fill next, or nullptr while the ring is full
+        T* Claim()
+        {
+            size_t t = tail.load( std::memory_order_relaxed );
+            if (t - cached_head == slots.size())
+            {
+                cached_head = head.load( std::memory_order_acquire );
+                if (t - cached_head == slots.size()) return nullptr;
+            }
+            return &slots[t & mask];
+        }
+
+        void Publish()
+        {
+            tail.store( tail.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        }
+
+        // Consumer: the oldest published slot, or nullptr while the ring is empty
+        T* Front()
+        {
+            size_t h = head.load( std::memory_order_relaxed );
+            if (h == cached_tail)
+            {
+                cached_tail = tail.load( std::memory_order_acquire );
+                if (h == cached_tail) return nullptr;
+            }
+            return &slots[h & mask];
+        }
+
+        void Pop()
+        {
+            head.store( head.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        }
+
+        // Either side: nothing published and not yet popped
+        bool Empty() const
+        {
+            return head.load( std::memory_order_acquire ) == tail.load( std::memory_order_acquire );
+        }
+
+    private:
+
+        static size_t round_up( size_t n )
+        {
+            size_t capacity = 1;
+            while (capacity < n) capacity <<= 1;
+            return capacity;
+        }
+
+        // the consumer's and producer's indices on separate cache lines
+        std::vector<T> slots;
+        size_t mask;
+        char pad0[64];
+        std::atomic<size_t> head;  // written by the consumer
+        size_t cached_tail;        // the consumer's last look at tail
+        char pad1[64];
+        std::atomic<size_t> tail;  // written by the producer
+        size_t cached_head;        // the producer's last look at head
+        char pad2[64];
+    };
+
+
+    // Yields, then sleeps for longer and longer up to a millisecond, for one side of a ring waiting on the other
+    class RingBackoff
+    {
+
+    public:
+
+        RingBackoff() : n( 0 ), sleep( 50 ) {}
+
+        void Wait()
+        {
+            if (n < 64)
+            {
+                std::this_thread::yield();
+                n++;
+            }
+            else
+            {
+                std::this_thread::sleep_for( std::chrono::microseconds( sleep ) );
+                if (sleep < 1000) sleep *= 2;
+            }
+        }
+
+        void Reset() { n = 0; sleep = 50; }
+
+    private:
+
+        int n;
+        int sleep;  // microseconds
+    };
+
+}
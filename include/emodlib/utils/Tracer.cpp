@@ -0,0 +1,281 @@
+/**
+ * @file Tracer.cpp
+ *
+ * @brief Per-thread trace buffers and their Chrome trace JSON
+ */
+
+#include "Tracer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+namespace emodlib
+{
+
+    struct TraceEvent
+    {
+        const char* category;
+        const char* name;
+        uint64_t    start;
+        uint64_t    duration;
+        int64_t     arg0;
+        int64_t     arg1;
+    };
+
+    static const size_t CHUNK_EVENTS = 1 << 12;
+
+    // Appended only by its own thread.  The chunk table is sized on the first event after each Start,
+    // and chunks are allocated as they fill, then kept for the thread's later traces.
+    struct ThreadTrace
+    {
+        std::vector<std::unique_ptr<TraceEvent[]>> chunks;
+        size_t                  limit;  // events, for the current trace
+        std::atomic<size_t>     size;
+        std::atomic<size_t>     dropped;
+        std::atomic<size_t>     n_chunks;
+        uint64_t                generation;
+        int                     tid;
+        std::string             name;
+        bool                    finished;  // the thread has exited
+
+        explicit ThreadTrace( int _tid )
+            : chunks(), limit( 0 ), size( 0 ), dropped( 0 ), n_chunks( 0 ), generation( 0 ), tid( _tid ), name(), finished( false ) {}
+
+        const TraceEvent& event( size_t i ) const { return chunks[i / CHUNK_EVENTS][i % CHUNK_EVENTS]; }
+    };
+
+    static std::atomic<bool>     active( false );
+    static std::atomic<uint64_t> generation( 0 );
+    static std::atomic<int64_t>  epoch( 0 );
+    static std::atomic<int>      open_scopes( 0 );  // recording scopes not yet completed, for Stop to wait on
+    static size_t                capacity = 0;      // under registry_mutex
+
+    // Buffers outlive their threads until the next Start, so that the trace keeps the tasks of finished workers
+    static std::mutex registry_mutex;
+    static std::vector<std::unique_ptr<ThreadTrace>> registry;
+    static int next_tid = 0;
+
+    static int64_t steady_ns()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    // Marks the thread's buffer finished as the thread exits, for the next Start to free
+    struct LocalTrace
+    {
+        ThreadTrace* trace;
+
+        LocalTrace() : trace( nullptr ) {}
+        ~LocalTrace()
+        {
+            if (!trace) return;
+            std::lock_guard<std::mutex> lock( registry_mutex );
+            trace->finished = true;
+        }
+    };
+
+    static ThreadTrace& local_trace()
+    {
+        thread_local LocalTrace local;
+        if (!local.trace)
+        {
+            std::lock_guard<std::mutex> lock( registry_mutex );
+            registry.emplace_back( new ThreadTrace( next_tid++ ) );
+            local.trace = registry.back().get();
+        }
+        return *local.trace;
+    }
+
+    // ----------------------------------------------------------------------------
+    // --- Tracer
+    // ----------------------------------------------------------------------------
+
+    void Tracer::Start( size_t events_per_thread )
+    {
+        std::lock_guard<std::mutex> lock( registry_mutex );
+
+        registry.erase( std::remove_if( registry.begin(), registry.end(),
+                                        []( const std::unique_ptr<ThreadTrace>& trace ) { return trace->finished; } ),
+                        registry.end() );
+
+        capacity = events_per_thread;
+        epoch = steady_ns();
+        generation++;
+        active = true;
+    }
+
+    // Any scope that saw the trace active is counted before Stop clears it, so that no event
+    // is being appended once Stop returns and WriteChromeTrace may read the buffers
+    void Tracer::Stop()
+    {
+        active = false;
+        while (open_scopes.load() > 0) std::this_thread::yield();
+    }
+
+    bool Tracer::Open()
+    {
+        if (!active.load( std::memory_order_relaxed )) return false;
+
+        open_scopes++;
+        if (active.load()) return true;
+
+        open_scopes--;  // raced with Stop
+        return false;
+    }
+
+    bool Tracer::Active()
+    {
+        return active.load( std::memory_order_relaxed );
+    }
+
+    uint64_t Tracer::Now()
+    {
+        return uint64_t( steady_ns() - epoch.load( std::memory_order_relaxed ) );
+    }
+
+    void Tracer::SetThreadName( const std::string& name )
+    {
+        ThreadTrace& trace = local_trace();
+        std::lock_guard<std::mutex> lock( registry_mutex );
+        trace.name = name;
+    }
+
+    void Tracer::Complete( const char* category, const char* name, uint64_t start, int64_t arg0, int64_t arg1 )
+    {
+        uint64_t end = Now();
+        ThreadTrace& trace = local_trace();
+
+        uint64_t current = generation.load( std::memory_order_acquire );
+        if (trace.generation != current)
+        {
+            // the first event of a trace takes its capacity, and the generation read with it, under the lock;
+            // drops the chunks beyond a smaller capacity, keeping the rest
+            std::lock_guard<std::mutex> lock( registry_mutex );
+            current = generation.load( std::memory_order_relaxed );
+            trace.limit = capacity;
+            trace.chunks.resize( (capacity + CHUNK_EVENTS - 1) / CHUNK_EVENTS );
+            size_t n_chunks = 0;
+            for (const auto& chunk : trace.chunks) n_chunks += chunk ? 1 : 0;
+            trace.n_chunks.store( n_chunks, std::memory_order_relaxed );
+            trace.size.store( 0, std::memory_order_relaxed );
+            trace.dropped.store( 0, std::memory_order_relaxed );
+            trace.generation = current;
+        }
+
+        size_t n = trace.size.load( std::memory_order_relaxed );
+        if (n >= trace.limit)
+        {
+            trace.dropped.store( trace.dropped.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            open_scopes--;
+            return;
+        }
+
+        std::unique_ptr<TraceEvent[]>& chunk = trace.chunks[n / CHUNK_EVENTS];
+        if (!chunk)
+        {
+            chunk.reset( new TraceEvent[CHUNK_EVENTS] );
+            trace.n_chunks.store( trace.n_chunks.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+        }
+
+        chunk[n % CHUNK_EVENTS] = TraceEvent{ category, name, start, end - start, arg0, arg1 };
+        trace.size.store( n + 1, std::memory_order_release );
+        open_scopes--;
+    }
+
+    size_t Tracer::GetNumEvents()
+    {
+        std::lock_guard<std::mutex> lock( registry_mutex );
+        size_t n = 0;
+        for (const auto& trace : registry)
+        {
+            if (trace->generation == generation) n += trace->size.load( std::memory_order_acquire );
+        }
+        return n;
+    }
+
+    size_t Tracer::GetNumDropped()
+    {
+        std::lock_guard<std::mutex> lock( registry_mutex );
+        size_t n = 0;
+        for (const auto& trace : registry)
+        {
+            if (trace->generation == generation) n += trace->dropped.load( std::memory_order_relaxed );
+        }
+        return n;
+    }
+
+    size_t Tracer::GetNumBytes()
+    {
+        std::lock_guard<std::mutex> lock( registry_mutex );
+        size_t n = 0;
+        for (const auto& trace : registry)
+        {
+            n += trace->n_chunks.load( std::memory_order_relaxed ) * CHUNK_EVENTS * sizeof(TraceEvent);
+        }
+        return n;
+    }
+
+    static std::string escaped( const std::string& text )
+    {
+        std::string out;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out;
+    }
+
+    void Tracer::WriteChromeTrace( const std::string& path )
+    {
+        if (Active()) throw std::logic_error( "Stop the trace before writing it" );
+
+        FILE* out = fopen( path.c_str(), "w" );
+        if (!out) throw std::runtime_error( "Cannot write trace to " + path );
+
+        std::lock_guard<std::mutex> lock( registry_mutex );
+
+        size_t dropped = 0;
+        bool first = true;
+        fprintf( out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [" );
+
+        for (const auto& trace : registry)
+        {
+            if (trace->generation != generation) continue;  // no events in this trace
+
+            std::string name = trace->name.empty() ? "thread " + std::to_string( trace->tid ) : trace->name;
+            fprintf( out, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                     first ? "" : ",", trace->tid, escaped( name ).c_str() );
+            first = false;
+
+            size_t n = trace->size.load( std::memory_order_acquire );
+            for (size_t i = 0; i < n; i++)
+            {
+                const TraceEvent& e = trace->event( i );
+                fprintf( out, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                         e.name, e.category, trace->tid, e.start * 1e-3, e.duration * 1e-3 );
+                if (e.arg0 >= 0)
+                {
+                    fprintf( out, ", \"args\": {\"begin\": %lld, \"end\": %lld}", (long long)e.arg0, (long long)e.arg1 );
+                }
+                fprintf( out, "}" );
+            }
+            dropped += trace->dropped.load( std::memory_order_relaxed );
+        }
+
+        fprintf( out, "\n], \"otherData\": {\"dropped_events\": %zu}}\n", dropped );
+
+        bool failed = ferror( out ) != 0;
+        fclose( out );
+        if (failed) throw std::runtime_error( "Failed writing trace to " + path );
+    }
+
+}
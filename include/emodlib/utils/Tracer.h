@@ -0,0 +1,76 @@
+/**
+ * @file Tracer.h
+ *
+ * @brief Opt-in timeline of simulation steps, scheduler tasks, RNG refills and output, as Chrome trace JSON
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+
+namespace emodlib
+{
+
+    // ------------------------------------------------------------------------
+    // --- Tracer
+    // ------------------------------------------------------------------------
+    // Events go to a buffer per thread, appended by its thread alone without locks and allocated
+    // in chunks as it fills, up to a fixed capacity; a full buffer drops further events and counts
+    // them.  Buffers of exited threads are kept until the next Start, so that the trace keeps their
+    // events.  Names and categories must be string literals, since only the pointers are kept.
+    // The trace is written once recording has stopped, as Chrome trace JSON for chrome://tracing or Perfetto.
+
+    class Tracer
+    {
+
+    public:
+
+        static void Start( size_t events_per_thread = (1 << 20) );  // discards any previous trace
+        static void Stop();  // returns once every scope opened while recording has completed
+        static bool Active();
+
+        static void WriteChromeTrace( const std::string& path );  // after Stop
+        static size_t GetNumEvents();
+        static size_t GetNumDropped();
+        static size_t GetNumBytes();  // held by the buffers, to leave out of memory measurements
+
+        static void SetThreadName( const std::string& name );  // shown for this thread's track
+
+        static uint64_t Now();  // nanoseconds since Start
+        static bool Open();  // whether a scope opening now records, counted until its Complete
+        static void Complete( const char* category, const char* name, uint64_t start, int64_t arg0, int64_t arg1 );
+
+    };
+
+
+    // Records the enclosing scope as one complete event, if a trace is being recorded when it opens
+    class TraceScope
+    {
+
+    public:
+        TraceScope( const char* _category, const char* _name, int64_t _arg0 = -1, int64_t _arg1 = -1 )
+            : category( _category ), name( _name ), arg0( _arg0 ), arg1( _arg1 )
+            , active( Tracer::Open() ), start( active ? Tracer::Now() : 0 ) {}
+        ~TraceScope() { if (active) Tracer::Complete( category, name, start, arg0, arg1 ); }
+
+        TraceScope( const TraceScope& ) = delete;
+        TraceScope& operator=( const TraceScope& ) = delete;
+
+    private:
+        const char* category;
+        const char* name;
+        int64_t     arg0;  // e.g. the range of a scheduler task, written as begin and end; -1 if unused
+        int64_t     arg1;
+        bool        active;
+        uint64_t    start;
+    };
+
+}
+
+
+#define EMODLIB_TRACE_CONCAT_(a, b) a##b
+#define EMODLIB_TRACE_CONCAT(a, b) EMODLIB_TRACE_CONCAT_(a, b)
+#define EMODLIB_TRACE_SCOPE(category, ...) ::emodlib::TraceScope EMODLIB_TRACE_CONCAT(emodlib_trace_scope_, __LINE__)( category, __VA_ARGS__ )
@@ -19,3 +19,14 @@ def tests(session: nox.Session) -> None:
     """
     session.install(".[test]")
     session.run("pytest", *session.posargs)
+
+
+@nox.session
+def bench(session: nox.Session) -> None:
+    """
+    Build and run the native microbenchmarks, writing JSON results to build/bench/results.json.
+    """
+    session.install("cmake")
+    session.run("cmake", "-S", ".", "-B", "build/bench", "-DCMAKE_BUILD_TYPE=Release")
+    session.run("cmake", "--build", "build/bench", "--target", "emodlib_bench", "--parallel")
+    session.run("build/bench/emodlib_bench", "--json=build/bench/results.json", *session.posargs, external=True)
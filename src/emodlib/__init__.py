@@ -1,4 +1,5 @@
 from ._emodlib_py import __doc__, __version__
 from .params import Params
+from .tracing import trace
 
-__all__ = ["__doc__", "__version__", "Params"]
+__all__ = ["__doc__", "__version__", "Params", "trace"]
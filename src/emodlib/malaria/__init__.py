@@ -1,12 +1,31 @@
+import contextlib
 import os
 
-from .._emodlib_py.malaria import Infection, IntrahostComponent, Susceptibility
-from ..params import Params, set_params, update_params
+from .._emodlib_py.malaria import (
+    CLONAL_PFEMP1_VARIANTS,
+    AggregateReporter,
+    INSTRUMENTATION,
+    PRECISION,
+    Infection,
+    IntrahostComponent,
+    IntrahostParams,
+    Population,
+    Susceptibility,
+    TrajectoryWriter,
+    instrumentation_stats,
+    reset_instrumentation,
+)
+from .batch import BatchTrajectories, run_batch
+from .precision import record_trajectories, load_trajectories, trajectory_divergence
+from .golden import record_golden, compare_golden
+from .splitting import SplittingResult, run_splitting
+from .trajectories import HostTrajectories, open_trajectories
+from ..params import Params, params_block, set_params, update_params
 
 
 def params_from_default_file():
     path = os.path.join(os.path.realpath(os.path.dirname(__file__)), "config.yml")
-    return Params.from_yaml(path)
+    return Params.from_file(path)
 
 
 IntrahostComponent.default_params = params_from_default_file()
@@ -16,8 +35,51 @@ IntrahostComponent.default_params = params_from_default_file()
 IntrahostComponent.set_params = set_params
 IntrahostComponent.update_params = update_params
 
+# monkey-patch params_block
+# immutable block nested on top of defaults, for hosts + populations created with it
+IntrahostComponent.params_block = params_block
+
+
+
+@contextlib.contextmanager
+def modify_host(self, index):
+    """The host at index, to change other than by challenge or treat; it moves to its new partition on leaving the block"""
+    host = self.acquire_host(index)
+    try:
+        yield host
+    finally:
+        self.release_host(index)
+
+
+# monkey-patch modify_host
+Population.modify_host = modify_host
+
 # initialize default parameters
 IntrahostComponent.set_params()
 
 
-__all__ = ["IntrahostComponent", "Susceptibility", "Infection"]
+__all__ = [
+    "CLONAL_PFEMP1_VARIANTS",
+    "INSTRUMENTATION",
+    "PRECISION",
+    "IntrahostComponent",
+    "IntrahostParams",
+    "Susceptibility",
+    "Infection",
+    "Population",
+    "AggregateReporter",
+    "TrajectoryWriter",
+    "HostTrajectories",
+    "open_trajectories",
+    "instrumentation_stats",
+    "reset_instrumentation",
+    "BatchTrajectories",
+    "run_batch",
+    "record_trajectories",
+    "load_trajectories",
+    "trajectory_divergence",
+    "record_golden",
+    "compare_golden",
+    "SplittingResult",
+    "run_splitting",
+]
@@ -0,0 +1,311 @@
+"""
+Golden-trajectory regression harness.
+
+A reference build records challenge trajectories for a fixed set of seeds and scenarios;
+a candidate build (another precision, variant count, or optimized kernels) records the same
+protocol and is compared against it: bitwise where the candidate promises identical numerics,
+otherwise by two-sample Kolmogorov-Smirnov and Anderson-Darling tests on per-host outcomes.
+"""
+
+import argparse
+import json
+import math
+import os
+import sys
+
+from .._emodlib_py.malaria import CLONAL_PFEMP1_VARIANTS, PRECISION
+from .precision import load_trajectories, record_trajectories
+
+GOLDEN_SEEDS = (12345, 23456, 34567, 45678)
+
+# challenge days of each scenario
+GOLDEN_SCENARIOS = {
+    "naive": (0,),
+    "repeated": (0, 60, 120, 180, 240, 300),
+}
+
+FEVER_THRESHOLD = 38.5  # degrees Celsius, for counting fever days
+
+OUTCOMES = ("peak_log_density", "mean_log_density", "patent_days", "clearance_day",
+            "fever_days", "peak_log_gametocytes", "mean_infectiousness")
+
+
+def record_golden(directory, seeds=GOLDEN_SEEDS, scenarios=None, n_hosts=50, duration=365, n_threads=1):
+    """
+    Record one trajectory file per scenario into directory, each with one parameter set per seed.
+
+    Every parameter set is the default configuration with its own Run_Number, so the hosts of
+    different seeds are independent replicates of the same model.
+    """
+    scenarios = GOLDEN_SCENARIOS if scenarios is None else scenarios
+    os.makedirs(directory, exist_ok=True)
+
+    param_sets = [dict(Run_Number=seed) for seed in seeds]
+    for name, challenge_days in scenarios.items():
+        record_trajectories(os.path.join(directory, name + ".traj"), param_sets=param_sets, n_hosts=n_hosts,
+                            duration=duration, challenge_days=challenge_days, n_threads=n_threads)
+
+    with open(os.path.join(directory, "golden.json"), "w") as f:
+        json.dump(dict(precision=PRECISION, pfemp1_variants=CLONAL_PFEMP1_VARIANTS, scenarios=sorted(scenarios),
+                       seeds=list(seeds), n_hosts=n_hosts, duration=duration), f, indent=2)
+
+
+def host_outcomes(header, data):
+    """
+    Per-host outcomes pooled over parameter sets: peak and mean patent log10 parasite density,
+    patent days, day of clearance (the end of the run if never cleared), fever days,
+    peak log10 gametocyte density and mean infectiousness.
+    """
+    n_sets, n_hosts, n_steps, n_channels = header["shape"]
+    channel = {name: c for c, name in enumerate(header["channels"])}
+    dt = header["protocol"]["dt"]
+
+    outcomes = {name: [] for name in OUTCOMES}
+
+    for run in range(n_sets * n_hosts):
+        base = run * n_steps * n_channels
+
+        def series(name):
+            return data[base + channel[name]: base + n_steps * n_channels: n_channels]
+
+        density = series("parasite_density")
+        patent = [d for d in density if d > 0]
+        last_patent = max((t for t, d in enumerate(density) if d > 0), default=-1)
+
+        outcomes["peak_log_density"].append(math.log10(1 + max(density)))
+        outcomes["mean_log_density"].append(sum(math.log10(1 + d) for d in patent) / len(patent) if patent else 0.0)
+        outcomes["patent_days"].append(len(patent) * dt)
+        outcomes["clearance_day"].append((last_patent + 1) * dt)
+        outcomes["fever_days"].append(sum(1 for f in series("fever_temperature") if f >= FEVER_THRESHOLD) * dt)
+        outcomes["peak_log_gametocytes"].append(math.log10(1 + max(series("gametocyte_density"))))
+        outcomes["mean_infectiousness"].append(sum(series("infectiousness")) / n_steps)
+
+    return outcomes
+
+
+def ks_2samp(x, y):
+    """Two-sample Kolmogorov-Smirnov statistic and asymptotic p-value (conservative with ties)."""
+    x, y = sorted(x), sorted(y)
+    n, m = len(x), len(y)
+
+    d = 0.0
+    i = j = 0
+    while i < n and j < m:
+        value = min(x[i], y[j])
+        while i < n and x[i] == value:
+            i += 1
+        while j < m and y[j] == value:
+            j += 1
+        d = max(d, abs(i / n - j / m))
+
+    en = math.sqrt(n * m / (n + m))
+    lam = (en + 0.12 + 0.11 / en) * d
+    if lam < 1e-3:
+        return d, 1.0
+
+    p = 2 * sum((-1) ** (k - 1) * math.exp(-2 * k * k * lam * lam) for k in range(1, 101))
+    return d, min(1.0, max(0.0, p))
+
+
+def anderson_ksamp(samples):
+    """
+    Standardized k-sample Anderson-Darling statistic, in the midrank form for data with ties
+    (Scholz & Stephens 1987), and its p-value interpolated from the critical values, capped to [0.001, 0.25].
+    """
+    k = len(samples)
+    sizes = [len(s) for s in samples]
+    N = sum(sizes)
+    pooled = sorted(v for s in samples for v in s)
+    distinct = sorted(set(pooled))
+
+    if len(distinct) < 2:
+        return 0.0, 0.25  # every observation identical: no evidence of a difference
+
+    ties = {v: 0 for v in distinct}
+    for v in pooled:
+        ties[v] += 1
+    counts = []
+    for s in samples:
+        c = {v: 0 for v in distinct}
+        for v in s:
+            c[v] += 1
+        counts.append(c)
+
+    A2 = 0.0
+    for i in range(k):
+        below = 0  # observations of sample i below the current value
+        below_all = 0
+        inner = 0.0
+        for v in distinct:
+            l, f = ties[v], counts[i][v]
+            M = below + f / 2.0
+            B = below_all + l / 2.0
+            inner += l / N * (N * M - sizes[i] * B) ** 2 / (B * (N - B) - N * l / 4.0)
+            below += f
+            below_all += l
+        A2 += inner / sizes[i]
+    A2 *= (N - 1.0) / N
+
+    H = sum(1.0 / n for n in sizes)
+    h = sum(1.0 / i for i in range(1, N))
+    g = 0.0
+    for i in range(1, N - 1):
+        g += sum(1.0 / ((N - i) * j) for j in range(i + 1, N))
+
+    a = (4 * g - 6) * (k - 1) + (10 - 6 * g) * H
+    b = (2 * g - 4) * k ** 2 + 8 * h * k + (2 * g - 14 * h - 4) * H - 8 * h + 4 * g - 6
+    c = (6 * h + 2 * g - 2) * k ** 2 + (4 * h - 4 * g + 6) * k + (2 * h - 6) * H + 4 * h
+    d = (2 * h + 6) * k ** 2 - 4 * h * k
+    variance = (a * N ** 3 + b * N ** 2 + c * N + d) / ((N - 1.0) * (N - 2.0) * (N - 3.0))
+    m = k - 1
+    T = (A2 - m) / math.sqrt(variance)
+
+    # critical values of T at these significance levels, and a quadratic fit of log(significance) through them
+    levels = [0.25, 0.1, 0.05, 0.025, 0.01, 0.005, 0.001]
+    b0 = [0.675, 1.281, 1.645, 1.96, 2.326, 2.573, 3.085]
+    b1 = [-0.245, 0.25, 0.678, 1.149, 1.822, 2.364, 3.615]
+    b2 = [-0.105, -0.305, -0.362, -0.391, -0.396, -0.345, -0.154]
+    critical = [b0[i] + b1[i] / math.sqrt(m) + b2[i] / m for i in range(len(levels))]
+
+    if T < critical[0]:
+        return T, levels[0]
+    if T > critical[-1]:
+        return T, levels[-1]
+
+    coefficients = _polyfit2(critical, [math.log(s) for s in levels])
+    return T, math.exp(coefficients[0] * T * T + coefficients[1] * T + coefficients[2])
+
+
+def _polyfit2(x, y):
+    """Least-squares quadratic through (x, y), highest power first."""
+    sums = [sum(xi ** p for xi in x) for p in range(5)]
+    rhs = [sum(yi * xi ** p for xi, yi in zip(x, y)) for p in (2, 1, 0)]
+    matrix = [[sums[4], sums[3], sums[2]],
+              [sums[3], sums[2], sums[1]],
+              [sums[2], sums[1], sums[0]]]
+
+    # Gaussian elimination on the 3x3 normal equations
+    for col in range(3):
+        pivot = max(range(col, 3), key=lambda r: abs(matrix[r][col]))
+        matrix[col], matrix[pivot] = matrix[pivot], matrix[col]
+        rhs[col], rhs[pivot] = rhs[pivot], rhs[col]
+        for r in range(col + 1, 3):
+            factor = matrix[r][col] / matrix[col][col]
+            for cc in range(col, 3):
+                matrix[r][cc] -= factor * matrix[col][cc]
+            rhs[r] -= factor * rhs[col]
+
+    solution = [0.0, 0.0, 0.0]
+    for r in (2, 1, 0):
+        solution[r] = (rhs[r] - sum(matrix[r][cc] * solution[cc] for cc in range(r + 1, 3))) / matrix[r][r]
+    return solution
+
+
+def first_difference(reference, other):
+    """(param_set, host, step, channel) of the first sample that is not bitwise identical, else None."""
+    (header, ref), (_, data) = reference, other
+    if ref.tobytes() == data.tobytes():
+        return None
+
+    n_sets, n_hosts, n_steps, n_channels = header["shape"]
+    for i, (a, b) in enumerate(zip(ref, data)):
+        if a != b or (a != a) != (b != b):
+            return (i // (n_hosts * n_steps * n_channels), (i // (n_steps * n_channels)) % n_hosts,
+                    (i // n_channels) % n_steps, header["channels"][i % n_channels])
+    return None
+
+
+def compare_scenario(reference, other, alpha=0.01, n_tests=1):
+    """
+    Bitwise and distributional comparison of two recordings of the same protocol.
+
+    Each outcome passes if neither test rejects at alpha / n_tests, the Bonferroni share of
+    the family-wise level when several outcomes and scenarios are tested together.  The
+    Anderson-Darling table ends at 0.001, so a statistic beyond it rejects at any level.
+    """
+    if reference[0]["shape"] != other[0]["shape"] or reference[0]["protocol"] != other[0]["protocol"]:
+        raise ValueError("Trajectories were recorded with different protocols")
+
+    difference = first_difference(reference, other)
+    report = dict(identical=difference is None, first_difference=difference, outcomes={})
+    if difference is None:
+        return report
+
+    threshold = alpha / n_tests
+    ref_outcomes, other_outcomes = host_outcomes(*reference), host_outcomes(*other)
+    for name in ref_outcomes:
+        d, ks_p = ks_2samp(ref_outcomes[name], other_outcomes[name])
+        T, ad_p = anderson_ksamp([ref_outcomes[name], other_outcomes[name]])
+        report["outcomes"][name] = dict(ks=d, ks_p=ks_p, ad=T, ad_p=ad_p,
+                                        passed=ks_p >= threshold and ad_p >= threshold and ad_p > 0.001)
+    return report
+
+
+def compare_golden(reference_dir, candidate_dir, bitwise=False, alpha=0.01):
+    """
+    Compare every scenario of a candidate recording against the reference.
+
+    With bitwise, the candidate passes only if every trajectory is identical; otherwise it
+    passes if no outcome distribution differs at family-wise level alpha.
+    Returns (passed, {scenario: report}).
+    """
+    with open(os.path.join(reference_dir, "golden.json")) as f:
+        scenarios = json.load(f)["scenarios"]
+
+    n_tests = 2 * len(OUTCOMES) * len(scenarios)
+    passed = True
+    reports = {}
+    for name in scenarios:
+        reference = load_trajectories(os.path.join(reference_dir, name + ".traj"))
+        candidate = load_trajectories(os.path.join(candidate_dir, name + ".traj"))
+        report = compare_scenario(reference, candidate, alpha=alpha, n_tests=n_tests)
+        report["precision"] = (reference[0]["precision"], candidate[0]["precision"])
+
+        if bitwise:
+            passed = passed and report["identical"]
+        else:
+            passed = passed and all(o["passed"] for o in report["outcomes"].values())
+        reports[name] = report
+
+    return passed, reports
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(
+        prog="python -m emodlib.malaria.golden",
+        description="Record golden trajectories with this build, or validate this build's recording against them.")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    record = commands.add_parser("record", help="record the golden scenarios with this build")
+    record.add_argument("directory")
+    record.add_argument("--hosts", type=int, default=50)
+    record.add_argument("--days", type=int, default=365)
+    record.add_argument("--seeds", type=int, nargs="+", default=list(GOLDEN_SEEDS))
+    record.add_argument("--threads", type=int, default=1)
+
+    compare = commands.add_parser("compare", help="validate a candidate recording against the reference")
+    compare.add_argument("reference")
+    compare.add_argument("candidate")
+    compare.add_argument("--bitwise", action="store_true", help="require identical trajectories")
+    compare.add_argument("--alpha", type=float, default=0.01, help="family-wise significance level")
+
+    args = parser.parse_args(argv)
+
+    if args.command == "record":
+        record_golden(args.directory, seeds=args.seeds, n_hosts=args.hosts, duration=args.days, n_threads=args.threads)
+        print("Recorded golden %s trajectories to %s" % (PRECISION, args.directory))
+        return 0
+
+    passed, reports = compare_golden(args.reference, args.candidate, bitwise=args.bitwise, alpha=args.alpha)
+    for name, report in reports.items():
+        print("%s (%s vs %s): %s" % (name, report["precision"][0], report["precision"][1],
+                                     "identical" if report["identical"] else "differs at %s" % (report["first_difference"],)))
+        for outcome, o in report["outcomes"].items():
+            print("  %-22s KS %.3f (p %.3g)  AD %7.3f (p %.3g)  %s" % (
+                outcome, o["ks"], o["ks_p"], o["ad"], o["ad_p"], "ok" if o["passed"] else "DIFFERS"))
+    print("PASS" if passed else "FAIL")
+    return 0 if passed else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,124 @@
+import argparse
+import json
+import operator
+import sys
+from array import array
+from functools import reduce
+
+from .._emodlib_py.malaria import CLONAL_PFEMP1_VARIANTS, PRECISION, BatchTrajectories
+from .batch import run_batch
+
+
+def record_trajectories(path, param_sets=({},), n_hosts=100, duration=365, challenge_days=(0,), dt=1.0, n_threads=1):
+    """
+    Run a batch with this build's precision and save it for comparison against another build.
+
+    The random draws do not depend on the precision, so the same protocol recorded
+    by a float32 and a float64 build differs only by floating-point error and its consequences.
+    The file is a JSON header line, recording the build's precision and PfEMP1 variant count,
+    followed by the trajectories as raw float32.
+    """
+    result = run_batch(list(param_sets), n_hosts=n_hosts, duration=duration,
+                       challenge_days=challenge_days, dt=dt, n_threads=n_threads)
+    header = dict(
+        precision=PRECISION,
+        pfemp1_variants=CLONAL_PFEMP1_VARIANTS,
+        shape=list(result.shape),
+        channels=list(BatchTrajectories.channels),
+        protocol=dict(param_sets=list(param_sets), n_hosts=n_hosts, duration=duration,
+                      challenge_days=list(challenge_days), dt=dt),
+    )
+    with open(path, "wb") as f:
+        f.write((json.dumps(header) + "\n").encode())
+        f.write(memoryview(result).cast("B"))
+
+
+def load_trajectories(path):
+    """Header and flat float32 array of a file written by record_trajectories."""
+    with open(path, "rb") as f:
+        header = json.loads(f.readline())
+        data = array("f")
+        data.frombytes(f.read())
+    if len(data) != reduce(operator.mul, header["shape"], 1):
+        raise ValueError("Truncated trajectory file '%s'" % path)
+    return header, data
+
+
+def trajectory_divergence(reference, other, rel_tol=1e-3, abs_tol=1e-6):
+    """
+    Per-channel divergence of other from reference, two (header, data) pairs over the same protocol.
+
+    For each channel: the largest absolute and relative differences, the fraction of samples
+    outside rel_tol (relative, beyond an abs_tol floor), and the first time step at which any
+    host leaves it.  For parasite density, also the fraction of samples where the two runs
+    disagree on whether a host is parasitemic at all.
+    """
+    (ref_header, ref), (other_header, data) = reference, other
+    if ref_header["shape"] != other_header["shape"] or ref_header["protocol"] != other_header["protocol"]:
+        raise ValueError("Trajectories were recorded with different protocols")
+
+    n_sets, n_hosts, n_steps, n_channels = ref_header["shape"]
+    report = {}
+    for c, channel in enumerate(ref_header["channels"]):
+        max_abs = max_rel = 0.0
+        n_outside = n_status = 0
+        first_step = None
+        for i in range(c, len(ref), n_channels):
+            a, b = ref[i], data[i]
+            diff = abs(a - b)
+            rel = diff / max(abs(a), abs(b), abs_tol)
+            max_abs = max(max_abs, diff)
+            max_rel = max(max_rel, rel)
+            if diff > abs_tol and rel > rel_tol:
+                n_outside += 1
+                step = (i // n_channels) % n_steps
+                first_step = step if first_step is None else min(first_step, step)
+            if (a > 0) != (b > 0):
+                n_status += 1
+
+        n_samples = n_sets * n_hosts * n_steps
+        report[channel] = dict(max_abs=max_abs, max_rel=max_rel,
+                               fraction_outside=n_outside / n_samples, first_step=first_step)
+        if channel == "parasite_density":
+            report[channel]["fraction_status_differs"] = n_status / n_samples
+
+    return report
+
+
+def main(argv=None):
+    parser = argparse.ArgumentParser(
+        prog="python -m emodlib.malaria.precision",
+        description="Record trajectories with this build, or report the divergence between two recordings.")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    record = commands.add_parser("record", help="record trajectories with this build's precision")
+    record.add_argument("path")
+    record.add_argument("--hosts", type=int, default=100)
+    record.add_argument("--days", type=int, default=365)
+    record.add_argument("--challenge-days", type=int, nargs="+", default=[0])
+    record.add_argument("--threads", type=int, default=1)
+
+    compare = commands.add_parser("compare", help="report divergence of the second recording from the first")
+    compare.add_argument("reference")
+    compare.add_argument("other")
+    compare.add_argument("--rel-tol", type=float, default=1e-3)
+
+    args = parser.parse_args(argv)
+
+    if args.command == "record":
+        record_trajectories(args.path, n_hosts=args.hosts, duration=args.days,
+                            challenge_days=args.challenge_days, n_threads=args.threads)
+        print("Recorded %s trajectories to %s" % (PRECISION, args.path))
+        return 0
+
+    reference, other = load_trajectories(args.reference), load_trajectories(args.other)
+    print("%s (%s) vs %s (%s)" % (args.reference, reference[0]["precision"], args.other, other[0]["precision"]))
+    for channel, d in trajectory_divergence(reference, other, rel_tol=args.rel_tol).items():
+        print("  %-20s max abs %-12.4g max rel %-12.4g outside %.2f%% from step %s%s" % (
+            channel, d["max_abs"], d["max_rel"], 100 * d["fraction_outside"], d["first_step"],
+            ", parasitemia differs %.2f%%" % (100 * d["fraction_status_differs"]) if "fraction_status_differs" in d else ""))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
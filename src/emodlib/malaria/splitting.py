@@ -0,0 +1,28 @@
+from .._emodlib_py.malaria import IntrahostComponent, SplittingResult, _run_splitting
+
+
+def run_splitting(
+    levels,
+    observable="rbc_deficit",
+    params={},
+    n_particles=1000,
+    duration=365,
+    challenge_days=(0,),
+    dt=1.0,
+    n_threads=1,
+):
+    """
+    Probability that the observable reaches the last of the increasing levels within the duration,
+    estimated by fixed-effort multilevel splitting.
+
+    Observables are "parasite_density" and "rbc_deficit" (1 - RBC count / capacity).
+    Params is a nested update on top of the default parameters; its Run_Number seeds the particle streams.
+    The duration and challenge days are in days, stepped by dt.
+    """
+    block = IntrahostComponent.params_block(params)
+    return _run_splitting(
+        block, observable, list(levels), n_particles, duration, list(challenge_days), dt, n_threads
+    )
+
+
+__all__ = ["SplittingResult", "run_splitting"]
@@ -0,0 +1,93 @@
+import ast
+import mmap
+import os
+import struct
+import sys
+
+from .._emodlib_py.malaria import TrajectoryWriter
+
+_ORDER = "<" if sys.byteorder == "little" else ">"
+_FORMATS = {"f4": "f", "i4": "i"}
+
+
+def _map_npy(path):
+    """Read-only map of a .npy file, with a memoryview of its data cast to the array's shape."""
+    with open(path, "rb") as f:
+        if f.read(6) != b"\x93NUMPY":
+            raise ValueError("Not a .npy file '%s'" % path)
+        major = f.read(2)[0]
+        size_format = "<H" if major == 1 else "<I"
+        (length,) = struct.unpack(size_format, f.read(struct.calcsize(size_format)))
+        header = ast.literal_eval(f.read(length).decode("latin1"))
+        offset = f.tell()
+        mapped = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+
+    descr, shape = header["descr"], list(header["shape"])
+    if header["fortran_order"] or descr[0] not in (_ORDER, "|") or descr[1:] not in _FORMATS:
+        mapped.close()
+        raise ValueError("Unsupported array %r in '%s'" % (descr, path))
+
+    count = 1
+    for n in shape:
+        count *= n
+    end = offset + count * int(descr[2:])
+    if end > len(mapped):
+        mapped.close()
+        raise ValueError("Truncated .npy file '%s'" % path)
+
+    # memoryviews cannot take a shape with zeros, so an empty array stays flat
+    view = memoryview(mapped)[offset:end]
+    return mapped, view.cast(_FORMATS[descr[1:]], shape) if count else view.cast(_FORMATS[descr[1:]])
+
+
+class HostTrajectories:
+    """
+    Per-host trajectories written by a TrajectoryWriter, memory-mapped.
+
+    Each channel is a (step, host) float32 memoryview over the file, so pages are read on first touch;
+    numpy.asarray(traj["parasite_density"]) wraps one without copying.  Release the views before close().
+    The files are readable while the run is still writing them, up to the last chunk on disk.
+    """
+
+    def __init__(self, path):
+        self.path = path
+        self.channels = [c for c in TrajectoryWriter.channels if os.path.exists(os.path.join(path, c + ".npy"))]
+        self._maps = []
+        self.hosts = self._open("hosts").tolist()
+        self.times = self._open("times")
+        self._columns = {c: self._open(c) for c in self.channels}
+
+    def _open(self, name):
+        mapped, view = _map_npy(os.path.join(self.path, name + ".npy"))
+        self._maps.append(mapped)
+        return view
+
+    @property
+    def n_steps(self):
+        return len(self.times)
+
+    def __getitem__(self, channel):
+        return self._columns[channel]
+
+    def host(self, index):
+        """Every channel of the host at this population index, as lists over steps."""
+        h = self.hosts.index(index)
+        return {c: [self._columns[c][s, h] for s in range(self.n_steps)] for c in self.channels}
+
+    def close(self):
+        self._columns = {}
+        self.times = None
+        for mapped in self._maps:
+            mapped.close()
+        self._maps = []
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+
+def open_trajectories(path):
+    """Map the directory written by a TrajectoryWriter for analysis."""
+    return HostTrajectories(path)
@@ -2,6 +2,8 @@ from typing import Any, Dict, TypeVar
 
 import yaml
 
+from ._emodlib_py import load_config
+
 
 class Params(dict):
     @classmethod
@@ -10,6 +12,11 @@ class Params(dict):
             params = yaml.load(cfg, Loader=yaml.FullLoader)
         return cls(params)
 
+    @classmethod
+    def from_file(cls, path):
+        """Parsed natively: config.yml-shaped YAML, or JSON for a .json extension"""
+        return cls(load_config(path))
+
     @property
     def yaml(self):
         return yaml.dump(self)
@@ -57,3 +64,10 @@ def set_params(cls, params={}):
     cfg = deep_update(cls.default_params, params)
     cls.params = cfg
     cls._configure_from_params(cfg)  # setting static variables in bound C++ classes
+
+
+@classmethod
+def params_block(cls, params={}):
+    """Immutable parameter block from a nested update on top of default parameters"""
+    cfg = deep_update(cls.default_params, params)
+    return cls._params_block_from_params(cfg)  # independent of the static defaults in bound C++ classes
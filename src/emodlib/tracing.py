@@ -0,0 +1,24 @@
+"""
+Timeline of population steps, scheduler tasks, RNG refills and output, as Chrome trace JSON.
+"""
+
+from contextlib import contextmanager
+
+from ._emodlib_py import _start_trace, _stop_trace, _trace_counts, _write_trace
+
+
+@contextmanager
+def trace(path, events_per_thread=1 << 20):
+    """
+    Record the model's native activity within the block and write it to path,
+    to open in chrome://tracing or https://ui.perfetto.dev.
+
+    Each thread keeps at most events_per_thread events; later ones are dropped and
+    counted in the file's otherData.  Yields a callable returning (recorded, dropped) so far.
+    """
+    _start_trace(events_per_thread)
+    try:
+        yield _trace_counts
+    finally:
+        _stop_trace()
+        _write_trace(str(path))
@@ -5,6 +5,8 @@
 
 #include "pybind11/pybind11.h"
 
+#include "emodlib/utils/Tracer.h"
+
 #include "malaria.cpp"
 
 #define STRINGIFY(x) #x
@@ -16,6 +18,26 @@ PYBIND11_MODULE(_emodlib_py, m)
 {
     m.doc() = "A collection of algorithms for disease-transmission modeling.";
 
+    // a parameter absent from a dictionary reads as it did from the dictionary itself
+    py::register_exception<emodlib::MissingParameter>(m, "MissingParameter", PyExc_KeyError);
+    py::register_exception<emodlib::ConfigError>(m, "ConfigError", PyExc_ValueError);
+
+    m.def("load_config",
+          &emodlib::LoadConfigFile,
+          "Parse a YAML (or .json) configuration file natively into a nested parameter dictionary",
+          py::arg("path"));
+
+    m.def("_start_trace", &emodlib::Tracer::Start,
+          "Record a timeline of population steps, scheduler tasks, RNG refills and output, discarding any previous one",
+          py::arg("events_per_thread") = size_t(1) << 20);
+    m.def("_stop_trace", &emodlib::Tracer::Stop, py::call_guard<py::gil_scoped_release>());
+    m.def("_write_trace", &emodlib::Tracer::WriteChromeTrace,
+          "Write the stopped trace as Chrome trace JSON, for chrome://tracing or ui.perfetto.dev",
+          py::arg("path"));
+    m.def("_trace_counts", []() {
+              return py::make_tuple(emodlib::Tracer::GetNumEvents(), emodlib::Tracer::GetNumDropped()); },
+          "Events recorded and dropped by full buffers in the current trace");
+
     py::module malaria_m = m.def_submodule("malaria", "The malaria intra-host module of emodlib");
     add_malaria_bindings(malaria_m);
 
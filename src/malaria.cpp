@@ -3,11 +3,24 @@
  * @brief emodlib malaria Python bindings.
 */
 
+#include <algorithm>
+
 #include "pybind11/pybind11.h"
 #include "pybind11/stl.h"
 
+#include "paramset.h"
+
+#include "emodlib/ConfigFile.h"
+
+#include "emodlib/malaria/AggregateReporter.h"
+#include "emodlib/malaria/ChallengeBatch.h"
 #include "emodlib/malaria/IntrahostComponent.h"
 #include "emodlib/malaria/MalariaAntibody.h"
+#include "emodlib/malaria/Population.h"
+#include "emodlib/malaria/Snapshot.h"
+#include "emodlib/malaria/Splitting.h"
+#include "emodlib/malaria/TrajectoryWriter.h"
+#include "emodlib/utils/Instrumentation.h"
 
 namespace py = pybind11;
 namespace emm = emodlib::malaria;
@@ -24,10 +37,10 @@ public:
           PYBIND11_OVERRIDE_PURE(void, IAntibodyBase, IncreaseAntigenCount, antigenCount); }
      int64_t GetAntigenCount() const override {
           PYBIND11_OVERRIDE_PURE(int64_t, IAntibodyBase, GetAntigenCount, ); }
-     float GetAntibodyCapacity() const override {
-          PYBIND11_OVERRIDE_PURE(float, IAntibodyBase, GetAntibodyCapacity, ); }
-     float GetAntibodyConcentration() const override {
-          PYBIND11_OVERRIDE_PURE(float, IAntibodyBase, GetAntibodyConcentration, ); }
+     emodlib::real_t GetAntibodyCapacity() const override {
+          PYBIND11_OVERRIDE_PURE(emodlib::real_t, IAntibodyBase, GetAntibodyCapacity, ); }
+     emodlib::real_t GetAntibodyConcentration() const override {
+          PYBIND11_OVERRIDE_PURE(emodlib::real_t, IAntibodyBase, GetAntibodyConcentration, ); }
 };
 
 template <class MalariaAntibodyBase = emm::MalariaAntibody>
@@ -38,10 +51,21 @@ public:
           PYBIND11_OVERRIDE(void, MalariaAntibodyBase, IncreaseAntigenCount, antigenCount); }
      int64_t GetAntigenCount() const override {
           PYBIND11_OVERRIDE(int64_t, MalariaAntibodyBase, GetAntigenCount, ); }
-     float GetAntibodyCapacity() const override {
-          PYBIND11_OVERRIDE(float, MalariaAntibodyBase, GetAntibodyCapacity, ); }
-     float GetAntibodyConcentration() const override {
-          PYBIND11_OVERRIDE(float, MalariaAntibodyBase, GetAntibodyConcentration, ); }
+     emodlib::real_t GetAntibodyCapacity() const override {
+          PYBIND11_OVERRIDE(emodlib::real_t, MalariaAntibodyBase, GetAntibodyCapacity, ); }
+     emodlib::real_t GetAntibodyConcentration() const override {
+          PYBIND11_OVERRIDE(emodlib::real_t, MalariaAntibodyBase, GetAntibodyConcentration, ); }
+};
+
+static emodlib::Backpressure::Enum backpressure_from_name(const std::string& name) {
+     if (name == "block") return emodlib::Backpressure::Block;
+     if (name == "drop") return emodlib::Backpressure::Drop;
+     throw py::value_error("Unknown backpressure '" + name + "' (expected 'block' or 'drop')");
+}
+
+// A population's host, read-only so that it only changes through the population, which keeps its partitions
+struct HostView {
+     const emm::IntrahostComponent* host;
 };
 
 
@@ -50,15 +74,66 @@ void add_malaria_bindings(py::module& m) {
     using namespace emm;
     using namespace py::literals;
 
+    // fixed per build (EMODLIB_PFEMP1_VARIANTS), and part of the snapshot header with the precision
+    m.attr("CLONAL_PFEMP1_VARIANTS") = CLONAL_PfEMP1_VARIANTS;
+    m.attr("REPERTOIRE_DRAWS") = REPERTOIRE_DRAWS;
+    m.attr("PRECISION") = EMODLIB_PRECISION_NAME;  // of the model state, fixed per build (EMODLIB_PRECISION)
+    m.attr("INSTRUMENTATION") = emodlib::Instrumentation::Enabled();  // EMODLIB_INSTRUMENTATION
+
+
+    // ==== Binding of the hot-path instrumentation ==== //
+    m.def("instrumentation_stats", []() {
+              py::dict phases, draws;
+              for (const auto& p : emodlib::Instrumentation::GetPhaseStats()) {
+                   py::dict phase("calls"_a=p.calls, "cycles"_a=p.cycles);
+                   for (int c = 0; c < emodlib::HardwareCounter::Count; c++)
+                        phase[emodlib::Instrumentation::HardwareCounterName(emodlib::HardwareCounter::Enum(c))] = p.hardware[c];
+                   phases[p.name.c_str()] = phase;
+              }
+              for (const auto& d : emodlib::Instrumentation::GetDrawStats())
+                   draws[d.name.c_str()] = d.count;
+              return py::dict("enabled"_a=emodlib::Instrumentation::Enabled(),
+                              "clock"_a=emodlib::Instrumentation::ClockName(),
+                              "hardware"_a=emodlib::Instrumentation::HardwareAvailable(),
+                              "phases"_a=phases, "draws"_a=draws); },
+          "Calls, cycles and hardware events (with EMODLIB_PERF_COUNTERS) of each update phase, inclusive of nested phases, "
+          "and random draws by kind, summed over threads");
+
+    m.def("reset_instrumentation", &emodlib::Instrumentation::Reset,
+          "Zero the instrumentation counters, while no population is updating");
+
+
+    // ==== Binding of immutable parameter blocks ==== //
+    py::class_<IntrahostParams, std::shared_ptr<IntrahostParams>> (m, "IntrahostParams")
+
+        .def_readonly("run_number", &IntrahostParams::randomSeed)
+        .def_readonly("common_random_numbers", &IntrahostParams::common_random_numbers)
+        .def_readonly("max_individual_infections", &IntrahostParams::max_ind_inf)
+
+        .def_static("from_file",
+                    [](const std::string& path) {
+                         return std::const_pointer_cast<IntrahostParams>(IntrahostParams::CreateFromFile(path)); },
+                    "Build an immutable parameter block from a complete YAML (or .json) configuration file, parsed natively",
+                    "path"_a);
+
 
     // ==== Binding of the intrahost component ==== //
     py::class_<IntrahostComponent> (m, "IntrahostComponent")
 
-        .def_static("create", &IntrahostComponent::Create)
+        .def_static("create",
+                    [](std::shared_ptr<IntrahostParams> params) { return IntrahostComponent::Create(params); },
+                    "Create an IntrahostComponent referencing a parameter block (default block if None)",
+                    "params"_a=py::none())
 
         .def_static("_configure_from_params",
-                    &IntrahostComponent::params::Configure,
-                    "Configure the IntrahostComponent params from a ParamSet dictionary",
+                    &IntrahostComponent::Configure,
+                    "Configure the default IntrahostComponent params from a ParamSet dictionary",
+                    "pset"_a)
+
+        .def_static("_params_block_from_params",
+                    [](const ParamSet& pset) {
+                         return std::const_pointer_cast<IntrahostParams>(IntrahostParams::Create(pset)); },
+                    "Build an immutable parameter block from a ParamSet dictionary",
                     "pset"_a)
 
         .def("update",
@@ -68,12 +143,30 @@ void add_malaria_bindings(py::module& m) {
 
         .def("challenge",
              &IntrahostComponent::Challenge,
-             "Challenge with a new infection")
+             "Challenge with a new infection (of strain_id, under the FALCIPARUM_STRAIN_GENERATOR strain model)",
+             "strain_id"_a=0)
 
         .def("treat",
              &IntrahostComponent::Treat,
              "Treat and clear all infections")
 
+        .def("clone",
+             [](const IntrahostComponent& ic) { return ic.Clone(); },
+             "Deep copy of the host, with its own copy of the host's random stream (or of the shared stream, for hosts without one)")
+
+        .def("checkpoint",
+             [](const IntrahostComponent& ic) {
+                  std::vector<char> buffer = Snapshot::SaveHost(ic);
+                  return py::bytes(buffer.data(), buffer.size()); },
+             "Versioned binary snapshot of the full host state (its parameter block is not included)")
+
+        .def_static("restore",
+                    [](py::bytes data, std::shared_ptr<IntrahostParams> params) {
+                         std::string buffer = data;
+                         return Snapshot::LoadHost(buffer.data(), buffer.size(), params); },
+                    "Rebuild an IntrahostComponent from a checkpoint, referencing a parameter block (default block if None)",
+                    "data"_a, "params"_a=py::none())
+
         .def_property_readonly("n_infections", &IntrahostComponent::GetNumInfections)
 
         .def_property_readonly("parasite_density", &IntrahostComponent::GetParasiteDensity)
@@ -94,11 +187,17 @@ void add_malaria_bindings(py::module& m) {
 
     py::class_<Susceptibility> (m, "Susceptibility")
 
-          .def_static("create", &Susceptibility::Create)
+          .def_static("create",
+                      [](std::shared_ptr<IntrahostParams> params) { return Susceptibility::Create(params); },
+                      "Create a Susceptibility referencing a parameter block (default block if None)",
+                      "params"_a=py::none())
 
           .def_static("configure",
-                      &Susceptibility::params::Configure,
-                      "Configure the Susceptibility params from a ParamSet dictionary",
+                      [](const ParamSet& pset) {
+                           auto block = std::make_shared<IntrahostParams>(*IntrahostParams::GetDefaults());
+                           block->susceptibility.Configure(pset);
+                           IntrahostParams::SetDefaults(block); },
+                      "Configure the default Susceptibility params from a ParamSet dictionary",
                       "pset"_a)
 
           .def("update",
@@ -118,18 +217,25 @@ void add_malaria_bindings(py::module& m) {
 
           .def_property("fever_kill_rate",
                         &Susceptibility::get_fever_kill_rate,
-                        &Susceptibility::set_fever_kill_rate);
+                        &Susceptibility::set_fever_kill_rate)
+
+          .def_property_readonly("RBC_count", &Susceptibility::get_RBC_count)
+          .def_property_readonly("RBC_availability", &Susceptibility::get_RBC_availability);
 
 
      py::class_<Infection> (m, "Infection")
 
-          .def_static("create", &Infection::Create,
+          .def_static("create",
+               [](Susceptibility* susceptibility, int hepatocytes) { return Infection::Create(susceptibility, hepatocytes); },
                "Create an Infection object with pointer to Susceptibility",
                "susceptibility"_a, "hepatocytes"_a=1)
 
           .def_static("configure",
-                      &Infection::params::Configure,
-                      "Configure the Infection params from a ParamSet dictionary",
+                      [](const ParamSet& pset) {
+                           auto block = std::make_shared<IntrahostParams>(*IntrahostParams::GetDefaults());
+                           block->infection.Configure(pset);
+                           IntrahostParams::SetDefaults(block); },
+                      "Configure the default Infection params from a ParamSet dictionary",
                       "pset"_a)
 
           .def("update",
@@ -141,6 +247,8 @@ void add_malaria_bindings(py::module& m) {
 
           .def_property_readonly("pfemp1_major_types", &Infection::get_pfemp1_major_types)
 
+          .def_property_readonly("strain_id", &Infection::get_strain_id)
+
           .def_property_readonly("msp_antibody", &Infection::get_msp_antibody);
 
 
@@ -154,4 +262,296 @@ void add_malaria_bindings(py::module& m) {
 
      py::class_<MalariaAntibodyMSP, MalariaAntibody, PyMalariaAntibody<MalariaAntibodyMSP>> (m, "MalariaAntibodyMSP");
 
+
+     // ==== Binding of the population container ==== //
+     py::class_<AggregateReporter, std::shared_ptr<AggregateReporter>> (m, "AggregateReporter", py::buffer_protocol())
+
+          .def_static("create",
+               [](const std::vector<float>& age_bins, float detection_threshold, float fever_threshold, int sketch_k,
+                  int pipeline_depth, const std::string& backpressure) {
+                    return std::shared_ptr<AggregateReporter>(AggregateReporter::Create(
+                         age_bins, detection_threshold, fever_threshold, sketch_k, pipeline_depth, backpressure_from_name(backpressure))); },
+               "Per-step population summaries and quantile sketches, by age bin if given as upper edges in years; "
+               "with a pipeline_depth, steps are closed on a reporter thread while the next ones are computed",
+               "age_bins"_a=std::vector<float>(), "detection_threshold"_a=40.0f, "fever_threshold"_a=38.5f, "sketch_k"_a=200,
+               "pipeline_depth"_a=0, "backpressure"_a="block")
+
+          // every accessor flushes first, so a pipelined reporter reads like a synchronous one
+          .def_buffer([](AggregateReporter& r) -> py::buffer_info {
+               r.Flush();
+               return py::buffer_info(
+                    const_cast<float*>(r.GetData().data()),
+                    sizeof(float),
+                    py::format_descriptor<float>::format(),
+                    3,
+                    { r.GetNumSteps(), r.GetNumStrata(), int(ReportChannel::Count) },
+                    { sizeof(float) * ReportChannel::Count * r.GetNumStrata(),
+                      sizeof(float) * ReportChannel::Count,
+                      sizeof(float) }); })
+
+          .def_property_readonly("shape", [](AggregateReporter& r) {
+               r.Flush();
+               return py::make_tuple(r.GetNumSteps(), r.GetNumStrata(), int(ReportChannel::Count)); })
+
+          .def_property_readonly_static("channels", [](py::object) { return AggregateReporter::Channels(); })
+          .def_property_readonly_static("distributions", [](py::object) { return AggregateReporter::Distributions(); })
+
+          .def_property_readonly("times", [](AggregateReporter& r) { r.Flush(); return r.GetTimes(); })
+          .def_property_readonly("age_bins", &AggregateReporter::GetAgeBins)
+          .def_property_readonly("detection_threshold", &AggregateReporter::GetDetectionThreshold)
+          .def_property_readonly("fever_threshold", &AggregateReporter::GetFeverThreshold)
+          .def_property_readonly("sketch_k", &AggregateReporter::GetSketchK)
+          .def_property_readonly("pipeline_depth", &AggregateReporter::GetPipelineDepth)
+          .def_property_readonly("n_dropped", &AggregateReporter::GetNumDropped, "Steps discarded while the pipeline was full")
+
+          .def("flush", &AggregateReporter::Flush, "Wait until the reporter thread has closed every step",
+               py::call_guard<py::gil_scoped_release>())
+
+          .def("quantiles",
+               [](AggregateReporter& r, const std::string& distribution, const std::vector<float>& q) {
+                    const auto& names = AggregateReporter::Distributions();
+                    auto it = std::find(names.begin(), names.end(), distribution);
+                    if (it == names.end()) throw py::value_error("Unknown distribution '" + distribution + "'");
+                    auto d = ReportDistribution::Enum(it - names.begin());
+                    r.Flush();
+
+                    // (step, stratum, quantile), NaN where a stratum had no values
+                    std::vector<std::vector<std::vector<float>>> quantiles(r.GetNumSteps());
+                    for (int step = 0; step < r.GetNumSteps(); step++)
+                    {
+                         for (int stratum = 0; stratum < r.GetNumStrata(); stratum++)
+                         {
+                              const emodlib::QuantileSketch& sketch = r.GetSketch(step, stratum, d);
+                              std::vector<float> values;
+                              for (float p : q) values.push_back(sketch.Quantile(p));
+                              quantiles[step].push_back(values);
+                         }
+                    }
+                    return quantiles; },
+               "Quantiles q of a distribution by step and age bin, from its sketches",
+               "distribution"_a, "q"_a)
+
+          .def("clear", &AggregateReporter::Clear, "Discard the rows reported so far",
+               py::call_guard<py::gil_scoped_release>());
+
+     py::class_<TrajectoryWriter, std::shared_ptr<TrajectoryWriter>> (m, "TrajectoryWriter")
+
+          .def_static("create",
+               [](const std::string& path, const std::vector<int>& hosts, int steps_per_chunk, int chunks_in_flight, const std::string& backpressure) {
+                    return std::shared_ptr<TrajectoryWriter>(TrajectoryWriter::Create(
+                         path, hosts, steps_per_chunk, chunks_in_flight, backpressure_from_name(backpressure))); },
+               "Stream the channels of hosts at these indices after each step to .npy columns in the directory at path",
+               "path"_a, "hosts"_a, "steps_per_chunk"_a=64, "chunks_in_flight"_a=2, "backpressure"_a="block")
+
+          .def_property_readonly_static("channels", [](py::object) { return TrajectoryWriter::Channels(); })
+
+          .def_property_readonly("path", &TrajectoryWriter::GetPath)
+          .def_property_readonly("hosts", &TrajectoryWriter::GetHosts)
+          .def_property_readonly("steps_per_chunk", &TrajectoryWriter::GetStepsPerChunk)
+          .def_property_readonly("chunks_in_flight", &TrajectoryWriter::GetChunksInFlight)
+          .def_property_readonly("n_steps", &TrajectoryWriter::GetNumSteps, "Steps recorded")
+          .def_property_readonly("n_written", &TrajectoryWriter::GetNumWritten, "Steps on disk")
+          .def_property_readonly("n_dropped", &TrajectoryWriter::GetNumDropped, "Steps discarded while every chunk was in flight")
+          .def_property_readonly("is_open", &TrajectoryWriter::IsOpen)
+
+          .def("flush", &TrajectoryWriter::Flush, "Wait until every recorded step is on disk",
+               py::call_guard<py::gil_scoped_release>())
+          .def("close", &TrajectoryWriter::Close, "Flush and stop the writer thread",
+               py::call_guard<py::gil_scoped_release>())
+
+          .def("__enter__", [](std::shared_ptr<TrajectoryWriter> w) { return w; })
+          .def("__exit__", [](TrajectoryWriter& w, py::object, py::object, py::object) {
+               py::gil_scoped_release release;
+               w.Close(); });
+
+     py::class_<HostView> (m, "HostView")
+
+          .def("clone",
+               [](const HostView& v) { return v.host->Clone(); },
+               "Deep copy of the host as a free-standing IntrahostComponent")
+
+          .def("checkpoint",
+               [](const HostView& v) {
+                    std::vector<char> buffer = Snapshot::SaveHost(*v.host);
+                    return py::bytes(buffer.data(), buffer.size()); },
+               "Versioned binary snapshot of the full host state (its parameter block is not included)")
+
+          .def_property_readonly("n_infections", [](const HostView& v) { return v.host->GetNumInfections(); })
+
+          .def_property_readonly("parasite_density", [](const HostView& v) { return v.host->GetParasiteDensity(); })
+          .def_property_readonly("gametocyte_density", [](const HostView& v) { return v.host->GetGametocyteDensity(); })
+          .def_property_readonly("fever_temperature", [](const HostView& v) { return v.host->GetFeverTemperature(); })
+
+          .def_property_readonly("infectiousness", [](const HostView& v) { return v.host->GetInfectiousness(); })
+
+          .def_property_readonly("susceptibility", [](const HostView& v) { return v.host->GetSusceptibility(); })
+          .def_property_readonly("infections", [](const HostView& v) { return v.host->GetInfections(); });
+
+     py::class_<Population> (m, "Population")
+
+          .def_static("create",
+               [](int n_hosts, int n_threads, std::shared_ptr<IntrahostParams> params) {
+                    return Population::Create(n_hosts, n_threads, params); },
+               "Create a Population of naive hosts, each with its own random stream",
+               "n_hosts"_a, "n_threads"_a=1, "params"_a=py::none())
+
+          .def("update",
+               &Population::Update,
+               "Update all hosts by dt, each partition with its own kernel",
+               "dt"_a,
+               py::call_guard<py::gil_scoped_release>())
+
+          .def("challenge",
+               &Population::Challenge,
+               "Challenge the host at index with a new infection (of strain_id, under the FALCIPARUM_STRAIN_GENERATOR strain model)",
+               "index"_a, "strain_id"_a=0)
+
+          .def("treat",
+               &Population::Treat,
+               "Treat and clear all infections of the host at index",
+               "index"_a)
+
+          .def("fork",
+               &Population::Fork,
+               "Deep copy of every host, for branching scenarios from a common state")
+
+          .def("checkpoint",
+               [](const Population& p) {
+                    std::vector<char> buffer = Snapshot::SavePopulation(p);
+                    return py::bytes(buffer.data(), buffer.size()); },
+               "Versioned binary snapshot of every host, with an offset table for random access")
+
+          .def_static("restore",
+               [](py::bytes data, int n_threads, std::shared_ptr<IntrahostParams> params) {
+                    std::string buffer = data;
+                    return Snapshot::LoadPopulation(buffer.data(), buffer.size(), n_threads, params); },
+               "Rebuild a Population from a checkpoint, referencing a parameter block (default block if None)",
+               "data"_a, "n_threads"_a=1, "params"_a=py::none())
+
+          .def("save",
+               [](const Population& p, const std::string& path) { Snapshot::SavePopulationFile(p, path); },
+               "Write a checkpoint to a file that Population.open can map",
+               "path"_a)
+
+          .def_static("open",
+               [](const std::string& path, int n_threads, std::shared_ptr<IntrahostParams> params) {
+                    return Snapshot::OpenPopulationFile(path, n_threads, params); },
+               "Map a saved checkpoint read-only; hosts are materialized from it on first use",
+               "path"_a, "n_threads"_a=1, "params"_a=py::none())
+
+          .def_property_readonly("n_materialized", &Population::GetNumMaterialized,
+               "Number of hosts no longer backed by a mapped snapshot")
+
+          .def("host",
+               [](const Population& p, int index) { return HostView{ p.GetHost(index) }; },
+               py::keep_alive<0, 1>(),
+               "Read-only view of the host at index",
+               "index"_a)
+
+          .def("acquire_host",
+               &Population::AcquireHost,
+               py::return_value_policy::reference_internal,
+               "The IntrahostComponent at index, to change other than by challenge or treat until release_host",
+               "index"_a)
+
+          .def("release_host",
+               &Population::ReleaseHost,
+               "Move a host changed since acquire_host to its new partition",
+               "index"_a)
+
+          .def("__len__", &Population::GetSize)
+
+          .def_property_readonly("uninfected", [](const Population& p) {
+               return p.GetPartition(HostPartition::Uninfected); })
+          .def_property_readonly("liver_stage", [](const Population& p) {
+               return p.GetPartition(HostPartition::LiverStage); })
+          .def_property_readonly("blood_stage", [](const Population& p) {
+               return p.GetPartition(HostPartition::BloodStage); })
+
+          .def_property("n_threads", &Population::GetNumThreads, &Population::SetNumThreads)
+
+          .def_property("reporter", &Population::GetReporter, &Population::SetReporter,
+               "AggregateReporter observing every host as it is updated, or None")
+
+          .def_property("writer", &Population::GetWriter, &Population::SetWriter,
+               "TrajectoryWriter recording its hosts after each update, or None")
+
+          .def_property_readonly("scheduler_stats", [](const Population& p) {
+               py::dict stats;
+               py::list tasks, steals, busy, idle;
+               for (const auto& w : p.GetSchedulerStats()) {
+                    tasks.append(w.tasks);
+                    steals.append(w.steals);
+                    busy.append(w.busy_seconds);
+                    idle.append(w.idle_seconds);
+               }
+               stats["tasks"] = tasks;
+               stats["steals"] = steals;
+               stats["busy_seconds"] = busy;
+               stats["idle_seconds"] = idle;
+               return stats; },
+               "Per-worker task, steal and busy/idle time counters of the population scheduler")
+
+          .def("reset_scheduler_stats", &Population::ResetSchedulerStats);
+
+     // ==== Binding of the parameter-batch engine ==== //
+     py::class_<BatchTrajectories> (m, "BatchTrajectories", py::buffer_protocol())
+
+          .def_buffer([](BatchTrajectories& b) -> py::buffer_info {
+               return py::buffer_info(
+                    b.data.data(),
+                    sizeof(float),
+                    py::format_descriptor<float>::format(),
+                    4,
+                    { b.n_param_sets, b.n_hosts, b.n_steps, b.n_channels },
+                    { sizeof(float) * b.n_channels * b.n_steps * b.n_hosts,
+                      sizeof(float) * b.n_channels * b.n_steps,
+                      sizeof(float) * b.n_channels,
+                      sizeof(float) }); })
+
+          .def_property_readonly("shape", [](const BatchTrajectories& b) {
+               return py::make_tuple(b.n_param_sets, b.n_hosts, b.n_steps, b.n_channels); })
+
+          .def_property_readonly_static("channels", [](py::object) {
+               return std::vector<std::string>{ "parasite_density", "gametocyte_density", "fever_temperature", "infectiousness" }; });
+
+     m.def("_stratified_repertoire_draws", &ChallengeBatch::StratifiedRepertoireDraws,
+           "Flat (host, draw) matrix of the stratified repertoire draws of a batch, as uint32",
+           "run_number"_a, "n_hosts"_a, "n_draws"_a);
+
+     m.def("_run_challenge_batch",
+           [](const std::vector<std::shared_ptr<IntrahostParams>>& params, int n_hosts, int duration,
+              const std::vector<int>& challenge_days, float dt, int n_threads, bool antithetic, bool stratified_repertoire) {
+                std::vector<IntrahostParamsPtr> blocks(params.begin(), params.end());
+                int variance_reduction = (antithetic ? VarianceReduction::Antithetic : VarianceReduction::None)
+                                       | (stratified_repertoire ? VarianceReduction::StratifiedRepertoire : VarianceReduction::None);
+                return ChallengeBatch::Run(blocks, n_hosts, duration, challenge_days, dt, n_threads, variance_reduction); },
+           "Run one challenge protocol for each parameter block, returning (param_set, host, time, channel) trajectories",
+           "params"_a, "n_hosts"_a, "duration"_a, "challenge_days"_a, "dt"_a, "n_threads"_a,
+           "antithetic"_a=false, "stratified_repertoire"_a=false,
+           py::call_guard<py::gil_scoped_release>());
+
+
+     // ==== Binding of the multilevel splitting estimator ==== //
+     py::class_<SplittingResult> (m, "SplittingResult")
+          .def_readonly("probability", &SplittingResult::probability)
+          .def_readonly("relative_variance", &SplittingResult::relative_variance)
+          .def_readonly("levels", &SplittingResult::levels)
+          .def_readonly("level_probabilities", &SplittingResult::level_probabilities)
+          .def_readonly("level_hits", &SplittingResult::level_hits)
+          .def_readonly("host_steps", &SplittingResult::host_steps);
+
+     m.def("_run_splitting",
+           [](std::shared_ptr<IntrahostParams> params, const std::string& observable, const std::vector<float>& levels,
+              int n_particles, int duration, const std::vector<int>& challenge_days, float dt, int n_threads) {
+                SplittingObservable::Enum obs;
+                if (observable == "parasite_density") obs = SplittingObservable::ParasiteDensity;
+                else if (observable == "rbc_deficit") obs = SplittingObservable::RBCDeficit;
+                else throw py::value_error("Unknown observable '" + observable + "' (expected 'parasite_density' or 'rbc_deficit')");
+
+                py::gil_scoped_release release;
+                return MultilevelSplitting::Run(params, obs, levels, n_particles, duration, challenge_days, dt, n_threads); },
+           "Estimate the probability of the observable reaching the last level by multilevel splitting",
+           "params"_a, "observable"_a, "levels"_a, "n_particles"_a, "duration"_a, "challenge_days"_a, "dt"_a, "n_threads"_a);
+
 }
@@ -0,0 +1,88 @@
+/**
+ * @file
+ * @brief Conversion of Python parameter dictionaries to the native emodlib ParamSet.
+*/
+
+#pragma once
+
+#include "pybind11/pybind11.h"
+
+#include "emodlib/ParamSet.h"
+
+namespace py = pybind11;
+
+
+// Nested dictionaries of bools, ints, floats and strings, as loaded from the YAML configuration
+inline emodlib::ParamSet paramset_from_dict(const py::dict& dict)
+{
+    emodlib::ParamSet pset;
+
+    for (auto item : dict)
+    {
+        std::string key = py::str(item.first);
+        py::handle value = item.second;
+
+        // bool before int, since Python bools are ints
+        if (py::isinstance<py::bool_>(value))
+            pset.Set(key, value.cast<bool>());
+        else if (py::isinstance<py::int_>(value))
+            pset.Set(key, value.cast<int64_t>());
+        else if (py::isinstance<py::float_>(value))
+            pset.Set(key, value.cast<double>());
+        else if (py::isinstance<py::str>(value))
+            pset.Set(key, value.cast<std::string>());
+        else if (py::isinstance<py::dict>(value))
+            pset.Set(key, paramset_from_dict(value.cast<py::dict>()));
+        else
+            throw py::type_error("Parameter '" + key + "' has unsupported type " + std::string(py::str(value.get_type().attr("__name__"))));
+    }
+
+    return pset;
+}
+
+inline py::dict paramset_to_dict(const emodlib::ParamSet& pset)
+{
+    py::dict dict;
+
+    for (const auto& item : pset)
+    {
+        const emodlib::ParamValue& value = item.second;
+        switch (value.GetType())
+        {
+        case emodlib::ParamValue::Type::Bool:   dict[item.first.c_str()] = value.cast<bool>(); break;
+        case emodlib::ParamValue::Type::Int:    dict[item.first.c_str()] = value.cast<int64_t>(); break;
+        case emodlib::ParamValue::Type::Double: dict[item.first.c_str()] = value.cast<double>(); break;
+        case emodlib::ParamValue::Type::String: dict[item.first.c_str()] = value.cast<std::string>(); break;
+        case emodlib::ParamValue::Type::Block:  dict[item.first.c_str()] = paramset_to_dict(value); break;
+        }
+    }
+
+    return dict;
+}
+
+
+namespace pybind11 { namespace detail {
+
+    // Bound functions taking a ParamSet accept any dictionary (including emodlib.Params)
+    template <> struct type_caster<emodlib::ParamSet>
+    {
+    public:
+
+        PYBIND11_TYPE_CASTER(emodlib::ParamSet, const_name("ParamSet"));
+
+        bool load(handle src, bool)
+        {
+            if (!isinstance<dict>(src))
+                return false;
+
+            value = paramset_from_dict(reinterpret_borrow<dict>(src));
+            return true;
+        }
+
+        static handle cast(const emodlib::ParamSet& src, return_value_policy, handle)
+        {
+            return paramset_to_dict(src).release();
+        }
+    };
+
+}}
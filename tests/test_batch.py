@@ -0,0 +1,175 @@
+import math
+
+import pytest
+
+from emodlib.malaria import BatchTrajectories, IntrahostComponent, Population, run_batch
+from emodlib._emodlib_py.malaria import REPERTOIRE_DRAWS, _stratified_repertoire_draws
+
+
+def test_batch_shape():
+    param_sets = [
+        dict(Max_Individual_Infections=3),
+        dict(Max_Individual_Infections=3, infection_params=dict(Antigen_Switch_Rate=1e-8)),
+    ]
+
+    result = run_batch(param_sets, n_hosts=4, duration=30, challenge_days=[0])
+    assert result.shape == (2, 4, 30, len(BatchTrajectories.channels))
+
+    view = memoryview(result)
+    assert view.shape == result.shape
+    assert view.format == "f"
+
+    i_density = BatchTrajectories.channels.index("parasite_density")
+    assert all(view[k, h, 0, i_density] == 0 for k in range(2) for h in range(4))  # still liver-stage
+    assert all(view[k, h, 29, i_density] > 0 for k in range(2) for h in range(4))
+
+
+def test_batch_days_with_dt():
+    # ten days in half-day steps, with the challenge on day 3 at the start of step 6
+    result = run_batch([{}], n_hosts=2, duration=10, challenge_days=[3], dt=0.5)
+    assert result.shape == (1, 2, 20, len(BatchTrajectories.channels))
+
+    reference = run_batch([{}], n_hosts=2, duration=10, challenge_days=[0], dt=0.5)
+    view, ref = memoryview(result), memoryview(reference)
+    i_density = BatchTrajectories.channels.index("parasite_density")
+    assert all(view[0, h, 6 + t, i_density] == ref[0, h, t, i_density] for h in range(2) for t in range(14))
+
+
+def test_batch_invalid_protocol():
+    with pytest.raises(ValueError):
+        run_batch([{}], n_hosts=-1, duration=10)
+    with pytest.raises(ValueError):
+        run_batch([{}], n_hosts=2, duration=-10)
+    with pytest.raises(ValueError):
+        run_batch([{}], n_hosts=2, duration=10, dt=0)
+
+
+def test_batch_matches_population():
+    IntrahostComponent.set_params()
+
+    result = run_batch([{}], n_hosts=3, duration=60, challenge_days=[0, 20])
+    view = memoryview(result)
+    i_density = BatchTrajectories.channels.index("parasite_density")
+
+    # hosts with the same index draw from the same stream in a population and in a batch
+    pop = Population.create(n_hosts=3, params=IntrahostComponent.params_block())
+    for t in range(60):
+        if t in (0, 20):
+            for i in range(len(pop)):
+                pop.challenge(i)
+        pop.update(dt=1)
+        for i in range(len(pop)):
+            assert view[0, i, t, i_density] == pytest.approx(pop.host(i).parasite_density, rel=1e-6)
+
+
+def test_batch_threaded():
+    param_sets = [dict(Run_Number=n) for n in range(3)]
+
+    serial = memoryview(run_batch(param_sets, n_hosts=5, duration=40, n_threads=1)).tolist()
+    threaded = memoryview(run_batch(param_sets, n_hosts=5, duration=40, n_threads=4)).tolist()
+    assert serial == threaded
+
+    # identical parameter sets see identical random streams
+    repeated = memoryview(run_batch([{}, {}], n_hosts=3, duration=40)).tolist()
+    assert repeated[0] == repeated[1]
+
+
+def paired_difference_variance(common_random_numbers, n_hosts=100, duration=200):
+    base = dict(Common_Random_Numbers=common_random_numbers)
+    perturbed = dict(base, infection_params=dict(Antibody_IRBC_Kill_Rate=1.596 * 1.02))
+    view = memoryview(run_batch([base, perturbed], n_hosts=n_hosts, duration=duration))
+
+    i_density = BatchTrajectories.channels.index("parasite_density")
+    diffs = []
+    for h in range(n_hosts):
+        x = sum(view[0, h, t, i_density] for t in range(duration))
+        y = sum(view[1, h, t, i_density] for t in range(duration))
+        diffs.append(math.log1p(y) - math.log1p(x))
+
+    mean = sum(diffs) / n_hosts
+    return sum((d - mean) ** 2 for d in diffs) / n_hosts
+
+
+def test_common_random_numbers():
+    params = IntrahostComponent.params_block(dict(Common_Random_Numbers=True))
+    assert params.common_random_numbers
+
+    crn = [dict(Common_Random_Numbers=True)] * 2
+    serial = memoryview(run_batch(crn, n_hosts=3, duration=40, n_threads=1)).tolist()
+    threaded = memoryview(run_batch(crn, n_hosts=3, duration=40, n_threads=4)).tolist()
+    assert serial == threaded
+    assert serial[0] == serial[1]
+
+    # keyed draws stay aligned after the perturbed parameter changes how many draws were consumed
+    sequential = paired_difference_variance(False)
+    keyed = paired_difference_variance(True)
+    print("Var[paired difference]: sequential=%g, keyed=%g" % (sequential, keyed))
+    assert keyed < sequential
+
+
+def replicate_summaries(n_hosts=200, duration=90, **variance_reduction):
+    """Per-replicate mean log-density over the trajectory, pooling hosts over four seeds"""
+    param_sets = [dict(Run_Number=n) for n in range(4)]
+    view = memoryview(run_batch(param_sets, n_hosts=n_hosts, duration=duration, challenge_days=[0, 30],
+                                n_threads=4, **variance_reduction))
+
+    i_density = BatchTrajectories.channels.index("parasite_density")
+    summaries = []
+    for k in range(len(param_sets)):
+        hosts = [sum(math.log1p(view[k, h, t, i_density]) for t in range(duration)) / duration for h in range(n_hosts)]
+        if variance_reduction.get("antithetic"):
+            hosts = [(hosts[h] + hosts[h + 1]) / 2 for h in range(0, n_hosts, 2)]  # a pair is one replicate
+        summaries.extend(hosts)
+    return summaries
+
+
+def mean_and_standard_error(xs):
+    mean = sum(xs) / len(xs)
+    variance = sum((x - mean) ** 2 for x in xs) / (len(xs) - 1)
+    return mean, math.sqrt(variance / len(xs))
+
+
+@pytest.mark.parametrize("variance_reduction", [
+    dict(antithetic=True),
+    dict(stratified_repertoire=True),
+    dict(antithetic=True, stratified_repertoire=True),
+])
+def test_variance_reduction_unbiased(variance_reduction):
+    reference, se_reference = mean_and_standard_error(replicate_summaries())
+    reduced, se_reduced = mean_and_standard_error(replicate_summaries(**variance_reduction))
+    z = (reduced - reference) / math.sqrt(se_reference ** 2 + se_reduced ** 2)
+    print("%s: mean %g +/- %g vs %g +/- %g (z=%.2f)" % (variance_reduction, reduced, se_reduced, reference, se_reference, z))
+    assert abs(z) < 3.5
+
+
+def test_stratified_repertoire_coverage():
+    n_hosts, n_draws = 40, 2 * REPERTOIRE_DRAWS
+    draws = _stratified_repertoire_draws(7, n_hosts, n_draws)
+    assert len(draws) == n_hosts * n_draws
+
+    # every slot of the repertoire puts exactly one host in each 1/n_hosts stratum of its range
+    for d in range(n_draws):
+        column = [draws[h * n_draws + d] for h in range(n_hosts)]
+        assert sorted(u * n_hosts >> 32 for u in column) == list(range(n_hosts))
+
+    # while each host's draws move between strata independently from slot to slot
+    first = [draws[h * n_draws] * n_hosts >> 32 for h in range(n_hosts)]
+    second = [draws[h * n_draws + 1] * n_hosts >> 32 for h in range(n_hosts)]
+    assert first != second
+    assert _stratified_repertoire_draws(7, n_hosts, n_draws) == draws
+
+
+def test_variance_reduction_deterministic():
+    modes = dict(antithetic=True, stratified_repertoire=True)
+    serial = memoryview(run_batch([{}], n_hosts=6, duration=40, n_threads=1, **modes)).tolist()
+    threaded = memoryview(run_batch([{}], n_hosts=6, duration=40, n_threads=4, **modes)).tolist()
+    assert serial == threaded
+
+    # the modes change which numbers are drawn, not how many hosts are simulated
+    plain = memoryview(run_batch([{}], n_hosts=6, duration=40)).tolist()
+    assert len(plain[0]) == len(serial[0])
+    assert plain != serial
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])
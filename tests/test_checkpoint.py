@@ -0,0 +1,140 @@
+import pytest
+
+from emodlib.malaria import IntrahostComponent, Population
+
+
+def test_host_roundtrip():
+    IntrahostComponent.set_params()
+
+    ic = IntrahostComponent.create()
+    ic.challenge()
+    for t in range(30):
+        ic.update(dt=1)
+
+    data = ic.checkpoint()
+    assert data[:7] == b"EMODLIB"
+
+    restored = IntrahostComponent.restore(data)
+    assert restored.checkpoint() == data
+    assert restored.n_infections == ic.n_infections
+    assert restored.parasite_density == ic.parasite_density
+    assert restored.susceptibility.age == ic.susceptibility.age
+
+
+def test_population_continuation():
+    IntrahostComponent.set_params()
+
+    pop = Population.create(n_hosts=20)
+    for i in range(0, 20, 2):
+        pop.challenge(i)
+    for t in range(100):
+        pop.update(dt=1)
+
+    restored = Population.restore(pop.checkpoint(), n_threads=2)
+    assert len(restored) == len(pop)
+    assert sorted(restored.blood_stage) == sorted(pop.blood_stage)
+
+    # per-host streams are saved with their position, so the restored run continues identically
+    for t in range(100):
+        if t == 50:
+            pop.challenge(1)
+            restored.challenge(1)
+        pop.update(dt=1)
+        restored.update(dt=1)
+        for i in range(len(pop)):
+            assert restored.host(i).parasite_density == pop.host(i).parasite_density
+            assert restored.host(i).gametocyte_density == pop.host(i).gametocyte_density
+
+
+def test_mapped_population(tmp_path):
+    IntrahostComponent.set_params()
+
+    pop = Population.create(n_hosts=20)
+    for i in range(0, 20, 4):
+        pop.challenge(i)
+    for t in range(30):
+        pop.update(dt=1)
+
+    path = str(tmp_path / "population.snapshot")
+    pop.save(path)
+
+    mapped = Population.open(path)
+    assert mapped.n_materialized == 0
+    assert sorted(mapped.liver_stage + mapped.blood_stage) == [0, 4, 8, 12, 16]
+
+    # untouched hosts are written back from the mapped records unchanged
+    assert mapped.host(3).susceptibility.age == pop.host(3).susceptibility.age
+    assert mapped.n_materialized == 1
+    assert mapped.checkpoint() == pop.checkpoint()
+
+    for t in range(30):
+        pop.update(dt=1)
+        mapped.update(dt=1)
+    assert mapped.n_materialized == 6  # the infected hosts and host 3
+    assert all(mapped.host(i).parasite_density == pop.host(i).parasite_density for i in range(20))
+
+
+def test_mapped_update_stays_lazy(tmp_path):
+    IntrahostComponent.set_params()
+
+    pop = Population.create(n_hosts=2000)
+    for i in range(0, 2000, 20):
+        pop.challenge(i)
+    for t in range(10):
+        pop.update(dt=1)
+
+    path = str(tmp_path / "population.snapshot")
+    pop.save(path)
+
+    # uninfected hosts stay as records, their updates replayed when they are read or saved
+    mapped = Population.open(path)
+    for t in range(15):
+        pop.update(dt=1)
+        mapped.update(dt=1)
+    assert mapped.n_materialized == 100
+    assert mapped.n_materialized < len(mapped) // 10
+
+    assert mapped.checkpoint() == pop.checkpoint()
+    assert mapped.fork().checkpoint() == pop.checkpoint()
+    assert mapped.host(7).checkpoint() == pop.host(7).checkpoint()
+    assert mapped.n_materialized == 101
+
+
+def test_save_over_mapped_file(tmp_path):
+    IntrahostComponent.set_params()
+
+    pop = Population.create(n_hosts=200)
+    for i in range(0, 200, 5):
+        pop.challenge(i)
+    for t in range(20):
+        pop.update(dt=1)
+
+    path = str(tmp_path / "population.snapshot")
+    pop.save(path)
+
+    # saving replaces the file, leaving the mapping of the old one intact for hosts not yet read
+    mapped = Population.open(path)
+    mapped.treat(0)
+    mapped.save(path)
+    assert mapped.n_materialized == 1
+    assert mapped.host(150).checkpoint() == pop.host(150).checkpoint()
+
+    reopened = Population.open(path)
+    assert reopened.host(0).n_infections == 0
+    assert reopened.checkpoint() == mapped.checkpoint()
+
+
+def test_invalid_snapshot():
+    ic = IntrahostComponent.create()
+    data = ic.checkpoint()
+
+    with pytest.raises(RuntimeError):
+        IntrahostComponent.restore(b"not a snapshot")
+    with pytest.raises(RuntimeError):
+        IntrahostComponent.restore(data[: len(data) // 2])
+    with pytest.raises(RuntimeError):
+        Population.restore(data)
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])
@@ -0,0 +1,77 @@
+import pytest
+
+from emodlib.malaria import IntrahostComponent, Population
+
+
+def test_clone_host():
+    IntrahostComponent.set_params()
+
+    pop = Population.create(n_hosts=1)
+    pop.challenge(0)
+    for t in range(40):
+        pop.update(dt=1)
+
+    branch = pop.host(0).clone()
+    assert branch.checkpoint() == pop.host(0).checkpoint()
+
+    # same stream position, so the untreated branch tracks the original exactly
+    with pop.modify_host(0) as ic:
+        for t in range(60):
+            ic.update(dt=1)
+            branch.update(dt=1)
+            assert branch.parasite_density == ic.parasite_density
+
+    branch.treat()
+    assert branch.n_infections == 0
+    assert pop.host(0).n_infections > 0
+
+
+def test_clone_shared_stream_host():
+    IntrahostComponent.set_params()
+
+    # created without a stream of its own, so it draws from the shared one
+    ic = IntrahostComponent.create()
+    ic.challenge()
+    for t in range(20):
+        ic.update(dt=1)
+
+    # each copy takes the shared stream at the same position, so they track each other exactly
+    a, b = ic.clone(), ic.clone()
+    for t in range(60):
+        a.update(dt=1)
+        b.update(dt=1)
+        assert a.parasite_density == b.parasite_density
+    assert a.checkpoint() == b.checkpoint()
+
+
+def test_fork_population():
+    IntrahostComponent.set_params()
+
+    pop = Population.create(n_hosts=10, n_threads=2)
+    for i in range(0, 10, 2):
+        pop.challenge(i)
+    for t in range(30):
+        pop.update(dt=1)
+
+    treat_now = pop.fork()
+    treat_later = pop.fork()
+    assert treat_now.checkpoint() == pop.checkpoint()
+
+    for i in treat_now.blood_stage:
+        treat_now.treat(i)
+
+    for t in range(10):
+        treat_now.update(dt=1)
+        treat_later.update(dt=1)
+        pop.update(dt=1)
+        if t == 3:
+            for i in treat_later.blood_stage:
+                treat_later.treat(i)
+
+    assert treat_later.checkpoint() != pop.checkpoint()
+    assert all(pop.host(i).parasite_density == treat_later.host(i).parasite_density for i in pop.uninfected)
+    assert len(treat_now.uninfected) >= len(pop.uninfected)
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])
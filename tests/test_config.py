@@ -0,0 +1,93 @@
+import json
+import os
+
+import pytest
+import yaml
+
+from emodlib import Params
+from emodlib.malaria import IntrahostComponent, IntrahostParams
+
+CONFIG = os.path.join(
+    os.path.realpath(os.path.dirname(__file__)), "..", "src", "emodlib", "malaria", "config.yml"
+)
+
+
+def test_native_yaml_matches_pyyaml():
+    with open(CONFIG) as cfg:
+        expected = yaml.load(cfg, Loader=yaml.FullLoader)
+
+    assert Params.from_file(CONFIG) == expected
+    assert IntrahostComponent.default_params == expected
+
+
+SCALARS = """\
+exponent_without_point: 1e-3
+exponent: 7.6e-10
+unsigned_exponent: 1.0e3
+point_first: .5
+signed_point_first: -.5
+trailing_point: 1.
+underscores: 1_000
+hex: 0x10
+octal: 017
+not_octal: 09
+binary: 0b101
+sexagesimal: 1:30
+sexagesimal_float: 1:30.5
+infinity: -.inf
+yes_bool: yes
+on_bool: On
+off_bool: OFF
+plain: abc
+quoted: "12"
+nested:
+  signed: +12
+  zero: 0
+"""
+
+
+def test_native_scalars_match_pyyaml(tmp_path):
+    path = tmp_path / "scalars.yml"
+    path.write_text(SCALARS)
+
+    native, expected = Params.from_file(str(path)), Params.from_yaml(str(path))
+    assert native == expected
+    assert {k: type(v) for k, v in native.items()} == {k: type(v) for k, v in expected.items()}
+
+
+def test_native_json(tmp_path):
+    path = tmp_path / "config.json"
+    path.write_text(json.dumps(Params.from_file(CONFIG)))
+
+    assert Params.from_file(str(path)) == Params.from_file(CONFIG)
+
+
+def test_params_block_from_file():
+    block = IntrahostParams.from_file(CONFIG)
+    assert block.run_number == 12345
+    assert block.max_individual_infections == 5
+
+    ic = IntrahostComponent.create(block)
+    ic.challenge()
+    densities = []
+    for _ in range(30):
+        ic.update(dt=1)
+        densities.append(ic.parasite_density)
+    assert max(densities) > 0
+
+
+def test_malformed_config(tmp_path):
+    path = tmp_path / "bad.yml"
+    path.write_text("Run_Number: 1\nparams:\n  - 1\n")
+
+    with pytest.raises(ValueError, match="bad.yml:3"):
+        Params.from_file(str(path))
+
+
+def test_invalid_derived_constant():
+    with pytest.raises(ValueError, match="Antibody_Memory_Level"):
+        IntrahostComponent.params_block(dict(susceptibility_params=dict(Antibody_Memory_Level=0.5)))
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])
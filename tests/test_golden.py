@@ -0,0 +1,87 @@
+import json
+import os
+import shutil
+
+import pytest
+
+from emodlib.malaria import CLONAL_PFEMP1_VARIANTS, PRECISION, compare_golden, load_trajectories, record_golden
+from emodlib.malaria.golden import GOLDEN_SCENARIOS, anderson_ksamp, ks_2samp
+
+# recorded by the default float64 build with 50 PfEMP1 variants, from the protocol in its golden.json
+REFERENCE = os.path.join(os.path.dirname(__file__), "data", "golden")
+
+
+def rewrite(path, scale):
+    """Scale the parasite densities of a recording in place."""
+    header, data = load_trajectories(path)
+    n_channels = len(header["channels"])
+    c = header["channels"].index("parasite_density")
+    for i in range(c, len(data), n_channels):
+        data[i] *= scale
+    with open(path, "wb") as f:
+        f.write((json.dumps(header) + "\n").encode())
+        f.write(data.tobytes())
+
+
+def test_ks_2samp():
+    d, p = ks_2samp([1, 2, 3, 4, 5], [6, 7, 8, 9, 10])
+    assert d == 1.0 and p < 0.01
+
+    d, p = ks_2samp(list(range(50)), list(range(50)))
+    assert d == 0.0 and p == 1.0
+
+
+def test_anderson_ksamp():
+    # Scholz & Stephens (1987), example 1, with ties handled by midranks
+    t1 = [38.7, 41.5, 43.8, 44.5, 45.5, 46.0, 47.7, 58.0]
+    t2 = [39.2, 39.3, 39.7, 41.4, 41.8, 42.9, 43.3, 45.8]
+    t3 = [34.0, 35.0, 39.0, 40.0, 43.0, 43.0, 44.0, 45.0]
+    t4 = [34.0, 34.8, 34.8, 35.4, 37.2, 37.8, 41.2, 42.8]
+
+    T, p = anderson_ksamp([t1, t2, t3, t4])
+    assert T == pytest.approx(4.480, abs=1e-3)
+    assert p == pytest.approx(0.0020, abs=3e-4)
+
+    T, p = anderson_ksamp([t1, t1])
+    assert p == 0.25
+
+
+def test_golden(tmp_path):
+    with open(os.path.join(REFERENCE, "golden.json")) as f:
+        golden = json.load(f)
+    if golden["pfemp1_variants"] != CLONAL_PFEMP1_VARIANTS:
+        pytest.skip("reference recorded with %d PfEMP1 variants" % golden["pfemp1_variants"])
+
+    candidate = tmp_path / "candidate"
+    record_golden(candidate, seeds=golden["seeds"], n_hosts=golden["n_hosts"], duration=golden["duration"],
+                  scenarios={name: GOLDEN_SCENARIOS[name] for name in golden["scenarios"]})
+
+    # this build reproduces the reference distributions, and bitwise at the precision it was recorded with
+    passed, reports = compare_golden(REFERENCE, candidate)
+    assert passed, {name: r["outcomes"] for name, r in reports.items()}
+    if PRECISION == golden["precision"]:
+        passed, reports = compare_golden(REFERENCE, candidate, bitwise=True)
+        assert passed, {name: r["first_difference"] for name, r in reports.items()}
+
+
+def test_golden_detects_changes(tmp_path):
+    reference, candidate = tmp_path / "reference", tmp_path / "candidate"
+    shutil.copytree(REFERENCE, reference)
+    shutil.copytree(REFERENCE, candidate)
+
+    # rounding-level differences break bitwise identity but not the distributions
+    rewrite(candidate / "naive.traj", 1 + 1e-6)
+    assert not compare_golden(reference, candidate, bitwise=True)[0]
+    passed, reports = compare_golden(reference, candidate)
+    assert passed
+    assert reports["naive"]["first_difference"][3] == "parasite_density"
+
+    # densities a hundredfold too high are caught
+    rewrite(candidate / "naive.traj", 100)
+    passed, reports = compare_golden(reference, candidate)
+    assert not passed
+    assert not reports["naive"]["outcomes"]["peak_log_density"]["passed"]
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])
@@ -132,5 +132,38 @@ def test_max_infections():
         assert ic.n_infections <= params["Max_Individual_Infections"]
 
 
+def test_params_blocks():
+    print("Set default parameters...")
+    IntrahostComponent.set_params()
+
+    print("Create hosts with independent parameter blocks...")
+    single = IntrahostComponent.params_block(dict(Max_Individual_Infections=1))
+    assert single.max_individual_infections == 1
+
+    ic_single = IntrahostComponent.create(params=single)
+    ic_default = IntrahostComponent.create()
+
+    print("Reconfigure defaults under existing hosts...")
+    IntrahostComponent.update_params(dict(Max_Individual_Infections=2))
+
+    for i in range(10):
+        ic_single.challenge()
+        ic_default.challenge()
+
+    print(
+        "%d + %d infections after 10 challenges"
+        % (ic_single.n_infections, ic_default.n_infections)
+    )
+    assert ic_single.n_infections == 1
+    assert ic_default.n_infections == 5  # block captured at creation
+
+    ic_new = IntrahostComponent.create()
+    for i in range(10):
+        ic_new.challenge()
+    assert ic_new.n_infections == 2
+
+    IntrahostComponent.set_params()
+
+
 if __name__ == "__main__":
     pytest.main(["-vv", "-s", __file__])
@@ -1,6 +1,6 @@
 import pytest
 
-from emodlib.malaria import Infection, IntrahostComponent, Susceptibility
+from emodlib.malaria import CLONAL_PFEMP1_VARIANTS, Infection, IntrahostComponent, Susceptibility
 
 
 @pytest.fixture
@@ -27,7 +27,7 @@ def test_infection(default_infection, params):
 
     major_types = infs[0].pfemp1_major_types
     print(major_types)
-    assert len(major_types) == 50
+    assert len(major_types) == CLONAL_PFEMP1_VARIANTS
     assert all([t < params["Falciparum_PfEMP1_Variants"] for t in major_types])
 
 
@@ -39,5 +39,27 @@ def test_antibody(default_infection):
     assert inf.msp_antibody.antigen_count > 0
 
 
+@pytest.mark.parametrize(
+    "switch_type",
+    ["CONSTANT_SWITCH_RATE_2VARS", "RATE_PER_PARASITE_7VARS", "RATE_PER_PARASITE_5VARS_DECAYING"],
+)
+def test_parasite_switch_type(switch_type):
+    block = IntrahostComponent.params_block(dict(infection_params=dict(Parasite_Switch_Type=switch_type)))
+    ic = IntrahostComponent.create(params=block)
+    ic.challenge()
+
+    densities = []
+    for _ in range(30):
+        ic.update(dt=1)
+        densities.append(ic.parasite_density)
+    print(switch_type, max(densities))
+    assert max(densities) > 0
+
+
+def test_unknown_parasite_switch_type():
+    with pytest.raises(ValueError):
+        IntrahostComponent.params_block(dict(infection_params=dict(Parasite_Switch_Type="NO_SUCH_SWITCH")))
+
+
 if __name__ == "__main__":
     pytest.main(["-vv", "-s", __file__])
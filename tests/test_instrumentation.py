@@ -0,0 +1,40 @@
+import pytest
+
+from emodlib.malaria import INSTRUMENTATION, IntrahostComponent, instrumentation_stats, reset_instrumentation
+
+
+def test_instrumentation():
+    reset_instrumentation()
+
+    ic = IntrahostComponent.create()
+    ic.challenge()
+    for _ in range(30):
+        ic.update(dt=1)
+
+    stats = instrumentation_stats()
+    assert stats["enabled"] == INSTRUMENTATION
+    assert stats["clock"] in ("tsc", "ns")
+    assert "processEndOfAsexualCycle" in stats["phases"]
+    assert "updateImmunityPfEMP1Minor" in stats["phases"]
+    assert "eGauss" in stats["draws"]
+    assert set(stats["phases"]["malariaImmunityIRBCKill"]) == {"calls", "cycles", "cpu_cycles", "instructions", "llc_misses", "branch_misses"}
+    assert stats["hardware"] in (True, False)
+
+    update = stats["phases"]["IntrahostComponent::Update"]
+    if INSTRUMENTATION:
+        assert update["calls"] == 30 and update["cycles"] > 0
+        assert stats["phases"]["malariaImmunityIRBCKill"]["calls"] > 0
+        assert stats["draws"]["e"] > 0
+
+        # nested phases are included in the update that calls them
+        assert stats["phases"]["Susceptibility::Update"]["cycles"] <= update["cycles"]
+
+        reset_instrumentation()
+        assert instrumentation_stats()["phases"]["IntrahostComponent::Update"]["calls"] == 0
+    else:
+        assert update["calls"] == 0
+        assert all(n == 0 for n in stats["draws"].values())
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])
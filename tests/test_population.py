@@ -0,0 +1,145 @@
+import pytest
+
+from emodlib.malaria import IntrahostComponent, Population
+
+
+def describe(pop, t=None):
+    s = "t=%d: " % t if t is not None else ""
+    s += "(uninfected, liver-stage, blood-stage) = (%d, %d, %d)" % (
+        len(pop.uninfected),
+        len(pop.liver_stage),
+        len(pop.blood_stage),
+    )
+    print(s)
+
+
+def test_partitions():
+    print("Set default parameters...")
+    IntrahostComponent.set_params()
+
+    print("Create...")
+    pop = Population.create(n_hosts=10)
+    assert len(pop) == 10
+    assert sorted(pop.uninfected) == list(range(10))
+
+    print("Challenge...")
+    for i in range(3):
+        pop.challenge(i)
+    describe(pop)
+    assert sorted(pop.liver_stage) == [0, 1, 2]
+    assert len(pop.uninfected) == 7
+
+    print("Update...")
+    for t in range(10):
+        pop.update(dt=1)
+        describe(pop, t)
+
+    assert sorted(pop.blood_stage) == [0, 1, 2]
+    assert all(pop.host(i).parasite_density > 0 for i in pop.blood_stage)
+    assert all(pop.host(i).parasite_density == 0 for i in pop.uninfected)
+
+    print("Treat...")
+    pop.treat(0)
+    describe(pop)
+    assert 0 in pop.uninfected
+    assert sorted(pop.blood_stage) == [1, 2]
+
+
+def test_uninfected_kernel():
+    IntrahostComponent.set_params()
+
+    pop = Population.create(n_hosts=2)
+    ic = IntrahostComponent.create()
+
+    for t in range(30):
+        pop.update(dt=1)
+        ic.update(dt=1)
+
+    s = pop.host(0).susceptibility
+    assert s.age == ic.susceptibility.age
+    assert pop.host(0).fever_temperature == ic.fever_temperature
+
+
+def test_clearance_migration():
+    IntrahostComponent.set_params()
+
+    pop = Population.create(n_hosts=5)
+    for i in range(len(pop)):
+        pop.challenge(i)
+
+    for t in range(365 * 2):
+        pop.update(dt=1)
+        for i in pop.uninfected:
+            assert pop.host(i).n_infections == 0
+
+    describe(pop)
+    assert len(pop.uninfected) + len(pop.liver_stage) + len(pop.blood_stage) == 5
+
+
+def test_modified_host_migration():
+    IntrahostComponent.set_params()
+
+    pop = Population.create(n_hosts=3)
+
+    # changed through the host itself rather than the population
+    with pop.modify_host(1) as h:
+        h.challenge()
+    assert 1 in pop.liver_stage
+
+    for t in range(30):
+        pop.update(dt=1)
+
+    assert pop.host(1).parasite_density > 0
+    assert sorted(pop.blood_stage) == [1]
+
+    with pop.modify_host(1) as h:
+        h.treat()
+    assert 1 in pop.uninfected
+    assert len(pop.blood_stage) == 0
+
+    # hosts seen through the population cannot be changed behind its back
+    with pytest.raises(AttributeError):
+        pop.host(0).challenge()
+
+
+def run_population(n_threads, n_hosts=50, duration=60):
+    pop = Population.create(n_hosts=n_hosts, n_threads=n_threads)
+    for i in range(0, n_hosts, 2):
+        pop.challenge(i)
+
+    densities = []
+    for t in range(duration):
+        pop.update(dt=1)
+        densities.append([pop.host(i).parasite_density for i in range(n_hosts)])
+
+    return pop, densities
+
+
+def test_threaded_update():
+    IntrahostComponent.set_params()
+
+    _, serial = run_population(n_threads=1)
+    pop, threaded = run_population(n_threads=4)
+
+    # each host draws from its own stream, so results do not depend on scheduling
+    assert serial == threaded
+
+    stats = pop.scheduler_stats
+    print(stats)
+    assert pop.n_threads == 4
+    assert len(stats["tasks"]) == 4
+    assert sum(stats["tasks"]) > 0
+    assert all(t >= 0 for t in stats["idle_seconds"])
+
+    pop.reset_scheduler_stats()
+    assert sum(pop.scheduler_stats["tasks"]) == 0
+
+
+def test_index_error():
+    pop = Population.create(n_hosts=1)
+    with pytest.raises(IndexError):
+        pop.challenge(1)
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])
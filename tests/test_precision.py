@@ -0,0 +1,82 @@
+import os
+
+import pytest
+
+from emodlib.malaria import (
+    CLONAL_PFEMP1_VARIANTS,
+    PRECISION,
+    load_trajectories,
+    record_trajectories,
+    trajectory_divergence,
+)
+from emodlib.malaria.golden import OUTCOMES, compare_scenario
+
+# recorded by the default float64 build with 50 PfEMP1 variants, from the protocol in its header
+REFERENCE = os.path.join(os.path.dirname(__file__), "data", "precision_float64.traj")
+
+
+def record_reference_protocol(path, header):
+    protocol = header["protocol"]
+    record_trajectories(path, param_sets=protocol["param_sets"], n_hosts=protocol["n_hosts"],
+                        duration=protocol["duration"], challenge_days=protocol["challenge_days"], dt=protocol["dt"])
+    return load_trajectories(path)
+
+
+def test_precision():
+    assert PRECISION in ("float32", "float64")
+
+
+def test_header(tmp_path):
+    path = tmp_path / "a.traj"
+    record_trajectories(path, n_hosts=4, duration=60)
+
+    header, _ = load_trajectories(path)
+    assert header["precision"] == PRECISION
+    assert header["pfemp1_variants"] == CLONAL_PFEMP1_VARIANTS
+    assert header["shape"][:3] == [1, 4, 60]
+
+
+def test_against_double_precision(tmp_path):
+    reference = load_trajectories(REFERENCE)
+    assert reference[0]["precision"] == "float64"
+    if reference[0]["pfemp1_variants"] != CLONAL_PFEMP1_VARIANTS:
+        pytest.skip("reference recorded with %d PfEMP1 variants" % reference[0]["pfemp1_variants"])
+
+    candidate = record_reference_protocol(tmp_path / "candidate.traj", reference[0])
+    assert candidate[0]["precision"] == PRECISION
+    assert candidate[0]["pfemp1_variants"] == CLONAL_PFEMP1_VARIANTS
+
+    report = trajectory_divergence(reference, candidate)
+    assert set(report) == set(reference[0]["channels"])
+    print({channel: (d["max_rel"], d["first_step"]) for channel, d in report.items()})
+
+    # rounding may send single hosts elsewhere, but not the distribution of their outcomes
+    result = compare_scenario(reference, candidate, n_tests=2 * len(OUTCOMES))
+    print(result["first_difference"])
+    assert all(o["passed"] for o in result["outcomes"].values()), result["outcomes"]
+
+
+def test_divergence(tmp_path):
+    reference = load_trajectories(REFERENCE)
+    other = (reference[0], reference[1][:])
+
+    report = trajectory_divergence(reference, other)
+    assert all(d["max_abs"] == 0 and d["first_step"] is None for d in report.values())
+    assert report["parasite_density"]["fraction_status_differs"] == 0
+
+    other[1][-1] += 1.0
+    report = trajectory_divergence(reference, other)
+    assert any(d["first_step"] == reference[0]["shape"][2] - 1 for d in report.values())
+
+
+def test_divergence_protocols(tmp_path):
+    a, b = tmp_path / "a.traj", tmp_path / "b.traj"
+    record_trajectories(a, n_hosts=2, duration=10)
+    record_trajectories(b, n_hosts=2, duration=20)
+
+    with pytest.raises(ValueError):
+        trajectory_divergence(load_trajectories(a), load_trajectories(b))
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])
@@ -0,0 +1,109 @@
+import pytest
+
+from emodlib.malaria import AggregateReporter, IntrahostComponent, Population
+
+
+def test_aggregate_reporter():
+    IntrahostComponent.set_params()
+
+    pop = Population.create(n_hosts=300, n_threads=2)
+    reporter = AggregateReporter.create()
+    pop.reporter = reporter
+    assert pop.reporter is reporter
+
+    for i in range(0, 300, 3):
+        pop.challenge(i)
+    for _ in range(30):
+        pop.update(dt=1)
+
+    assert reporter.shape == (30, 1, len(AggregateReporter.channels))
+    assert reporter.times[-1] == 30
+
+    rows = memoryview(reporter).tolist()
+    last = dict(zip(AggregateReporter.channels, rows[-1][0]))
+    assert last["hosts"] == 300
+
+    # the summaries agree with the hosts themselves
+    hosts = [pop.host(i) for i in range(300)]
+    densities = [h.parasite_density for h in hosts if h.n_infections and h.parasite_density > 0]
+    assert last["infected_prevalence"] == pytest.approx(sum(h.n_infections > 0 for h in hosts) / 300)
+    assert last["patent_prevalence"] == pytest.approx(sum(d > reporter.detection_threshold for d in densities) / 300)
+    assert last["mean_density"] == pytest.approx(sum(densities) / len(densities), rel=1e-5)
+    assert last["mean_infectiousness"] == pytest.approx(sum(h.infectiousness for h in hosts) / 300, rel=1e-5, abs=1e-9)
+
+    reporter.clear()
+    assert reporter.shape[0] == 0
+
+
+def test_age_bins():
+    pop = Population.create(n_hosts=10)
+    pop.reporter = AggregateReporter.create(age_bins=[5, 15, 100])
+    pop.update(dt=1)
+
+    # hosts are adults until demographics are ported
+    counts = [stratum[0] for stratum in memoryview(pop.reporter).tolist()[0]]
+    assert counts == [0, 0, 10]
+
+    with pytest.raises(ValueError):
+        AggregateReporter.create(age_bins=[15, 5])
+
+
+def test_quantile_sketches():
+    IntrahostComponent.set_params()
+
+    pop = Population.create(n_hosts=2000, n_threads=2)
+    pop.reporter = AggregateReporter.create(sketch_k=100)
+    for i in range(0, 2000, 2):
+        pop.challenge(i)
+    for _ in range(20):
+        pop.update(dt=1)
+
+    q = [0.1, 0.5, 0.9]
+    quantiles = pop.reporter.quantiles("parasite_density", q)
+    assert len(quantiles) == 20 and len(quantiles[-1]) == 1
+
+    # each sketched quantile sits within the sketch's rank error of the true one
+    densities = sorted(pop.host(i).parasite_density for i in range(2000)
+                       if pop.host(i).n_infections and pop.host(i).parasite_density > 0)
+    for p, value in zip(q, quantiles[-1][0]):
+        rank = sum(d <= value for d in densities) / len(densities)
+        assert rank == pytest.approx(p, abs=0.03)
+
+    median = memoryview(pop.reporter).tolist()[-1][0][AggregateReporter.channels.index("median_density")]
+    assert median == pytest.approx(pop.reporter.quantiles("parasite_density", [0.5])[-1][0][0])
+
+    breadth = pop.reporter.quantiles("pfemp1_major_breadth", [0, 1])[-1][0]
+    assert 0 <= breadth[0] <= breadth[1] <= 1
+
+    with pytest.raises(ValueError):
+        pop.reporter.quantiles("antibodies", q)
+
+
+def test_pipelined_reporter():
+    IntrahostComponent.set_params()
+
+    reporters = [AggregateReporter.create(age_bins=[5, 100]),
+                 AggregateReporter.create(age_bins=[5, 100], pipeline_depth=4)]
+    assert reporters[1].pipeline_depth == 4
+
+    # the same hosts on one thread, so only the reporting differs
+    for reporter in reporters:
+        pop = Population.create(n_hosts=500)
+        pop.reporter = reporter
+        for i in range(0, 500, 5):
+            pop.challenge(i)
+        for _ in range(20):
+            pop.update(dt=1)
+
+    synchronous, pipelined = reporters
+    assert pipelined.shape == synchronous.shape
+    assert pipelined.times == synchronous.times
+    assert memoryview(pipelined).tolist() == memoryview(synchronous).tolist()
+    assert pipelined.n_dropped == 0
+
+    with pytest.raises(ValueError):
+        AggregateReporter.create(pipeline_depth=2, backpressure="spill")
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])
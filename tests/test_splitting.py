@@ -0,0 +1,76 @@
+import math
+
+import pytest
+
+from emodlib.malaria import IntrahostComponent, Population, run_splitting
+
+
+def test_single_level_is_plain_monte_carlo():
+    IntrahostComponent.set_params()
+
+    n_hosts, duration, level = 50, 60, 0.13
+    result = run_splitting([level], n_particles=n_hosts, duration=duration)
+
+    # first-stage particles draw from the same streams as population hosts with the same index
+    pop = Population.create(n_hosts=n_hosts)
+    for i in range(n_hosts):
+        pop.challenge(i)
+
+    reached = set()
+    for t in range(duration):
+        pop.update(dt=1)
+        for i in range(n_hosts):
+            if 1 - pop.host(i).susceptibility.RBC_availability >= level:
+                reached.add(i)
+
+    assert result.level_hits == [len(reached)]
+    assert result.probability == pytest.approx(len(reached) / n_hosts)
+
+
+def test_splitting_unbiased():
+    duration = 120
+
+    brute = run_splitting([0.15], n_particles=5000, duration=duration)
+
+    estimates = [
+        run_splitting([0.14, 0.15], params=dict(Run_Number=100 + s), n_particles=300, duration=duration).probability
+        for s in range(8)
+    ]
+    mean = sum(estimates) / len(estimates)
+    var = sum((e - mean) ** 2 for e in estimates) / (len(estimates) - 1) / len(estimates)
+    brute_var = brute.probability * (1 - brute.probability) / 5000
+
+    print("brute force: %g, splitting: %g +/- %g" % (brute.probability, mean, math.sqrt(var)))
+    assert abs(mean - brute.probability) < 4 * math.sqrt(var + brute_var)
+
+
+def test_splitting_unbiased_rare_level():
+    duration = 120
+
+    # about 1 in 250 hosts reach the last level, so each stage of splitting resamples from a few dozen survivors
+    brute = run_splitting([0.16], n_particles=20000, duration=duration, n_threads=4)
+    assert 0 < brute.probability < 0.01
+
+    estimates = [
+        run_splitting([0.14, 0.15, 0.16], params=dict(Run_Number=200 + s), n_particles=300, duration=duration).probability
+        for s in range(16)
+    ]
+    mean = sum(estimates) / len(estimates)
+    var = sum((e - mean) ** 2 for e in estimates) / (len(estimates) - 1) / len(estimates)
+    brute_var = brute.probability * (1 - brute.probability) / 20000
+
+    print("brute force: %g, splitting: %g +/- %g" % (brute.probability, mean, math.sqrt(var)))
+    assert abs(mean - brute.probability) < 4 * math.sqrt(var + brute_var)
+
+
+def test_invalid_levels():
+    with pytest.raises(ValueError):
+        run_splitting([0.2, 0.1])
+    with pytest.raises(ValueError):
+        run_splitting([0.1], observable="hemoglobin")
+    with pytest.raises(ValueError):
+        run_splitting([0.1], duration=-1)
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])
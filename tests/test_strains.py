@@ -0,0 +1,84 @@
+import pytest
+
+from emodlib.malaria import IntrahostComponent, Population
+
+
+def strain_block(model):
+    return IntrahostComponent.params_block(dict(infection_params=dict(Malaria_Strain_Model=model)))
+
+
+def first_infection(params, strain_id=0, index=0):
+    pop = Population.create(n_hosts=index + 1, params=params)
+    pop.challenge(index, strain_id=strain_id)
+    return pop, pop.host(index).infections[0]  # the population owns the infection, so keep it alive too
+
+
+def test_random_strain():
+    pop_a, a = first_infection(strain_block("FALCIPARUM_RANDOM_STRAIN"), index=0)
+    pop_b, b = first_infection(strain_block("FALCIPARUM_RANDOM_STRAIN"), index=1)
+
+    assert a.strain_id == b.strain_id == -1
+    assert a.pfemp1_major_types != b.pfemp1_major_types
+
+
+def test_nonrandom_strain():
+    params = strain_block("FALCIPARUM_NONRANDOM_STRAIN")
+    pop_a, a = first_infection(params, index=0)
+    pop_b, b = first_infection(params, index=1)
+
+    assert a.strain_id == 0
+    assert a.msp_type == 0
+    assert a.pfemp1_major_types == list(range(50))
+    assert b.pfemp1_major_types == a.pfemp1_major_types
+
+
+def test_random50_strain():
+    pop_a, a = first_infection(strain_block("FALCIPARUM_RANDOM50_STRAIN"))
+
+    assert a.strain_id == -1
+    assert all(t < 50 for t in a.pfemp1_major_types)
+    assert len(set(a.pfemp1_major_types)) > 1
+
+
+def test_strain_generator():
+    params = strain_block("FALCIPARUM_STRAIN_GENERATOR")
+
+    # a strain has the same antigens on every host, whatever the host's own stream
+    pop_a, a = first_infection(params, strain_id=7, index=0)
+    pop_b, b = first_infection(params, strain_id=7, index=3)
+    pop_c, c = first_infection(params, strain_id=8, index=0)
+
+    assert a.strain_id == b.strain_id == 7
+    assert a.pfemp1_major_types == b.pfemp1_major_types
+    assert a.msp_type == b.msp_type
+    assert c.strain_id == 8
+    assert c.pfemp1_major_types != a.pfemp1_major_types
+
+    with pytest.raises(ValueError):
+        first_infection(params, strain_id=-1)
+
+
+def test_strain_checkpoint():
+    params = strain_block("FALCIPARUM_STRAIN_GENERATOR")
+    pop, inf = first_infection(params, strain_id=3)
+    for t in range(30):
+        pop.update(dt=1)
+
+    restored = IntrahostComponent.restore(pop.host(0).checkpoint(), params=params)
+    assert restored.infections[0].strain_id == 3
+    assert restored.infections[0].pfemp1_major_types == inf.pfemp1_major_types
+
+    with pop.modify_host(0) as ic:
+        for t in range(30):
+            ic.update(dt=1)
+            restored.update(dt=1)
+            assert restored.parasite_density == ic.parasite_density
+
+
+def test_unknown_strain_model():
+    with pytest.raises(ValueError):
+        strain_block("FALCIPARUM_NO_SUCH_STRAIN")
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])
@@ -0,0 +1,77 @@
+import json
+
+import pytest
+
+import emodlib
+from emodlib.malaria import AggregateReporter, Population
+
+
+def test_trace(tmp_path):
+    path = tmp_path / "trace.json"
+
+    pop = Population.create(n_hosts=200, n_threads=2)
+    for i in range(0, 200, 4):
+        pop.challenge(i)
+
+    with emodlib.trace(path) as counts:
+        for _ in range(20):
+            pop.update(dt=1)
+        recorded, dropped = counts()
+        assert recorded > 0 and dropped == 0
+
+    with open(path) as f:
+        trace = json.load(f)
+    events = trace["traceEvents"]
+    assert trace["otherData"]["dropped_events"] == 0
+
+    steps = [e for e in events if e["name"] == "Population::Update"]
+    assert len(steps) == 20
+    assert all(e["ph"] == "X" and e["dur"] >= 0 for e in steps)
+
+    tasks = [e for e in events if e.get("cat") == "scheduler"]
+    assert tasks and all(e["args"]["begin"] < e["args"]["end"] for e in tasks)
+    assert any(e["name"] == "refill" for e in events)
+
+    names = {e["args"]["name"] for e in events if e["ph"] == "M"}
+    assert "worker 1" in names
+
+
+def test_trace_output_scopes(tmp_path):
+    path = tmp_path / "trace.json"
+
+    pop = Population.create(n_hosts=200)
+    pop.reporter = AggregateReporter.create(pipeline_depth=2)
+    for i in range(0, 200, 4):
+        pop.challenge(i)
+
+    with emodlib.trace(path):
+        for _ in range(10):
+            pop.update(dt=1)
+    pop.reporter.flush()
+
+    with open(path) as f:
+        events = json.load(f)["traceEvents"]
+
+    # reporting is timed as output, not as part of reclassifying hosts
+    reclassify = [e for e in events if e["name"] == "reclassify"]
+    ends = [e for e in events if e["name"] == "AggregateReporter::EndStep"]
+    assert len(reclassify) == len(ends) == 10
+    assert all(e["cat"] == "output" for e in ends)
+    for r, e in zip(reclassify, ends):
+        assert r["ts"] + r["dur"] <= e["ts"] + 1e-3  # written to the nanosecond
+
+
+def test_trace_capacity(tmp_path):
+    pop = Population.create(n_hosts=100)
+    pop.challenge(0)
+
+    with emodlib.trace(tmp_path / "trace.json", events_per_thread=10) as counts:
+        for _ in range(20):
+            pop.update(dt=1)
+
+    recorded, dropped = counts()
+    assert recorded == 10 and dropped > 0
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])
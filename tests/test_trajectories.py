@@ -0,0 +1,69 @@
+import pytest
+
+from emodlib.malaria import Population, TrajectoryWriter, open_trajectories
+
+
+def test_trajectory_writer(tmp_path):
+    path = str(tmp_path / "trajectories")
+    pop = Population.create(n_hosts=100, n_threads=2)
+    hosts = [0, 10, 99]
+
+    with TrajectoryWriter.create(path, hosts, steps_per_chunk=4) as writer:
+        pop.writer = writer
+        for i in range(0, 100, 10):
+            pop.challenge(i)
+        for _ in range(10):
+            pop.update(dt=1)
+        assert writer.n_steps == 10
+        writer.flush()
+        assert writer.n_written == 10
+        last = {i: pop.host(i).parasite_density for i in hosts}
+    assert not writer.is_open
+
+    with pytest.raises(RuntimeError):
+        pop.update(dt=1)
+    pop.writer = None
+
+    with open_trajectories(path) as traj:
+        assert traj.hosts == hosts
+        assert traj.n_steps == 10
+        assert traj.channels == TrajectoryWriter.channels
+        assert traj.times.tolist() == [float(t) for t in range(1, 11)]
+
+        density = traj["parasite_density"]
+        assert density.shape == (10, 3)
+        for h, i in enumerate(hosts):
+            assert density[9, h] == pytest.approx(last[i], rel=1e-6)
+        assert traj.host(10)["parasite_density"][-1] == pytest.approx(last[10], rel=1e-6)
+        del density
+
+
+def test_dropping_writer(tmp_path):
+    path = str(tmp_path / "dropping")
+    pop = Population.create(n_hosts=10)
+
+    # whatever the writer keeps up with, every step is either on disk or counted as dropped
+    with TrajectoryWriter.create(path, [0, 1], steps_per_chunk=1, chunks_in_flight=1, backpressure="drop") as writer:
+        pop.writer = writer
+        for _ in range(50):
+            pop.update(dt=1)
+        writer.flush()
+        assert writer.n_written + writer.n_dropped == 50
+    pop.writer = None
+
+    with open_trajectories(path) as traj:
+        assert traj.n_steps == writer.n_written
+        times = traj.times.tolist()
+        assert times == sorted(times)
+
+
+def test_writer_hosts(tmp_path):
+    pop = Population.create(n_hosts=10)
+    with pytest.raises(IndexError):
+        pop.writer = TrajectoryWriter.create(str(tmp_path / "out"), [10])
+    with pytest.raises(ValueError):
+        TrajectoryWriter.create(str(tmp_path / "out"), [])
+
+
+if __name__ == "__main__":
+    pytest.main(["-vv", "-s", __file__])